@@ -7,6 +7,7 @@ import (
 	"fmt"
 	"io"
 	"log"
+	"mime"
 	"net/http"
 	"strings"
 	"time"
@@ -167,6 +168,13 @@ func (h *AudioHandler) RateLimitMiddleware(next echo.HandlerFunc) echo.HandlerFu
 	}
 }
 
+// Content types StreamAudio can feed to the speech service (mu-law or raw PCM)
+var streamableAudioTypes = map[string]bool{
+	"audio/basic":              true,
+	"audio/wav":                true,
+	"application/octet-stream": true,
+}
+
 // StreamAudio handles chunked audio streaming
 func (h *AudioHandler) StreamAudio(c echo.Context) error {
 	startTime := time.Now()
@@ -177,6 +185,12 @@ func (h *AudioHandler) StreamAudio(c echo.Context) error {
 		return echo.NewHTTPError(http.StatusBadRequest, "Invalid content type. Expected audio/* or application/octet-stream")
 	}
 
+	// Reject codecs the transcriber cannot decode so clients fall back to the next one they offer
+	mediaType, _, err := mime.ParseMediaType(contentType)
+	if err != nil || !streamableAudioTypes[mediaType] {
+		return echo.NewHTTPError(http.StatusUnsupportedMediaType, "Unsupported audio codec")
+	}
+
 	// Get device info from JWT context
 	deviceID := c.Get("device_id").(string)
 	userID := c.Get("user_id").(int)
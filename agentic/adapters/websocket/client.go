@@ -3,15 +3,18 @@ package websocket
 import (
 	"context"
 	"encoding/base64"
+	"encoding/json"
 	"fmt"
 	"io/ioutil"
 	"sync"
+	"sync/atomic"
 	"time"
 
 	"github.com/gorilla/websocket"
 	"github.com/satriahrh/cocoa-fruit/agentic/adapters/speech"
 	"github.com/satriahrh/cocoa-fruit/agentic/adapters/tts"
 	"github.com/satriahrh/cocoa-fruit/agentic/usecase"
+	"github.com/satriahrh/cocoa-fruit/agentic/utils/cbor"
 	"github.com/satriahrh/cocoa-fruit/agentic/utils/log"
 	"go.uber.org/zap"
 )
@@ -32,6 +35,58 @@ type Client struct {
 	googleTTS     *tts.GoogleTTS
 	inputChan     chan string
 	outputChan    chan string
+
+	// Cancels the response being synthesized (guarded by mu)
+	responseCancel context.CancelFunc
+
+	// Serializes writes: responses and writePump share the connection
+	writeMu      sync.Mutex
+	utteranceSeq uint64
+
+	// Control messages go as tagged CBOR binary frames instead of JSON text
+	// (the doll accepted the "doll-cbor" subprotocol)
+	cbor bool
+
+	// Utterance the doll is streaming up in binary frames (readPump only), and
+	// the one before it, whose frames a replay after a resume may resend
+	uplink     *uplinkUtterance
+	lastUplink *uplinkUtterance
+
+	// Session resume (see resume.go): conn is swapped under mu, connDone stops
+	// the pumps of the current connection and readDone closes when its readPump
+	// has returned
+	resumeToken string
+	connDone    chan struct{}
+	readDone    chan struct{}
+	detachTimer *time.Timer
+}
+
+// UtteranceMarker brackets each TTS response so the doll can tell where one
+// response starts and ends
+type UtteranceMarker struct {
+	Type        string `json:"type"`
+	UtteranceID uint64 `json:"utterance_id"`
+	Bytes       int    `json:"bytes,omitempty"`
+}
+
+func (m UtteranceMarker) cborMap() cbor.Map {
+	fields := cbor.Map{{Key: "type", Value: m.Type}, {Key: "utterance_id", Value: m.UtteranceID}}
+	if m.Bytes != 0 {
+		fields = append(fields, cbor.Pair{Key: "bytes", Value: m.Bytes})
+	}
+	return fields
+}
+
+// outgoingControl is a message to the doll that goes out in the negotiated encoding
+type outgoingControl interface {
+	cborMap() cbor.Map
+}
+
+// ControlMessage is a message from the doll that is not chat input: JSON text, or
+// a tagged CBOR binary frame on the "doll-cbor" subprotocol
+type ControlMessage struct {
+	Type   string `json:"type"`
+	Reason string `json:"reason,omitempty"`
 }
 
 // Message types following your integration platform patterns
@@ -91,7 +146,7 @@ func isPrintableText(data []byte) bool {
 }
 
 // NewClient creates a new WebSocket client
-func NewClient(conn *websocket.Conn, userID int, deviceID, deviceVersion string, chatService *usecase.ChatService, googleSpeech *speech.GoogleSpeech, googleTTS *tts.GoogleTTS) *Client {
+func NewClient(conn *websocket.Conn, resumeToken string, userID int, deviceID, deviceVersion string, chatService *usecase.ChatService, googleSpeech *speech.GoogleSpeech, googleTTS *tts.GoogleTTS) *Client {
 	ctx := context.TODO()
 	ctx = context.WithValue(ctx, "user_id", userID)
 	ctx = context.WithValue(ctx, "device_id", deviceID)
@@ -112,13 +167,14 @@ func NewClient(conn *websocket.Conn, userID int, deviceID, deviceVersion string,
 		googleTTS:     googleTTS,
 		inputChan:     make(chan string, 10),
 		outputChan:    make(chan string, 10),
+		cbor:          conn.Subprotocol() == CBORSubprotocol,
+		resumeToken:   resumeToken,
+		connDone:      make(chan struct{}),
+		readDone:      make(chan struct{}),
 	}
 }
 
 func (c *Client) Run() {
-	// Set up WebSocket handlers
-	c.setupHandlers()
-
 	// Start chat service
 	go c.startChatService()
 
@@ -126,9 +182,7 @@ func (c *Client) Run() {
 	go c.handleChatResponses()
 
 	// Start the goroutines
-	go c.Ping()
-	go c.readPump()
-	go c.writePump()
+	c.startConnection(c.conn, c.connDone, c.readDone)
 
 	go func() {
 		time.Sleep(500 * time.Millisecond)
@@ -136,35 +190,45 @@ func (c *Client) Run() {
 	}()
 }
 
+// startConnection runs the goroutines of one connection until done is closed
+func (c *Client) startConnection(conn *websocket.Conn, done, readDone chan struct{}) {
+	// Set up WebSocket handlers
+	c.setupHandlers(conn)
+
+	go c.Ping(conn, done)
+	go c.readPump(conn, readDone)
+	go c.writePump(conn, done)
+}
+
 // setupHandlers configures all WebSocket message handlers
-func (c *Client) setupHandlers() {
-	c.conn.SetCloseHandler(func(code int, text string) error {
+func (c *Client) setupHandlers(conn *websocket.Conn) {
+	conn.SetCloseHandler(func(code int, text string) error {
 		log.WithCtx(c.ctx).Info("🔌 WebSocket connection closed",
 			zap.Int("code", code),
 			zap.String("text", text),
 			zap.String("device_id", c.ctx.Value("device_id").(string)),
 			zap.Int("user_id", c.ctx.Value("user_id").(int)))
-		c.Close()
+		c.detach(conn)
 		return nil
 	})
 
 	// Handle incoming ping messages - respond with pong
-	c.conn.SetPingHandler(func(appData string) error {
+	conn.SetPingHandler(func(appData string) error {
 		log.WithCtx(c.ctx).Debug("🏓 Received ping from doll",
 			zap.String("ping_data", appData),
 			zap.String("device_id", c.ctx.Value("device_id").(string)),
 			zap.Int("user_id", c.ctx.Value("user_id").(int)))
 		c.incomingPing <- appData
-		return c.conn.WriteControl(websocket.PongMessage, []byte(appData), time.Now().Add(writeWait))
+		return conn.WriteControl(websocket.PongMessage, []byte(appData), time.Now().Add(writeWait))
 	})
 
 	// Handle incoming pong messages - update read deadline
-	c.conn.SetPongHandler(func(appData string) error {
+	conn.SetPongHandler(func(appData string) error {
 		log.WithCtx(c.ctx).Debug("🏓 Received pong from doll",
 			zap.String("pong_data", appData),
 			zap.String("device_id", c.ctx.Value("device_id").(string)),
 			zap.Int("user_id", c.ctx.Value("user_id").(int)))
-		c.conn.SetReadDeadline(time.Now().Add(pongWait))
+		conn.SetReadDeadline(time.Now().Add(pongWait))
 		return nil
 	})
 }
@@ -174,6 +238,11 @@ func (c *Client) Close() {
 	c.mu.Lock()
 	defer c.mu.Unlock()
 
+	c.closeLocked()
+}
+
+// closeLocked ends the session; the caller holds mu
+func (c *Client) closeLocked() {
 	if c.closed {
 		return
 	}
@@ -183,10 +252,24 @@ func (c *Client) Close() {
 		c.cancel()
 	}
 
+	if c.detachTimer != nil {
+		c.detachTimer.Stop()
+		c.detachTimer = nil
+	}
+
 	if c.conn != nil {
 		c.conn.Close()
 	}
 
+	// Once the last readPump has returned, the utterance is ended here
+	select {
+	case <-c.readDone:
+		if c.uplink != nil {
+			c.endUplink()
+		}
+	default:
+	}
+
 	if c.send != nil {
 		close(c.send)
 	}
@@ -223,9 +306,16 @@ func (c *Client) handleChatResponses() {
 					zap.String("device_id", c.deviceID),
 					zap.Int("user_id", c.userID))
 
-				// Start streaming synthesis
-				audioChan, err := c.googleTTS.Synthesize(c.ctx, response)
+				// Start streaming synthesis; a cancel from the doll aborts it
+				responseCtx := c.beginResponse()
+				audioChan, err := c.googleTTS.Synthesize(responseCtx, response)
+				if responseCtx.Err() != nil {
+					log.WithCtx(c.ctx).Info("🛑 Dropping cancelled response", zap.String("response", response))
+					c.endResponse()
+					continue
+				}
 				if err != nil {
+					c.endResponse()
 					log.WithCtx(c.ctx).Error("❌ Failed to start audio synthesis", zap.Error(err))
 					// Fallback to text if TTS fails
 					if err := c.SendMessage([]byte(response)); err != nil {
@@ -243,12 +333,15 @@ func (c *Client) handleChatResponses() {
 				// ...existing code...
 				if audioChan == nil {
 					log.WithCtx(c.ctx).Error("❌ Audio synthesis error")
+					c.endResponse()
 					continue
 				}
 				// ...existing code...
 				// ...existing code...
 
-				if err := c.conn.WriteMessage(websocket.BinaryMessage, audioChan); err != nil {
+				err = c.sendUtterance(audioChan)
+				c.endResponse()
+				if err != nil {
 					// ...existing code...
 					continue
 				}
@@ -260,6 +353,126 @@ func (c *Client) handleChatResponses() {
 	}
 }
 
+// writeFrame writes one message with the write deadline
+func (c *Client) writeFrame(messageType int, data []byte) error {
+	c.writeMu.Lock()
+	defer c.writeMu.Unlock()
+
+	c.mu.RLock()
+	conn := c.conn
+	c.mu.RUnlock()
+	if conn == nil {
+		return errDetached
+	}
+
+	conn.SetWriteDeadline(time.Now().Add(writeWait))
+	return conn.WriteMessage(messageType, data)
+}
+
+// writeControl writes a control message as CBOR or JSON, whichever was negotiated
+func (c *Client) writeControl(message outgoingControl) error {
+	if c.cbor {
+		data, err := cbor.Marshal(message.cborMap())
+		if err != nil {
+			return err
+		}
+		return c.writeFrame(websocket.BinaryMessage, data)
+	}
+
+	data, err := json.Marshal(message)
+	if err != nil {
+		return err
+	}
+	return c.writeFrame(websocket.TextMessage, data)
+}
+
+// sendUtterance writes one TTS response between tts_start and tts_end markers
+func (c *Client) sendUtterance(audio []byte) error {
+	id := atomic.AddUint64(&c.utteranceSeq, 1)
+
+	if err := c.writeControl(UtteranceMarker{Type: "tts_start", UtteranceID: id, Bytes: len(audio)}); err != nil {
+		return err
+	}
+
+	if err := c.writeFrame(websocket.BinaryMessage, audio); err != nil {
+		return err
+	}
+
+	return c.writeControl(UtteranceMarker{Type: "tts_end", UtteranceID: id})
+}
+
+// beginResponse returns the context a response is synthesized and sent under
+func (c *Client) beginResponse() context.Context {
+	ctx, cancel := context.WithCancel(c.ctx)
+
+	c.mu.Lock()
+	c.responseCancel = cancel
+	c.mu.Unlock()
+
+	return ctx
+}
+
+// endResponse releases the response context
+func (c *Client) endResponse() {
+	c.mu.Lock()
+	if c.responseCancel != nil {
+		c.responseCancel()
+		c.responseCancel = nil
+	}
+	c.mu.Unlock()
+}
+
+// CancelResponse drops the response in progress and any queued behind it; the doll
+// sends this when the user talks over the TTS (barge-in)
+func (c *Client) CancelResponse(reason string) {
+	c.endResponse()
+
+	dropped := 0
+	for {
+		select {
+		case <-c.outputChan:
+			dropped++
+			continue
+		default:
+		}
+		break
+	}
+
+	log.WithCtx(c.ctx).Info("🛑 Response cancelled by doll",
+		zap.String("reason", reason),
+		zap.Int("dropped_responses", dropped),
+		zap.String("device_id", c.deviceID),
+		zap.Int("user_id", c.userID))
+}
+
+// parseControlMessage recognizes control messages among the doll's text messages
+func parseControlMessage(message []byte) (ControlMessage, bool) {
+	var control ControlMessage
+	if len(message) == 0 || message[0] != '{' {
+		return control, false
+	}
+	if err := json.Unmarshal(message, &control); err != nil {
+		return control, false
+	}
+	return control, control.Type == "cancel"
+}
+
+// parseCBORControlMessage recognizes control messages among the doll's binary
+// messages on the "doll-cbor" subprotocol
+func parseCBORControlMessage(message []byte) (ControlMessage, bool) {
+	var control ControlMessage
+	if !cbor.IsTagged(message) {
+		return control, false
+	}
+	fields, err := cbor.Unmarshal(message)
+	if err != nil {
+		return control, false
+	}
+	control.Type, _ = fields.String("type")
+	control.Reason, _ = fields.String("reason")
+	return control, control.Type == "cancel"
+}
+
 // SendInput sends input to the chat service
 func (c *Client) SendInput(input string) error {
 	select {
@@ -272,7 +485,7 @@ func (c *Client) SendInput(input string) error {
 	}
 }
 
-func (c *Client) Ping() {
+func (c *Client) Ping(conn *websocket.Conn, done chan struct{}) {
 	for {
 		select {
 		case <-c.incomingPing:
@@ -282,21 +495,15 @@ func (c *Client) Ping() {
 				return
 			}
 
-			c.mu.RLock()
-			conn := c.conn
-			c.mu.RUnlock()
-
-			if conn == nil {
-				log.WithCtx(c.ctx).Debug("Connection is nil, stopping ping routine")
-				return
-			}
-
 			if err := conn.WriteControl(websocket.PingMessage, []byte{}, time.Now().Add(writeWait)); err != nil {
 				log.WithCtx(c.ctx).Error("Failed to send ping", zap.Error(err))
-				c.Close() // Close the connection on ping failure
+				c.detach(conn) // Drop the connection on ping failure
 				return
 			}
 			log.WithCtx(c.ctx).Debug("Ping sent")
+		case <-done:
+			log.WithCtx(c.ctx).Debug("Connection ended, stopping ping routine")
+			return
 		case <-c.ctx.Done():
 			log.WithCtx(c.ctx).Debug("Context cancelled, stopping ping routine")
 			return
@@ -305,18 +512,27 @@ func (c *Client) Ping() {
 }
 
 // readPump handles incoming WebSocket messages
-func (c *Client) readPump() {
-	defer c.Close()
+func (c *Client) readPump(conn *websocket.Conn, readDone chan struct{}) {
+	defer func() {
+		// The session waits for a resume; the utterance only ends with it
+		c.detach(conn)
+		c.mu.Lock()
+		if c.closed && c.uplink != nil {
+			c.endUplink()
+		}
+		close(readDone)
+		c.mu.Unlock()
+	}()
 
-	c.conn.SetReadLimit(maxMessageSize)
-	c.conn.SetReadDeadline(time.Now().Add(pongWait))
+	conn.SetReadLimit(maxMessageSize)
+	conn.SetReadDeadline(time.Now().Add(pongWait))
 
 	for {
 		if c.IsClosed() {
 			return
 		}
 
-		messageType, message, err := c.conn.ReadMessage()
+		messageType, message, err := conn.ReadMessage()
 		if err != nil {
 			if websocket.IsUnexpectedCloseError(err, websocket.CloseGoingAway, websocket.CloseAbnormalClosure) {
 				log.WithCtx(c.ctx).Error("❌ WebSocket read error",
@@ -334,6 +550,22 @@ func (c *Client) readPump() {
 			messagePreview = messagePreview[:50] + "..."
 		}
 
+		// Frames of a streamed utterance are reassembled; any other binary message is a whole clip
+		if messageType == websocket.BinaryMessage && c.handleUplinkFrame(message) {
+			continue
+		}
+
+		// Barge-in in CBOR; any other tagged message is not audio either
+		if messageType == websocket.BinaryMessage && c.cbor && cbor.IsTagged(message) {
+			if control, ok := parseCBORControlMessage(message); ok {
+				c.CancelResponse(control.Reason)
+			} else {
+				log.WithCtx(c.ctx).Warn("⚠️ Ignoring CBOR control message",
+					zap.Int("message_length", len(message)))
+			}
+			continue
+		}
+
 		// Check if it's binary audio data (binary message type or large binary message)
 		if messageType == websocket.BinaryMessage || (len(message) > 1000 && !isPrintableText(message)) {
 			msgType = "audio"
@@ -389,6 +621,12 @@ func (c *Client) readPump() {
 			zap.String("device_id", c.ctx.Value("device_id").(string)),
 			zap.Int("user_id", c.ctx.Value("user_id").(int)))
 
+		// Barge-in: stop the response instead of treating this as chat input
+		if control, ok := parseControlMessage(message); ok {
+			c.CancelResponse(control.Reason)
+			continue
+		}
+
 		// Handle as regular text message
 		if err := c.SendInput(string(message)); err != nil {
 			log.WithCtx(c.ctx).Error("❌ Failed to send message to chat service", zap.Error(err))
@@ -397,11 +635,11 @@ func (c *Client) readPump() {
 }
 
 // writePump handles outgoing WebSocket messages
-func (c *Client) writePump() {
+func (c *Client) writePump(conn *websocket.Conn, done chan struct{}) {
 	ticker := time.NewTicker(pingPeriod)
 	defer func() {
 		ticker.Stop()
-		c.Close()
+		c.detach(conn)
 	}()
 
 	for {
@@ -411,13 +649,12 @@ func (c *Client) writePump() {
 				return
 			}
 
-			c.conn.SetWriteDeadline(time.Now().Add(writeWait))
 			if !ok {
-				c.conn.WriteMessage(websocket.CloseMessage, []byte{})
+				c.writeFrame(websocket.CloseMessage, []byte{})
 				return
 			}
 
-			if err := c.conn.WriteMessage(websocket.TextMessage, message); err != nil {
+			if err := c.writeFrame(websocket.TextMessage, message); err != nil {
 				log.WithCtx(c.ctx).Error("❌ Failed to write message to doll",
 					zap.Error(err),
 					zap.String("device_id", c.ctx.Value("device_id").(string)),
@@ -437,6 +674,8 @@ func (c *Client) writePump() {
 				zap.String("device_id", c.ctx.Value("device_id").(string)),
 				zap.Int("user_id", c.ctx.Value("user_id").(int)))
 
+		case <-done:
+			return
 		case <-c.ctx.Done():
 			return
 		}
@@ -2,6 +2,7 @@ package websocket
 
 import (
 	"fmt"
+	"net/http"
 	"strings"
 
 	"github.com/golang-jwt/jwt/v5"
@@ -66,16 +67,54 @@ func (s *Server) JWTMiddleware(next echo.HandlerFunc) echo.HandlerFunc {
 
 // Handler returns an http.Handler for your "/ws" endpoint.
 func (s *Server) Handler(c echo.Context) error {
-	conn, err := s.upgrader.Upgrade(c.Response(), c.Request(), nil)
+	userID := c.Get("user_id").(int)
+	deviceID := c.Get("device_id").(string)
+	deviceVersion := c.Get("device_version").(string)
+
+	// Tell the doll which codecs it may stream utterances up in
+	header := http.Header{}
+	header.Set(UplinkHeader, UplinkCodecs)
+
+	// A doll that lost its connection picks its session back up
+	if token := c.Request().Header.Get(ResumeTokenHeader); token != "" {
+		if client := s.hub.GetClientByDevice(deviceID); client != nil && client.ResumeToken() == token {
+			header.Set(ResumeTokenHeader, token)
+			header.Set(ResumedHeader, "1")
+
+			conn, err := s.upgrader.Upgrade(c.Response(), c.Request(), header)
+			if err != nil {
+				log.WithCtx(c.Request().Context()).Error("❌ Failed to upgrade connection to WebSocket", zap.Error(err))
+				return err
+			}
+
+			// The session expired meanwhile; the doll reconnects without it
+			if !client.Resume(conn) {
+				conn.Close()
+			}
+			return nil
+		}
+	}
+
+	// A new session replaces one still waiting for its doll to come back
+	if client := s.hub.GetClientByDevice(deviceID); client != nil && client.IsDetached() {
+		log.WithCtx(c.Request().Context()).Info("♻️ Replacing the session the doll did not resume",
+			zap.String("device_id", deviceID))
+		client.Close()
+	}
+
+	resumeToken, err := newResumeToken()
+	if err != nil {
+		log.WithCtx(c.Request().Context()).Error("❌ Failed to create resume token", zap.Error(err))
+		return echo.NewHTTPError(500, "Failed to create session")
+	}
+	header.Set(ResumeTokenHeader, resumeToken)
+
+	conn, err := s.upgrader.Upgrade(c.Response(), c.Request(), header)
 	if err != nil {
 		log.WithCtx(c.Request().Context()).Error("❌ Failed to upgrade connection to WebSocket", zap.Error(err))
 		return err
 	}
 
-	userID := c.Get("user_id").(int)
-	deviceID := c.Get("device_id").(string)
-	deviceVersion := c.Get("device_version").(string)
-
 	// Check if device is already connected
 	if s.hub.IsDeviceConnected(deviceID) {
 		log.WithCtx(c.Request().Context()).Warn("⚠️ Device already connected, rejecting duplicate connection",
@@ -91,7 +130,7 @@ func (s *Server) Handler(c echo.Context) error {
 		zap.String("device_version", deviceVersion),
 		zap.String("remote_addr", c.Request().RemoteAddr))
 
-	client := NewClient(conn, userID, deviceID, deviceVersion, s.svc, s.googleSpeech, s.googleTTS)
+	client := NewClient(conn, resumeToken, userID, deviceID, deviceVersion, s.svc, s.googleSpeech, s.googleTTS)
 	s.hub.Register(client)
 
 	// Start the client goroutines
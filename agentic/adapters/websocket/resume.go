@@ -0,0 +1,116 @@
+package websocket
+
+import (
+	"crypto/rand"
+	"errors"
+	"fmt"
+	"time"
+
+	"github.com/gorilla/websocket"
+	"github.com/satriahrh/cocoa-fruit/agentic/utils/log"
+	"go.uber.org/zap"
+)
+
+// A session outlives its connection for resumeGrace. The handshake answer carries
+// a resume token; a reconnect that sends it back within the grace period gets
+// X-Resumed: 1 and the same Client: the chat history, the responses still queued
+// and the utterance being streamed up carry on.
+const (
+	ResumeTokenHeader = "X-Resume-Token"
+	ResumedHeader     = "X-Resumed"
+
+	resumeGrace = 30 * time.Second
+)
+
+// errDetached is returned by writes while the doll is reconnecting
+var errDetached = errors.New("websocket: session has no connection")
+
+// newResumeToken returns a random token for a new session
+func newResumeToken() (string, error) {
+	token := make([]byte, 16)
+	if _, err := rand.Read(token); err != nil {
+		return "", err
+	}
+	return fmt.Sprintf("%x", token), nil
+}
+
+// ResumeToken returns the token a reconnect presents to pick this session up
+func (c *Client) ResumeToken() string {
+	return c.resumeToken
+}
+
+// IsDetached returns true while the session waits for the doll to reconnect
+func (c *Client) IsDetached() bool {
+	c.mu.RLock()
+	defer c.mu.RUnlock()
+	return !c.closed && c.conn == nil
+}
+
+// Resume attaches a new connection to the session. Returns false if the session
+// has ended meanwhile.
+func (c *Client) Resume(conn *websocket.Conn) bool {
+	c.mu.Lock()
+	if c.closed {
+		c.mu.Unlock()
+		return false
+	}
+	if c.detachTimer != nil {
+		c.detachTimer.Stop()
+		c.detachTimer = nil
+	}
+
+	// The old connection may still look alive to us; it is replaced
+	if c.conn != nil {
+		close(c.connDone)
+		c.conn.Close()
+	}
+	readDone := c.readDone
+	c.conn = conn
+	c.connDone = make(chan struct{})
+	c.readDone = make(chan struct{})
+	done, newReadDone := c.connDone, c.readDone
+	c.mu.Unlock()
+
+	// The uplink state is readPump's: the old one must be gone first
+	<-readDone
+	c.startConnection(conn, done, newReadDone)
+
+	log.WithCtx(c.ctx).Info("🔁 Doll resumed its session",
+		zap.String("device_id", c.deviceID),
+		zap.Int("user_id", c.userID))
+	return true
+}
+
+// detach drops a connection that ended and holds the session for a reconnect.
+// Calls for a connection that was already replaced are ignored.
+func (c *Client) detach(conn *websocket.Conn) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+
+	if c.closed || c.conn != conn {
+		return
+	}
+	c.conn = nil
+	close(c.connDone)
+	conn.Close()
+	c.detachTimer = time.AfterFunc(resumeGrace, c.expire)
+
+	log.WithCtx(c.ctx).Info("🔌 Connection lost, holding the session for a resume",
+		zap.Duration("grace", resumeGrace),
+		zap.String("device_id", c.deviceID),
+		zap.Int("user_id", c.userID))
+}
+
+// expire ends a session the doll did not come back for
+func (c *Client) expire() {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+
+	if c.closed || c.conn != nil {
+		return
+	}
+	log.WithCtx(c.ctx).Info("⌛ Session not resumed, closing it",
+		zap.String("device_id", c.deviceID),
+		zap.Int("user_id", c.userID))
+	c.closeLocked()
+}
@@ -16,6 +16,10 @@ import (
 
 const (
 	TranscriptionTopic = "transcription.results"
+
+	// Subprotocols in order of preference: control messages in CBOR, or JSON
+	CBORSubprotocol = "doll-cbor"
+	JSONSubprotocol = "websocket"
 )
 
 type Server struct {
@@ -31,7 +35,10 @@ func NewServer(svc *usecase.ChatService, googleTTS *tts.GoogleTTS, googleSpeech
 	hub := NewHub()
 
 	server := &Server{
-		upgrader:      websocket.Upgrader{CheckOrigin: func(r *http.Request) bool { return true }},
+		upgrader: websocket.Upgrader{
+			Subprotocols: []string{CBORSubprotocol, JSONSubprotocol},
+			CheckOrigin:  func(r *http.Request) bool { return true },
+		},
 		svc:           svc,
 		googleTTS:     googleTTS,
 		googleSpeech:  googleSpeech,
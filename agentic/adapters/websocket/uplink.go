@@ -0,0 +1,258 @@
+package websocket
+
+import (
+	"context"
+	"encoding/binary"
+
+	"github.com/satriahrh/cocoa-fruit/agentic/utils/cbor"
+	"github.com/satriahrh/cocoa-fruit/agentic/utils/log"
+	"go.uber.org/zap"
+)
+
+// The doll streams an utterance as sequenced binary frames with a 12 byte
+// big-endian header: type, codec id, utterance (16 bit), sequence (32 bit) and
+// timestamp (32 bit, in samples). A begin frame carries the 32-bit sample rate.
+const (
+	uplinkHeaderBytes = 12
+	uplinkBeginBytes  = uplinkHeaderBytes + 4
+
+	uplinkFrameAudio = 1
+	uplinkFrameBegin = 2
+	uplinkFrameEnd   = 3
+
+	uplinkCodecMulaw  = 0
+	uplinkSampleRate  = 8000 // What TranscribeStreaming is configured for
+	uplinkAudioBuffer = 100  // Frames waiting for the speech stream
+	uplinkAckFrames   = 25   // Frames between acks; the doll holds them for a replay until then
+
+	// Advertised in the handshake response; the doll only streams frames in a
+	// codec listed here and uses the HTTP upload otherwise
+	UplinkHeader = "X-Doll-Uplink"
+	UplinkCodecs = "mulaw"
+)
+
+// uplinkFrame is the parsed header of one uplink frame
+type uplinkFrame struct {
+	Type      byte
+	Codec     byte
+	Utterance uint16
+	Sequence  uint32
+	Timestamp uint32
+	Payload   []byte
+}
+
+// uplinkUtterance is the utterance being streamed in (readPump only)
+type uplinkUtterance struct {
+	id      uint16
+	nextSeq uint32
+	audio   chan []byte
+	unacked int // Frames taken since the last ack
+}
+
+// UplinkAck releases every frame of the utterance up to and including Sequence
+// from the doll's replay window
+type UplinkAck struct {
+	Type        string `json:"type"`
+	UtteranceID uint64 `json:"utterance_id"`
+	Sequence    uint32 `json:"sequence"`
+}
+
+func (a UplinkAck) cborMap() cbor.Map {
+	return cbor.Map{
+		{Key: "type", Value: a.Type},
+		{Key: "utterance_id", Value: a.UtteranceID},
+		{Key: "sequence", Value: a.Sequence},
+	}
+}
+
+func parseUplinkFrame(message []byte) uplinkFrame {
+	return uplinkFrame{
+		Type:      message[0],
+		Codec:     message[1],
+		Utterance: binary.BigEndian.Uint16(message[2:4]),
+		Sequence:  binary.BigEndian.Uint32(message[4:8]),
+		Timestamp: binary.BigEndian.Uint32(message[8:12]),
+		Payload:   message[uplinkHeaderBytes:],
+	}
+}
+
+// isUplinkBegin recognizes the begin frame of a streamed utterance; a binary
+// message that is not one (or part of the open one) is a whole clip
+func isUplinkBegin(message []byte) bool {
+	if len(message) != uplinkBeginBytes || message[0] != uplinkFrameBegin {
+		return false
+	}
+	frame := parseUplinkFrame(message)
+	return frame.Codec == uplinkCodecMulaw && frame.Sequence == 0 &&
+		binary.BigEndian.Uint32(frame.Payload) == uplinkSampleRate
+}
+
+// handleUplinkFrame takes a binary message as part of a streamed utterance.
+// Returns false if it is not one, so the caller treats it as a clip.
+func (c *Client) handleUplinkFrame(message []byte) bool {
+	if isUplinkBegin(message) {
+		frame := parseUplinkFrame(message)
+		if c.resentUplink(frame) == nil {
+			c.beginUplink(frame)
+		}
+		return true
+	}
+
+	if len(message) < uplinkHeaderBytes {
+		return false
+	}
+	frame := parseUplinkFrame(message)
+	if frame.Type != uplinkFrameAudio && frame.Type != uplinkFrameEnd {
+		return false
+	}
+
+	// A replay after a resume resends what may already be here. The end frame
+	// of an utterance that already ended is acked again: the first ack may
+	// have been lost with the connection.
+	if resent := c.resentUplink(frame); resent != nil {
+		log.WithCtx(c.ctx).Debug("🔁 Dropping duplicate uplink frame",
+			zap.Int("utterance_id", int(frame.Utterance)),
+			zap.Int("sequence", int(frame.Sequence)))
+		if frame.Type == uplinkFrameEnd && resent != c.uplink {
+			c.ackUplink(resent)
+		}
+		return true
+	}
+
+	u := c.uplink
+	if u == nil || frame.Utterance != u.id {
+		return false
+	}
+	if frame.Sequence > u.nextSeq {
+		log.WithCtx(c.ctx).Warn("⚠️ Uplink frames missing",
+			zap.Int("utterance_id", int(frame.Utterance)),
+			zap.Int("expected", int(u.nextSeq)),
+			zap.Int("sequence", int(frame.Sequence)))
+	}
+	u.nextSeq = frame.Sequence + 1
+	u.unacked++
+
+	if frame.Type == uplinkFrameEnd {
+		c.ackUplink(u)
+		c.endUplink()
+		return true
+	}
+	if u.unacked >= uplinkAckFrames {
+		c.ackUplink(u)
+	}
+
+	if frame.Codec != uplinkCodecMulaw || len(frame.Payload) == 0 {
+		return true
+	}
+	select {
+	case u.audio <- mulawToLinear16(frame.Payload):
+	default:
+		log.WithCtx(c.ctx).Warn("⚠️ Speech stream is behind, dropping uplink audio",
+			zap.Int("utterance_id", int(frame.Utterance)),
+			zap.Int("bytes", len(frame.Payload)))
+	}
+	return true
+}
+
+// resentUplink returns the utterance a frame was already taken for, if any
+func (c *Client) resentUplink(frame uplinkFrame) *uplinkUtterance {
+	for _, u := range []*uplinkUtterance{c.uplink, c.lastUplink} {
+		if u != nil && u.id == frame.Utterance && frame.Sequence < u.nextSeq {
+			return u
+		}
+	}
+	return nil
+}
+
+// beginUplink opens an utterance and starts transcribing it as it arrives
+func (c *Client) beginUplink(frame uplinkFrame) {
+	if c.uplink != nil {
+		log.WithCtx(c.ctx).Warn("⚠️ Uplink utterance replaced before its end frame",
+			zap.Int("utterance_id", int(c.uplink.id)))
+		c.endUplink()
+	}
+
+	u := &uplinkUtterance{
+		id:      frame.Utterance,
+		nextSeq: 1,
+		audio:   make(chan []byte, uplinkAudioBuffer),
+	}
+	c.uplink = u
+
+	log.WithCtx(c.ctx).Info("🎤 Streaming utterance started",
+		zap.Int("utterance_id", int(u.id)),
+		zap.String("device_id", c.deviceID),
+		zap.Int("user_id", c.userID))
+
+	go c.transcribeUplink(u)
+}
+
+// endUplink closes the open utterance; its transcript goes to the chat service
+func (c *Client) endUplink() {
+	close(c.uplink.audio)
+	c.lastUplink = c.uplink
+	c.uplink = nil
+}
+
+// ackUplink acknowledges every frame of the utterance taken so far
+func (c *Client) ackUplink(u *uplinkUtterance) {
+	u.unacked = 0
+	ack := UplinkAck{Type: "uplink_ack", UtteranceID: uint64(u.id), Sequence: u.nextSeq - 1}
+	if err := c.writeControl(ack); err != nil {
+		log.WithCtx(c.ctx).Error("❌ Failed to acknowledge uplink frames",
+			zap.Error(err),
+			zap.Int("utterance_id", int(u.id)),
+			zap.Int("sequence", int(ack.Sequence)))
+	}
+}
+
+// transcribeUplink runs the streaming transcription of one utterance
+func (c *Client) transcribeUplink(u *uplinkUtterance) {
+	transcript, err := c.googleSpeech.TranscribeStreaming(c.ctx, u.audio)
+
+	// Whatever the stream did not take must not block readPump
+	for range u.audio {
+	}
+
+	if err != nil {
+		if c.ctx.Err() == context.Canceled {
+			return
+		}
+		log.WithCtx(c.ctx).Error("❌ Failed to transcribe streamed utterance",
+			zap.Error(err),
+			zap.Int("utterance_id", int(u.id)))
+		return
+	}
+
+	if transcript == "" {
+		log.WithCtx(c.ctx).Warn("⚠️ Streamed utterance transcription returned empty result",
+			zap.Int("utterance_id", int(u.id)))
+		return
+	}
+
+	log.WithCtx(c.ctx).Info("✅ Streamed utterance transcribed",
+		zap.String("transcript", transcript),
+		zap.Int("utterance_id", int(u.id)),
+		zap.String("device_id", c.deviceID),
+		zap.Int("user_id", c.userID))
+
+	if err := c.SendInput(transcript); err != nil {
+		log.WithCtx(c.ctx).Error("❌ Failed to send transcript to chat service", zap.Error(err))
+	}
+}
+
+// mulawToLinear16 expands G.711 mu-law to the little-endian LINEAR16 the
+// speech stream expects
+func mulawToLinear16(mulaw []byte) []byte {
+	pcm := make([]byte, 2*len(mulaw))
+	for i, u := range mulaw {
+		u = ^u
+		t := (int(u&0x0F)<<3 + 0x84) << ((u & 0x70) >> 4)
+		sample := t - 0x84
+		if u&0x80 != 0 {
+			sample = 0x84 - t
+		}
+		binary.LittleEndian.PutUint16(pcm[2*i:], uint16(int16(sample)))
+	}
+	return pcm
+}
@@ -0,0 +1,266 @@
+// Package cbor encodes and decodes the CBOR (RFC 8949) control messages the doll
+// speaks on the "doll-cbor" subprotocol: one definite-length map of text keys to
+// text or unsigned values, behind the self-describe tag.
+package cbor
+
+import (
+	"encoding/binary"
+	"errors"
+)
+
+const (
+	majorUnsigned = 0
+	majorNegative = 1
+	majorBytes    = 2
+	majorText     = 3
+	majorArray    = 4
+	majorMap      = 5
+	majorTag      = 6
+	majorSimple   = 7
+
+	maxDepth = 16
+)
+
+// SelfDescribe is the tag (55799) that tells a control frame from binary audio
+var SelfDescribe = []byte{0xd9, 0xd9, 0xf7}
+
+var ErrMalformed = errors.New("cbor: malformed or truncated item")
+
+// Pair is one map entry; Value is a string or an unsigned integer
+type Pair struct {
+	Key   string
+	Value interface{}
+}
+
+// Map keeps its entries in order, so the encoding is stable
+type Map []Pair
+
+// String returns the text value of key
+func (m Map) String(key string) (string, bool) {
+	for _, p := range m {
+		if p.Key == key {
+			s, ok := p.Value.(string)
+			return s, ok
+		}
+	}
+	return "", false
+}
+
+// Uint returns the unsigned value of key
+func (m Map) Uint(key string) (uint64, bool) {
+	for _, p := range m {
+		if p.Key == key {
+			n, ok := p.Value.(uint64)
+			return n, ok
+		}
+	}
+	return 0, false
+}
+
+// IsTagged reports whether data starts with the self-describe tag
+func IsTagged(data []byte) bool {
+	return len(data) >= len(SelfDescribe) &&
+		data[0] == SelfDescribe[0] && data[1] == SelfDescribe[1] && data[2] == SelfDescribe[2]
+}
+
+// Marshal encodes m as a tagged map. Values must be strings or unsigned integers
+// (int values must not be negative).
+func Marshal(m Map) ([]byte, error) {
+	out := append([]byte{}, SelfDescribe...)
+	out = appendHead(out, majorMap, uint64(len(m)))
+	for _, p := range m {
+		out = appendText(out, p.Key)
+		switch v := p.Value.(type) {
+		case string:
+			out = appendText(out, v)
+		case uint64:
+			out = appendHead(out, majorUnsigned, v)
+		case uint32:
+			out = appendHead(out, majorUnsigned, uint64(v))
+		case int:
+			if v < 0 {
+				return nil, errors.New("cbor: negative value for " + p.Key)
+			}
+			out = appendHead(out, majorUnsigned, uint64(v))
+		default:
+			return nil, errors.New("cbor: unsupported value for " + p.Key)
+		}
+	}
+	return out, nil
+}
+
+// Unmarshal decodes one map, optionally tagged. Text and unsigned values are
+// kept; entries with other keys or values are skipped.
+func Unmarshal(data []byte) (Map, error) {
+	r := reader{data: data}
+	if IsTagged(data) {
+		r.offset = len(SelfDescribe)
+	}
+
+	major, pairs, err := r.head()
+	if err != nil {
+		return nil, err
+	}
+	if major != majorMap {
+		return nil, errors.New("cbor: not a map")
+	}
+
+	var m Map
+	for i := uint64(0); i < pairs; i++ {
+		key, isText, err := r.text()
+		if err != nil {
+			return nil, err
+		}
+		if !isText {
+			if err := r.skip(0); err != nil {
+				return nil, err
+			}
+		}
+
+		value, err := r.value()
+		if err != nil {
+			return nil, err
+		}
+		if isText && value != nil {
+			m = append(m, Pair{Key: key, Value: value})
+		}
+	}
+
+	// Exactly one item
+	if r.offset != len(r.data) {
+		return nil, ErrMalformed
+	}
+	return m, nil
+}
+
+func appendHead(out []byte, major byte, argument uint64) []byte {
+	major <<= 5
+	switch {
+	case argument < 24:
+		return append(out, major|byte(argument))
+	case argument <= 0xff:
+		return append(out, major|24, byte(argument))
+	case argument <= 0xffff:
+		return binary.BigEndian.AppendUint16(append(out, major|25), uint16(argument))
+	case argument <= 0xffffffff:
+		return binary.BigEndian.AppendUint32(append(out, major|26), uint32(argument))
+	default:
+		return binary.BigEndian.AppendUint64(append(out, major|27), argument)
+	}
+}
+
+func appendText(out []byte, text string) []byte {
+	return append(appendHead(out, majorText, uint64(len(text))), text...)
+}
+
+type reader struct {
+	data   []byte
+	offset int
+}
+
+// head reads the major type and argument of the next item; indefinite lengths
+// are rejected
+func (r *reader) head() (byte, uint64, error) {
+	if r.offset >= len(r.data) {
+		return 0, 0, ErrMalformed
+	}
+	initial := r.data[r.offset]
+	r.offset++
+
+	major, info := initial>>5, initial&0x1f
+	if info < 24 {
+		return major, uint64(info), nil
+	}
+	if info > 27 {
+		return 0, 0, ErrMalformed
+	}
+
+	size := 1 << (info - 24)
+	if len(r.data)-r.offset < size {
+		return 0, 0, ErrMalformed
+	}
+	var argument uint64
+	for _, b := range r.data[r.offset : r.offset+size] {
+		argument = argument<<8 | uint64(b)
+	}
+	r.offset += size
+	return major, argument, nil
+}
+
+// take returns the next n bytes of a string
+func (r *reader) take(n uint64) ([]byte, error) {
+	if n > uint64(len(r.data)-r.offset) {
+		return nil, ErrMalformed
+	}
+	b := r.data[r.offset : r.offset+int(n)]
+	r.offset += int(n)
+	return b, nil
+}
+
+// text reads a text key; anything else is left in place for skip
+func (r *reader) text() (string, bool, error) {
+	if r.offset >= len(r.data) {
+		return "", false, ErrMalformed
+	}
+	if r.data[r.offset]>>5 != majorText {
+		return "", false, nil
+	}
+	_, length, err := r.head()
+	if err != nil {
+		return "", false, err
+	}
+	b, err := r.take(length)
+	if err != nil {
+		return "", false, err
+	}
+	return string(b), true, nil
+}
+
+// value reads a text or unsigned value, and skips (returning nil) any other
+func (r *reader) value() (interface{}, error) {
+	if r.offset >= len(r.data) {
+		return nil, ErrMalformed
+	}
+	switch r.data[r.offset] >> 5 {
+	case majorText:
+		s, _, err := r.text()
+		return s, err
+	case majorUnsigned:
+		_, n, err := r.head()
+		return n, err
+	default:
+		return nil, r.skip(0)
+	}
+}
+
+// skip steps over the next item, whatever it holds
+func (r *reader) skip(depth int) error {
+	if depth > maxDepth {
+		return ErrMalformed
+	}
+	major, argument, err := r.head()
+	if err != nil {
+		return err
+	}
+
+	switch major {
+	case majorBytes, majorText:
+		_, err = r.take(argument)
+		return err
+	case majorArray, majorMap:
+		items := argument
+		if major == majorMap {
+			items *= 2
+		}
+		for i := uint64(0); i < items; i++ {
+			if err := r.skip(depth + 1); err != nil {
+				return err
+			}
+		}
+		return nil
+	case majorTag:
+		return r.skip(depth + 1)
+	default:
+		return nil
+	}
+}
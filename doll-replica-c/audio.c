@@ -1,123 +1,430 @@
 #include "audio.h"
+#include "barge_in.h"
+#include "base64.h"
+#include "capture.h"
+#include "clip_player.h"
+#include "downlink.h"
+#include "g711.h"
+#include "metrics.h"
+#include "trace.h"
 #include "utils.h"
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
+#include <stdint.h>
+#include <time.h>
 #include <pthread.h>
+#include <stdatomic.h>
 
-static PaStream *audio_stream = NULL;
-static PaStream *recording_stream = NULL;
+// One duplex stream, opened at startup and never stopped: recording and playback
+// are switched on and off in the callback instead of opening streams on demand
+static PaStream *duplex_stream = NULL;
+static int duplex_has_input = 0;
+static atomic_int capture_enabled = 0;
+static atomic_int callback_busy = 0;    // Set while the callback runs, see wait_for_callback()
 static int audio_initialized = 0;
 static int recording_active = 0;
 
-// Recording buffer
-static unsigned char *recording_buffer = NULL;
-static size_t recording_buffer_size = 0;
-static size_t recording_buffer_used = 0;
-static size_t max_recording_size;
+// Segmented recording, filled by the uplink thread from the capture ring
+static recording_t *current_recording = NULL;
+static int streaming_capture_active = 0;
 
-// Streaming callback
-static audio_chunk_callback streaming_callback = NULL;
+// Serializes start/stop: the uplink thread stops recordings on end of utterance
+static pthread_mutex_t recording_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 // Streaming audio playback variables
 static int streaming_audio_active = 0;
-static unsigned char *streaming_audio_buffer = NULL;
-static size_t streaming_audio_buffer_size = 0;
-static size_t streaming_audio_buffer_used = 0;
-static pthread_mutex_t streaming_audio_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t streaming_audio_cond = PTHREAD_COND_INITIALIZER;
-
-// Ring buffer for smooth streaming
-static AudioRingBuffer *streaming_ring_buffer = NULL;
-static PaStream *streaming_stream = NULL;
-
-// Base64 decoding table (same as in utils.c)
-static const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-
-// Recording callback function
-static int recording_callback(const void *inputBuffer, void *outputBuffer,
-                             unsigned long framesPerBuffer,
-                             const PaStreamCallbackTimeInfo *timeInfo,
-                             PaStreamCallbackFlags statusFlags,
-                             void *userData) {
-    (void)outputBuffer; // Unused
-    (void)timeInfo;     // Unused
-    (void)statusFlags;  // Unused
-    (void)userData;     // Unused
-    
-    if (inputBuffer && recording_active) {
-        size_t bytes_to_write = framesPerBuffer * CHANNELS * 1; // 1 byte per sample (MULAW)
+
+// Jitter buffer for smooth streaming; the callback plays from it while it is published
+static JitterBuffer *streaming_jitter_buffer = NULL;
+static _Atomic(JitterBuffer *) playback_jitter_buffer = NULL;
+static atomic_uint streaming_underflow_count = 0; // Counted in the callback, never printed there
+
+// Per-utterance playback state (WebSocket service thread). The server brackets each
+// TTS response with tts_start / tts_end; a response without markers is one utterance
+// that ends once no audio has arrived for UTTERANCE_IDLE_MS.
+typedef struct {
+    unsigned int id;
+    int active;
+    int end_received;
+    size_t bytes;
+    uint64_t started_us;
+    uint64_t first_byte_us;
+    uint64_t last_byte_us;
+} playback_utterance_t;
+static playback_utterance_t utterance;
+
+// A response that starts before the current one has played out is held back here
+// and decoded once the current one has drained
+typedef struct {
+    unsigned int id;
+    int active;
+    int end_received;
+    unsigned char *data;
+    size_t size;
+    size_t capacity;
+} pending_utterance_t;
+static pending_utterance_t pending_utterance;
+
+// Set by the callback: first period of the utterance handed to the device, and the
+// end of the latest one
+static atomic_uint_fast64_t first_sample_us = 0;
+static atomic_uint_fast64_t last_sample_us = 0;
+static double output_latency_ms = 0.0;
+
+// Barge-in: the callback listens while TTS plays and nothing is being recorded
+static atomic_int barge_in_enabled = 0;
+static atomic_int barge_in_pending = 0;     // Set by the callback, taken by audio_take_barge_in()
+static atomic_int downlink_suppressed = 0;  // TTS of the interrupted response is dropped
+static BargeInDetector barge_in_detector;   // Callback only
+
+// Mic history so the interrupting utterance does not lose its first words while the
+// new session opens (callback only; preroll_pending hands it to the next recording)
+#define BARGE_IN_PREROLL_SAMPLES (DEVICE_SAMPLE_RATE * BARGE_IN_PREROLL_MS / 1000 * CHANNELS)
+#define BARGE_IN_LEAD_SAMPLES (DEVICE_SAMPLE_RATE * BARGE_IN_LEAD_MS / 1000 * CHANNELS)
+static int16_t preroll[BARGE_IN_PREROLL_SAMPLES];
+static size_t preroll_written = 0;          // Samples ever written, indexes modulo the size
+static size_t preroll_mark = 0;             // Where the interrupting utterance starts
+static atomic_int preroll_pending = 0;
+
+// TTS format from the handshake; the downlink decoder thread turns it into device-rate PCM
+static audio_format_t downlink_format = { AUDIO_ENCODING_MULAW, SAMPLE_RATE };
+
+// Add the playing clip on top of the TTS already in the output buffer
+static void mix_clip(int16_t *output, size_t samples) {
+    int16_t clip[FRAMES_PER_BUFFER * CHANNELS];
+    
+    while (samples > 0) {
+        size_t n = samples < FRAMES_PER_BUFFER * CHANNELS ? samples : FRAMES_PER_BUFFER * CHANNELS;
+        size_t written = clip_player_render(clip, n);
+        for (size_t i = 0; i < written; i++) {
+            int32_t sum = output[i] + clip[i];
+            output[i] = (int16_t)(sum > INT16_MAX ? INT16_MAX : sum < INT16_MIN ? INT16_MIN : sum);
+        }
+        output += n;
+        samples -= n;
+    }
+}
+
+// Keep the last BARGE_IN_PREROLL_MS of mic input
+static void remember_preroll(const int16_t *input, size_t samples) {
+    while (samples > 0) {
+        size_t offset = preroll_written % BARGE_IN_PREROLL_SAMPLES;
+        size_t n = BARGE_IN_PREROLL_SAMPLES - offset;
+        if (n > samples) n = samples;
+        memcpy(preroll + offset, input, n * sizeof(int16_t));
+        preroll_written += n;
+        input += n;
+        samples -= n;
+    }
+}
+
+// Capture the mic history from the barge-in mark, unless it has been overwritten already
+static void push_preroll(void) {
+    size_t count = preroll_written - preroll_mark;
+    if (count > BARGE_IN_PREROLL_SAMPLES) return;
+    
+    size_t offset = preroll_mark % BARGE_IN_PREROLL_SAMPLES;
+    size_t first = BARGE_IN_PREROLL_SAMPLES - offset;
+    if (first > count) first = count;
+    capture_push(preroll + offset, first);
+    if (count > first) {
+        capture_push(preroll, count - first);
+    }
+}
+
+// The user talks over the TTS: drop what is queued (O(1)), silence this period and stop
+// playing the jitter buffer. The control thread tears the stream down from here.
+static void interrupt_playback(JitterBuffer *jitter_buffer, int16_t *output, size_t samples) {
+    jitter_buffer_flush(jitter_buffer);
+    atomic_store(&playback_jitter_buffer, NULL);
+    memset(output, 0, samples * sizeof(int16_t));
+    
+    preroll_mark = preroll_written > BARGE_IN_LEAD_SAMPLES ? preroll_written - BARGE_IN_LEAD_SAMPLES : 0;
+    atomic_store(&preroll_pending, 1);
+    atomic_store(&barge_in_pending, 1);
+}
+
+// Device xruns the host reported for this period
+static void count_status_flags(PaStreamCallbackFlags flags) {
+    if (flags & paOutputUnderflow) metrics_add(METRIC_AUDIO_OUTPUT_UNDERFLOWS, 1);
+    if (flags & paOutputOverflow) metrics_add(METRIC_AUDIO_OUTPUT_OVERFLOWS, 1);
+    if (flags & paInputUnderflow) metrics_add(METRIC_AUDIO_INPUT_UNDERFLOWS, 1);
+    if (flags & paInputOverflow) metrics_add(METRIC_AUDIO_INPUT_OVERFLOWS, 1);
+}
+
+// Duplex callback: capture when a recording is on, and play streaming TTS and clips.
+// This runs on the real-time audio thread: no locks, no allocation, no I/O
+static int duplex_callback(const void *inputBuffer, void *outputBuffer,
+                           unsigned long framesPerBuffer,
+                           const PaStreamCallbackTimeInfo *timeInfo,
+                           PaStreamCallbackFlags statusFlags,
+                           void *userData) {
+    (void)userData; // Unused
+    
+    size_t samples = framesPerBuffer * CHANNELS;
+    atomic_store(&callback_busy, 1);
+    uint64_t callback_start = trace_now_us();
+    
+    metrics_add(METRIC_AUDIO_CALLBACKS, 1);
+    if (statusFlags) {
+        count_status_flags(statusFlags);
+    }
+    
+    const int16_t *input = (const int16_t *)inputBuffer;
+    int capturing = input && atomic_load(&capture_enabled);
+    if (capturing) {
+        // A recording started by barge-in begins with the speech that triggered it
+        if (atomic_load(&preroll_pending)) {
+            atomic_store(&preroll_pending, 0);
+            push_preroll();
+        }
+        
+        // Hand the PCM to the uplink thread (lock-free, never blocks); it encodes
+        // to mu-law, appends to the recording and streams it if a callback is attached
+        capture_push(input, samples);
         
-        // If streaming callback is set, send chunk immediately
-        if (streaming_callback) {
-            streaming_callback((const unsigned char *)inputBuffer, bytes_to_write);
+        // Stamped with when the first sample hit the ADC, not when the callback ran
+        PaTime capture_delay = timeInfo ? timeInfo->currentTime - timeInfo->inputBufferAdcTime : 0;
+        trace_event_at(TRACE_CAPTURE, trace_now_us() - (uint64_t)(capture_delay > 0 ? capture_delay * 1e6 : 0),
+                       samples);
+    }
+    
+    int16_t *output = (int16_t *)outputBuffer;
+    JitterBuffer *jitter_buffer = atomic_load(&playback_jitter_buffer);
+    if (jitter_buffer) {
+        if (statusFlags & paOutputUnderflow) {
+            atomic_fetch_add_explicit(&streaming_underflow_count, 1, memory_order_relaxed);
         }
         
-        // Also buffer for traditional recording
-        if (recording_buffer_used + bytes_to_write <= max_recording_size) {
-            memcpy(recording_buffer + recording_buffer_used, inputBuffer, bytes_to_write);
-            recording_buffer_used += bytes_to_write;
-            
-        } else {
-            // Buffer full, but don't stop recording - just stop capturing
-            // Don't set recording_active = 0 here, just stop capturing
+        // Always fills the whole period: prebuffer and underruns are concealed
+        size_t played = jitter_buffer_pull(jitter_buffer, (unsigned char *)output, samples * AUDIO_BYTES_PER_SAMPLE);
+        mix_clip(output, samples);
+        
+        // Timestamps for the utterance's start and drain times
+        if (played > 0) {
+            uint64_t now = trace_now_us();
+            if (!atomic_load_explicit(&first_sample_us, memory_order_relaxed)) {
+                atomic_store_explicit(&first_sample_us, now, memory_order_relaxed);
+                trace_event_at(TRACE_FIRST_SAMPLE, now, played);
+            }
+            atomic_store_explicit(&last_sample_us, now + framesPerBuffer * 1000000ULL / DEVICE_SAMPLE_RATE,
+                                  memory_order_relaxed);
         }
+        
+        // The mic hears this period's echo shortly; the detector allows for it
+        if (input && !capturing && atomic_load(&barge_in_enabled) &&
+            barge_in_process(&barge_in_detector, input, output, samples, played > 0)) {
+            interrupt_playback(jitter_buffer, output, samples);
+        }
+    } else {
+        clip_player_render(output, samples);
+    }
+    
+    if (input) {
+        remember_preroll(input, samples);
     }
     
+    metrics_observe(METRIC_AUDIO_CALLBACK_US, trace_now_us() - callback_start);
+    
+    atomic_store(&callback_busy, 0);
     return paContinue;
 }
 
+// Wait until the callback is not inside a period. Called after switching something
+// off: the callback sets callback_busy before it reads any switch, so once this
+// returns it has either finished with the old state or will see the new one.
+static void wait_for_callback(void) {
+    struct timespec pause = { 0, 1000000L };
+    while (atomic_load(&callback_busy)) {
+        nanosleep(&pause, NULL);
+    }
+}
+
+static double elapsed_ms(const struct timespec *since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000.0 + (now.tv_nsec - since->tv_nsec) / 1e6;
+}
+
+// Open and start the duplex stream at the devices' low latency settings. Without
+// a usable input device it is output only, and recording is unavailable.
+static int open_duplex_stream(void) {
+    PaDeviceIndex output_device = Pa_GetDefaultOutputDevice();
+    PaDeviceIndex input_device = Pa_GetDefaultInputDevice();
+    if (output_device == paNoDevice) {
+        printf("❌ No audio output device\n");
+        return 0;
+    }
+    
+    PaStreamParameters outputParameters;
+    outputParameters.device = output_device;
+    outputParameters.channelCount = CHANNELS;
+    outputParameters.sampleFormat = AUDIO_FORMAT;
+    outputParameters.suggestedLatency = Pa_GetDeviceInfo(output_device)->defaultLowOutputLatency;
+    outputParameters.hostApiSpecificStreamInfo = NULL;
+    
+    struct timespec open_start;
+    clock_gettime(CLOCK_MONOTONIC, &open_start);
+    
+    PaError err = paNoError;
+    duplex_has_input = 0;
+    if (input_device != paNoDevice) {
+        PaStreamParameters inputParameters;
+        inputParameters.device = input_device;
+        inputParameters.channelCount = CHANNELS;
+        inputParameters.sampleFormat = AUDIO_FORMAT;
+        inputParameters.suggestedLatency = Pa_GetDeviceInfo(input_device)->defaultLowInputLatency;
+        inputParameters.hostApiSpecificStreamInfo = NULL;
+        
+        err = Pa_OpenStream(&duplex_stream, &inputParameters, &outputParameters,
+                            DEVICE_SAMPLE_RATE, FRAMES_PER_BUFFER, paClipOff | paDitherOff,
+                            duplex_callback, NULL);
+        if (err == paNoError) {
+            duplex_has_input = 1;
+        } else {
+            printf("⚠️  Failed to open duplex stream (%s), recording unavailable\n", Pa_GetErrorText(err));
+        }
+    }
+    
+    if (!duplex_has_input) {
+        err = Pa_OpenStream(&duplex_stream, NULL, &outputParameters,
+                            DEVICE_SAMPLE_RATE, FRAMES_PER_BUFFER, paClipOff | paDitherOff,
+                            duplex_callback, NULL);
+        if (err != paNoError) {
+            printf("❌ Failed to open audio stream: %s\n", Pa_GetErrorText(err));
+            duplex_stream = NULL;
+            return 0;
+        }
+    }
+    
+    err = Pa_StartStream(duplex_stream);
+    if (err != paNoError) {
+        printf("❌ Failed to start audio stream: %s\n", Pa_GetErrorText(err));
+        Pa_CloseStream(duplex_stream);
+        duplex_stream = NULL;
+        return 0;
+    }
+    
+    // What the host actually gave us, which is what recording and playback starts will cost from now on
+    const PaStreamInfo *info = Pa_GetStreamInfo(duplex_stream);
+    output_latency_ms = info ? info->outputLatency * 1000.0 : 0.0;
+    printf("✅ %s stream running after %.1f ms (input latency %.1f ms, output latency %.1f ms, %.0f Hz)\n",
+           duplex_has_input ? "Duplex" : "Output-only", elapsed_ms(&open_start),
+           info ? info->inputLatency * 1000.0 : 0.0, info ? info->outputLatency * 1000.0 : 0.0,
+           info ? info->sampleRate : 0.0);
+    return 1;
+}
+
+// Stop and close the duplex stream; the callback has returned for good afterwards
+static void close_duplex_stream(void) {
+    if (!duplex_stream) return;
+    
+    Pa_StopStream(duplex_stream);
+    Pa_CloseStream(duplex_stream);
+    duplex_stream = NULL;
+    duplex_has_input = 0;
+}
+
+// Create the jitter buffer once; each utterance resets it instead of allocating
+static int init_streaming_jitter_buffer(void) {
+    jitter_buffer_config_t jitter_config = {
+        .sample_rate = DEVICE_SAMPLE_RATE, // Pushed after resampling
+        .bytes_per_sample = CHANNELS * AUDIO_BYTES_PER_SAMPLE, // Decoded PCM
+        .target_ms = JITTER_TARGET_MS,
+        .start_ms = JITTER_START_MS,
+        .min_ms = JITTER_MIN_MS,
+        .max_ms = JITTER_MAX_MS,
+        .conceal_ms = JITTER_CONCEAL_MS,
+    };
+    
+    streaming_jitter_buffer = init_jitter_buffer(STREAMING_AUDIO_BUFFER_SIZE, &jitter_config);
+    if (!streaming_jitter_buffer) {
+        printf("❌ Failed to initialize jitter buffer\n");
+        return 0;
+    }
+    return 1;
+}
+
+// Sampled gauges, refreshed when metrics are scraped or logged
+static void collect_audio_metrics(void) {
+    if (duplex_stream) {
+        metrics_set(METRIC_AUDIO_CPU_LOAD, Pa_GetStreamCpuLoad(duplex_stream));
+    }
+    
+    capture_stats_t capture_stats;
+    capture_get_stats(&capture_stats);
+    metrics_set(METRIC_CAPTURE_QUEUE_BYTES, (double)capture_stats.queue_depth);
+    
+    downlink_stats_t downlink_stats;
+    downlink_get_stats(&downlink_stats);
+    metrics_set(METRIC_DOWNLINK_QUEUE_BYTES, (double)downlink_stats.queue_depth);
+    
+    jitter_buffer_stats_t jitter_stats;
+    jitter_buffer_get_stats(streaming_jitter_buffer, &jitter_stats);
+    metrics_set(METRIC_JITTER_DEPTH_MS, jitter_stats.depth_ms);
+}
+
 // Initialize audio system
 int init_audio(void) {
     if (audio_initialized) {
         return 1; // Already initialized
     }
     
+    // Pick the G.711 kernels before any audio flows
+    g711_init();
+    
     PaError err = Pa_Initialize();
     if (err != paNoError) {
         printf("❌ Failed to initialize PortAudio: %s\n", Pa_GetErrorText(err));
         return 0;
     }
     
-    // Open audio output stream
-    err = Pa_OpenDefaultStream(&audio_stream,
-                             0,                    // No input channels
-                             CHANNELS,             // Output channels
-                             AUDIO_FORMAT,         // Sample format
-                             SAMPLE_RATE,          // Sample rate
-                             FRAMES_PER_BUFFER,    // Frames per buffer
-                             NULL,                 // No callback
-                             NULL);                // No user data
+    // The clip thread decodes clips and reports completion off the audio thread
+    if (!clip_player_init()) {
+        Pa_Terminate();
+        return 0;
+    }
     
-    if (err != paNoError) {
-        printf("❌ Failed to open audio stream: %s\n", Pa_GetErrorText(err));
+    // Start the uplink thread that drains captured audio to the recording and network
+    if (!capture_init()) {
+        clip_player_cleanup();
         Pa_Terminate();
         return 0;
     }
     
-    // Start the stream
-    err = Pa_StartStream(audio_stream);
-    if (err != paNoError) {
-        printf("❌ Failed to start audio stream: %s\n", Pa_GetErrorText(err));
-        Pa_CloseStream(audio_stream);
+    // And the decoder thread that turns received TTS into PCM for playback
+    if (!downlink_init()) {
+        capture_cleanup();
+        clip_player_cleanup();
         Pa_Terminate();
         return 0;
     }
     
-    // Calculate maximum recording size
-    max_recording_size = SAMPLE_RATE * CHANNELS * 2 * MAX_RECORDING_DURATION; // 2 bytes per sample
+    // Its jitter buffer lives as long as the stream; utterances only reset it
+    if (!init_streaming_jitter_buffer()) {
+        downlink_cleanup();
+        capture_cleanup();
+        clip_player_cleanup();
+        Pa_Terminate();
+        return 0;
+    }
     
-    // Allocate recording buffer
-    recording_buffer = malloc(max_recording_size);
-    if (!recording_buffer) {
-        printf("❌ Failed to allocate recording buffer\n");
-        Pa_CloseStream(audio_stream);
+    // Everything the callback feeds is ready: open the stream once, for good
+    barge_in_init(&barge_in_detector, DEVICE_SAMPLE_RATE);
+    if (!open_duplex_stream()) {
+        cleanup_jitter_buffer(streaming_jitter_buffer);
+        streaming_jitter_buffer = NULL;
+        downlink_cleanup();
+        capture_cleanup();
+        clip_player_cleanup();
         Pa_Terminate();
         return 0;
     }
     
     audio_initialized = 1;
-    printf("✅ Audio system initialized (16kHz, Mono, 16-bit)\n");
+    metrics_set_collector(collect_audio_metrics);
+    printf("✅ Audio system initialized (%dHz device, Mono, 16-bit, %dHz mu-law on the wire)\n",
+           DEVICE_SAMPLE_RATE, SAMPLE_RATE);
     return 1;
 }
 
@@ -127,26 +434,25 @@ void cleanup_audio(void) {
         stop_recording();
     }
     
-    if (recording_buffer) {
-        free(recording_buffer);
-        recording_buffer = NULL;
-    }
+    capture_cleanup();
     
-    if (recording_stream) {
-        Pa_CloseStream(recording_stream);
-        recording_stream = NULL;
+    if (current_recording) {
+        recording_release(current_recording);
+        current_recording = NULL;
     }
     
-    if (audio_stream) {
-        Pa_StopStream(audio_stream);
-        Pa_CloseStream(audio_stream);
-        audio_stream = NULL;
-    }
+    // Cleanup streaming (unpublishes the jitter buffer before it is freed)
+    stop_streaming_audio_playback();
     
-    // Cleanup streaming
-    if (streaming_audio_active) {
-        stop_streaming_audio_playback();
-    }
+    close_duplex_stream();
+    
+    // Callback has stopped: queued clips are reported as not completed
+    clip_player_cleanup();
+    downlink_cleanup();
+    
+    // Neither the decoder thread nor the callback is left to use it
+    cleanup_jitter_buffer(streaming_jitter_buffer);
+    streaming_jitter_buffer = NULL;
     
     if (audio_initialized) {
         Pa_Terminate();
@@ -160,8 +466,8 @@ int start_recording(void) {
     return start_recording_with_streaming(NULL);
 }
 
-// Start recording with streaming callback
-int start_recording_with_streaming(audio_chunk_callback callback) {
+// Start recording with streaming callback (recording_mutex held)
+static int start_recording_locked(audio_chunk_callback callback) {
     if (!audio_initialized) {
         printf("❌ Audio system not initialized\n");
         return 0;
@@ -172,577 +478,496 @@ int start_recording_with_streaming(audio_chunk_callback callback) {
         return 0;
     }
     
-    PaError err = Pa_OpenDefaultStream(&recording_stream,
-                                     CHANNELS,             // Input channels
-                                     0,                    // No output channels
-                                     AUDIO_FORMAT,         // Sample format
-                                     SAMPLE_RATE,          // Sample rate
-                                     FRAMES_PER_BUFFER,    // Frames per buffer
-                                     recording_callback,   // Recording callback
-                                     NULL);                // No user data
+    if (!duplex_has_input) {
+        printf("❌ No audio input device\n");
+        return 0;
+    }
     
-    if (err != paNoError) {
-        printf("❌ Failed to open recording stream: %s\n", Pa_GetErrorText(err));
+    // Drop any recording nobody collected and start a new, empty one
+    if (current_recording) {
+        recording_release(current_recording);
+    }
+    current_recording = recording_create();
+    if (!current_recording) {
         return 0;
     }
     
-    err = Pa_StartStream(recording_stream);
-    if (err != paNoError) {
-        printf("❌ Failed to start recording stream: %s\n", Pa_GetErrorText(err));
-        Pa_CloseStream(recording_stream);
-        recording_stream = NULL;
+    if (!capture_begin(callback, current_recording)) {
+        printf("❌ Failed to attach capture pipeline\n");
         return 0;
     }
     
-    // Reset recording buffer
-    recording_buffer_used = 0;
+    // The input side is already running: recording starts with the next callback period
+    atomic_store(&capture_enabled, 1);
+    
     recording_active = 1;
-    streaming_callback = callback;
+    streaming_capture_active = callback != NULL;
     
     printf("🎤 Started recording...\n");
     return 1;
 }
 
+// Start recording with streaming callback
+int start_recording_with_streaming(audio_chunk_callback callback) {
+    pthread_mutex_lock(&recording_mutex);
+    int result = start_recording_locked(callback);
+    pthread_mutex_unlock(&recording_mutex);
+    return result;
+}
+
 // Check if recording is active
 int is_recording_active(void) {
     return recording_active;
 }
 
-// Stop recording audio
-int stop_recording(void) {
-    if (!recording_active || !recording_stream) {
+// Stop recording audio (recording_mutex held)
+static int stop_recording_locked(void) {
+    if (!recording_active) {
         printf("⚠️  No active recording\n");
         return 0;
     }
     
-    PaError err = Pa_StopStream(recording_stream);
-    if (err != paNoError) {
-        printf("❌ Failed to stop recording stream: %s\n", Pa_GetErrorText(err));
-        return 0;
-    }
+    atomic_store(&capture_enabled, 0);
+    wait_for_callback();
+    recording_active = 0;
     
-    err = Pa_CloseStream(recording_stream);
-    if (err != paNoError) {
-        printf("❌ Failed to close recording stream: %s\n", Pa_GetErrorText(err));
-        return 0;
-    }
+    // The utterance that interrupted the last response is over: play TTS again
+    atomic_store(&downlink_suppressed, 0);
     
-    recording_stream = NULL;
-    recording_active = 0;
-    streaming_callback = NULL;
+    // Callback no longer pushes: flush what the uplink thread has not handled yet
+    capture_end();
     
-    printf("⏹️  Recording stopped (%zu bytes captured)\n", recording_buffer_used);
+    if (streaming_capture_active) {
+        streaming_capture_active = 0;
+        
+        capture_stats_t stats;
+        capture_get_stats(&stats);
+        printf("📊 Uplink (%s): %llu bytes for %llu samples sent in %u batches (%llu silent bytes suppressed), "
+               "%u send failures, %u overruns (%llu bytes lost), max queue %zu bytes\n",
+               stats.codec, (unsigned long long)stats.bytes_sent, (unsigned long long)stats.samples_encoded,
+               stats.batches_sent, (unsigned long long)stats.bytes_suppressed,
+               stats.send_failures, stats.overruns,
+               (unsigned long long)stats.bytes_overrun, stats.max_queue_depth);
+    }
+    
+    printf("⏹️  Recording stopped (%zu bytes captured in %zu segments)\n",
+           recording_size(current_recording), current_recording ? current_recording->segment_count : 0);
     return 1;
 }
 
-// Get recorded audio data
-int get_recorded_audio(unsigned char **audio_data, size_t *data_size) {
+// Stop recording audio
+int stop_recording(void) {
+    pthread_mutex_lock(&recording_mutex);
+    int result = stop_recording_locked();
+    pthread_mutex_unlock(&recording_mutex);
+    return result;
+}
+
+// Get recorded audio - ownership of the segment list passes to the caller,
+// who must recording_release() it when done
+int get_recorded_audio(recording_t **recording) {
     if (recording_active) {
         printf("❌ Cannot get audio while recording is active\n");
         return 0;
     }
     
-    if (recording_buffer_used == 0) {
+    if (recording_size(current_recording) == 0) {
         printf("❌ No recorded audio available\n");
         return 0;
     }
     
-    // Allocate memory for the recorded audio
-    *audio_data = malloc(recording_buffer_used);
-    if (!*audio_data) {
-        printf("❌ Failed to allocate memory for recorded audio\n");
-        return 0;
-    }
-    
-    // Copy recorded data
-    memcpy(*audio_data, recording_buffer, recording_buffer_used);
-    *data_size = recording_buffer_used;
-    
+    *recording = current_recording;
+    current_recording = NULL;
     return 1;
 }
 
 // Encode audio data to base64
 int encode_audio_to_base64(const unsigned char *audio_data, size_t data_size, char **base64_output) {
-    size_t base64_size = ((data_size + 2) / 3) * 4 + 1; // +1 for null terminator
-    *base64_output = malloc(base64_size);
+    *base64_output = malloc(BASE64_ENCODED_LENGTH(data_size) + 1); // +1 for null terminator
     
     if (!*base64_output) {
         printf("❌ Failed to allocate memory for base64 output\n");
         return 0;
     }
     
-    int i, j = 0;
-    for (i = 0; i < data_size; i += 3) {
-        unsigned char byte1 = audio_data[i];
-        unsigned char byte2 = (i + 1 < data_size) ? audio_data[i + 1] : 0;
-        unsigned char byte3 = (i + 2 < data_size) ? audio_data[i + 2] : 0;
-        
-        (*base64_output)[j++] = base64_chars[byte1 >> 2];
-        (*base64_output)[j++] = base64_chars[((byte1 & 3) << 4) | (byte2 >> 4)];
-        (*base64_output)[j++] = (i + 1 < data_size) ? base64_chars[((byte2 & 15) << 2) | (byte3 >> 6)] : '=';
-        (*base64_output)[j++] = (i + 2 < data_size) ? base64_chars[byte3 & 63] : '=';
-    }
-    
-    (*base64_output)[j] = '\0';
+    base64_encode(*base64_output, audio_data, data_size);
     return 1;
 }
 
-// Play audio data directly
-int play_audio_data(const unsigned char *audio_data, size_t data_size) {
-    if (!audio_initialized || !audio_stream) {
+// Queue a whole clip on the clip output stream and return at once
+unsigned int play_audio_clip(const unsigned char *audio_data, size_t data_size,
+                             clip_done_callback done, void *user_data) {
+    if (!audio_initialized || !duplex_stream) {
         printf("❌ Audio system not initialized\n");
         return 0;
     }
     
-    // Properly parse WAV file to find PCM data
-    size_t pcm_offset = 0;
-    if (data_size > 12 && 
-        audio_data[0] == 'R' && audio_data[1] == 'I' && 
-        audio_data[2] == 'F' && audio_data[3] == 'F') {
-        
-        // Skip RIFF header (12 bytes)
-        pcm_offset = 12;
-        
-        // Search for the "data" chunk
-        while (pcm_offset + 8 < data_size) {
-            if (audio_data[pcm_offset] == 'd' && 
-                audio_data[pcm_offset + 1] == 'a' && 
-                audio_data[pcm_offset + 2] == 't' && 
-                audio_data[pcm_offset + 3] == 'a') {
-                
-                // Found data chunk, skip chunk header (8 bytes)
-                pcm_offset += 8;
-                break;
-            }
-            
-            // Skip to next chunk
-            if (pcm_offset + 4 < data_size) {
-                uint32_t chunk_size = (audio_data[pcm_offset + 4] << 0) | 
-                                    (audio_data[pcm_offset + 5] << 8) | 
-                                    (audio_data[pcm_offset + 6] << 16) | 
-                                    (audio_data[pcm_offset + 7] << 24);
-                pcm_offset += 8 + chunk_size;
-            } else {
-                break;
-            }
-        }
-        
-        // Update audio data pointer and size
-        audio_data += pcm_offset;
-        data_size -= pcm_offset;
+    if (!audio_data || data_size == 0) {
+        printf("❌ Invalid audio clip\n");
+        return 0;
     }
     
-    // For MULAW (8-bit), data size should be fine as-is
-    // No need to check for even/odd since each sample is 1 byte
-    
-    // Restart the stream before playback
-    Pa_StopStream(audio_stream);
-    Pa_StartStream(audio_stream);
-    
-    // Write audio data in chunks to avoid buffer underflow
-    size_t chunk_size = FRAMES_PER_BUFFER * CHANNELS * 1; // 1 byte per sample (MULAW)
-    size_t offset = 0;
-    
-    while (offset < data_size) {
-        size_t bytes_to_write = (offset + chunk_size > data_size) ? 
-                               (data_size - offset) : chunk_size;
-        
-        PaError err = Pa_WriteStream(audio_stream, audio_data + offset, bytes_to_write);
-        if (err != paNoError) {
-            printf("❌ Failed to play audio: %s\n", Pa_GetErrorText(err));
-            return 0;
-        }
-        
-        offset += bytes_to_write;
-        
-        // Small delay to allow audio to play
-        usleep(10000); // 10ms
+    // The clip thread owns its own copy, so the caller's buffer is free on return
+    unsigned char *copy = malloc(data_size);
+    if (!copy) {
+        printf("❌ Failed to allocate memory for audio clip\n");
+        return 0;
     }
+    memcpy(copy, audio_data, data_size);
     
-    // Wait for audio to finish playing
-    while (Pa_GetStreamWriteAvailable(audio_stream) < FRAMES_PER_BUFFER) {
-        usleep(1000); // 1ms
-    }
-    return 1;
+    return clip_player_submit(copy, data_size, done, user_data);
 }
 
-// Decode base64 audio data
+// Stop a queued or playing clip (0 = all)
+int cancel_audio_clip(unsigned int clip_id) {
+    return clip_player_cancel(clip_id);
+}
+
+// Play audio data (WAV PCM16 / WAV mu-law / MP3 / Ogg Opus / raw mu-law) without waiting for it
+int play_audio_data(const unsigned char *audio_data, size_t data_size) {
+    return play_audio_clip(audio_data, data_size, NULL, NULL) != 0;
+}
+
+// Decode base64 audio data (strict: malformed input is rejected, not guessed at)
 int decode_base64_audio(const char *base64_input, unsigned char **audio_output, size_t *output_size) {
-    int input_length = strlen(base64_input);
-    int i, j = 0;
-    
-    // Calculate output size
-    *output_size = (input_length * 3) / 4;
-    if (base64_input[input_length - 1] == '=') (*output_size)--;
-    if (base64_input[input_length - 2] == '=') (*output_size)--;
+    size_t input_length = strlen(base64_input);
     
     // Allocate output buffer
-    *audio_output = malloc(*output_size);
+    *audio_output = malloc(BASE64_DECODED_MAX(input_length) + 1);
     if (!*audio_output) {
         printf("❌ Failed to allocate memory for audio data\n");
         return 0;
     }
     
-    // Decode base64
-    for (i = 0; i < input_length; i += 4) {
-        unsigned char byte1 = strchr(base64_chars, base64_input[i]) - base64_chars;
-        unsigned char byte2 = (i + 1 < input_length) ? strchr(base64_chars, base64_input[i + 1]) - base64_chars : 0;
-        unsigned char byte3 = (i + 2 < input_length) ? strchr(base64_chars, base64_input[i + 2]) - base64_chars : 0;
-        unsigned char byte4 = (i + 3 < input_length) ? strchr(base64_chars, base64_input[i + 3]) - base64_chars : 0;
-        
-        (*audio_output)[j++] = (byte1 << 2) | (byte2 >> 4);
-        if (j < *output_size) (*audio_output)[j++] = ((byte2 & 15) << 4) | (byte3 >> 2);
-        if (j < *output_size) (*audio_output)[j++] = ((byte3 & 3) << 6) | byte4;
+    if (!base64_decode(*audio_output, output_size, base64_input, input_length)) {
+        printf("❌ Invalid base64 audio (%zu characters)\n", input_length);
+        free(*audio_output);
+        *audio_output = NULL;
+        return 0;
     }
     
     return 1;
 }
 
-// Play audio from base64 encoded data
+// Play audio from base64 encoded data without waiting for it
 int play_audio_from_base64(const char *base64_audio) {
     unsigned char *audio_data;
     size_t audio_size;
     
+    if (!audio_initialized || !duplex_stream) {
+        printf("❌ Audio system not initialized\n");
+        return 0;
+    }
+    
     if (!decode_base64_audio(base64_audio, &audio_data, &audio_size)) {
         printf("❌ Failed to decode base64 audio\n");
         return 0;
     }
     
-    int result = play_audio_data(audio_data, audio_size);
-    free(audio_data);
-    
-    return result;
+    // The decoded buffer is handed over as is
+    return clip_player_submit(audio_data, audio_size, NULL, NULL) != 0;
 }
 
 // ============================================================================
-// RING BUFFER FUNCTIONS
+// STREAMING AUDIO PLAYBACK FUNCTIONS
 // ============================================================================
 
-// Initialize ring buffer
-AudioRingBuffer* init_audio_ring_buffer(size_t size) {
-    AudioRingBuffer *rb = malloc(sizeof(AudioRingBuffer));
-    if (!rb) {
-        printf("❌ Failed to allocate ring buffer structure\n");
-        return NULL;
-    }
-    
-    rb->buffer = malloc(size);
-    if (!rb->buffer) {
-        printf("❌ Failed to allocate ring buffer memory\n");
-        free(rb);
-        return NULL;
-    }
-    
-    rb->size = size;
-    rb->used = 0;
-    rb->read_pos = 0;
-    rb->write_pos = 0;
-    rb->active = 1;
-    
-    pthread_mutex_init(&rb->mutex, NULL);
-    pthread_cond_init(&rb->not_empty, NULL);
-    pthread_cond_init(&rb->not_full, NULL);
-    
-    printf("✅ Ring buffer initialized (%zu bytes)\n", size);
-    return rb;
-}
-
-// Write to ring buffer
-int write_audio_buffer(AudioRingBuffer *rb, const unsigned char *data, size_t size) {
-    if (!rb || !rb->active) return 0;
-    
-    pthread_mutex_lock(&rb->mutex);
-    
-    // Wait if buffer is full
-    while (rb->used + size > rb->size && rb->active) {
-        pthread_cond_wait(&rb->not_full, &rb->mutex);
+// Start streaming audio playback
+int start_streaming_audio_playback(void) {
+    if (!audio_initialized || !streaming_jitter_buffer) {
+        printf("❌ Audio system not initialized\n");
+        return 0;
     }
     
-    if (!rb->active) {
-        pthread_mutex_unlock(&rb->mutex);
+    if (streaming_audio_active) {
+        printf("⚠️  Streaming audio already active\n");
         return 0;
     }
     
-    // Write data to buffer
-    size_t first_chunk = rb->size - rb->write_pos;
-    if (first_chunk > size) first_chunk = size;
-    
-    memcpy(rb->buffer + rb->write_pos, data, first_chunk);
+    // Neither the decoder thread nor the callback uses the jitter buffer between utterances
+    jitter_buffer_reset(streaming_jitter_buffer);
+    atomic_store(&streaming_underflow_count, 0);
+    atomic_store(&first_sample_us, 0);
+    atomic_store(&last_sample_us, 0);
     
-    if (first_chunk < size) {
-        memcpy(rb->buffer, data + first_chunk, size - first_chunk);
+    // Received chunks are decoded into the jitter buffer from here on
+    if (!downlink_begin(streaming_jitter_buffer, &downlink_format)) {
+        printf("❌ Failed to attach downlink decoder\n");
+        return 0;
     }
     
-    rb->write_pos = (rb->write_pos + size) % rb->size;
-    rb->used += size;
-    
-    pthread_cond_signal(&rb->not_empty);
-    pthread_mutex_unlock(&rb->mutex);
+    // The output side is already running: playback starts with the next callback period
+    atomic_store(&playback_jitter_buffer, streaming_jitter_buffer);
     
+    streaming_audio_active = 1;
+    printf("✅ Streaming audio playback started with jitter buffer (negotiated %s %uHz -> %dHz)\n",
+           audio_encoding_name(downlink_format.encoding), downlink_format.sample_rate, DEVICE_SAMPLE_RATE);
     return 1;
 }
 
-// Read from ring buffer
-int read_audio_buffer(AudioRingBuffer *rb, unsigned char *data, size_t size) {
-    if (!rb || !rb->active) return 0;
-    
-    pthread_mutex_lock(&rb->mutex);
+// Report how long the utterance took to start and to play out
+static void log_utterance(int drained) {
+    uint64_t first_sample = atomic_load(&first_sample_us);
+    uint64_t last_sample = atomic_load(&last_sample_us);
     
-    // Wait if buffer is empty
-    while (rb->used < size && rb->active) {
-        pthread_cond_wait(&rb->not_empty, &rb->mutex);
+    printf("📊 Utterance %u: %zu bytes", utterance.id, utterance.bytes);
+    if (first_sample && utterance.first_byte_us) {
+        metrics_observe(METRIC_FIRST_SAMPLE_MS, (first_sample - utterance.first_byte_us) / 1000);
+        printf(", first byte -> first sample %.1f ms", (double)(first_sample - utterance.first_byte_us) / 1000.0);
     }
-    
-    if (!rb->active) {
-        pthread_mutex_unlock(&rb->mutex);
+    if (drained && last_sample > utterance.last_byte_us) {
+        printf(", last byte -> drained %.1f ms", (double)(last_sample - utterance.last_byte_us) / 1000.0);
+    }
+    printf(drained ? " (+%.1f ms output latency)\n" : ", interrupted (+%.1f ms output latency)\n",
+           output_latency_ms);
+}
+
+// Detach the downlink and let the output idle; the device stays open
+static int stop_playback(int drained) {
+    if (!streaming_audio_active) {
         return 0;
     }
     
-    // Read data from buffer
-    size_t first_chunk = rb->size - rb->read_pos;
-    if (first_chunk > size) first_chunk = size;
+    streaming_audio_active = 0;
+    
+    // Stop decoding first: the decoder thread is the jitter buffer's producer
+    downlink_end();
     
-    memcpy(data, rb->buffer + rb->read_pos, first_chunk);
+    // Unpublish the jitter buffer; once the callback is out of its period nothing reads it
+    atomic_store(&playback_jitter_buffer, NULL);
+    wait_for_callback();
     
-    if (first_chunk < size) {
-        memcpy(data + first_chunk, rb->buffer, size - first_chunk);
+    if (utterance.active) {
+        log_utterance(drained);
+        utterance.active = 0;
     }
     
-    rb->read_pos = (rb->read_pos + size) % rb->size;
-    rb->used -= size;
+    if (atomic_load(&streaming_underflow_count) > 0) {
+        printf("⚠️  %u audio underflows during streaming playback\n", atomic_load(&streaming_underflow_count));
+    }
+    
+    downlink_stats_t downlink_stats;
+    downlink_get_stats(&downlink_stats);
+    printf("📊 Downlink (%s): %llu bytes received, %llu dropped, %llu samples decoded, "
+           "%u decode errors, max queue %zu bytes\n",
+           downlink_stats.decoder, (unsigned long long)downlink_stats.bytes_received,
+           (unsigned long long)downlink_stats.bytes_dropped, (unsigned long long)downlink_stats.samples_decoded,
+           downlink_stats.decode_errors, downlink_stats.max_queue_depth);
     
-    pthread_cond_signal(&rb->not_full);
-    pthread_mutex_unlock(&rb->mutex);
+    jitter_buffer_stats_t stats;
+    jitter_buffer_get_stats(streaming_jitter_buffer, &stats);
+    printf("📊 Jitter buffer: target %ums, jitter %ums, %u underruns, %llu bytes concealed, %llu dropped\n",
+           stats.target_ms, stats.jitter_ms, stats.underruns,
+           (unsigned long long)stats.concealed_bytes, (unsigned long long)stats.dropped_bytes);
     
+    printf("⏹️  Streaming audio playback stopped\n");
     return 1;
 }
 
-// Cleanup ring buffer
-void cleanup_audio_ring_buffer(AudioRingBuffer *rb) {
-    if (!rb) return;
-    
-    pthread_mutex_lock(&rb->mutex);
-    rb->active = 0;
-    pthread_cond_signal(&rb->not_empty);
-    pthread_cond_signal(&rb->not_full);
-    pthread_mutex_unlock(&rb->mutex);
-    
-    pthread_mutex_destroy(&rb->mutex);
-    pthread_cond_destroy(&rb->not_empty);
-    pthread_cond_destroy(&rb->not_full);
-    
-    if (rb->buffer) {
-        free(rb->buffer);
-    }
-    free(rb);
+// Drop a held-back utterance
+static void discard_pending_utterance(void) {
+    free(pending_utterance.data);
+    memset(&pending_utterance, 0, sizeof(pending_utterance));
 }
 
-// ============================================================================
-// STREAMING AUDIO PLAYBACK FUNCTIONS
-// ============================================================================
-
-// Streaming playback callback
-static int streaming_playback_callback(const void *inputBuffer, void *outputBuffer,
-                                      unsigned long framesPerBuffer,
-                                      const PaStreamCallbackTimeInfo *timeInfo,
-                                      PaStreamCallbackFlags statusFlags,
-                                      void *userData) {
-    (void)inputBuffer; // Unused
-    (void)timeInfo;    // Unused
-    (void)userData;    // Unused
-    
-    if (statusFlags & paOutputUnderflow) {
-        printf("⚠️  Audio underflow detected\n");
-    }
-    
-    if (streaming_ring_buffer && streaming_ring_buffer->active) {
-        size_t bytes_needed = framesPerBuffer * CHANNELS * 1; // 1 byte per sample (MULAW)
-        unsigned char *temp_buffer = malloc(bytes_needed);
-        
-        if (read_audio_buffer(streaming_ring_buffer, temp_buffer, bytes_needed)) {
-            memcpy(outputBuffer, temp_buffer, bytes_needed);
-        } else {
-            // Buffer underrun - fill with silence
-            memset(outputBuffer, 0, bytes_needed);
-        }
-        
-        free(temp_buffer);
-    } else {
-        // No data - fill with silence
-        size_t bytes_needed = framesPerBuffer * CHANNELS * 1;
-        memset(outputBuffer, 0, bytes_needed);
+// Start playing a new utterance
+static int begin_utterance(unsigned int utterance_id) {
+    if (!streaming_audio_active && !start_streaming_audio_playback()) {
+        return 0;
     }
     
-    return paContinue;
+    memset(&utterance, 0, sizeof(utterance));
+    utterance.id = utterance_id;
+    utterance.active = 1;
+    utterance.started_us = trace_now_us();
+    return 1;
 }
 
-// LINEAR16 (PCM) audio format detection and handling for Google TTS streaming
-static int is_linear16_data(const unsigned char *data, size_t size) {
-    // LINEAR16 is raw PCM data at 24000 Hz, 16-bit, mono
-    // We'll assume any data that's not obviously MP3 is LINEAR16
-    if (size < 2) return 0;
-    
-    // Check for MP3 sync word to exclude MP3 data
-    if (data[0] == 0xFF && (data[1] == 0xFB || data[1] == 0xFA)) {
-        return 0; // This is MP3
-    }
-    
-    // Check for ID3v2 header to exclude MP3 data
-    if (size >= 10 && 
-        data[0] == 'I' && data[1] == 'D' && data[2] == '3' &&
-        data[3] >= 0x02 && data[3] <= 0x04) {
-        return 0; // This is MP3
-    }
-    
-    // Assume it's LINEAR16 PCM data from Google TTS streaming
-    return 1;
+// Stop streaming audio playback now, including anything held back for later
+int stop_streaming_audio_playback(void) {
+    discard_pending_utterance();
+    return stop_playback(0);
 }
 
-// Handle LINEAR16 PCM audio data (Google TTS streaming format)
-static int handle_linear16_audio(const unsigned char *audio_data, size_t audio_size, 
-                                unsigned char **pcm_data, size_t *pcm_size) {
-    printf("🎵 Processing MULAW audio data (%zu bytes, 8000 Hz)\n", audio_size);
-    
-    // MULAW data from Google TTS streaming - PortAudio supports MULAW natively
-    // Format: 8000 Hz, 8-bit MULAW, mono
-    // Just copy the data for playback
-    *pcm_data = malloc(audio_size);
-    if (!*pcm_data) {
-        printf("❌ Failed to allocate memory for PCM data\n");
+// Check if streaming audio is active
+int is_streaming_audio_active(void) {
+    return streaming_audio_active;
+}
+
+// Keep a chunk of the held-back utterance; it is decoded once the current one has drained
+static int hold_back_chunk(const unsigned char *audio_chunk, size_t chunk_size) {
+    if (pending_utterance.size + chunk_size > UTTERANCE_HOLD_MAX) {
+        printf("❌ Held-back utterance too large, dropped %zu bytes\n", chunk_size);
         return 0;
     }
     
-    memcpy(*pcm_data, audio_data, audio_size);
-    *pcm_size = audio_size;
+    if (pending_utterance.size + chunk_size > pending_utterance.capacity) {
+        size_t capacity = pending_utterance.capacity ? pending_utterance.capacity : 16384;
+        while (capacity < pending_utterance.size + chunk_size) capacity *= 2;
+        unsigned char *data = realloc(pending_utterance.data, capacity);
+        if (!data) {
+            printf("❌ Failed to allocate memory for held-back utterance\n");
+            return 0;
+        }
+        pending_utterance.data = data;
+        pending_utterance.capacity = capacity;
+    }
     
-    printf("✅ MULAW audio data ready for playback (8000 Hz)\n");
+    memcpy(pending_utterance.data + pending_utterance.size, audio_chunk, chunk_size);
+    pending_utterance.size += chunk_size;
     return 1;
 }
 
-// Start streaming audio playback
-int start_streaming_audio_playback(void) {
-    if (!audio_initialized) {
-        printf("❌ Audio system not initialized\n");
+// Queue an encoded audio chunk for the decoder thread (called from WebSocket callback)
+int play_audio_chunk(const unsigned char *audio_chunk, size_t chunk_size) {
+    if (!audio_chunk || chunk_size == 0) {
+        printf("❌ Invalid audio chunk\n");
         return 0;
     }
     
-    if (streaming_audio_active) {
-        printf("⚠️  Streaming audio already active\n");
-        return 0;
+    // The next response, while the current one still plays out
+    if (pending_utterance.active) {
+        return hold_back_chunk(audio_chunk, chunk_size);
     }
     
-    // Initialize ring buffer
-    streaming_ring_buffer = init_audio_ring_buffer(1024 * 1024); // 1MB buffer
-    if (!streaming_ring_buffer) {
-        printf("❌ Failed to initialize ring buffer\n");
+    // A server that sends no markers: the first chunk starts the utterance
+    if (!utterance.active && !begin_utterance(0)) {
         return 0;
     }
     
-    // Configure output parameters
-    PaStreamParameters outputParameters;
-    outputParameters.device = Pa_GetDefaultOutputDevice();
-    outputParameters.channelCount = CHANNELS;
-    outputParameters.sampleFormat = AUDIO_FORMAT;
-    outputParameters.suggestedLatency = Pa_GetDeviceInfo(outputParameters.device)->defaultLowOutputLatency;
-    outputParameters.hostApiSpecificStreamInfo = NULL;
-    
-    // Open streaming stream with callback
-    PaError err = Pa_OpenStream(&streaming_stream,
-                               NULL,                    // No input
-                               &outputParameters,       // Output
-                               SAMPLE_RATE,             // Sample rate
-                               FRAMES_PER_BUFFER,       // Frames per buffer
-                               paClipOff | paDitherOff, // Stream flags
-                               streaming_playback_callback, // Callback
-                               NULL);                   // User data
+    // Decoding (mu-law, LINEAR16, MP3, Ogg/Opus) and resampling happen on the decoder thread
+    size_t queued = downlink_push(audio_chunk, chunk_size);
     
-    if (err != paNoError) {
-        printf("❌ Failed to open streaming stream: %s\n", Pa_GetErrorText(err));
-        cleanup_audio_ring_buffer(streaming_ring_buffer);
-        streaming_ring_buffer = NULL;
-        return 0;
+    if (utterance.active) {
+        uint64_t now = trace_now_us();
+        if (!utterance.first_byte_us) {
+            utterance.first_byte_us = now;
+            trace_event_at(TRACE_TTS_FIRST_BYTE, now, utterance.id);
+        }
+        utterance.last_byte_us = now;
+        utterance.bytes += queued;
+    }
+    if (queued == chunk_size) {
+        return 1;
     }
     
-    // Start the stream
-    err = Pa_StartStream(streaming_stream);
-    if (err != paNoError) {
-        printf("❌ Failed to start streaming stream: %s\n", Pa_GetErrorText(err));
-        Pa_CloseStream(streaming_stream);
-        cleanup_audio_ring_buffer(streaming_ring_buffer);
-        streaming_ring_buffer = NULL;
-        streaming_stream = NULL;
+    printf("❌ Downlink queue full, dropped %zu of %zu bytes\n", chunk_size - queued, chunk_size);
+    return 0;
+}
+
+// Set the TTS format negotiated with the server
+void audio_set_downlink_format(const audio_format_t *format) {
+    downlink_format = *format;
+}
+
+void audio_get_downlink_format(audio_format_t *format) {
+    *format = downlink_format;
+}
+
+// ============================================================================
+// BARGE-IN
+// ============================================================================
+
+// Enable or disable talk-over detection during streaming playback
+void audio_set_barge_in(int enabled) {
+    atomic_store(&barge_in_enabled, enabled != 0);
+}
+
+// Take a barge-in the callback detected; it has already stopped playing the TTS
+int audio_take_barge_in(void) {
+    if (!atomic_exchange(&barge_in_pending, 0)) {
         return 0;
     }
     
-    streaming_audio_active = 1;
-    printf("✅ Streaming audio playback started with ring buffer\n");
+    metrics_add(METRIC_BARGE_INS, 1);
     return 1;
 }
 
-// Stop streaming audio playback
-int stop_streaming_audio_playback(void) {
-    if (!streaming_audio_active) {
-        return 0;
+// Drop received TTS until the current recording stops
+void audio_suppress_downlink(int suppress) {
+    atomic_store(&downlink_suppressed, suppress != 0);
+}
+
+int audio_downlink_suppressed(void) {
+    return atomic_load(&downlink_suppressed);
+}
+
+// ============================================================================
+// UTTERANCE PLAYBACK
+// ============================================================================
+
+// tts_start: play the response, or hold it back while the last one plays out
+int audio_begin_utterance(unsigned int utterance_id) {
+    if (utterance.active && !utterance.end_received) {
+        // The server moved on without ending the last one: it is over
+        stop_playback(0);
     }
     
-    streaming_audio_active = 0;
+    if (utterance.active) {
+        discard_pending_utterance();
+        pending_utterance.id = utterance_id;
+        pending_utterance.active = 1;
+        return 1;
+    }
     
-    // Stop and close streaming stream
-    if (streaming_stream) {
-        Pa_StopStream(streaming_stream);
-        Pa_CloseStream(streaming_stream);
-        streaming_stream = NULL;
+    return begin_utterance(utterance_id);
+}
+
+// tts_end: nothing more is coming for this response
+int audio_end_utterance(unsigned int utterance_id) {
+    if (pending_utterance.active) {
+        if (pending_utterance.id != utterance_id) return 0;
+        pending_utterance.end_received = 1;
+        return 1;
     }
     
-    // Cleanup ring buffer
-    if (streaming_ring_buffer) {
-        cleanup_audio_ring_buffer(streaming_ring_buffer);
-        streaming_ring_buffer = NULL;
+    if (!utterance.active || utterance.id != utterance_id) {
+        return 0;
     }
     
-    printf("⏹️  Streaming audio playback stopped\n");
+    utterance.end_received = 1;
     return 1;
 }
 
-// Check if streaming audio is active
-int is_streaming_audio_active(void) {
-    return streaming_audio_active;
+// Everything received has been decoded and handed to the device
+static int playback_drained(void) {
+    return downlink_idle() && audio_ring_buffer_used(streaming_jitter_buffer->ring) == 0;
 }
 
-// Play an audio chunk (called from WebSocket callback)
-int play_audio_chunk(const unsigned char *audio_chunk, size_t chunk_size) {
-    if (!streaming_audio_active || !streaming_ring_buffer) {
-        printf("❌ Streaming audio not active or ring buffer not initialized\n");
-        return 0;
+// Finish the current utterance once it has played out, and start the held-back one
+void audio_poll_playback(void) {
+    if (!utterance.active) {
+        return;
     }
     
-    if (!audio_chunk || chunk_size == 0) {
-        printf("❌ Invalid audio chunk\n");
-        return 0;
+    int ended = utterance.end_received;
+    if (!ended) {
+        // No tts_end (or a server without markers): a quiet downlink ends it too
+        uint64_t since = utterance.last_byte_us ? utterance.last_byte_us : utterance.started_us;
+        ended = trace_now_us() - since > (uint64_t)UTTERANCE_IDLE_MS * 1000;
     }
     
-    printf("🎵 Adding audio chunk to ring buffer (%zu bytes)\n", chunk_size);
-    
-    // Handle MULAW audio data from Google TTS streaming
-    unsigned char *pcm_data;
-    size_t pcm_size;
-    
-    if (!handle_linear16_audio(audio_chunk, chunk_size, &pcm_data, &pcm_size)) {
-        printf("❌ Failed to process audio chunk\n");
-        return 0;
+    if (!ended || !playback_drained()) {
+        return;
     }
     
-    // Write to ring buffer (non-blocking)
-    int result = write_audio_buffer(streaming_ring_buffer, pcm_data, pcm_size);
-    
-    // Clean up
-    free(pcm_data);
+    stop_playback(1);
     
-    if (result) {
-        printf("✅ Audio chunk added to ring buffer successfully\n");
-    } else {
-        printf("❌ Failed to add audio chunk to ring buffer\n");
+    if (pending_utterance.active) {
+        pending_utterance_t next = pending_utterance;
+        memset(&pending_utterance, 0, sizeof(pending_utterance));
+        
+        if (begin_utterance(next.id)) {
+            if (next.size > 0) {
+                play_audio_chunk(next.data, next.size);
+            }
+            utterance.end_received = next.end_received;
+        }
+        free(next.data);
     }
-    
-    return result;
-} 
\ No newline at end of file
+}
+
+// Check if an utterance is playing or waiting to
+int audio_utterance_active(void) {
+    return utterance.active || pending_utterance.active;
+}
@@ -3,22 +3,32 @@
 
 #include <stdio.h>
 #include <portaudio.h>
+#include "ring_buffer.h"
+#include "jitter_buffer.h"
+#include "recording.h"
+#include "audio_format.h"
+#include "clip_player.h"
 
 // Audio functions
- #include <pthread.h>
 int init_audio(void);
 void cleanup_audio(void);
+
+// Clip playback: these queue the clip and return immediately; done (optional)
+// runs on the clip thread when it has played out or was cancelled
+unsigned int play_audio_clip(const unsigned char *audio_data, size_t data_size,
+                             clip_done_callback done, void *user_data);  // Clip id, 0 on error
+int cancel_audio_clip(unsigned int clip_id);                             // 0 cancels all
 int play_audio_data(const unsigned char *audio_data, size_t data_size);
 int play_audio_from_base64(const char *base64_audio);
 
 // Audio recording functions
 int start_recording(void);
 int stop_recording(void);
-int get_recorded_audio(unsigned char **audio_data, size_t *data_size);
+int get_recorded_audio(recording_t **recording);
 int encode_audio_to_base64(const unsigned char *audio_data, size_t data_size, char **base64_output);
 
-// Real-time streaming functions
-typedef void (*audio_chunk_callback)(const unsigned char *chunk, size_t chunk_size);
+// Real-time streaming functions (callback runs on the uplink thread, returns 1 on success)
+typedef int (*audio_chunk_callback)(const unsigned char *chunk, size_t chunk_size);
 int start_recording_with_streaming(audio_chunk_callback callback);
 int is_recording_active(void);
 
@@ -28,30 +38,52 @@ int stop_streaming_audio_playback(void);
 int is_streaming_audio_active(void);
 int play_audio_chunk(const unsigned char *audio_chunk, size_t chunk_size);
 
+// Barge-in: while streaming TTS plays and nothing is being recorded, the callback
+// compares the mic with the echo expected from the speaker. When the user talks over
+// the TTS it flushes playback at once and flags it for audio_take_barge_in().
+void audio_set_barge_in(int enabled);
+int audio_take_barge_in(void);              // 1 once per barge-in
+void audio_suppress_downlink(int suppress); // Cleared when the next recording stops
+int audio_downlink_suppressed(void);
+
+// Utterance-aware playback (WebSocket service thread): the server brackets each TTS
+// response with tts_start / tts_end. Playback starts with the response; once it has
+// ended and drained the output idles until the next one, without closing the device.
+int audio_begin_utterance(unsigned int utterance_id);
+int audio_end_utterance(unsigned int utterance_id);
+void audio_poll_playback(void);     // Main loop: finishes a drained utterance
+int audio_utterance_active(void);
+
+// Format of the TTS audio the server sends (negotiated at connect time);
+// takes effect when the next streaming playback starts
+void audio_set_downlink_format(const audio_format_t *format);
+void audio_get_downlink_format(audio_format_t *format);
+
 // Audio configuration
-#define SAMPLE_RATE 8000
+#define SAMPLE_RATE 8000          // Network rate: mu-law uplink and the default TTS format
+#ifndef DEVICE_SAMPLE_RATE
+#define DEVICE_SAMPLE_RATE 16000  // PortAudio streams run here; audio is resampled to and from it
+#endif
 #define CHANNELS 1
 #define FRAMES_PER_BUFFER 512
-#define AUDIO_FORMAT paUInt8  // MULAW is 8-bit unsigned
-#define MAX_RECORDING_DURATION 60  // Increased to 60 seconds for longer recordings
-#define STREAMING_CHUNK_SIZE (FRAMES_PER_BUFFER * CHANNELS * 1) // 1KB chunks for MULAW (8-bit)
+#define AUDIO_FORMAT paInt16  // Devices run 16-bit PCM; the network carries G.711 mu-law
+#define AUDIO_BYTES_PER_SAMPLE 2
+#define STREAMING_CHUNK_SIZE (FRAMES_PER_BUFFER * CHANNELS * 1) // 512 byte mu-law chunks on the wire
 
 // Streaming audio buffer configuration
 #define STREAMING_AUDIO_BUFFER_SIZE (1024 * 1024) // 1MB buffer for streaming audio
 #define STREAMING_AUDIO_CHUNK_QUEUE_SIZE 50 // Queue for audio chunks
 
-// Ring buffer for smooth audio streaming
-typedef struct {
-    unsigned char *buffer;
-    size_t size;
-    size_t used;
-    size_t read_pos;
-    size_t write_pos;
-    pthread_mutex_t mutex;
-    pthread_cond_t not_empty;
-    pthread_cond_t not_full;
-    int active;
-} AudioRingBuffer;
+// Jitter buffer configuration for TTS playback (milliseconds)
+#define JITTER_TARGET_MS 60     // Initial playout depth
+#define JITTER_START_MS 40      // Audio buffered before the first sample plays
+#define JITTER_MIN_MS 20        // Adaptive floor
+#define JITTER_MAX_MS 200       // Adaptive ceiling
+#define JITTER_CONCEAL_MS 30    // Repeat-and-fade length on underrun
+
+// Utterance playback configuration
+#define UTTERANCE_IDLE_MS 1000              // Without tts_end, this much downlink silence ends a response
+#define UTTERANCE_HOLD_MAX (256 * 1024)     // Next response held back while the current one plays out
 
 // Base64 decoding for audio
 int decode_base64_audio(const char *base64_input, unsigned char **audio_output, size_t *output_size);
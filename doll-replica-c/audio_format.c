@@ -0,0 +1,65 @@
+#include "audio_format.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define AUDIO_FORMAT_MIN_RATE 4000
+#define AUDIO_FORMAT_MAX_RATE 48000
+
+const char* audio_encoding_name(audio_encoding_t encoding) {
+    switch (encoding) {
+        case AUDIO_ENCODING_LINEAR16: return "linear16";
+        case AUDIO_ENCODING_MP3: return "mp3";
+        case AUDIO_ENCODING_OGG_OPUS: return "ogg_opus";
+        default: return "mulaw";
+    }
+}
+
+size_t audio_format_sample_size(const audio_format_t *format) {
+    switch (format->encoding) {
+        case AUDIO_ENCODING_LINEAR16: return 2;
+        case AUDIO_ENCODING_MULAW: return 1;
+        default: return 0;
+    }
+}
+
+// Parse "<encoding>;rate=<hz>" (parameters are optional, whitespace is ignored)
+int audio_format_parse(const char *text, audio_format_t *format) {
+    if (!text || !format) return 0;
+
+    while (*text == ' ' || *text == '\t') text++;
+
+    size_t name_len = strcspn(text, "; \t,");
+    audio_format_t parsed = { AUDIO_ENCODING_MULAW, 8000 };
+    if (name_len == 8 && strncasecmp(text, "linear16", 8) == 0) {
+        parsed.encoding = AUDIO_ENCODING_LINEAR16;
+    } else if (name_len == 5 && strncasecmp(text, "mulaw", 5) == 0) {
+        parsed.encoding = AUDIO_ENCODING_MULAW;
+    } else if (name_len == 3 && strncasecmp(text, "mp3", 3) == 0) {
+        parsed.encoding = AUDIO_ENCODING_MP3;
+    } else if (name_len == 8 && strncasecmp(text, "ogg_opus", 8) == 0) {
+        parsed.encoding = AUDIO_ENCODING_OGG_OPUS;
+    } else {
+        return 0;
+    }
+
+    const char *rate = strstr(text + name_len, "rate=");
+    const char *end = strchr(text, ',');
+    if (rate && (!end || rate < end)) {
+        long hz = strtol(rate + 5, NULL, 10);
+        if (hz < AUDIO_FORMAT_MIN_RATE || hz > AUDIO_FORMAT_MAX_RATE) {
+            return 0;
+        }
+        parsed.sample_rate = (unsigned int)hz;
+    }
+
+    *format = parsed;
+    return 1;
+}
+
+int audio_format_to_string(const audio_format_t *format, char *buffer, size_t size) {
+    int written = snprintf(buffer, size, "%s;rate=%u",
+                           audio_encoding_name(format->encoding), format->sample_rate);
+    return written > 0 && (size_t)written < size;
+}
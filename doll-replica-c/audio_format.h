@@ -0,0 +1,49 @@
+#ifndef AUDIO_FORMAT_H
+#define AUDIO_FORMAT_H
+
+#include <stddef.h>
+
+// Format negotiation headers. Formats are written "<encoding>;rate=<hz>" with the
+// encoding names the server's TTS configuration uses (LINEAR16 is little-endian).
+#define AUDIO_FORMAT_HEADER "x-audio-format:"   // Format of the body / stream being sent
+#define AUDIO_ACCEPT_HEADER "x-audio-accept:"   // Formats the sender can play, preferred first
+#define AUDIO_FORMAT_MAX_LENGTH 64
+
+// Compressed TTS is offered first when its decoder is built in; the rate is
+// a hint, the decoder takes the real one from the stream
+#ifdef HAVE_OPUS
+#define AUDIO_ACCEPT_OGG_OPUS "ogg_opus;rate=24000, "
+#else
+#define AUDIO_ACCEPT_OGG_OPUS ""
+#endif
+#ifdef HAVE_MPG123
+#define AUDIO_ACCEPT_MP3 "mp3;rate=24000, "
+#else
+#define AUDIO_ACCEPT_MP3 ""
+#endif
+
+// Everything the decoders and resampler can bring to the device rate, smallest on the wire first
+#define AUDIO_ACCEPT_FORMATS AUDIO_ACCEPT_OGG_OPUS AUDIO_ACCEPT_MP3 \
+    "linear16;rate=24000, linear16;rate=16000, linear16;rate=8000, mulaw;rate=8000"
+
+typedef enum {
+    AUDIO_ENCODING_MULAW = 0,
+    AUDIO_ENCODING_LINEAR16,
+    AUDIO_ENCODING_MP3,         // MPEG audio frames, optionally behind an ID3v2 tag
+    AUDIO_ENCODING_OGG_OPUS,    // Opus in an Ogg container (RFC 7845)
+} audio_encoding_t;
+
+typedef struct {
+    audio_encoding_t encoding;
+    unsigned int sample_rate;
+} audio_format_t;
+
+// Audio format functions
+int audio_format_parse(const char *text, audio_format_t *format);  // Returns 0 if unrecognized
+int audio_format_to_string(const audio_format_t *format, char *buffer, size_t size);
+const char* audio_encoding_name(audio_encoding_t encoding);
+
+// Bytes per sample on the wire; 0 for compressed encodings
+size_t audio_format_sample_size(const audio_format_t *format);
+
+#endif // AUDIO_FORMAT_H
@@ -0,0 +1,96 @@
+#include "barge_in.h"
+#include "vad.h"
+#include <math.h>
+#include <string.h>
+
+#define BARGE_IN_NOISE_RATE 0.05      // Noise floor tracking per period
+#define BARGE_IN_COUPLING_RATE 0.1    // Echo coupling tracking per period
+#define BARGE_IN_MIN_COUPLING 0.001   // ~-30 dB: a well isolated speaker
+#define BARGE_IN_MAX_COUPLING 4.0     // ~+6 dB: mic right next to the speaker
+
+static double mean_square(const int16_t *samples, size_t count) {
+    double energy = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        energy += (double)samples[i] * samples[i];
+    }
+    return energy / count;
+}
+
+// Initialize detector
+void barge_in_init(BargeInDetector *detector, unsigned int sample_rate) {
+    memset(detector, 0, sizeof(*detector));
+    detector->sample_rate = sample_rate;
+    detector->noise_floor = VAD_MIN_ENERGY;
+    detector->echo_coupling = BARGE_IN_INITIAL_COUPLING;
+    detector->idle_ms = BARGE_IN_HOLD_MS;
+}
+
+// Reset per-response state
+void barge_in_reset(BargeInDetector *detector) {
+    detector->speaker_envelope = 0.0;
+    detector->playback_ms = 0;
+    detector->idle_ms = BARGE_IN_HOLD_MS;
+    detector->speech_ms = 0;
+}
+
+// Process one period
+int barge_in_process(BargeInDetector *detector, const int16_t *mic, const int16_t *speaker,
+                     size_t samples, int playing) {
+    if (samples == 0) return 0;
+
+    unsigned int period_ms = (unsigned int)(samples * 1000 / detector->sample_rate);
+    if (period_ms == 0) period_ms = 1;
+
+    if (playing) {
+        detector->idle_ms = 0;
+    } else if (detector->idle_ms < BARGE_IN_HOLD_MS) {
+        detector->idle_ms += period_ms;
+    }
+
+    // Nothing audible for a while: the response is over, the next one warms up again
+    if (detector->idle_ms >= BARGE_IN_HOLD_MS) {
+        barge_in_reset(detector);
+        return 0;
+    }
+
+    double mic_energy = mean_square(mic, samples);
+    double speaker_energy = mean_square(speaker, samples);
+
+    // Peak hold with an exponential release over the echo tail
+    double release = exp(-(double)period_ms / BARGE_IN_ECHO_TAIL_MS);
+    detector->speaker_envelope *= release;
+    if (speaker_energy > detector->speaker_envelope) {
+        detector->speaker_envelope = speaker_energy;
+    }
+
+    double echo = detector->echo_coupling * detector->speaker_envelope;
+    double threshold = detector->noise_floor * VAD_SPEECH_RATIO;
+    if (threshold < echo * BARGE_IN_ECHO_MARGIN) threshold = echo * BARGE_IN_ECHO_MARGIN;
+    if (threshold < VAD_MIN_ENERGY) threshold = VAD_MIN_ENERGY;
+
+    int warming_up = detector->playback_ms < BARGE_IN_WARMUP_MS;
+    detector->playback_ms += period_ms;
+
+    if (!warming_up && mic_energy > threshold) {
+        detector->speech_ms += period_ms;
+        if (detector->speech_ms >= BARGE_IN_TRIGGER_MS) {
+            detector->speech_ms = 0;
+            return 1;
+        }
+        return 0;
+    }
+
+    // The user is quiet: what the mic hears is the room plus the TTS echo, so learn
+    // from it. During warm-up this is also how a loud echo path raises the coupling.
+    detector->speech_ms = 0;
+    if (detector->speaker_envelope > VAD_MIN_ENERGY) {
+        double coupling = mic_energy / detector->speaker_envelope;
+        detector->echo_coupling += (coupling - detector->echo_coupling) * BARGE_IN_COUPLING_RATE;
+        if (detector->echo_coupling < BARGE_IN_MIN_COUPLING) detector->echo_coupling = BARGE_IN_MIN_COUPLING;
+        if (detector->echo_coupling > BARGE_IN_MAX_COUPLING) detector->echo_coupling = BARGE_IN_MAX_COUPLING;
+    } else {
+        detector->noise_floor += (mic_energy - detector->noise_floor) * BARGE_IN_NOISE_RATE;
+    }
+
+    return 0;
+}
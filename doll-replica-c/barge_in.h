@@ -0,0 +1,40 @@
+#ifndef BARGE_IN_H
+#define BARGE_IN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Barge-in configuration
+#define BARGE_IN_TRIGGER_MS 120         // Speech over the threshold for this long interrupts playback
+#define BARGE_IN_WARMUP_MS 300          // Start of each response: learn the echo, never trigger
+#define BARGE_IN_HOLD_MS 500            // Playback counts as active this long after the last TTS sample
+#define BARGE_IN_ECHO_TAIL_MS 250       // How long speaker energy keeps coming back through the mic
+#define BARGE_IN_ECHO_MARGIN 4.0        // Mic energy over the expected echo that counts as the user (~6 dB)
+#define BARGE_IN_INITIAL_COUPLING 0.25  // Echo/speaker energy ratio assumed until it is measured
+#define BARGE_IN_LEAD_MS 300            // Audio before the trigger that starts the new utterance
+#define BARGE_IN_PREROLL_MS 1000        // Mic history kept while TTS plays (covers the session start)
+
+// Echo-aware talk-over detector. Runs in the audio callback on the mic period and
+// the speaker period that was just written: the speaker energy, held over the echo
+// tail and scaled by the measured mic/speaker coupling, is what the mic would hear
+// from the TTS alone, so only speech clearly above that counts as the user.
+typedef struct {
+    unsigned int sample_rate;
+    double noise_floor;         // Background energy, learned in pauses of the TTS
+    double echo_coupling;       // Mic/speaker energy ratio, learned while the user is quiet
+    double speaker_envelope;    // Recent speaker energy, held over the echo tail
+    unsigned int playback_ms;   // Time since this response became audible
+    unsigned int idle_ms;       // Time since the last TTS sample
+    unsigned int speech_ms;     // Consecutive time over the threshold
+} BargeInDetector;
+
+// Barge-in functions
+void barge_in_init(BargeInDetector *detector, unsigned int sample_rate);
+void barge_in_reset(BargeInDetector *detector);  // Keeps the learned coupling and noise floor
+
+// Process one period; playing is whether the speaker period carries TTS.
+// Returns 1 when the user is talking over playback.
+int barge_in_process(BargeInDetector *detector, const int16_t *mic, const int16_t *speaker,
+                     size_t samples, int playing);
+
+#endif // BARGE_IN_H
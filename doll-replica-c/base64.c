@@ -0,0 +1,437 @@
+#include "base64.h"
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BASE64_X86 1
+#include <immintrin.h>
+#endif
+
+#define BASE64_INVALID 0xFF
+
+static const char encode_table[64] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Sextet for every byte value, BASE64_INVALID outside the alphabet ('=' included)
+static const uint8_t decode_table[256] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,   62, 0xFF, 0xFF, 0xFF,   63,
+      52,   53,   54,   55,   56,   57,   58,   59,   60,   61, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF,    0,    1,    2,    3,    4,    5,    6,    7,    8,    9,   10,   11,   12,   13,   14,
+      15,   16,   17,   18,   19,   20,   21,   22,   23,   24,   25, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF,   26,   27,   28,   29,   30,   31,   32,   33,   34,   35,   36,   37,   38,   39,   40,
+      41,   42,   43,   44,   45,   46,   47,   48,   49,   50,   51, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+// Kernels work on whole blocks only and return how much input they consumed:
+// whole 3-byte groups when encoding, whole 4-character quanta when decoding.
+// Decoders stop at the first block with a character outside the alphabet.
+
+// ============================================================================
+// SCALAR KERNELS
+// ============================================================================
+
+static size_t encode_scalar(char *output, const uint8_t *input, size_t size) {
+    size_t i = 0;
+    for (; i + 3 <= size; i += 3) {
+        uint8_t a = input[i], b = input[i + 1], c = input[i + 2];
+        output[0] = encode_table[a >> 2];
+        output[1] = encode_table[((a & 3) << 4) | (b >> 4)];
+        output[2] = encode_table[((b & 15) << 2) | (c >> 6)];
+        output[3] = encode_table[c & 63];
+        output += 4;
+    }
+    return i;
+}
+
+static size_t decode_scalar(uint8_t *output, const uint8_t *input, size_t length) {
+    size_t i = 0;
+    for (; i + 4 <= length; i += 4) {
+        uint8_t a = decode_table[input[i]];
+        uint8_t b = decode_table[input[i + 1]];
+        uint8_t c = decode_table[input[i + 2]];
+        uint8_t d = decode_table[input[i + 3]];
+        if ((a | b | c | d) & 0xC0) {  // BASE64_INVALID has the top bits set
+            break;
+        }
+
+        uint32_t group = ((uint32_t)a << 18) | ((uint32_t)b << 12) | ((uint32_t)c << 6) | d;
+        output[0] = (uint8_t)(group >> 16);
+        output[1] = (uint8_t)(group >> 8);
+        output[2] = (uint8_t)group;
+        output += 3;
+    }
+    return i;
+}
+
+#ifdef BASE64_X86
+
+// ============================================================================
+// SSSE3 KERNELS
+// ============================================================================
+
+// 12 bytes (in the low 12 lanes) to 16 sextets, one per byte. Each 3-byte group
+// is spread over 4 lanes and the sextets are moved into place with two multiplies.
+__attribute__((target("ssse3")))
+static inline __m128i encode_sextets_ssse3(__m128i input) {
+    input = _mm_shuffle_epi8(input, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+    __m128i ac = _mm_mulhi_epu16(_mm_and_si128(input, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+    __m128i bd = _mm_mullo_epi16(_mm_and_si128(input, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(ac, bd);
+}
+
+// Sextets to ASCII: one offset per alphabet range, picked with pshufb
+__attribute__((target("ssse3")))
+static inline __m128i encode_ascii_ssse3(__m128i sextets) {
+    const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '+' - 62, '/' - 63, 'A', 0, 0);
+    __m128i range = _mm_subs_epu8(sextets, _mm_set1_epi8(51));
+    __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), sextets);
+    range = _mm_or_si128(range, _mm_and_si128(upper, _mm_set1_epi8(13)));
+    return _mm_add_epi8(_mm_shuffle_epi8(offsets, range), sextets);
+}
+
+__attribute__((target("ssse3")))
+static size_t encode_ssse3(char *output, const uint8_t *input, size_t size) {
+    size_t i = 0;
+    // 16-byte loads, 12 bytes used
+    for (; i + 16 <= size; i += 12) {
+        __m128i sextets = encode_sextets_ssse3(_mm_loadu_si128((const __m128i *)(input + i)));
+        _mm_storeu_si128((__m128i *)output, encode_ascii_ssse3(sextets));
+        output += 16;
+    }
+    return i + encode_scalar(output, input + i, size - i);
+}
+
+// ASCII to sextets for 16 characters. Returns 0 if any is outside the alphabet:
+// the low and high nibble classes of a valid character never share a bit.
+__attribute__((target("ssse3")))
+static inline int decode_sextets_ssse3(__m128i *chars) {
+    const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                         0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                         0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask_2f = _mm_set1_epi8(0x2F);
+
+    __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(*chars, 4), mask_2f);
+    __m128i lo_nibbles = _mm_and_si128(*chars, mask_2f);
+    __m128i classes = _mm_and_si128(_mm_shuffle_epi8(lut_lo, lo_nibbles), _mm_shuffle_epi8(lut_hi, hi_nibbles));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(classes, _mm_setzero_si128())) != 0xFFFF) {
+        return 0;
+    }
+
+    // '/' is the one character its high nibble does not place
+    __m128i is_slash = _mm_cmpeq_epi8(*chars, mask_2f);
+    __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(is_slash, hi_nibbles));
+    *chars = _mm_add_epi8(*chars, roll);
+    return 1;
+}
+
+// 16 sextets to 12 bytes in the low lanes
+__attribute__((target("ssse3")))
+static inline __m128i decode_pack_ssse3(__m128i sextets) {
+    __m128i pairs = _mm_maddubs_epi16(sextets, _mm_set1_epi32(0x01400140));
+    __m128i groups = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(groups, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+// Exactly 12 bytes, so the output needs no slack
+__attribute__((target("ssse3")))
+static inline void store12_ssse3(uint8_t *output, __m128i bytes) {
+    _mm_storel_epi64((__m128i *)output, bytes);
+    uint32_t tail = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(bytes, 8));
+    memcpy(output + 8, &tail, 4);
+}
+
+__attribute__((target("ssse3")))
+static size_t decode_ssse3(uint8_t *output, const uint8_t *input, size_t length) {
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i chars = _mm_loadu_si128((const __m128i *)(input + i));
+        if (!decode_sextets_ssse3(&chars)) {
+            break;
+        }
+        store12_ssse3(output, decode_pack_ssse3(chars));
+        output += 12;
+    }
+    return i + decode_scalar(output, input + i, length - i);
+}
+
+// ============================================================================
+// AVX2 KERNELS
+// ============================================================================
+
+// Same steps as SSSE3 on two 128-bit lanes
+__attribute__((target("avx2")))
+static size_t encode_avx2(char *output, const uint8_t *input, size_t size) {
+    const __m256i spread = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                            1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m256i offsets = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                             '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                             '+' - 62, '/' - 63, 'A', 0, 0,
+                                             'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                             '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                             '+' - 62, '/' - 63, 'A', 0, 0);
+    size_t i = 0;
+    // Two 16-byte loads 12 bytes apart, 24 bytes used
+    for (; i + 28 <= size; i += 24) {
+        __m128i low = _mm_loadu_si128((const __m128i *)(input + i));
+        __m128i high = _mm_loadu_si128((const __m128i *)(input + i + 12));
+        __m256i bytes = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1), spread);
+
+        __m256i ac = _mm256_mulhi_epu16(_mm256_and_si256(bytes, _mm256_set1_epi32(0x0FC0FC00)),
+                                        _mm256_set1_epi32(0x04000040));
+        __m256i bd = _mm256_mullo_epi16(_mm256_and_si256(bytes, _mm256_set1_epi32(0x003F03F0)),
+                                        _mm256_set1_epi32(0x01000010));
+        __m256i sextets = _mm256_or_si256(ac, bd);
+
+        __m256i range = _mm256_subs_epu8(sextets, _mm256_set1_epi8(51));
+        __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), sextets);
+        range = _mm256_or_si256(range, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+        __m256i ascii = _mm256_add_epi8(_mm256_shuffle_epi8(offsets, range), sextets);
+
+        _mm256_storeu_si256((__m256i *)output, ascii);
+        output += 32;
+    }
+    return i + encode_ssse3(output, input + i, size - i);
+}
+
+__attribute__((target("avx2")))
+static size_t decode_avx2(uint8_t *output, const uint8_t *input, size_t length) {
+    const __m256i lut_lo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                            0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+                                            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                            0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i lut_hi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                                              0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                          2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i mask_2f = _mm256_set1_epi8(0x2F);
+
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i chars = _mm256_loadu_si256((const __m256i *)(input + i));
+        __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(chars, 4), mask_2f);
+        __m256i lo_nibbles = _mm256_and_si256(chars, mask_2f);
+        if (!_mm256_testz_si256(_mm256_shuffle_epi8(lut_lo, lo_nibbles), _mm256_shuffle_epi8(lut_hi, hi_nibbles))) {
+            break;
+        }
+
+        __m256i is_slash = _mm256_cmpeq_epi8(chars, mask_2f);
+        __m256i sextets = _mm256_add_epi8(chars, _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(is_slash, hi_nibbles)));
+
+        __m256i pairs = _mm256_maddubs_epi16(sextets, _mm256_set1_epi32(0x01400140));
+        __m256i groups = _mm256_shuffle_epi8(_mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000)), pack);
+
+        // 24 bytes, contiguous in the low six dwords
+        groups = _mm256_permutevar8x32_epi32(groups, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+        _mm_storeu_si128((__m128i *)output, _mm256_castsi256_si128(groups));
+        _mm_storel_epi64((__m128i *)(output + 16), _mm256_extracti128_si256(groups, 1));
+        output += 24;
+    }
+    return i + decode_ssse3(output, input + i, length - i);
+}
+
+#endif // BASE64_X86
+
+// ============================================================================
+// DISPATCH
+// ============================================================================
+
+typedef struct {
+    const char *name;
+    size_t (*encode)(char *output, const uint8_t *input, size_t size);
+    size_t (*decode)(uint8_t *output, const uint8_t *input, size_t length);
+} base64_kernels_t;
+
+static const base64_kernels_t scalar_kernels = { "scalar", encode_scalar, decode_scalar };
+
+#ifdef BASE64_X86
+static const base64_kernels_t ssse3_kernels = { "ssse3", encode_ssse3, decode_ssse3 };
+static const base64_kernels_t avx2_kernels = { "avx2", encode_avx2, decode_avx2 };
+#endif
+
+// Usable before base64_init(), which only upgrades to a faster set
+static const base64_kernels_t *kernels = &scalar_kernels;
+
+// Select a kernel set
+int base64_set_impl(base64_impl_t impl) {
+    switch (impl) {
+        case BASE64_IMPL_SCALAR:
+            kernels = &scalar_kernels;
+            return 1;
+#ifdef BASE64_X86
+        case BASE64_IMPL_SSSE3:
+            if (!__builtin_cpu_supports("ssse3")) return 0;
+            kernels = &ssse3_kernels;
+            return 1;
+        case BASE64_IMPL_AVX2:
+            if (!__builtin_cpu_supports("avx2")) return 0;
+            kernels = &avx2_kernels;
+            return 1;
+#endif
+        default:
+            return 0;
+    }
+}
+
+// Pick the fastest kernels this CPU supports
+void base64_init(void) {
+    if (!base64_set_impl(BASE64_IMPL_AVX2) && !base64_set_impl(BASE64_IMPL_SSSE3)) {
+        base64_set_impl(BASE64_IMPL_SCALAR);
+    }
+    printf("✅ Base64 codec ready (%s kernels)\n", kernels->name);
+}
+
+const char* base64_impl_name(void) {
+    return kernels->name;
+}
+
+size_t base64_encode(char *output, const uint8_t *input, size_t size) {
+    size_t done = kernels->encode(output, input, size);
+    char *p = output + done / 3 * 4;
+
+    // Padded final group
+    size_t remaining = size - done;
+    if (remaining) {
+        uint32_t group = (uint32_t)input[done] << 16;
+        if (remaining == 2) group |= (uint32_t)input[done + 1] << 8;
+        p[0] = encode_table[group >> 18];
+        p[1] = encode_table[(group >> 12) & 63];
+        p[2] = remaining == 2 ? encode_table[(group >> 6) & 63] : '=';
+        p[3] = '=';
+        p += 4;
+    }
+
+    *p = '\0';
+    return (size_t)(p - output);
+}
+
+// Last (possibly padded) quantum: returns the bytes written, or -1 if invalid
+static int decode_last_quantum(uint8_t *output, const uint8_t *chars) {
+    uint8_t a = decode_table[chars[0]];
+    uint8_t b = decode_table[chars[1]];
+    if (a == BASE64_INVALID || b == BASE64_INVALID) return -1;
+
+    if (chars[2] == '=' && chars[3] == '=') {
+        if (b & 0x0F) return -1;  // Non-canonical: unused bits set
+        output[0] = (uint8_t)((a << 2) | (b >> 4));
+        return 1;
+    }
+
+    uint8_t c = decode_table[chars[2]];
+    if (c == BASE64_INVALID) return -1;
+
+    if (chars[3] == '=') {
+        if (c & 0x03) return -1;
+        output[0] = (uint8_t)((a << 2) | (b >> 4));
+        output[1] = (uint8_t)((b << 4) | (c >> 2));
+        return 2;
+    }
+
+    uint8_t d = decode_table[chars[3]];
+    if (d == BASE64_INVALID) return -1;
+    output[0] = (uint8_t)((a << 2) | (b >> 4));
+    output[1] = (uint8_t)((b << 4) | (c >> 2));
+    output[2] = (uint8_t)((c << 6) | d);
+    return 3;
+}
+
+int base64_decode(uint8_t *output, size_t *output_size, const char *input, size_t length) {
+    const uint8_t *chars = (const uint8_t *)input;
+    *output_size = 0;
+    if (length == 0) return 1;
+    if (length % 4 != 0) return 0;
+
+    // Everything but the last quantum, which is the only one that may be padded
+    size_t body = length - 4;
+    if (kernels->decode(output, chars, body) != body) {
+        return 0;
+    }
+
+    int last = decode_last_quantum(output + body / 4 * 3, chars + body);
+    if (last < 0) return 0;
+
+    *output_size = body / 4 * 3 + (size_t)last;
+    return 1;
+}
+
+// ============================================================================
+// STREAMING DECODER
+// ============================================================================
+
+void base64_stream_init(base64_stream_t *stream) {
+    memset(stream, 0, sizeof(*stream));
+}
+
+// One quantum at a time; a padded one ends the stream
+static int stream_quantum(base64_stream_t *stream, uint8_t *output, size_t *output_size, const char *chars) {
+    if (stream->finished) return 0;
+
+    int written = decode_last_quantum(output + *output_size, (const uint8_t *)chars);
+    if (written < 0) return 0;
+
+    *output_size += (size_t)written;
+    stream->finished = written < 3;
+    return 1;
+}
+
+int base64_stream_decode(base64_stream_t *stream, uint8_t *output, size_t *output_size,
+                         const char *input, size_t length) {
+    *output_size = 0;
+
+    // Complete the quantum the last call ended in
+    if (stream->pending_length) {
+        size_t take = 4 - stream->pending_length;
+        if (take > length) take = length;
+        memcpy(stream->pending + stream->pending_length, input, take);
+        stream->pending_length += take;
+        input += take;
+        length -= take;
+
+        if (stream->pending_length < 4) return 1;
+        stream->pending_length = 0;
+        if (!stream_quantum(stream, output, output_size, stream->pending)) return 0;
+    }
+
+    size_t whole = length / 4 * 4;
+    size_t done = 0;
+    while (done < whole) {
+        if (stream->finished) return 0;
+
+        // The kernels stop at the first quantum with padding or a bad character
+        size_t decoded = kernels->decode(output + *output_size, (const uint8_t *)input + done, whole - done);
+        *output_size += decoded / 4 * 3;
+        done += decoded;
+
+        if (done < whole) {
+            if (!stream_quantum(stream, output, output_size, input + done)) return 0;
+            done += 4;
+        }
+    }
+
+    // Keep the split quantum for the next call
+    stream->pending_length = length - whole;
+    if (stream->pending_length && stream->finished) return 0;
+    memcpy(stream->pending, input + whole, stream->pending_length);
+    return 1;
+}
+
+int base64_stream_finish(base64_stream_t *stream) {
+    return stream->pending_length == 0;
+}
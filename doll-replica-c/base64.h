@@ -0,0 +1,47 @@
+#ifndef BASE64_H
+#define BASE64_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Kernel implementations, fastest available is picked by base64_init()
+typedef enum {
+    BASE64_IMPL_SCALAR = 0,
+    BASE64_IMPL_SSSE3,
+    BASE64_IMPL_AVX2,
+} base64_impl_t;
+
+void base64_init(void);
+int base64_set_impl(base64_impl_t impl);  // Returns 0 if the CPU lacks it
+const char* base64_impl_name(void);
+
+// Buffer sizes (RFC 4648 standard alphabet, padded)
+#define BASE64_ENCODED_LENGTH(n) ((((n) + 2) / 3) * 4)  // Without the terminating NUL
+#define BASE64_DECODED_MAX(n) (((n) / 4) * 3)           // Upper bound, padding not subtracted
+
+// Encode size bytes; output needs BASE64_ENCODED_LENGTH(size) + 1 bytes.
+// Returns the encoded length, the output is NUL terminated.
+size_t base64_encode(char *output, const uint8_t *input, size_t size);
+
+// Strict decode: the length must be a multiple of 4, '=' may only pad the last
+// quantum and the unused bits before it must be zero; no whitespace.
+// output needs BASE64_DECODED_MAX(length) bytes. Returns 0 on invalid input.
+int base64_decode(uint8_t *output, size_t *output_size, const char *input, size_t length);
+
+// Incremental decoder for base64 that arrives split at arbitrary points (network
+// fragments): a quantum cut at the end of one call is completed by the next.
+// Same strictness as base64_decode.
+typedef struct {
+    char pending[4];        // Start of a quantum split across calls
+    size_t pending_length;
+    int finished;           // A padded quantum was seen; nothing may follow it
+} base64_stream_t;
+
+#define BASE64_STREAM_DECODED_MAX(n) ((((n) + 3) / 4) * 3)  // Output room for n more characters
+
+void base64_stream_init(base64_stream_t *stream);
+int base64_stream_decode(base64_stream_t *stream, uint8_t *output, size_t *output_size,
+                         const char *input, size_t length);  // Returns 0 on invalid input
+int base64_stream_finish(base64_stream_t *stream);           // Returns 0 if it ended mid-quantum
+
+#endif // BASE64_H
@@ -0,0 +1,123 @@
+#include "base64.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Base64 throughput benchmark: one second of 16 kHz PCM16, the size of a
+// base64 audio clip on the control path, against the code this replaced
+#define BENCH_BYTES 32000
+#define BENCH_ITERATIONS 2000
+#define LEGACY_ITERATIONS 50
+
+static const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// The previous encode_audio_to_base64 loop
+static void legacy_encode(char *output, const unsigned char *input, size_t size) {
+    size_t j = 0;
+    for (size_t i = 0; i < size; i += 3) {
+        unsigned char byte1 = input[i];
+        unsigned char byte2 = (i + 1 < size) ? input[i + 1] : 0;
+        unsigned char byte3 = (i + 2 < size) ? input[i + 2] : 0;
+
+        output[j++] = base64_chars[byte1 >> 2];
+        output[j++] = base64_chars[((byte1 & 3) << 4) | (byte2 >> 4)];
+        output[j++] = (i + 1 < size) ? base64_chars[((byte2 & 15) << 2) | (byte3 >> 6)] : '=';
+        output[j++] = (i + 2 < size) ? base64_chars[byte3 & 63] : '=';
+    }
+    output[j] = '\0';
+}
+
+// The previous decode_base64_audio loop: a strchr scan per character
+static size_t legacy_decode(unsigned char *output, const char *input) {
+    int input_length = strlen(input);
+    size_t output_size = (input_length * 3) / 4;
+    if (input[input_length - 1] == '=') output_size--;
+    if (input[input_length - 2] == '=') output_size--;
+
+    size_t j = 0;
+    for (int i = 0; i < input_length; i += 4) {
+        unsigned char byte1 = strchr(base64_chars, input[i]) - base64_chars;
+        unsigned char byte2 = (i + 1 < input_length) ? strchr(base64_chars, input[i + 1]) - base64_chars : 0;
+        unsigned char byte3 = (i + 2 < input_length) ? strchr(base64_chars, input[i + 2]) - base64_chars : 0;
+        unsigned char byte4 = (i + 3 < input_length) ? strchr(base64_chars, input[i + 3]) - base64_chars : 0;
+
+        output[j++] = (byte1 << 2) | (byte2 >> 4);
+        if (j < output_size) output[j++] = ((byte2 & 15) << 4) | (byte3 >> 2);
+        if (j < output_size) output[j++] = ((byte3 & 3) << 6) | byte4;
+    }
+    return output_size;
+}
+
+static void report(const char *name, const char *impl, double seconds, int iterations) {
+    double bytes = (double)BENCH_BYTES * iterations;
+    printf("  %-8s %-7s %8.1f MB/s  (%.2f us per clip)\n",
+           name, impl, bytes / seconds / 1e6, seconds / iterations * 1e6);
+}
+
+int main(void) {
+    static unsigned char data[BENCH_BYTES];
+    static char text[BASE64_ENCODED_LENGTH(BENCH_BYTES) + 1];
+    static unsigned char decoded[BASE64_DECODED_MAX(BASE64_ENCODED_LENGTH(BENCH_BYTES))];
+    static const base64_impl_t impls[] = { BASE64_IMPL_SCALAR, BASE64_IMPL_SSSE3, BASE64_IMPL_AVX2 };
+    volatile int sink = 0;
+    size_t decoded_size = 0;
+
+    srand(1);
+    for (int i = 0; i < BENCH_BYTES; i++) {
+        data[i] = (unsigned char)rand();
+    }
+
+    printf("📊 Base64 throughput (%d bytes, %d characters)\n", BENCH_BYTES, (int)BASE64_ENCODED_LENGTH(BENCH_BYTES));
+
+    double start = now_seconds();
+    for (int i = 0; i < LEGACY_ITERATIONS; i++) {
+        legacy_encode(text, data, BENCH_BYTES);
+        sink += text[i % BENCH_BYTES];
+    }
+    report("encode", "legacy", now_seconds() - start, LEGACY_ITERATIONS);
+
+    start = now_seconds();
+    for (int i = 0; i < LEGACY_ITERATIONS; i++) {
+        decoded_size = legacy_decode(decoded, text);
+        sink += decoded[i % BENCH_BYTES];
+    }
+    report("decode", "legacy", now_seconds() - start, LEGACY_ITERATIONS);
+
+    for (size_t k = 0; k < sizeof(impls) / sizeof(impls[0]); k++) {
+        if (!base64_set_impl(impls[k])) {
+            continue;
+        }
+        const char *impl = base64_impl_name();
+
+        start = now_seconds();
+        for (int i = 0; i < BENCH_ITERATIONS; i++) {
+            base64_encode(text, data, BENCH_BYTES);
+            sink += text[i % BENCH_BYTES];
+        }
+        report("encode", impl, now_seconds() - start, BENCH_ITERATIONS);
+
+        start = now_seconds();
+        for (int i = 0; i < BENCH_ITERATIONS; i++) {
+            if (!base64_decode(decoded, &decoded_size, text, BASE64_ENCODED_LENGTH(BENCH_BYTES))) {
+                printf("❌ %s decode rejected valid input\n", impl);
+                return 1;
+            }
+            sink += decoded[i % BENCH_BYTES];
+        }
+        report("decode", impl, now_seconds() - start, BENCH_ITERATIONS);
+
+        if (decoded_size != BENCH_BYTES || memcmp(decoded, data, BENCH_BYTES) != 0) {
+            printf("❌ %s round trip mismatch\n", impl);
+            return 1;
+        }
+    }
+
+    return sink == 42;
+}
@@ -0,0 +1,93 @@
+#include "json_message.h"
+#include "control_message.h"
+#include "cbor.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Control message decoding benchmark: the same transcription and utterance
+// marker as JSON text (tokenizer) and as CBOR (in-place decoder)
+#define BENCH_ITERATIONS 2000000
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t encode_transcription(uint8_t *out, size_t size) {
+    CborWriter writer;
+    cbor_writer_init(&writer, out, size);
+    cbor_write_self_describe(&writer);
+    cbor_write_map(&writer, 3);
+    cbor_write_text(&writer, "type");
+    cbor_write_text(&writer, "transcription");
+    cbor_write_text(&writer, "session_id");
+    cbor_write_text(&writer, "session-0042");
+    cbor_write_text(&writer, "text");
+    cbor_write_text(&writer, "turn the lights off in the kitchen and lower the blinds");
+    return writer.error ? 0 : writer.length;
+}
+
+static size_t encode_marker(uint8_t *out, size_t size) {
+    CborWriter writer;
+    cbor_writer_init(&writer, out, size);
+    cbor_write_self_describe(&writer);
+    cbor_write_map(&writer, 2);
+    cbor_write_text(&writer, "type");
+    cbor_write_text(&writer, "tts_start");
+    cbor_write_text(&writer, "utterance_id");
+    cbor_write_uint(&writer, 4242);
+    return writer.error ? 0 : writer.length;
+}
+
+static void bench(const char *name, const char *json, const uint8_t *cbor, size_t cbor_length) {
+    static JsonMessage parser;
+    static control_message_t decoded;
+    size_t json_length = strlen(json);
+    volatile unsigned int sink = 0;
+
+    json_message_init(&parser, NULL, NULL, NULL);
+    json_message_feed(&parser, json, json_length);
+    if (!json_message_finish(&parser) || !control_message_decode_cbor(&decoded, cbor, cbor_length) ||
+        parser.fields.found != decoded.found || strcmp(parser.fields.text, decoded.text) != 0 ||
+        parser.fields.utterance_id != decoded.utterance_id) {
+        printf("❌ JSON and CBOR disagree on the %s message\n", name);
+        return;
+    }
+
+    printf("  %-13s JSON %3zu bytes, CBOR %3zu bytes\n", name, json_length, cbor_length);
+
+    double start = now_seconds();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        json_message_reset(&parser);
+        json_message_feed(&parser, json, json_length);
+        sink += json_message_finish(&parser);
+    }
+    double json_seconds = now_seconds() - start;
+
+    start = now_seconds();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        sink += control_message_decode_cbor(&decoded, cbor, cbor_length);
+    }
+    double cbor_seconds = now_seconds() - start;
+
+    printf("  %-13s JSON %6.1f ns, CBOR %6.1f ns per message (%.1fx)\n", "",
+           json_seconds / BENCH_ITERATIONS * 1e9, cbor_seconds / BENCH_ITERATIONS * 1e9,
+           json_seconds / cbor_seconds);
+    (void)sink;
+}
+
+int main(void) {
+    uint8_t transcription[256];
+    uint8_t marker[64];
+
+    printf("📊 Control message decoding\n");
+    bench("transcription",
+          "{\"type\":\"transcription\",\"session_id\":\"session-0042\","
+          "\"text\":\"turn the lights off in the kitchen and lower the blinds\"}",
+          transcription, encode_transcription(transcription, sizeof(transcription)));
+    bench("tts_start", "{\"type\":\"tts_start\",\"utterance_id\":4242}",
+          marker, encode_marker(marker, sizeof(marker)));
+    return 0;
+}
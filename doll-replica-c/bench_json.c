@@ -0,0 +1,130 @@
+#include "json_message.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Incoming message parsing benchmark: large transcription messages delivered in
+// lws-sized fragments, against the reassemble-then-strstr code this replaced
+#define BENCH_MESSAGE_BYTES (192 * 1024)
+#define BENCH_FRAGMENT 4096
+#define BENCH_ITERATIONS 500
+#define LEGACY_BUFFER_SIZE (1024 * 256)
+
+static char legacy_buffer[LEGACY_BUFFER_SIZE];
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// The previous LWS_CALLBACK_CLIENT_RECEIVE path: append every fragment, then
+// strstr for the type and fields and copy them out
+static int legacy_parse(const char *message, size_t length, char *session_id, char *text) {
+    size_t buffer_length = 0;
+    for (size_t offset = 0; offset < length; offset += BENCH_FRAGMENT) {
+        size_t fragment = length - offset < BENCH_FRAGMENT ? length - offset : BENCH_FRAGMENT;
+        if (buffer_length + fragment >= LEGACY_BUFFER_SIZE) {
+            return 0;
+        }
+        memcpy(legacy_buffer + buffer_length, message + offset, fragment);
+        buffer_length += fragment;
+        legacy_buffer[buffer_length] = '\0';
+    }
+
+    if (!strstr(legacy_buffer, "\"tts_") && !strstr(legacy_buffer, "\"type\":\"transcription\"")) {
+        return 0;
+    }
+    char *text_start = strstr(legacy_buffer, "\"text\":\"");
+    char *session_start = strstr(legacy_buffer, "\"session_id\":\"");
+    if (!text_start || !session_start) {
+        return 0;
+    }
+    text_start += 8;
+    session_start += 14;
+    char *text_end = strchr(text_start, '"');
+    char *session_end = strchr(session_start, '"');
+    if (!text_end || !session_end || session_end - session_start >= 64 || text_end - text_start >= 1024) {
+        return 0;
+    }
+    memcpy(session_id, session_start, session_end - session_start);
+    session_id[session_end - session_start] = '\0';
+    memcpy(text, text_start, text_end - text_start);
+    text[text_end - text_start] = '\0';
+    return 1;
+}
+
+static int tokenizer_parse(JsonMessage *parser, const char *message, size_t length) {
+    json_message_reset(parser);
+    for (size_t offset = 0; offset < length; offset += BENCH_FRAGMENT) {
+        size_t fragment = length - offset < BENCH_FRAGMENT ? length - offset : BENCH_FRAGMENT;
+        json_message_feed(parser, message + offset, fragment);
+    }
+    return json_message_finish(parser) && strcmp(parser->fields.type, "transcription") == 0;
+}
+
+// A transcription whose fields come after a large member: the layout that makes
+// the strstr path scan the whole message several times. Nested members are
+// dense in brackets and quotes, a long string has few.
+static size_t build_message(char *message, size_t size, int nested) {
+    const char *prefix = nested ? "{\"type\":\"transcription\",\"segments\":[" : "{\"type\":\"transcription\",\"context\":\"";
+    const char *filler = nested ? "{\"start\":1.25,\"end\":2.5,\"words\":\"the quick brown fox jumps over the lazy dog\"},"
+                                : "the quick brown fox jumps over the lazy dog, ";
+    const char *suffix = nested ? "]" : "\"";
+
+    size_t length = (size_t)snprintf(message, size, "%s", prefix);
+    size_t filler_length = strlen(filler);
+    while (length + filler_length + 256 < size) {
+        memcpy(message + length, filler, filler_length);
+        length += filler_length;
+    }
+    if (nested) length--; // Trailing comma
+    length += (size_t)snprintf(message + length, size - length,
+                               "%s,\"session_id\":\"session-0042\",\"text\":\"turn the lights off in the kitchen\"}", suffix);
+    return length;
+}
+
+static void report(const char *layout, const char *name, size_t length, double seconds, int iterations) {
+    double bytes = (double)length * iterations;
+    printf("  %-7s %-9s %8.1f MB/s  (%.2f us per message)\n",
+           layout, name, bytes / seconds / 1e6, seconds / iterations * 1e6);
+}
+
+int main(void) {
+    static char message[BENCH_MESSAGE_BYTES];
+    static JsonMessage parser;
+    char session_id[64];
+    char text[1024];
+    volatile int sink = 0;
+
+    json_message_init(&parser, NULL, NULL, NULL);
+
+    for (int nested = 1; nested >= 0; nested--) {
+        const char *layout = nested ? "nested" : "string";
+        size_t length = build_message(message, sizeof(message), nested);
+
+        if (nested) {
+            printf("📊 JSON message parsing (%zu bytes in %d byte fragments)\n", length, BENCH_FRAGMENT);
+        }
+        if (!legacy_parse(message, length, session_id, text) || !tokenizer_parse(&parser, message, length) ||
+            strcmp(text, parser.fields.text) != 0 || strcmp(session_id, parser.fields.session_id) != 0) {
+            printf("❌ Parsers disagree on the %s layout\n", layout);
+            return 1;
+        }
+
+        double start = now_seconds();
+        for (int i = 0; i < BENCH_ITERATIONS; i++) {
+            sink += legacy_parse(message, length, session_id, text);
+        }
+        report(layout, "strstr", length, now_seconds() - start, BENCH_ITERATIONS);
+
+        start = now_seconds();
+        for (int i = 0; i < BENCH_ITERATIONS; i++) {
+            sink += tokenizer_parse(&parser, message, length);
+        }
+        report(layout, "tokenizer", length, now_seconds() - start, BENCH_ITERATIONS);
+    }
+
+    return sink == 42;
+}
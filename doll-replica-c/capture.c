@@ -0,0 +1,433 @@
+#include "capture.h"
+#include "ring_buffer.h"
+#include "g711.h"
+#include "metrics.h"
+#include "resampler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+// Capture ring: the input callback produces, the uplink thread consumes
+static AudioRingBuffer *capture_ring = NULL;
+
+// Device rate -> network rate, run by the uplink thread before the VAD and encoder
+static Resampler *uplink_resampler = NULL;
+static size_t batch_samples = CAPTURE_MAX_BATCH_BYTES; // Device samples per read that fit a batch
+
+// Uplink thread state
+static pthread_t uplink_tid;
+static atomic_int uplink_running = 0;
+static pthread_mutex_t sink_mutex = PTHREAD_MUTEX_INITIALIZER;
+static audio_chunk_callback uplink_sink = NULL;
+static recording_t *uplink_recording = NULL;
+
+// VAD gate between the capture ring and the uplink sink (uplink thread / sink_mutex)
+static VoiceActivityDetector vad;
+static capture_dtx_callback vad_dtx_handler = NULL;
+static capture_end_callback vad_end_handler = NULL;
+static int vad_enabled = 0;
+static int16_t vad_frame[CAPTURE_VAD_FRAME_SAMPLES];
+static size_t vad_frame_fill = 0;
+static unsigned char send_buffer[CAPTURE_MAX_BATCH_BYTES];
+static size_t send_fill = 0;
+
+// Uplink codec (sink_mutex); the encoder is rebuilt when the selection changes
+static const uplink_codec_t *uplink_codec = NULL;
+static CodecEncoder *uplink_encoder = NULL;
+static unsigned int dtx_silence_ms = 0;
+static int utterance_ended = 0;
+static int end_pending = 0;
+
+// Uplink timeline, in samples at SAMPLE_RATE since capture_begin() with suppressed
+// silence included, so a DTX gap shows up as a jump (sink_mutex)
+static uint64_t stream_position = 0;    // Next sample handed to the gate
+static uint64_t vad_frame_position = 0; // First sample in vad_frame
+static uint64_t encoder_position = 0;   // First sample the encoder still holds
+static uint64_t send_position = 0;      // First sample in send_buffer
+
+// Counters (written from the callback and the uplink thread)
+static atomic_uint_fast64_t bytes_captured = 0;
+static atomic_uint_fast64_t bytes_overrun = 0;
+static atomic_uint overrun_count = 0;
+static atomic_size_t max_queue_depth = 0;
+static atomic_uint_fast64_t bytes_sent = 0;
+static atomic_uint batches_sent = 0;
+static atomic_uint send_failures = 0;
+static atomic_uint append_failures = 0;
+static atomic_uint_fast64_t bytes_suppressed = 0;
+
+// Published copies of encoder state for capture_get_stats(), which runs on the
+// service thread and must not wait for sink_mutex behind a blocking send
+static _Atomic(const char *) encoder_codec_name = NULL;
+static atomic_uint_fast64_t samples_encoded = 0;
+
+// Send what the gate has accumulated
+static void flush_send_buffer(void) {
+    if (send_fill == 0 || !uplink_sink) {
+        send_fill = 0;
+        return;
+    }
+
+    if (uplink_sink(send_buffer, send_fill)) {
+        atomic_fetch_add_explicit(&bytes_sent, send_fill, memory_order_relaxed);
+        atomic_fetch_add_explicit(&batches_sent, 1, memory_order_relaxed);
+        metrics_add(METRIC_UPLINK_BYTES_SENT, send_fill);
+    } else {
+        atomic_fetch_add_explicit(&send_failures, 1, memory_order_relaxed);
+        metrics_add(METRIC_UPLINK_SEND_FAILURES, 1);
+    }
+    send_fill = 0;
+}
+
+// Queue audio that starts at position for the sink, sending whenever a batch fills up
+static void queue_send(const unsigned char *data, size_t size, uint64_t position) {
+    while (size > 0) {
+        if (send_fill == 0) {
+            send_position = position;
+        }
+        size_t space = sizeof(send_buffer) - send_fill;
+        size_t bytes = size < space ? size : space;
+        memcpy(send_buffer + send_fill, data, bytes);
+        send_fill += bytes;
+        data += bytes;
+        size -= bytes;
+
+        if (send_fill == sizeof(send_buffer)) {
+            flush_send_buffer();
+        }
+    }
+}
+
+// Encode PCM for the sink, a slice at a time so the output always fits
+static void encode_and_queue(const int16_t *samples, size_t count, uint64_t position) {
+    unsigned char encoded[CODEC_MAX_FRAME_BYTES * 4];
+
+    while (count > 0) {
+        size_t n = count < CODEC_MAX_FRAME_SAMPLES ? count : CODEC_MAX_FRAME_SAMPLES;
+        // Output starts with the frame the encoder was already holding samples of
+        uint64_t frame_position = position - uplink_encoder->pending_samples;
+        size_t bytes = codec_encoder_encode(uplink_encoder, samples, n, encoded);
+        queue_send(encoded, bytes, frame_position);
+        samples += n;
+        count -= n;
+        position += n;
+    }
+    encoder_position = position - uplink_encoder->pending_samples;
+    atomic_store_explicit(&samples_encoded, uplink_encoder->samples_in, memory_order_relaxed);
+}
+
+// Emit the codec's partial frame, padded, so nothing is held across a gap
+static void flush_encoder(void) {
+    unsigned char encoded[CODEC_MAX_FRAME_BYTES];
+    queue_send(encoded, codec_encoder_flush(uplink_encoder, encoded), encoder_position);
+}
+
+// Run one VAD frame: speech and hangover go up, silence becomes a DTX gap
+static void gate_frame(const int16_t *samples, size_t count, uint64_t position) {
+    if (vad_process_frame(&vad, samples, count) != VAD_SILENCE) {
+        if (dtx_silence_ms > 0) {
+            // Tell the uplink how much silence was skipped before this chunk
+            if (vad_dtx_handler) vad_dtx_handler(dtx_silence_ms);
+            dtx_silence_ms = 0;
+        }
+        encode_and_queue(samples, count, position);
+    } else {
+        if (dtx_silence_ms == 0) {
+            // Speech just ended: send its tail now rather than when speech resumes
+            flush_encoder();
+            flush_send_buffer();
+        }
+        dtx_silence_ms += VAD_FRAME_MS;
+        atomic_fetch_add_explicit(&bytes_suppressed, count, memory_order_relaxed);
+    }
+
+    if (vad_end_of_utterance(&vad)) {
+        flush_encoder();
+        flush_send_buffer();
+        utterance_ended = 1;
+        end_pending = 1;
+    }
+}
+
+// Feed captured audio to the uplink, through the VAD when it is enabled.
+// The gate looks at the PCM; what goes up is the codec's encoding of it.
+static void send_to_sink(const int16_t *samples, size_t count) {
+    if (!uplink_sink || utterance_ended) return;
+
+    if (!vad_enabled) {
+        encode_and_queue(samples, count, stream_position);
+        stream_position += count;
+        return;
+    }
+
+    while (count > 0 && !utterance_ended) {
+        if (vad_frame_fill == 0) {
+            vad_frame_position = stream_position;
+        }
+        size_t space = CAPTURE_VAD_FRAME_SAMPLES - vad_frame_fill;
+        size_t n = count < space ? count : space;
+        memcpy(vad_frame + vad_frame_fill, samples, n * sizeof(int16_t));
+        vad_frame_fill += n;
+        samples += n;
+        count -= n;
+        stream_position += n;
+
+        if (vad_frame_fill == CAPTURE_VAD_FRAME_SAMPLES) {
+            gate_frame(vad_frame, vad_frame_fill, vad_frame_position);
+            vad_frame_fill = 0;
+        }
+    }
+}
+
+// Move everything queued into the recording and the sink in batches (sink_mutex held)
+static void drain_capture_ring(void) {
+    int16_t batch[CAPTURE_MAX_BATCH_BYTES];
+    int16_t resampled[CAPTURE_MAX_BATCH_BYTES];
+    unsigned char encoded[CAPTURE_MAX_BATCH_BYTES];
+    size_t batch_size;
+
+    size_t depth = audio_ring_buffer_used(capture_ring);
+    if (depth > atomic_load_explicit(&max_queue_depth, memory_order_relaxed)) {
+        atomic_store_explicit(&max_queue_depth, depth, memory_order_relaxed);
+    }
+
+    // The callback only ever writes whole samples, so reads stay sample aligned
+    while ((batch_size = read_audio_buffer(capture_ring, (unsigned char *)batch,
+                                           batch_samples * sizeof(int16_t))) > 0) {
+        size_t count = resampler_process(uplink_resampler, batch, batch_size / sizeof(int16_t), resampled);
+        if (count == 0) continue;
+        g711_ulaw_encode(encoded, resampled, count);
+
+        // Segments may be allocated or mapped here, which is why this is not done in the callback
+        if (uplink_recording && !recording_append(uplink_recording, encoded, count)) {
+            atomic_fetch_add_explicit(&append_failures, 1, memory_order_relaxed);
+        }
+
+        send_to_sink(resampled, count);
+    }
+
+    flush_send_buffer();
+}
+
+// Uplink thread - drains the capture ring so the audio callback never touches
+// the network or the allocator
+static void* uplink_thread(void *arg) {
+    (void)arg;
+    struct timespec period = { 0, CAPTURE_BATCH_MS * 1000000L };
+
+    while (atomic_load(&uplink_running)) {
+        nanosleep(&period, NULL);
+
+        pthread_mutex_lock(&sink_mutex);
+        drain_capture_ring();
+        int end_of_utterance = end_pending;
+        end_pending = 0;
+        pthread_mutex_unlock(&sink_mutex);
+
+        // Outside the lock: the handler is expected to stop the recording
+        if (end_of_utterance && vad_end_handler) {
+            vad_end_handler();
+        }
+    }
+
+    return NULL;
+}
+
+// Initialize capture pipeline
+int capture_init(void) {
+    if (capture_ring) {
+        return 1; // Already initialized
+    }
+
+    uplink_resampler = resampler_create(DEVICE_SAMPLE_RATE, SAMPLE_RATE);
+    if (!uplink_resampler) {
+        return 0;
+    }
+    batch_samples = CAPTURE_MAX_BATCH_BYTES;
+    while (resampler_max_output(uplink_resampler, batch_samples) > CAPTURE_MAX_BATCH_BYTES) {
+        batch_samples /= 2;
+    }
+
+    capture_ring = init_audio_ring_buffer(CAPTURE_RING_SIZE);
+    if (!capture_ring) {
+        printf("❌ Failed to allocate capture ring\n");
+        resampler_destroy(uplink_resampler);
+        uplink_resampler = NULL;
+        return 0;
+    }
+
+    atomic_store(&uplink_running, 1);
+    if (pthread_create(&uplink_tid, NULL, uplink_thread, NULL) != 0) {
+        printf("❌ Failed to create uplink thread\n");
+        atomic_store(&uplink_running, 0);
+        cleanup_audio_ring_buffer(capture_ring);
+        capture_ring = NULL;
+        resampler_destroy(uplink_resampler);
+        uplink_resampler = NULL;
+        return 0;
+    }
+
+    return 1;
+}
+
+// Cleanup capture pipeline
+void capture_cleanup(void) {
+    if (!capture_ring) return;
+
+    atomic_store(&uplink_running, 0);
+    pthread_join(uplink_tid, NULL);
+
+    recording_release(uplink_recording);
+    uplink_recording = NULL;
+
+    codec_encoder_destroy(uplink_encoder);
+    uplink_encoder = NULL;
+
+    cleanup_audio_ring_buffer(capture_ring);
+    capture_ring = NULL;
+
+    resampler_destroy(uplink_resampler);
+    uplink_resampler = NULL;
+}
+
+// Attach the recording and uplink sink
+int capture_begin(audio_chunk_callback callback, recording_t *recording) {
+    if (!capture_ring) return 0;
+
+    pthread_mutex_lock(&sink_mutex);
+    // Anything left over from a previous utterance belongs to nobody
+    uplink_sink = NULL;
+    recording_release(uplink_recording);
+    uplink_recording = NULL;
+    drain_capture_ring();
+
+    atomic_store(&bytes_captured, 0);
+    atomic_store(&bytes_overrun, 0);
+    atomic_store(&overrun_count, 0);
+    atomic_store(&max_queue_depth, 0);
+    atomic_store(&bytes_sent, 0);
+    atomic_store(&batches_sent, 0);
+    atomic_store(&send_failures, 0);
+    atomic_store(&append_failures, 0);
+    atomic_store(&bytes_suppressed, 0);
+
+    // Encoder state is per stream; a different codec needs a new instance
+    const uplink_codec_t *codec = uplink_codec ? uplink_codec : codec_default();
+    if (!uplink_encoder || uplink_encoder->codec != codec) {
+        codec_encoder_destroy(uplink_encoder);
+        uplink_encoder = codec_encoder_create(codec, SAMPLE_RATE);
+        if (!uplink_encoder) {
+            pthread_mutex_unlock(&sink_mutex);
+            return 0;
+        }
+    }
+    codec_encoder_reset(uplink_encoder);
+    atomic_store(&encoder_codec_name, codec->name);
+    atomic_store(&samples_encoded, 0);
+
+    resampler_reset(uplink_resampler);
+    vad_reset(&vad);
+    vad_frame_fill = 0;
+    send_fill = 0;
+    dtx_silence_ms = 0;
+    utterance_ended = 0;
+    end_pending = 0;
+    stream_position = 0;
+    vad_frame_position = 0;
+    encoder_position = 0;
+    send_position = 0;
+
+    uplink_sink = callback;
+    uplink_recording = recording_retain(recording);
+    pthread_mutex_unlock(&sink_mutex);
+    return 1;
+}
+
+// Flush the remaining audio and detach (input stream must be stopped)
+void capture_end(void) {
+    if (!capture_ring) return;
+
+    pthread_mutex_lock(&sink_mutex);
+    drain_capture_ring();
+
+    // A trailing partial VAD frame still goes up unless it is silence
+    if (vad_frame_fill > 0 && uplink_sink && !utterance_ended && vad.state != VAD_SILENCE) {
+        encode_and_queue(vad_frame, vad_frame_fill, vad_frame_position);
+    }
+    if (uplink_sink && !utterance_ended) {
+        flush_encoder();
+        flush_send_buffer();
+    }
+    vad_frame_fill = 0;
+    end_pending = 0;
+
+    uplink_sink = NULL;
+    recording_release(uplink_recording);
+    uplink_recording = NULL;
+    pthread_mutex_unlock(&sink_mutex);
+}
+
+// Select the uplink codec for the next stream
+void capture_set_uplink_codec(const uplink_codec_t *codec) {
+    pthread_mutex_lock(&sink_mutex);
+    uplink_codec = codec;
+    pthread_mutex_unlock(&sink_mutex);
+}
+
+// Enable VAD gating of the uplink
+void capture_set_vad_handlers(capture_dtx_callback on_dtx, capture_end_callback on_end) {
+    pthread_mutex_lock(&sink_mutex);
+    vad_init(&vad, SAMPLE_RATE);
+    vad_dtx_handler = on_dtx;
+    vad_end_handler = on_end;
+    vad_enabled = on_dtx || on_end;
+    pthread_mutex_unlock(&sink_mutex);
+}
+
+// Queue captured samples (real-time input callback)
+size_t capture_push(const int16_t *samples, size_t count) {
+    if (!capture_ring) return 0;
+
+    // Only whole samples, so a full ring never leaves half of one behind
+    size_t free_samples = audio_ring_buffer_free(capture_ring) / sizeof(int16_t);
+    size_t accepted = count < free_samples ? count : free_samples;
+    size_t written = write_audio_buffer(capture_ring, (const unsigned char *)samples,
+                                        accepted * sizeof(int16_t)) / sizeof(int16_t);
+    atomic_fetch_add_explicit(&bytes_captured, written * sizeof(int16_t), memory_order_relaxed);
+
+    if (written < count) {
+        size_t lost = (count - written) * sizeof(int16_t);
+        atomic_fetch_add_explicit(&bytes_overrun, lost, memory_order_relaxed);
+        atomic_fetch_add_explicit(&overrun_count, 1, memory_order_relaxed);
+        metrics_add(METRIC_CAPTURE_OVERRUN_BYTES, lost);
+    }
+    return written;
+}
+
+// Where the batch being sent starts on the uplink timeline (from inside the sink)
+uint64_t capture_sink_position(void) {
+    return send_position;
+}
+
+// Snapshot statistics
+void capture_get_stats(capture_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    stats->bytes_captured = atomic_load(&bytes_captured);
+    stats->bytes_overrun = atomic_load(&bytes_overrun);
+    stats->overruns = atomic_load(&overrun_count);
+    stats->queue_depth = audio_ring_buffer_used(capture_ring);
+    stats->max_queue_depth = atomic_load(&max_queue_depth);
+    stats->bytes_sent = atomic_load(&bytes_sent);
+    stats->batches_sent = atomic_load(&batches_sent);
+    stats->send_failures = atomic_load(&send_failures);
+    stats->append_failures = atomic_load(&append_failures);
+    stats->bytes_suppressed = atomic_load(&bytes_suppressed);
+
+    const char *codec = atomic_load(&encoder_codec_name);
+    stats->codec = codec ? codec : codec_default()->name;
+    stats->samples_encoded = atomic_load(&samples_encoded);
+}
@@ -0,0 +1,64 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "audio.h"
+#include "vad.h"
+#include "codec.h"
+
+// Capture pipeline configuration
+#define CAPTURE_RING_SIZE (256 * 1024) // ~8 s of 16 kHz 16-bit audio between callback and uplink
+#define CAPTURE_BATCH_MS 20            // Uplink thread wake-up period
+#define CAPTURE_MAX_BATCH_BYTES 4096   // Largest single send (mu-law)
+#define CAPTURE_VAD_FRAME_SAMPLES (SAMPLE_RATE * VAD_FRAME_MS / 1000 * CHANNELS)
+
+// VAD notifications while streaming (called on the uplink thread)
+typedef void (*capture_dtx_callback)(unsigned int silent_ms);  // Silence suppressed before the next chunk
+typedef void (*capture_end_callback)(void);                    // Trailing silence ended the utterance
+
+// Capture pipeline statistics
+typedef struct {
+    uint64_t bytes_captured;    // Accepted into the capture ring (16-bit PCM at the device rate)
+    uint64_t bytes_overrun;     // Dropped because the ring was full (same unit)
+    unsigned int overruns;      // Callback periods that lost audio
+    size_t queue_depth;         // PCM bytes waiting for the uplink thread
+    size_t max_queue_depth;
+    unsigned int append_failures;
+    uint64_t bytes_sent;
+    unsigned int batches_sent;
+    unsigned int send_failures;
+    uint64_t bytes_suppressed;  // Silence the VAD kept off the uplink (mu-law bytes)
+    const char *codec;          // Uplink codec of the current / last stream
+    uint64_t samples_encoded;   // Samples that went through the uplink codec
+} capture_stats_t;
+
+// Capture pipeline functions
+int capture_init(void);
+void capture_cleanup(void);
+
+// Attach / detach the recording and optional uplink sink;
+// capture_end() flushes what is still queued
+int capture_begin(audio_chunk_callback callback, recording_t *recording);
+void capture_end(void);
+
+// Codec for the uplink sink from the next capture_begin() on (default mu-law);
+// the recording is always mu-law
+void capture_set_uplink_codec(const uplink_codec_t *codec);
+
+// Enable VAD gating of the uplink; end-of-utterance fires with no locks held,
+// so the handler may stop the recording
+void capture_set_vad_handlers(capture_dtx_callback on_dtx, capture_end_callback on_end);
+
+// Called from the real-time input callback with device-rate 16-bit PCM: never
+// blocks or allocates. The uplink thread resamples to SAMPLE_RATE and encodes
+// to mu-law for the recording and sink.
+size_t capture_push(const int16_t *samples, size_t count);
+
+// Position of the first sample of the batch being sent, in samples at SAMPLE_RATE
+// since capture_begin(); suppressed silence counts. Only valid inside the sink.
+uint64_t capture_sink_position(void);
+
+void capture_get_stats(capture_stats_t *stats);
+
+#endif // CAPTURE_H
@@ -0,0 +1,199 @@
+#include "cbor.h"
+#include <string.h>
+
+void cbor_reader_init(CborReader *reader, const uint8_t *data, size_t length) {
+    reader->data = data;
+    reader->length = length;
+    reader->offset = 0;
+    reader->error = 0;
+}
+
+static int fail(CborReader *reader) {
+    reader->error = 1;
+    return 0;
+}
+
+int cbor_peek(const CborReader *reader) {
+    if (reader->error || reader->offset >= reader->length) {
+        return -1;
+    }
+    return reader->data[reader->offset] >> 5;
+}
+
+int cbor_read_head(CborReader *reader, int *major, uint64_t *argument) {
+    if (reader->error || reader->offset >= reader->length) {
+        return fail(reader);
+    }
+    uint8_t initial = reader->data[reader->offset++];
+    unsigned int info = initial & 0x1F;
+    *major = initial >> 5;
+
+    if (info < 24) {
+        *argument = info;
+        return 1;
+    }
+    // 24..27: the argument follows in 1, 2, 4 or 8 bytes; 31 is indefinite length
+    if (info > 27) {
+        return fail(reader);
+    }
+    size_t bytes = (size_t)1 << (info - 24);
+    if (reader->length - reader->offset < bytes) {
+        return fail(reader);
+    }
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        value = (value << 8) | reader->data[reader->offset++];
+    }
+    *argument = value;
+    return 1;
+}
+
+int cbor_read_map(CborReader *reader, uint64_t *pairs) {
+    int major;
+    if (!cbor_read_head(reader, &major, pairs)) return 0;
+    return major == CBOR_MAJOR_MAP ? 1 : fail(reader);
+}
+
+int cbor_read_text(CborReader *reader, const char **text, size_t *length) {
+    int major;
+    uint64_t size;
+    if (!cbor_read_head(reader, &major, &size)) return 0;
+    if (major != CBOR_MAJOR_TEXT || size > reader->length - reader->offset) {
+        return fail(reader);
+    }
+    *text = (const char *)reader->data + reader->offset;
+    *length = (size_t)size;
+    reader->offset += (size_t)size;
+    return 1;
+}
+
+int cbor_read_uint(CborReader *reader, uint64_t *value) {
+    int major;
+    if (!cbor_read_head(reader, &major, value)) return 0;
+    return major == CBOR_MAJOR_UNSIGNED ? 1 : fail(reader);
+}
+
+int cbor_read_bool(CborReader *reader, int *value) {
+    int major;
+    uint64_t simple;
+    if (!cbor_read_head(reader, &major, &simple)) return 0;
+    // Simple values 20 and 21
+    if (major != CBOR_MAJOR_SIMPLE || (simple != 20 && simple != 21)) {
+        return fail(reader);
+    }
+    *value = simple == 21;
+    return 1;
+}
+
+// Items still to read are counted instead of recursing, so nesting depth costs nothing
+int cbor_skip(CborReader *reader) {
+    uint64_t remaining = 1;
+
+    while (remaining > 0) {
+        int major;
+        uint64_t argument;
+        if (!cbor_read_head(reader, &major, &argument)) {
+            return 0;
+        }
+        remaining--;
+
+        // Each item takes at least a byte, which bounds the counts below
+        uint64_t left = reader->length - reader->offset;
+        switch (major) {
+            case CBOR_MAJOR_BYTES:
+            case CBOR_MAJOR_TEXT:
+                if (argument > left) return fail(reader);
+                reader->offset += (size_t)argument;
+                break;
+            case CBOR_MAJOR_ARRAY:
+                if (argument > left) return fail(reader);
+                remaining += argument;
+                break;
+            case CBOR_MAJOR_MAP:
+                if (argument > left / 2) return fail(reader);
+                remaining += argument * 2;
+                break;
+            case CBOR_MAJOR_TAG:
+                remaining++;
+                break;
+            default:
+                // Integers and simple values, floats included, are all head
+                break;
+        }
+    }
+    return 1;
+}
+
+int cbor_is_tagged(const uint8_t *data, size_t length) {
+    return length >= CBOR_SELF_DESCRIBE_BYTES && data[0] == 0xD9 && data[1] == 0xD9 && data[2] == 0xF7;
+}
+
+void cbor_skip_self_describe(CborReader *reader) {
+    if (!reader->error && cbor_is_tagged(reader->data + reader->offset, reader->length - reader->offset)) {
+        reader->offset += CBOR_SELF_DESCRIBE_BYTES;
+    }
+}
+
+void cbor_writer_init(CborWriter *writer, uint8_t *data, size_t size) {
+    writer->data = data;
+    writer->size = size;
+    writer->length = 0;
+    writer->error = 0;
+}
+
+static void put(CborWriter *writer, const void *data, size_t length) {
+    if (writer->error || writer->size - writer->length < length) {
+        writer->error = 1;
+        return;
+    }
+    memcpy(writer->data + writer->length, data, length);
+    writer->length += length;
+}
+
+// Shortest form of the argument, as RFC 8949 deterministic encoding asks
+void cbor_write_head(CborWriter *writer, int major, uint64_t argument) {
+    uint8_t head[9];
+    size_t bytes;
+    unsigned int info;
+
+    if (argument < 24) {
+        info = (unsigned int)argument;
+        bytes = 0;
+    } else if (argument <= 0xFF) {
+        info = 24;
+        bytes = 1;
+    } else if (argument <= 0xFFFF) {
+        info = 25;
+        bytes = 2;
+    } else if (argument <= 0xFFFFFFFFu) {
+        info = 26;
+        bytes = 4;
+    } else {
+        info = 27;
+        bytes = 8;
+    }
+
+    head[0] = (uint8_t)((major << 5) | info);
+    for (size_t i = 0; i < bytes; i++) {
+        head[1 + i] = (uint8_t)(argument >> (8 * (bytes - 1 - i)));
+    }
+    put(writer, head, 1 + bytes);
+}
+
+void cbor_write_self_describe(CborWriter *writer) {
+    cbor_write_head(writer, CBOR_MAJOR_TAG, CBOR_SELF_DESCRIBE_TAG);
+}
+
+void cbor_write_map(CborWriter *writer, uint64_t pairs) {
+    cbor_write_head(writer, CBOR_MAJOR_MAP, pairs);
+}
+
+void cbor_write_text(CborWriter *writer, const char *text) {
+    size_t length = strlen(text);
+    cbor_write_head(writer, CBOR_MAJOR_TEXT, length);
+    put(writer, text, length);
+}
+
+void cbor_write_uint(CborWriter *writer, uint64_t value) {
+    cbor_write_head(writer, CBOR_MAJOR_UNSIGNED, value);
+}
@@ -0,0 +1,66 @@
+#ifndef CBOR_H
+#define CBOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CBOR (RFC 8949) subset for control messages: definite-length items only.
+// Indefinite-length strings and containers are rejected as malformed.
+#define CBOR_MAJOR_UNSIGNED 0
+#define CBOR_MAJOR_NEGATIVE 1
+#define CBOR_MAJOR_BYTES 2
+#define CBOR_MAJOR_TEXT 3
+#define CBOR_MAJOR_ARRAY 4
+#define CBOR_MAJOR_MAP 5
+#define CBOR_MAJOR_TAG 6
+#define CBOR_MAJOR_SIMPLE 7             // false, true, null, floats
+
+#define CBOR_SELF_DESCRIBE_TAG 55799    // Marks a CBOR control frame: d9 d9 f7
+#define CBOR_SELF_DESCRIBE_BYTES 3
+
+// Reads items in place: strings come back as pointers into the buffer
+typedef struct {
+    const uint8_t *data;
+    size_t length;
+    size_t offset;
+    int error;                      // Malformed or truncated; every read fails from then on
+} CborReader;
+
+void cbor_reader_init(CborReader *reader, const uint8_t *data, size_t length);
+
+// Major type of the next item without reading it, -1 at the end
+int cbor_peek(const CborReader *reader);
+
+// Head of the next item: its major type and argument (length, count or value)
+int cbor_read_head(CborReader *reader, int *major, uint64_t *argument);
+
+int cbor_read_map(CborReader *reader, uint64_t *pairs);
+int cbor_read_text(CborReader *reader, const char **text, size_t *length);
+int cbor_read_uint(CborReader *reader, uint64_t *value);
+int cbor_read_bool(CborReader *reader, int *value);
+
+// Skip the next item, whatever it holds
+int cbor_skip(CborReader *reader);
+
+// Skip a leading self-describe tag if there is one
+void cbor_skip_self_describe(CborReader *reader);
+
+// Writes items into a caller buffer; error is set once it is full
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t length;
+    int error;
+} CborWriter;
+
+void cbor_writer_init(CborWriter *writer, uint8_t *data, size_t size);
+void cbor_write_head(CborWriter *writer, int major, uint64_t argument);
+void cbor_write_self_describe(CborWriter *writer);
+void cbor_write_map(CborWriter *writer, uint64_t pairs);
+void cbor_write_text(CborWriter *writer, const char *text);
+void cbor_write_uint(CborWriter *writer, uint64_t value);
+
+// 1 if data starts with the self-describe tag
+int cbor_is_tagged(const uint8_t *data, size_t length);
+
+#endif // CBOR_H
@@ -0,0 +1,376 @@
+#include "clip_player.h"
+#include "audio.h"
+#include "decoder.h"
+#include "resampler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define CLIP_FADE_SAMPLES (DEVICE_SAMPLE_RATE * CLIP_FADE_MS / 1000 * CHANNELS)
+
+typedef enum {
+    CLIP_QUEUED = 0,
+    CLIP_PLAYING,
+    CLIP_DONE,
+    CLIP_CANCELLED,
+} clip_state_t;
+
+typedef struct AudioClip {
+    unsigned int id;
+    unsigned char *data;        // Encoded clip, freed once decoded
+    size_t size;
+    int16_t *pcm;               // Device-rate PCM
+    size_t samples;
+    size_t capacity;
+    size_t position;            // Output callback only
+    atomic_int state;
+    atomic_int cancel;
+    clip_done_callback done;
+    void *user_data;
+    struct AudioClip *next;
+} AudioClip;
+
+// Queue of clips waiting to play (queue_mutex); the clip thread decodes the head
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static AudioClip *queue_head = NULL;
+static AudioClip *queue_tail = NULL;
+static size_t queue_length = 0;
+static AudioClip *decoding_clip = NULL;
+static pthread_t clip_tid;
+static int clip_running = 0;
+static atomic_uint next_clip_id = 1;
+
+// The clip the output callback is playing. The clip thread publishes it and takes
+// it back; render_busy tells it when the callback may still be reading the old one.
+static _Atomic(AudioClip *) active_clip = NULL;
+static atomic_int render_busy = 0;
+
+// ============================================================================
+// DECODING (clip thread)
+// ============================================================================
+
+typedef struct {
+    AudioClip *clip;
+    Resampler *resampler;
+    int failed;
+} clip_decode_t;
+
+// Decoder output: resample to the device rate and append to the clip
+static void append_decoded(void *ctx, const int16_t *pcm, size_t samples, unsigned int sample_rate) {
+    clip_decode_t *decode = ctx;
+    AudioClip *clip = decode->clip;
+    if (decode->failed) return;
+
+    if (!decode->resampler || decode->resampler->in_rate != sample_rate) {
+        resampler_destroy(decode->resampler);
+        decode->resampler = resampler_create(sample_rate, DEVICE_SAMPLE_RATE);
+        if (!decode->resampler) {
+            decode->failed = 1;
+            return;
+        }
+    }
+
+    size_t needed = clip->samples + resampler_max_output(decode->resampler, samples);
+    if (needed > clip->capacity) {
+        size_t capacity = clip->capacity ? clip->capacity : DEVICE_SAMPLE_RATE;
+        while (capacity < needed) capacity *= 2;
+        int16_t *pcm_buffer = realloc(clip->pcm, capacity * sizeof(int16_t));
+        if (!pcm_buffer) {
+            printf("❌ Failed to allocate clip buffer\n");
+            decode->failed = 1;
+            return;
+        }
+        clip->pcm = pcm_buffer;
+        clip->capacity = capacity;
+    }
+
+    clip->samples += resampler_process(decode->resampler, pcm, samples, clip->pcm + clip->samples);
+}
+
+// Find the format and data of a WAV file; anything else is sniffed, defaulting to 8 kHz mu-law
+static int probe_clip(const unsigned char *data, size_t size, audio_format_t *format, size_t *offset) {
+    audio_format_t raw = { AUDIO_ENCODING_MULAW, SAMPLE_RATE };
+    *offset = 0;
+
+    int wav = decoder_parse_wav(data, size, format, offset);
+    if (wav < 0) {
+        return 0;
+    }
+    if (wav == 0) {
+        decoder_detect(data, size, &raw, format);
+    }
+    return 1;
+}
+
+// Decode the whole clip to device-rate PCM
+static int decode_clip(AudioClip *clip) {
+    audio_format_t format;
+    size_t offset;
+    if (!probe_clip(clip->data, clip->size, &format, &offset)) {
+        return 0;
+    }
+
+    AudioDecoder *decoder = decoder_create(&format, DEVICE_SAMPLE_RATE);
+    if (!decoder) {
+        return 0;
+    }
+
+    clip_decode_t decode = { clip, NULL, 0 };
+    decoder_decode(decoder, clip->data + offset, clip->size - offset, append_decoded, &decode);
+    decoder_destroy(decoder);
+    resampler_destroy(decode.resampler);
+
+    free(clip->data);
+    clip->data = NULL;
+    return !decode.failed && clip->samples > 0;
+}
+
+// ============================================================================
+// CLIP THREAD
+// ============================================================================
+
+// Report the outcome and free the clip (no locks held)
+static void finish_clip(AudioClip *clip, int completed) {
+    if (clip->done) {
+        clip->done(clip->id, completed, clip->user_data);
+    }
+    free(clip->data);
+    free(clip->pcm);
+    free(clip);
+}
+
+// Take the playing clip back from the output callback
+static AudioClip* detach_active_clip(void) {
+    AudioClip *clip = atomic_exchange(&active_clip, NULL);
+    struct timespec pause = { 0, 1000000L };
+
+    // The callback sets render_busy before it loads active_clip, so once it is
+    // clear the callback either finished with the clip or will see NULL
+    while (clip && atomic_load(&render_busy)) {
+        nanosleep(&pause, NULL);
+    }
+    return clip;
+}
+
+// Clip thread - decodes queued clips, hands them to the output callback one at a
+// time and reports when they are done, so callers never wait for playback
+static void* clip_thread(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&queue_mutex);
+    while (clip_running) {
+        AudioClip *playing = atomic_load(&active_clip);
+
+        // Retire the playing clip once the callback has played or cancelled it
+        if (playing && atomic_load(&playing->state) != CLIP_PLAYING) {
+            detach_active_clip();
+            pthread_mutex_unlock(&queue_mutex);
+            finish_clip(playing, atomic_load(&playing->state) == CLIP_DONE);
+            pthread_mutex_lock(&queue_mutex);
+            continue;
+        }
+
+        // Start the next clip
+        if (!playing && queue_head) {
+            AudioClip *clip = queue_head;
+            queue_head = clip->next;
+            if (!queue_head) queue_tail = NULL;
+            queue_length--;
+            decoding_clip = clip;
+            pthread_mutex_unlock(&queue_mutex);
+
+            int ready = !atomic_load(&clip->cancel) && decode_clip(clip);
+
+            pthread_mutex_lock(&queue_mutex);
+            decoding_clip = NULL;
+            if (ready && !atomic_load(&clip->cancel)) {
+                atomic_store(&clip->state, CLIP_PLAYING);
+                atomic_store(&active_clip, clip);
+            } else {
+                pthread_mutex_unlock(&queue_mutex);
+                finish_clip(clip, 0);
+                pthread_mutex_lock(&queue_mutex);
+            }
+            continue;
+        }
+
+        if (playing) {
+            // The callback cannot signal us, so check back while a clip plays
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += CLIP_POLL_MS * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&queue_cond, &queue_mutex, &deadline);
+        } else {
+            pthread_cond_wait(&queue_cond, &queue_mutex);
+        }
+    }
+    pthread_mutex_unlock(&queue_mutex);
+
+    return NULL;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+// Initialize clip player
+int clip_player_init(void) {
+    pthread_mutex_lock(&queue_mutex);
+    if (clip_running) {
+        pthread_mutex_unlock(&queue_mutex);
+        return 1; // Already initialized
+    }
+
+    clip_running = 1;
+    if (pthread_create(&clip_tid, NULL, clip_thread, NULL) != 0) {
+        printf("❌ Failed to create clip thread\n");
+        clip_running = 0;
+        pthread_mutex_unlock(&queue_mutex);
+        return 0;
+    }
+
+    pthread_mutex_unlock(&queue_mutex);
+    return 1;
+}
+
+// Cleanup clip player (the output stream must be stopped already)
+void clip_player_cleanup(void) {
+    pthread_mutex_lock(&queue_mutex);
+    if (!clip_running) {
+        pthread_mutex_unlock(&queue_mutex);
+        return;
+    }
+    clip_running = 0;
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_mutex);
+    pthread_join(clip_tid, NULL);
+
+    AudioClip *playing = detach_active_clip();
+    if (playing) {
+        finish_clip(playing, 0);
+    }
+
+    while (queue_head) {
+        AudioClip *clip = queue_head;
+        queue_head = clip->next;
+        finish_clip(clip, 0);
+    }
+    queue_tail = NULL;
+    queue_length = 0;
+}
+
+// Queue a clip for playback
+unsigned int clip_player_submit(unsigned char *data, size_t size,
+                                clip_done_callback done, void *user_data) {
+    if (!data || size == 0) {
+        free(data);
+        return 0;
+    }
+
+    AudioClip *clip = calloc(1, sizeof(AudioClip));
+    if (!clip) {
+        printf("❌ Failed to allocate clip\n");
+        free(data);
+        return 0;
+    }
+
+    clip->data = data;
+    clip->size = size;
+    clip->done = done;
+    clip->user_data = user_data;
+    do {
+        clip->id = atomic_fetch_add(&next_clip_id, 1);
+    } while (clip->id == 0);
+
+    pthread_mutex_lock(&queue_mutex);
+    if (!clip_running || queue_length >= CLIP_QUEUE_MAX) {
+        pthread_mutex_unlock(&queue_mutex);
+        printf("❌ Clip queue full, dropping %zu byte clip\n", size);
+        free(clip->data);
+        free(clip);
+        return 0;
+    }
+
+    if (queue_tail) {
+        queue_tail->next = clip;
+    } else {
+        queue_head = clip;
+    }
+    queue_tail = clip;
+    queue_length++;
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_mutex);
+
+    return clip->id;
+}
+
+// Cancel one clip, or all of them
+int clip_player_cancel(unsigned int clip_id) {
+    int cancelled = 0;
+
+    pthread_mutex_lock(&queue_mutex);
+
+    // Queued and decoding clips are dropped by the clip thread when it gets to them
+    for (AudioClip *clip = queue_head; clip; clip = clip->next) {
+        if (clip_id == 0 || clip->id == clip_id) {
+            atomic_store(&clip->cancel, 1);
+            cancelled = 1;
+        }
+    }
+    if (decoding_clip && (clip_id == 0 || decoding_clip->id == clip_id)) {
+        atomic_store(&decoding_clip->cancel, 1);
+        cancelled = 1;
+    }
+
+    // The playing one fades out in the next callback
+    AudioClip *playing = atomic_load(&active_clip);
+    if (playing && (clip_id == 0 || playing->id == clip_id)) {
+        atomic_store(&playing->cancel, 1);
+        cancelled = 1;
+    }
+
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_mutex);
+    return cancelled;
+}
+
+// Render the playing clip into an output period
+size_t clip_player_render(int16_t *output, size_t samples) {
+    size_t written = 0;
+
+    atomic_store(&render_busy, 1);
+    AudioClip *clip = atomic_load(&active_clip);
+
+    if (clip && atomic_load(&clip->state) == CLIP_PLAYING) {
+        size_t remaining = clip->samples - clip->position;
+        written = samples < remaining ? samples : remaining;
+        memcpy(output, clip->pcm + clip->position, written * sizeof(int16_t));
+
+        if (atomic_load_explicit(&clip->cancel, memory_order_relaxed)) {
+            // Short linear ramp instead of a hard cut
+            size_t fade = written < CLIP_FADE_SAMPLES ? written : CLIP_FADE_SAMPLES;
+            for (size_t i = 0; i < fade; i++) {
+                output[i] = (int16_t)(output[i] * (int32_t)(fade - i) / (int32_t)fade);
+            }
+            written = fade;
+            atomic_store(&clip->state, CLIP_CANCELLED);
+        } else {
+            clip->position += written;
+            if (clip->position == clip->samples) {
+                atomic_store(&clip->state, CLIP_DONE);
+            }
+        }
+    }
+
+    memset(output + written, 0, (samples - written) * sizeof(int16_t));
+    atomic_store(&render_busy, 0);
+    return written;
+}
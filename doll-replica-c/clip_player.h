@@ -0,0 +1,33 @@
+#ifndef CLIP_PLAYER_H
+#define CLIP_PLAYER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Clip player configuration
+#define CLIP_QUEUE_MAX 16       // Clips waiting behind the one playing
+#define CLIP_POLL_MS 10         // How often the clip thread checks for a finished clip
+#define CLIP_FADE_MS 5          // Ramp-down on cancel so the cut does not click
+
+// Runs on the clip thread once a clip has played out (completed = 1), was
+// cancelled or could not be decoded (completed = 0)
+typedef void (*clip_done_callback)(unsigned int clip_id, int completed, void *user_data);
+
+// Clip player functions
+int clip_player_init(void);
+void clip_player_cleanup(void);   // Cancels everything; done callbacks still run
+
+// Queue a whole clip (WAV PCM16 / WAV mu-law / MP3 / Ogg Opus / raw mu-law) and
+// return at once. Takes ownership of data, which must come from malloc().
+// Returns the clip id, or 0 if the clip was not queued.
+unsigned int clip_player_submit(unsigned char *data, size_t size,
+                                clip_done_callback done, void *user_data);
+
+// Stop a queued or playing clip; 0 cancels all of them. Returns 1 if anything was cancelled.
+int clip_player_cancel(unsigned int clip_id);
+
+// Called from the real-time output callback: fills all of output with the playing
+// clip or silence, never blocks or allocates. Returns the clip samples written.
+size_t clip_player_render(int16_t *output, size_t samples);
+
+#endif // CLIP_PLAYER_H
@@ -0,0 +1,354 @@
+#include "codec.h"
+#include "g711.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#ifdef HAVE_OPUS
+#include <opus.h>
+#endif
+
+#define CODEC_OPUS_MAX_PACKET 400       // Far above what CODEC_OPUS_BITRATE produces per frame
+
+// ============================================================================
+// MU-LAW PASSTHROUGH
+// ============================================================================
+
+static void* mulaw_create(unsigned int sample_rate) {
+    (void)sample_rate;
+    static int no_state;
+    return &no_state;
+}
+
+static void mulaw_destroy(void *state) {
+    (void)state;
+}
+
+static void mulaw_reset(void *state) {
+    (void)state;
+}
+
+static size_t mulaw_encode(void *state, const int16_t *pcm, size_t samples, unsigned char *out) {
+    (void)state;
+    g711_ulaw_encode(out, pcm, samples);
+    return samples;
+}
+
+// ============================================================================
+// IMA-ADPCM (4 bits per sample, WAV block layout)
+// ============================================================================
+
+static const int16_t adpcm_step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767
+};
+
+static const int8_t adpcm_index_table[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+typedef struct {
+    int predictor;
+    int index;      // Carried across blocks so the step size does not restart
+} adpcm_state_t;
+
+static void* adpcm_create(unsigned int sample_rate) {
+    (void)sample_rate;
+    return calloc(1, sizeof(adpcm_state_t));
+}
+
+static void adpcm_destroy(void *state) {
+    free(state);
+}
+
+static void adpcm_reset(void *state) {
+    memset(state, 0, sizeof(adpcm_state_t));
+}
+
+// Quantize one sample against the running prediction, returning the nibble
+static unsigned char adpcm_encode_sample(adpcm_state_t *st, int sample) {
+    int step = adpcm_step_table[st->index];
+    int diff = sample - st->predictor;
+    unsigned char nibble = 0;
+
+    if (diff < 0) {
+        nibble = 8;
+        diff = -diff;
+    }
+
+    // Reconstruct exactly as the decoder will so both sides track the same predictor
+    int vpdiff = step >> 3;
+    if (diff >= step) { nibble |= 4; diff -= step; vpdiff += step; }
+    step >>= 1;
+    if (diff >= step) { nibble |= 2; diff -= step; vpdiff += step; }
+    step >>= 1;
+    if (diff >= step) { nibble |= 1; vpdiff += step; }
+
+    st->predictor += (nibble & 8) ? -vpdiff : vpdiff;
+    if (st->predictor > INT16_MAX) st->predictor = INT16_MAX;
+    if (st->predictor < INT16_MIN) st->predictor = INT16_MIN;
+
+    st->index += adpcm_index_table[nibble];
+    if (st->index < 0) st->index = 0;
+    if (st->index > 88) st->index = 88;
+    return nibble;
+}
+
+// Each block starts from an exact sample, so a lost block never desyncs the next
+static size_t adpcm_encode(void *state, const int16_t *pcm, size_t samples, unsigned char *out) {
+    adpcm_state_t *st = state;
+    size_t written = 0;
+
+    for (size_t block = 0; block < samples; block += CODEC_ADPCM_BLOCK_SAMPLES) {
+        const int16_t *in = pcm + block;
+        unsigned char *p = out + written;
+
+        st->predictor = in[0];
+        p[0] = (unsigned char)(in[0] & 0xFF);
+        p[1] = (unsigned char)((in[0] >> 8) & 0xFF);
+        p[2] = (unsigned char)st->index;
+        p[3] = 0;
+        p += 4;
+
+        for (size_t i = 1; i < CODEC_ADPCM_BLOCK_SAMPLES; i += 2) {
+            unsigned char low = adpcm_encode_sample(st, in[i]);
+            unsigned char high = adpcm_encode_sample(st, in[i + 1]);
+            *p++ = (unsigned char)(low | (high << 4));
+        }
+
+        written += CODEC_ADPCM_BLOCK_BYTES;
+    }
+
+    return written;
+}
+
+// ============================================================================
+// OPUS (length-prefixed packets)
+// ============================================================================
+
+#ifdef HAVE_OPUS
+
+static void* opus_codec_create(unsigned int sample_rate) {
+    int error = OPUS_OK;
+    OpusEncoder *encoder = opus_encoder_create((opus_int32)sample_rate, 1, OPUS_APPLICATION_VOIP, &error);
+    if (error != OPUS_OK || !encoder) {
+        printf("❌ Failed to create Opus encoder: %s\n", opus_strerror(error));
+        return NULL;
+    }
+
+    opus_encoder_ctl(encoder, OPUS_SET_BITRATE(CODEC_OPUS_BITRATE));
+    opus_encoder_ctl(encoder, OPUS_SET_COMPLEXITY(CODEC_OPUS_COMPLEXITY));
+    opus_encoder_ctl(encoder, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+    return encoder;
+}
+
+static void opus_codec_destroy(void *state) {
+    opus_encoder_destroy(state);
+}
+
+static void opus_codec_reset(void *state) {
+    opus_encoder_ctl(state, OPUS_RESET_STATE);
+}
+
+// Opus packets carry no length of their own, so each gets a 16-bit big-endian prefix.
+// codec_encoder_encode() hands over exactly one frame per call.
+static size_t opus_codec_encode(void *state, const int16_t *pcm, size_t samples, unsigned char *out) {
+    opus_int32 bytes = opus_encode(state, pcm, (int)samples, out + 2, CODEC_OPUS_MAX_PACKET);
+    if (bytes < 0) {
+        printf("❌ Opus encode failed: %s\n", opus_strerror(bytes));
+        return 0;
+    }
+
+    out[0] = (unsigned char)(bytes >> 8);
+    out[1] = (unsigned char)(bytes & 0xFF);
+    return (size_t)bytes + 2;
+}
+
+#endif // HAVE_OPUS
+
+// ============================================================================
+// REGISTRY
+// ============================================================================
+
+static const uplink_codec_t codecs[] = {
+    { "mulaw", 0, "audio/basic", 1, 0, 1,
+      mulaw_create, mulaw_destroy, mulaw_reset, mulaw_encode },
+    { "ima-adpcm", 1, "audio/x-ima-adpcm", CODEC_ADPCM_BLOCK_SAMPLES, 0, CODEC_ADPCM_BLOCK_BYTES,
+      adpcm_create, adpcm_destroy, adpcm_reset, adpcm_encode },
+#ifdef HAVE_OPUS
+    { "opus", 2, "audio/x-opus-lp", 0, CODEC_OPUS_FRAME_MS, CODEC_OPUS_MAX_PACKET + 2,
+      opus_codec_create, opus_codec_destroy, opus_codec_reset, opus_codec_encode },
+#endif
+};
+
+#define CODEC_COUNT (sizeof(codecs) / sizeof(codecs[0]))
+
+const uplink_codec_t* codec_find(const char *name) {
+    for (size_t i = 0; i < CODEC_COUNT; i++) {
+        if (strcasecmp(codecs[i].name, name) == 0) {
+            return &codecs[i];
+        }
+    }
+    return NULL;
+}
+
+// Matches the media type only; parameters after ';' are ignored
+const uplink_codec_t* codec_find_by_content_type(const char *content_type) {
+    size_t length = strcspn(content_type, "; \t");
+    for (size_t i = 0; i < CODEC_COUNT; i++) {
+        if (strlen(codecs[i].content_type) == length &&
+            strncasecmp(codecs[i].content_type, content_type, length) == 0) {
+            return &codecs[i];
+        }
+    }
+    return NULL;
+}
+
+const uplink_codec_t* codec_default(void) {
+    return &codecs[0];
+}
+
+// Codecs named in UPLINK_CODEC_PREFERENCE that this build has, passthrough always last
+size_t codec_preference_list(const uplink_codec_t **list, size_t max) {
+    char preference[] = UPLINK_CODEC_PREFERENCE;
+    size_t count = 0;
+    char *saveptr = NULL;
+
+    // Leave room for the passthrough fallback
+    for (char *name = strtok_r(preference, ", ", &saveptr);
+         name && count + 1 < max;
+         name = strtok_r(NULL, ", ", &saveptr)) {
+        const uplink_codec_t *codec = codec_find(name);
+        if (!codec) {
+            continue;
+        }
+
+        int duplicate = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (list[i] == codec) duplicate = 1;
+        }
+        if (!duplicate) {
+            list[count++] = codec;
+        }
+    }
+
+    // Every server understands mu-law, so the list always ends with it
+    int has_default = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (list[i] == codec_default()) has_default = 1;
+    }
+    if (!has_default && count < max) {
+        list[count++] = codec_default();
+    }
+    return count;
+}
+
+// ============================================================================
+// ENCODER
+// ============================================================================
+
+// Create an encoder instance
+CodecEncoder* codec_encoder_create(const uplink_codec_t *codec, unsigned int sample_rate) {
+    CodecEncoder *encoder = calloc(1, sizeof(CodecEncoder));
+    if (!encoder) {
+        printf("❌ Failed to allocate %s encoder\n", codec->name);
+        return NULL;
+    }
+
+    encoder->codec = codec;
+    encoder->frame_samples = codec->frame_ms ? sample_rate * codec->frame_ms / 1000 : codec->frame_samples;
+    if (encoder->frame_samples == 0 || encoder->frame_samples > CODEC_MAX_FRAME_SAMPLES) {
+        printf("❌ %s frames do not fit at %u Hz\n", codec->name, sample_rate);
+        free(encoder);
+        return NULL;
+    }
+
+    encoder->state = codec->create(sample_rate);
+    if (!encoder->state) {
+        free(encoder);
+        return NULL;
+    }
+
+    return encoder;
+}
+
+void codec_encoder_destroy(CodecEncoder *encoder) {
+    if (!encoder) return;
+
+    encoder->codec->destroy(encoder->state);
+    free(encoder);
+}
+
+// Start a new stream: drop the partial frame and the codec history
+void codec_encoder_reset(CodecEncoder *encoder) {
+    if (!encoder) return;
+
+    encoder->codec->reset(encoder->state);
+    encoder->pending_samples = 0;
+    encoder->samples_in = 0;
+    encoder->bytes_out = 0;
+}
+
+size_t codec_encoder_max_output(const CodecEncoder *encoder, size_t samples) {
+    size_t frames = (encoder->pending_samples + samples) / encoder->frame_samples;
+    return frames * encoder->codec->max_frame_bytes;
+}
+
+// Encode whole frames, holding back the remainder
+size_t codec_encoder_encode(CodecEncoder *encoder, const int16_t *pcm, size_t samples, unsigned char *out) {
+    const uplink_codec_t *codec = encoder->codec;
+    size_t frame = encoder->frame_samples;
+    size_t written = 0;
+
+    encoder->samples_in += samples;
+
+    // Complete the partial frame first
+    if (encoder->pending_samples > 0) {
+        size_t take = frame - encoder->pending_samples;
+        if (take > samples) take = samples;
+        memcpy(encoder->pending + encoder->pending_samples, pcm, take * sizeof(int16_t));
+        encoder->pending_samples += take;
+        pcm += take;
+        samples -= take;
+
+        if (encoder->pending_samples < frame) {
+            return 0;
+        }
+        written += codec->encode(encoder->state, encoder->pending, frame, out);
+        encoder->pending_samples = 0;
+    }
+
+    // Then everything that forms whole frames, straight from the input
+    while (samples >= frame) {
+        size_t whole = frame == 1 ? samples : frame;
+        written += codec->encode(encoder->state, pcm, whole, out + written);
+        pcm += whole;
+        samples -= whole;
+    }
+
+    memcpy(encoder->pending, pcm, samples * sizeof(int16_t));
+    encoder->pending_samples = samples;
+    encoder->bytes_out += written;
+    return written;
+}
+
+// Pad the partial frame with silence and encode it
+size_t codec_encoder_flush(CodecEncoder *encoder, unsigned char *out) {
+    if (!encoder || encoder->pending_samples == 0) return 0;
+
+    size_t frame = encoder->frame_samples;
+    memset(encoder->pending + encoder->pending_samples, 0,
+           (frame - encoder->pending_samples) * sizeof(int16_t));
+
+    size_t written = encoder->codec->encode(encoder->state, encoder->pending, frame, out);
+    encoder->pending_samples = 0;
+    encoder->bytes_out += written;
+    return written;
+}
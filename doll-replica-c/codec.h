@@ -0,0 +1,67 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Uplink codec configuration
+#ifndef UPLINK_CODEC_PREFERENCE
+#define UPLINK_CODEC_PREFERENCE "opus,ima-adpcm,mulaw"  // Offered in order until the server accepts one
+#endif
+#define CODEC_MAX_FRAME_SAMPLES 512     // Largest frame any codec buffers
+#define CODEC_MAX_FRAME_BYTES 1024      // Largest encoded frame, including framing
+#define CODEC_ADPCM_BLOCK_SAMPLES 505   // WAV-style IMA block: 4 byte header + 252 bytes of nibbles
+#define CODEC_ADPCM_BLOCK_BYTES 256
+#define CODEC_OPUS_FRAME_MS 20
+#define CODEC_OPUS_BITRATE 12000        // Wideband speech is clear at 12 kbit/s, narrowband needs less
+#define CODEC_OPUS_COMPLEXITY 5         // Encoder CPU vs quality, 0-10
+
+// An uplink codec. Frame-based codecs only emit whole frames; the encoder
+// below buffers partial input and pads the last frame with silence on flush.
+typedef struct {
+    const char *name;               // Used in UPLINK_CODEC_PREFERENCE and logs
+    unsigned int id;                // Codec id in WebSocket uplink frames
+    const char *content_type;       // Offered on /api/v1/audio/stream
+    unsigned int frame_samples;     // Fixed frame length; 1 for sample-by-sample codecs
+    unsigned int frame_ms;          // Or, when non-zero, a frame duration at the stream's rate
+    size_t max_frame_bytes;         // Encoded size bound for one frame
+
+    void* (*create)(unsigned int sample_rate);
+    void (*destroy)(void *state);
+    void (*reset)(void *state);
+    // Encode exactly frame_samples samples; returns bytes written or 0 on error
+    size_t (*encode)(void *state, const int16_t *pcm, size_t samples, unsigned char *out);
+} uplink_codec_t;
+
+// Codec instance plus the partial frame it has not encoded yet
+typedef struct {
+    const uplink_codec_t *codec;
+    void *state;
+    size_t frame_samples;           // Resolved frame length for this stream
+    int16_t pending[CODEC_MAX_FRAME_SAMPLES];
+    size_t pending_samples;
+    uint64_t samples_in;
+    uint64_t bytes_out;
+} CodecEncoder;
+
+// Registry functions
+const uplink_codec_t* codec_find(const char *name);                    // NULL if unknown or not built
+const uplink_codec_t* codec_find_by_content_type(const char *content_type);
+const uplink_codec_t* codec_default(void);                             // mu-law passthrough
+size_t codec_preference_list(const uplink_codec_t **codecs, size_t max); // Parsed UPLINK_CODEC_PREFERENCE
+
+// Encoder functions
+CodecEncoder* codec_encoder_create(const uplink_codec_t *codec, unsigned int sample_rate);
+void codec_encoder_destroy(CodecEncoder *encoder);
+void codec_encoder_reset(CodecEncoder *encoder);
+
+// Upper bound on what one encode call produces for the given input
+size_t codec_encoder_max_output(const CodecEncoder *encoder, size_t samples);
+
+// Encode as many whole frames as the input completes; returns bytes written
+size_t codec_encoder_encode(CodecEncoder *encoder, const int16_t *pcm, size_t samples, unsigned char *out);
+
+// Pad and encode the partial frame, if any (before a DTX gap or at the end)
+size_t codec_encoder_flush(CodecEncoder *encoder, unsigned char *out);
+
+#endif // CODEC_H
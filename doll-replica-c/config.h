@@ -7,9 +7,19 @@
 #define WEBSOCKET_PATH "/ws"
 
 // Connection settings
-#define PING_INTERVAL_SECONDS 30  // More IoT-friendly
+#define KEEPALIVE_INTERVAL_MS 5000  // Ping this long after the last pong
+#define KEEPALIVE_TIMEOUT_MS 2000   // No pong by then: the link is gone, even if TCP has not noticed
 #define MAX_MESSAGE_LENGTH 65536  // Back to reasonable size, large data handled dynamically
-#define MAX_QUEUE_SIZE 10
+
+// Control message encoding, negotiated through the WebSocket subprotocol. CBOR is
+// offered first; a server that picks the JSON protocol, or none, gets JSON.
+#define WS_PROTOCOL_JSON "websocket"
+#define WS_PROTOCOL_CBOR "doll-cbor"
+#define WS_OFFER_CBOR 1
+
+// Service loop wakeups - between them it sleeps until a socket, stdin or another thread needs it
+#define SERVICE_ACTIVE_TICK_MS 10    // While a response plays: barge-in and drain checks
+#define SERVICE_IDLE_TICK_MS 1000    // Otherwise only the periodic stats line is due
 
 // Logging levels
 #define LOG_LEVELS (LLL_USER | LLL_ERR | LLL_WARN | LLL_NOTICE)
@@ -0,0 +1,136 @@
+#include "control_message.h"
+#include "cbor.h"
+#include <string.h>
+
+// Keys with their lengths, so a lookup is a length compare and at most one memcmp
+static const struct {
+    const char *name;
+    size_t length;
+} field_names[CONTROL_FIELD_COUNT] = {
+    { "type", 4 }, { "session_id", 10 }, { "text", 4 }, { "utterance_id", 12 }, { "sequence", 8 }, { "audio", 5 },
+};
+
+void control_message_reset(control_message_t *message) {
+    message->type[0] = '\0';
+    message->session_id[0] = '\0';
+    message->text[0] = '\0';
+    message->utterance_id = 0;
+    message->sequence = 0;
+    message->found = 0;
+    message->truncated = 0;
+}
+
+int control_field_lookup(const char *key, size_t length) {
+    for (int field = 0; field < CONTROL_FIELD_COUNT; field++) {
+        if (field_names[field].length == length && memcmp(key, field_names[field].name, length) == 0) {
+            return field;
+        }
+    }
+    return -1;
+}
+
+// Out of line on purpose: inlined, its constant sizes bound the copies in
+// store_string() and GCC turns them into rep movsq, slow to start for strings this short
+__attribute__((noinline))
+char* control_message_string(control_message_t *message, int field, size_t *size) {
+    switch (field) {
+        case CONTROL_FIELD_TYPE:
+            *size = sizeof(message->type);
+            return message->type;
+        case CONTROL_FIELD_SESSION_ID:
+            *size = sizeof(message->session_id);
+            return message->session_id;
+        case CONTROL_FIELD_TEXT:
+            *size = sizeof(message->text);
+            return message->text;
+        default:
+            return NULL;
+    }
+}
+
+uint64_t* control_message_number(control_message_t *message, int field) {
+    switch (field) {
+        case CONTROL_FIELD_UTTERANCE_ID:
+            return &message->utterance_id;
+        case CONTROL_FIELD_SEQUENCE:
+            return &message->sequence;
+        default:
+            return NULL;
+    }
+}
+
+// A string value of ours: copied out, cut to fit like the JSON parser does
+static void store_string(control_message_t *message, int field, const char *text, size_t length) {
+    size_t size;
+    char *buffer = control_message_string(message, field, &size);
+
+    if (length > size - 1) {
+        length = size - 1;
+        message->truncated |= CONTROL_FIELD_BIT(field);
+    } else {
+        message->truncated &= ~CONTROL_FIELD_BIT(field);
+    }
+    memcpy(buffer, text, length);
+    buffer[length] = '\0';
+    message->found |= CONTROL_FIELD_BIT(field);
+}
+
+int control_message_decode_cbor(control_message_t *message, const uint8_t *data, size_t length) {
+    CborReader reader;
+    uint64_t pairs;
+
+    control_message_reset(message);
+    cbor_reader_init(&reader, data, length);
+    cbor_skip_self_describe(&reader);
+    if (!cbor_read_map(&reader, &pairs)) {
+        return 0;
+    }
+
+    for (uint64_t i = 0; i < pairs; i++) {
+        // Keys that are not text are allowed, just never ours
+        int field = -1;
+        if (cbor_peek(&reader) == CBOR_MAJOR_TEXT) {
+            const char *key;
+            size_t key_length;
+            if (!cbor_read_text(&reader, &key, &key_length)) return 0;
+            field = control_field_lookup(key, key_length);
+        } else if (!cbor_skip(&reader)) {
+            return 0;
+        }
+
+        // A value of the wrong type is skipped, as JSON ignores a number where text belongs
+        int major = cbor_peek(&reader);
+        uint64_t *number = control_message_number(message, field);
+        size_t size;
+        if (number && major == CBOR_MAJOR_UNSIGNED) {
+            if (!cbor_read_uint(&reader, number)) return 0;
+            message->found |= CONTROL_FIELD_BIT(field);
+        } else if (control_message_string(message, field, &size) && major == CBOR_MAJOR_TEXT) {
+            const char *text;
+            size_t text_length;
+            if (!cbor_read_text(&reader, &text, &text_length)) return 0;
+            store_string(message, field, text, text_length);
+        } else if (!cbor_skip(&reader)) {
+            return 0;
+        }
+    }
+
+    // Exactly one item
+    return reader.offset == reader.length;
+}
+
+size_t control_message_encode_cbor(uint8_t *out, size_t size, const char *type,
+                                   const char *key, const char *value) {
+    CborWriter writer;
+
+    cbor_writer_init(&writer, out, size);
+    cbor_write_self_describe(&writer);
+    cbor_write_map(&writer, key ? 2 : 1);
+    cbor_write_text(&writer, "type");
+    cbor_write_text(&writer, type);
+    if (key) {
+        cbor_write_text(&writer, key);
+        cbor_write_text(&writer, value);
+    }
+    return writer.error ? 0 : writer.length;
+}
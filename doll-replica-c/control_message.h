@@ -0,0 +1,65 @@
+#ifndef CONTROL_MESSAGE_H
+#define CONTROL_MESSAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Control message configuration (transcriptions, utterance markers, errors)
+#define CONTROL_TYPE_MAX 32
+#define CONTROL_SESSION_MAX 64
+#define CONTROL_TEXT_MAX 4096
+#define CONTROL_CBOR_MAX 16384          // Reassembly limit for one CBOR control message
+
+// Encoding of control messages, chosen by the WebSocket subprotocol the server
+// accepted; the value is the protocols[] id
+typedef enum {
+    CONTROL_ENCODING_JSON = 0,          // Text frames
+    CONTROL_ENCODING_CBOR,              // Binary frames behind the CBOR self-describe tag
+} control_encoding_t;
+
+// Members the client acts on; the schema is the same in both encodings
+typedef enum {
+    CONTROL_FIELD_TYPE = 0,
+    CONTROL_FIELD_SESSION_ID,
+    CONTROL_FIELD_TEXT,
+    CONTROL_FIELD_UTTERANCE_ID,     // Unsigned number
+    CONTROL_FIELD_SEQUENCE,         // Unsigned number: uplink frame an ack covers
+    CONTROL_FIELD_AUDIO,            // JSON only: base64, streamed, never stored
+    CONTROL_FIELD_COUNT
+} control_field_t;
+
+#define CONTROL_FIELD_BIT(field) (1u << (field))
+
+// One decoded control message, fixed size: nothing is allocated per message
+typedef struct {
+    char type[CONTROL_TYPE_MAX];
+    char session_id[CONTROL_SESSION_MAX];
+    char text[CONTROL_TEXT_MAX];
+    uint64_t utterance_id;
+    uint64_t sequence;
+    unsigned int found;             // CONTROL_FIELD_BIT()s of the members read
+    unsigned int truncated;         // String members cut to fit their buffer
+} control_message_t;
+
+void control_message_reset(control_message_t *message);
+
+// Field named by a key, -1 for keys we ignore
+int control_field_lookup(const char *key, size_t length);
+
+// Buffer of a stored string field, NULL for the others
+char* control_message_string(control_message_t *message, int field, size_t *size);
+
+// Where an unsigned number field goes, NULL for the others
+uint64_t* control_message_number(control_message_t *message, int field);
+
+// Decode one CBOR control message: a definite-length map, optionally behind the
+// self-describe tag. Strings are copied straight out of data. Returns 0 if it is
+// not well-formed or not a map.
+int control_message_decode_cbor(control_message_t *message, const uint8_t *data, size_t length);
+
+// Encode {"type": type, key: value} (key NULL for none) as a tagged CBOR map.
+// Returns the encoded length, 0 if it does not fit.
+size_t control_message_encode_cbor(uint8_t *out, size_t size, const char *type,
+                                   const char *key, const char *value);
+
+#endif // CONTROL_MESSAGE_H
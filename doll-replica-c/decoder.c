@@ -0,0 +1,570 @@
+#include "decoder.h"
+#include "g711.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WAV_FORMAT_PCM16 1
+#define WAV_FORMAT_MULAW 7
+
+#ifdef HAVE_OPUS
+#include <opus.h>
+#endif
+#ifdef HAVE_MPG123
+#include <mpg123.h>
+#endif
+
+// ============================================================================
+// LINEAR16 / MU-LAW
+// ============================================================================
+
+typedef struct {
+    unsigned int sample_rate;
+    unsigned char carry;        // Odd byte of a sample split across chunks
+    int carry_valid;
+    int16_t pcm[DECODER_MAX_PCM_SAMPLES];
+} pcm_state_t;
+
+static void* pcm_create(const audio_format_t *format, unsigned int preferred_rate) {
+    (void)preferred_rate;
+    pcm_state_t *st = calloc(1, sizeof(pcm_state_t));
+    if (st) st->sample_rate = format->sample_rate;
+    return st;
+}
+
+static void pcm_destroy(void *state) {
+    free(state);
+}
+
+static int linear16_decode(void *state, const unsigned char *data, size_t size,
+                           decoder_output_fn output, void *ctx) {
+    pcm_state_t *st = state;
+    size_t n = 0;
+
+    // Little-endian samples; a sample may straddle two chunks
+    if (st->carry_valid && size > 0) {
+        st->pcm[n++] = (int16_t)(st->carry | (data[0] << 8));
+        data++;
+        size--;
+        st->carry_valid = 0;
+    }
+
+    while (size >= 2) {
+        size_t count = size / 2;
+        if (count > DECODER_MAX_PCM_SAMPLES - n) count = DECODER_MAX_PCM_SAMPLES - n;
+        for (size_t i = 0; i < count; i++) {
+            st->pcm[n++] = (int16_t)(data[2 * i] | (data[2 * i + 1] << 8));
+        }
+        data += count * 2;
+        size -= count * 2;
+
+        output(ctx, st->pcm, n, st->sample_rate);
+        n = 0;
+    }
+
+    if (n > 0) output(ctx, st->pcm, n, st->sample_rate);
+    if (size == 1) {
+        st->carry = data[0];
+        st->carry_valid = 1;
+    }
+    return 1;
+}
+
+static int mulaw_decode(void *state, const unsigned char *data, size_t size,
+                        decoder_output_fn output, void *ctx) {
+    pcm_state_t *st = state;
+
+    while (size > 0) {
+        size_t count = size < DECODER_MAX_PCM_SAMPLES ? size : DECODER_MAX_PCM_SAMPLES;
+        g711_ulaw_decode(st->pcm, data, count);
+        output(ctx, st->pcm, count, st->sample_rate);
+        data += count;
+        size -= count;
+    }
+    return 1;
+}
+
+// ============================================================================
+// MP3 (libmpg123 in feed mode)
+// ============================================================================
+
+#ifdef HAVE_MPG123
+
+typedef struct {
+    mpg123_handle *handle;
+    unsigned int sample_rate;
+    int16_t pcm[DECODER_MAX_PCM_SAMPLES];
+} mp3_state_t;
+
+static void mp3_destroy(void *state) {
+    mp3_state_t *st = state;
+    if (!st) return;
+
+    if (st->handle) {
+        mpg123_close(st->handle);
+        mpg123_delete(st->handle);
+    }
+    free(st);
+}
+
+static void* mp3_create(const audio_format_t *format, unsigned int preferred_rate) {
+    (void)preferred_rate;
+    static int library_ready = 0;
+    if (!library_ready) {
+        if (mpg123_init() != MPG123_OK) return NULL;
+        library_ready = 1;
+    }
+
+    mp3_state_t *st = calloc(1, sizeof(mp3_state_t));
+    if (!st) return NULL;
+    st->sample_rate = format->sample_rate;
+
+    int err = MPG123_OK;
+    st->handle = mpg123_new(NULL, &err);
+    if (!st->handle) {
+        printf("❌ Failed to create MP3 decoder: %s\n", mpg123_plain_strerror(err));
+        free(st);
+        return NULL;
+    }
+
+    // Mono 16-bit at whatever rate the stream has; stereo is mixed down
+    const long *rates;
+    size_t rate_count;
+    mpg123_param(st->handle, MPG123_ADD_FLAGS, MPG123_QUIET | MPG123_MONO_MIX, 0);
+    mpg123_format_none(st->handle);
+    mpg123_rates(&rates, &rate_count);
+    for (size_t i = 0; i < rate_count; i++) {
+        mpg123_format(st->handle, rates[i], MPG123_MONO, MPG123_ENC_SIGNED_16);
+    }
+
+    if (mpg123_open_feed(st->handle) != MPG123_OK) {
+        printf("❌ Failed to open MP3 feed: %s\n", mpg123_strerror(st->handle));
+        mp3_destroy(st);
+        return NULL;
+    }
+    return st;
+}
+
+static int mp3_decode(void *state, const unsigned char *data, size_t size,
+                      decoder_output_fn output, void *ctx) {
+    mp3_state_t *st = state;
+    size_t done = 0;
+    int ret = mpg123_decode(st->handle, data, size, (unsigned char *)st->pcm, sizeof(st->pcm), &done);
+
+    // The first call takes the input, the following ones drain the frames it completed
+    for (;;) {
+        if (ret == MPG123_NEW_FORMAT) {
+            long rate;
+            int channels, encoding;
+            mpg123_getformat(st->handle, &rate, &channels, &encoding);
+            st->sample_rate = (unsigned int)rate;
+        }
+        if (done > 0) {
+            output(ctx, st->pcm, done / sizeof(int16_t), st->sample_rate);
+        }
+        if (ret == MPG123_ERR) {
+            printf("❌ MP3 decode error: %s\n", mpg123_strerror(st->handle));
+            return 0;
+        }
+        if (ret == MPG123_NEED_MORE || ret == MPG123_DONE) {
+            return 1;
+        }
+        ret = mpg123_decode(st->handle, NULL, 0, (unsigned char *)st->pcm, sizeof(st->pcm), &done);
+    }
+}
+
+#endif // HAVE_MPG123
+
+// ============================================================================
+// OGG / OPUS (RFC 7845)
+// ============================================================================
+
+#ifdef HAVE_OPUS
+
+#define OGG_HEADER_SIZE 27
+#define OGG_FLAG_CONTINUED 0x01
+#define OGG_FLAG_BOS 0x02
+#define OPUS_GRANULE_RATE 48000
+
+typedef struct {
+    OpusDecoder *decoder;
+    unsigned int sample_rate;       // Decoder output rate
+    unsigned int preskip;           // Output samples still to drop at stream start
+
+    // Page reassembly; pages are taken whole, so one never straddles a decode call
+    unsigned char page[DECODER_OGG_MAX_PAGE];
+    size_t page_fill;
+    uint32_t serial;
+    int header_packets;             // OpusHead and OpusTags seen in this logical stream
+
+    // Packet reassembly across lacing values and pages
+    unsigned char packet[DECODER_OGG_MAX_PACKET];
+    size_t packet_size;
+    int packet_open;
+    int packet_oversize;
+
+    int16_t pcm[DECODER_MAX_PCM_SAMPLES];
+} ogg_opus_state_t;
+
+static void ogg_opus_destroy(void *state) {
+    ogg_opus_state_t *st = state;
+    if (!st) return;
+
+    if (st->decoder) opus_decoder_destroy(st->decoder);
+    free(st);
+}
+
+static void* ogg_opus_create(const audio_format_t *format, unsigned int preferred_rate) {
+    (void)format;
+    ogg_opus_state_t *st = calloc(1, sizeof(ogg_opus_state_t));
+    if (!st) return NULL;
+
+    // Opus decodes natively at these rates, which saves a resampling pass
+    switch (preferred_rate) {
+        case 8000: case 12000: case 16000: case 24000: case 48000:
+            st->sample_rate = preferred_rate;
+            break;
+        default:
+            st->sample_rate = OPUS_GRANULE_RATE;
+            break;
+    }
+
+    // Mono output; libopus mixes stereo packets down itself
+    int err = OPUS_OK;
+    st->decoder = opus_decoder_create((opus_int32)st->sample_rate, 1, &err);
+    if (err != OPUS_OK || !st->decoder) {
+        printf("❌ Failed to create Opus decoder: %s\n", opus_strerror(err));
+        free(st);
+        return NULL;
+    }
+    return st;
+}
+
+// Handle one complete Ogg packet of the current logical stream
+static int ogg_opus_packet(ogg_opus_state_t *st, decoder_output_fn output, void *ctx) {
+    const unsigned char *p = st->packet;
+    size_t size = st->packet_size;
+
+    if (st->header_packets == 0) {
+        if (size < 19 || memcmp(p, "OpusHead", 8) != 0) {
+            printf("❌ Ogg stream is not Opus\n");
+            return 0;
+        }
+        if (p[18] != 0) {
+            printf("❌ Unsupported Opus channel mapping %u\n", p[18]);
+            return 0;
+        }
+        unsigned int preskip = p[10] | (p[11] << 8);
+        st->preskip = preskip * st->sample_rate / OPUS_GRANULE_RATE;
+        opus_decoder_ctl(st->decoder, OPUS_RESET_STATE);
+        st->header_packets = 1;
+        return 1;
+    }
+
+    if (st->header_packets == 1) {
+        st->header_packets = 2; // OpusTags: nothing we need
+        return 1;
+    }
+
+    int samples = opus_decode(st->decoder, p, (opus_int32)size, st->pcm, DECODER_MAX_PCM_SAMPLES, 0);
+    if (samples < 0) {
+        printf("❌ Opus decode error: %s\n", opus_strerror(samples));
+        return 0;
+    }
+
+    const int16_t *pcm = st->pcm;
+    if (st->preskip > 0) {
+        unsigned int skip = st->preskip < (unsigned int)samples ? st->preskip : (unsigned int)samples;
+        st->preskip -= skip;
+        pcm += skip;
+        samples -= (int)skip;
+    }
+    if (samples > 0) {
+        output(ctx, pcm, (size_t)samples, st->sample_rate);
+    }
+    return 1;
+}
+
+// Split a complete page into packets. Returns 0 if a packet failed to decode.
+static int ogg_opus_page(ogg_opus_state_t *st, const unsigned char *page,
+                         decoder_output_fn output, void *ctx) {
+    unsigned char flags = page[5];
+    uint32_t serial = page[14] | (page[15] << 8) | (page[16] << 16) | ((uint32_t)page[17] << 24);
+    unsigned int segments = page[26];
+    const unsigned char *lacing = page + OGG_HEADER_SIZE;
+    const unsigned char *body = lacing + segments;
+    int ok = 1;
+
+    // A new logical stream (the next TTS response) starts with its own headers
+    if (flags & OGG_FLAG_BOS) {
+        st->serial = serial;
+        st->header_packets = 0;
+        st->packet_open = 0;
+    } else if (serial != st->serial) {
+        return 1; // Some other multiplexed stream
+    }
+
+    // The transport is reliable, so a broken continuation means the server restarted mid-packet
+    int skip = (flags & OGG_FLAG_CONTINUED) && !st->packet_open;
+    if (!(flags & OGG_FLAG_CONTINUED)) {
+        st->packet_open = 0;
+    }
+
+    for (unsigned int i = 0; i < segments; i++) {
+        size_t len = lacing[i];
+
+        if (!skip) {
+            if (!st->packet_open) {
+                st->packet_size = 0;
+                st->packet_oversize = 0;
+                st->packet_open = 1;
+            }
+            if (st->packet_size + len <= sizeof(st->packet)) {
+                memcpy(st->packet + st->packet_size, body, len);
+                st->packet_size += len;
+            } else {
+                st->packet_oversize = 1;
+            }
+        }
+        body += len;
+
+        // A lacing value below 255 ends the packet
+        if (len < 255) {
+            if (!skip && !st->packet_oversize && !ogg_opus_packet(st, output, ctx)) {
+                ok = 0;
+            } else if (!skip && st->packet_oversize && st->header_packets == 1) {
+                st->header_packets = 2; // Oversized OpusTags, usually embedded cover art
+            }
+            st->packet_open = 0;
+            skip = 0;
+        }
+    }
+    return ok;
+}
+
+static int ogg_opus_decode(void *state, const unsigned char *data, size_t size,
+                           decoder_output_fn output, void *ctx) {
+    ogg_opus_state_t *st = state;
+    int ok = 1;
+
+    while (size > 0) {
+        size_t space = sizeof(st->page) - st->page_fill;
+        size_t n = size < space ? size : space;
+        memcpy(st->page + st->page_fill, data, n);
+        st->page_fill += n;
+        data += n;
+        size -= n;
+
+        size_t offset = 0;
+        while (st->page_fill - offset >= OGG_HEADER_SIZE) {
+            const unsigned char *page = st->page + offset;
+
+            // Lost capture pattern: skip ahead to the next one
+            if (memcmp(page, "OggS", 4) != 0) {
+                offset++;
+                while (offset + 4 <= st->page_fill && memcmp(st->page + offset, "OggS", 4) != 0) {
+                    offset++;
+                }
+                ok = 0;
+                continue;
+            }
+
+            size_t header_size = OGG_HEADER_SIZE + page[26];
+            if (st->page_fill - offset < header_size) break;
+
+            size_t page_size = header_size;
+            for (unsigned int i = 0; i < page[26]; i++) {
+                page_size += page[OGG_HEADER_SIZE + i];
+            }
+            if (st->page_fill - offset < page_size) break;
+
+            if (!ogg_opus_page(st, page, output, ctx)) ok = 0;
+            offset += page_size;
+        }
+
+        memmove(st->page, st->page + offset, st->page_fill - offset);
+        st->page_fill -= offset;
+    }
+    return ok;
+}
+
+#endif // HAVE_OPUS
+
+// ============================================================================
+// REGISTRY
+// ============================================================================
+
+static const downlink_decoder_t decoders[] = {
+    { "mulaw", AUDIO_ENCODING_MULAW, pcm_create, pcm_destroy, mulaw_decode },
+    { "linear16", AUDIO_ENCODING_LINEAR16, pcm_create, pcm_destroy, linear16_decode },
+#ifdef HAVE_MPG123
+    { "mp3", AUDIO_ENCODING_MP3, mp3_create, mp3_destroy, mp3_decode },
+#endif
+#ifdef HAVE_OPUS
+    { "ogg_opus", AUDIO_ENCODING_OGG_OPUS, ogg_opus_create, ogg_opus_destroy, ogg_opus_decode },
+#endif
+};
+
+const downlink_decoder_t* decoder_find(audio_encoding_t encoding) {
+    for (size_t i = 0; i < sizeof(decoders) / sizeof(decoders[0]); i++) {
+        if (decoders[i].encoding == encoding) return &decoders[i];
+    }
+    return NULL;
+}
+
+// Length of the MPEG-1/2/2.5 Layer III frame starting at p, or 0 if p is not a frame header
+static size_t mp3_frame_length(const unsigned char *p) {
+    static const unsigned short bitrates[2][15] = {
+        { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 },   // MPEG-1
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },       // MPEG-2 / 2.5
+    };
+    static const unsigned int rates[3] = { 44100, 48000, 32000 };
+
+    if (p[0] != 0xFF || (p[1] & 0xE0) != 0xE0) return 0;
+
+    unsigned int version = (p[1] >> 3) & 3;     // 3 = MPEG-1, 2 = MPEG-2, 0 = MPEG-2.5
+    unsigned int layer = (p[1] >> 1) & 3;       // 1 = Layer III
+    unsigned int bitrate_index = p[2] >> 4;
+    unsigned int rate_index = (p[2] >> 2) & 3;
+    if (version == 1 || layer != 1 || bitrate_index == 0 || bitrate_index == 15 || rate_index == 3) {
+        return 0;
+    }
+
+    int mpeg1 = version == 3;
+    unsigned int rate = rates[rate_index] >> (mpeg1 ? 0 : version == 2 ? 1 : 2);
+    unsigned int bitrate = bitrates[mpeg1 ? 0 : 1][bitrate_index] * 1000;
+    return (mpeg1 ? 144 : 72) * bitrate / rate + ((p[2] >> 1) & 1);
+}
+
+// Walk the RIFF chunks up to "data", noting the format tag and rate on the way
+int decoder_parse_wav(const unsigned char *data, size_t size, audio_format_t *format, size_t *offset) {
+    if (size <= 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0) {
+        return 0;
+    }
+
+    unsigned int wav_format = WAV_FORMAT_MULAW;
+    unsigned int wav_rate = 8000;      // G.711 defaults until the fmt chunk says otherwise
+    size_t pos = 12;
+    *offset = 0;
+
+    while (pos + 8 <= size) {
+        uint32_t chunk_size = data[pos + 4] | (data[pos + 5] << 8) | (data[pos + 6] << 16) |
+                              ((uint32_t)data[pos + 7] << 24);
+
+        if (memcmp(data + pos, "data", 4) == 0) {
+            *offset = pos + 8;
+            break;
+        }
+
+        if (memcmp(data + pos, "fmt ", 4) == 0 && pos + 16 <= size) {
+            wav_format = data[pos + 8] | (data[pos + 9] << 8);
+            wav_rate = data[pos + 12] | (data[pos + 13] << 8) | (data[pos + 14] << 16) |
+                       ((uint32_t)data[pos + 15] << 24);
+        }
+
+        // RIFF pads an odd-sized chunk to an even length
+        pos += 8 + (size_t)chunk_size + (chunk_size & 1);
+    }
+
+    if (*offset == 0) {
+        printf("❌ WAV header has no data chunk\n");
+        return -1;
+    }
+
+    if (wav_format != WAV_FORMAT_PCM16 && wav_format != WAV_FORMAT_MULAW) {
+        printf("❌ Unsupported WAV format tag %u\n", wav_format);
+        return -1;
+    }
+
+    format->encoding = wav_format == WAV_FORMAT_PCM16 ? AUDIO_ENCODING_LINEAR16 : AUDIO_ENCODING_MULAW;
+    format->sample_rate = wav_rate;
+    return 1;
+}
+
+// Raw PCM can start with anything, so MP3 needs a second frame header right
+// where the first frame ends before it counts
+void decoder_detect(const unsigned char *data, size_t size,
+                    const audio_format_t *negotiated, audio_format_t *detected) {
+    *detected = *negotiated;
+
+    if (size >= 4 && memcmp(data, "OggS", 4) == 0) {
+        detected->encoding = AUDIO_ENCODING_OGG_OPUS;
+        return;
+    }
+
+    if (size >= 10 && data[0] == 'I' && data[1] == 'D' && data[2] == '3' &&
+        data[3] >= 0x02 && data[3] <= 0x04) {
+        detected->encoding = AUDIO_ENCODING_MP3;
+        return;
+    }
+
+    if (size >= 4) {
+        size_t length = mp3_frame_length(data);
+        if (length > 0 && size >= length + 4 && mp3_frame_length(data + length) > 0) {
+            detected->encoding = AUDIO_ENCODING_MP3;
+        }
+    }
+}
+
+// ============================================================================
+// DECODER
+// ============================================================================
+
+// Create a decoder instance
+AudioDecoder* decoder_create(const audio_format_t *format, unsigned int preferred_rate) {
+    const downlink_decoder_t *codec = decoder_find(format->encoding);
+    if (!codec) {
+        printf("❌ No %s decoder in this build\n", audio_encoding_name(format->encoding));
+        return NULL;
+    }
+
+    AudioDecoder *decoder = calloc(1, sizeof(AudioDecoder));
+    if (!decoder) {
+        printf("❌ Failed to allocate decoder\n");
+        return NULL;
+    }
+
+    decoder->decoder = codec;
+    decoder->format = *format;
+    decoder->state = codec->create(format, preferred_rate);
+    if (!decoder->state) {
+        printf("❌ Failed to create %s decoder\n", codec->name);
+        free(decoder);
+        return NULL;
+    }
+    return decoder;
+}
+
+// Destroy a decoder instance
+void decoder_destroy(AudioDecoder *decoder) {
+    if (!decoder) return;
+
+    decoder->decoder->destroy(decoder->state);
+    free(decoder);
+}
+
+typedef struct {
+    AudioDecoder *decoder;
+    decoder_output_fn output;
+    void *ctx;
+} decoder_tap_t;
+
+// Counts what the codec produces on its way to the caller's output
+static void decoder_tap(void *ctx, const int16_t *pcm, size_t samples, unsigned int sample_rate) {
+    decoder_tap_t *tap = ctx;
+    tap->decoder->samples_out += samples;
+    tap->output(tap->ctx, pcm, samples, sample_rate);
+}
+
+// Feed a chunk of the stream; PCM is delivered to output before this returns
+int decoder_decode(AudioDecoder *decoder, const unsigned char *data, size_t size,
+                   decoder_output_fn output, void *ctx) {
+    decoder_tap_t tap = { decoder, output, ctx };
+
+    decoder->bytes_in += size;
+    if (!decoder->decoder->decode(decoder->state, data, size, decoder_tap, &tap)) {
+        decoder->errors++;
+        return 0;
+    }
+    return 1;
+}
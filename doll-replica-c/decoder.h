@@ -0,0 +1,58 @@
+#ifndef DECODER_H
+#define DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "audio_format.h"
+
+// Downlink decoder configuration
+#define DECODER_MAX_PCM_SAMPLES 5760        // Largest block handed to the output (120 ms Opus at 48 kHz)
+#define DECODER_OGG_MAX_PAGE (27 + 255 + 255 * 255)
+#define DECODER_OGG_MAX_PACKET 16384        // Larger packets (cover art in OpusTags) are skipped
+
+// Decoded PCM goes here as it becomes available, at the rate the stream declares
+typedef void (*decoder_output_fn)(void *ctx, const int16_t *pcm, size_t samples, unsigned int sample_rate);
+
+// A TTS stream decoder. Input may be split anywhere: decoders carry partial
+// samples, frames, pages and packets across calls.
+typedef struct {
+    const char *name;
+    audio_encoding_t encoding;
+
+    void* (*create)(const audio_format_t *format, unsigned int preferred_rate);
+    void (*destroy)(void *state);
+    // Consume all of the input; returns 0 on a decode error (later input resyncs)
+    int (*decode)(void *state, const unsigned char *data, size_t size,
+                  decoder_output_fn output, void *ctx);
+} downlink_decoder_t;
+
+typedef struct {
+    const downlink_decoder_t *decoder;
+    void *state;
+    audio_format_t format;
+    uint64_t bytes_in;
+    uint64_t samples_out;
+    unsigned int errors;
+} AudioDecoder;
+
+// Registry functions
+const downlink_decoder_t* decoder_find(audio_encoding_t encoding);  // NULL if not built
+
+// Pick the encoding from the first bytes of a stream: Ogg and MP3 (sync word
+// or ID3v2 tag) are recognized, anything else is taken to be the negotiated format
+void decoder_detect(const unsigned char *data, size_t size,
+                    const audio_format_t *negotiated, audio_format_t *detected);
+
+// RIFF/WAVE header (PCM16 or mu-law): the format and the offset of the samples.
+// Returns 0 if the data is not a WAV file, -1 for one that cannot be played
+// or whose header does not fit in size bytes.
+int decoder_parse_wav(const unsigned char *data, size_t size, audio_format_t *format, size_t *offset);
+
+// Decoder functions; codecs that can decode at preferred_rate themselves (Opus) do,
+// the rest report the stream's own rate to the output
+AudioDecoder* decoder_create(const audio_format_t *format, unsigned int preferred_rate);
+void decoder_destroy(AudioDecoder *decoder);
+int decoder_decode(AudioDecoder *decoder, const unsigned char *data, size_t size,
+                   decoder_output_fn output, void *ctx);
+
+#endif // DECODER_H
@@ -0,0 +1,345 @@
+#include "downlink.h"
+#include "audio.h"
+#include "decoder.h"
+#include "metrics.h"
+#include "resampler.h"
+#include "ring_buffer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+// Downlink ring: the WebSocket thread produces encoded TTS, the decoder thread consumes
+static AudioRingBuffer *downlink_ring = NULL;
+
+// Decoder thread state; the thread sleeps until downlink_push() has something for it
+static pthread_t decoder_tid;
+static atomic_int decoder_running = 0;
+static pthread_mutex_t wake_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake_cond = PTHREAD_COND_INITIALIZER;
+static int wake_pending = 0;
+static atomic_int draining = 0;     // Set before the thread reads the ring, cleared once decoded
+
+// Current stream (stream_mutex); the decoder is created from the stream's first bytes.
+// The mutex covers ring reads and swapping these pointers, never a decode: while
+// decoding is set the decoder thread uses the decoder, resampler and jitter buffer
+// unlocked, and begin / end bump the generation and wait for it to let go.
+static pthread_mutex_t stream_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stream_cond = PTHREAD_COND_INITIALIZER;  // decoding cleared, or a new generation
+static JitterBuffer *stream_jitter_buffer = NULL;
+static audio_format_t stream_format = { AUDIO_ENCODING_MULAW, SAMPLE_RATE };
+static AudioDecoder *stream_decoder = NULL;
+static _Atomic(const char *) stream_decoder_name = "none";
+static int stream_active = 0;
+static int decoding = 0;                        // A chunk is being decoded unlocked
+static atomic_uint stream_generation = 0;       // Bumped by begin / end: the decode in flight is stale
+
+// Decoder rate -> device rate, rebuilt if the stream's rate changes
+static Resampler *stream_resampler = NULL;
+static size_t slice_samples = DOWNLINK_PCM_BLOCK; // Decoded samples per resampling pass
+
+// Counters (written from the WebSocket and decoder threads)
+static atomic_uint_fast64_t bytes_received = 0;
+static atomic_uint_fast64_t bytes_dropped = 0;
+static atomic_uint_fast64_t samples_decoded = 0;
+static atomic_uint_fast64_t bytes_played = 0;
+static atomic_uint_fast64_t bytes_overflow = 0;
+static atomic_uint decode_errors = 0;
+static atomic_size_t max_queue_depth = 0;
+
+// Wait until the jitter buffer has room for size bytes. The callback cannot signal,
+// so this polls; begin / end wake it at once. Returns 0 if the stream went stale.
+static int wait_for_room(JitterBuffer *jitter_buffer, size_t size, unsigned int generation) {
+    while (audio_ring_buffer_free(jitter_buffer->ring) < size) {
+        pthread_mutex_lock(&stream_mutex);
+        if (atomic_load(&stream_generation) == generation && atomic_load(&decoder_running)) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += DOWNLINK_ROOM_POLL_MS * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&stream_cond, &stream_mutex, &deadline);
+        }
+        pthread_mutex_unlock(&stream_mutex);
+
+        if (atomic_load(&stream_generation) != generation || !atomic_load(&decoder_running)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Decoder output: bring it to the device rate and hand it to the jitter buffer.
+// Runs unlocked with decoding set; ctx is the generation the chunk was read in.
+static void play_decoded(void *ctx, const int16_t *pcm, size_t samples, unsigned int sample_rate) {
+    unsigned int generation = *(const unsigned int *)ctx;
+    int16_t out[DOWNLINK_PCM_BLOCK];
+
+    if (atomic_load(&stream_generation) != generation) {
+        return;
+    }
+
+    atomic_fetch_add_explicit(&samples_decoded, samples, memory_order_relaxed);
+
+    if (!stream_resampler || stream_resampler->in_rate != sample_rate) {
+        resampler_destroy(stream_resampler);
+        stream_resampler = resampler_create(sample_rate, DEVICE_SAMPLE_RATE);
+        if (!stream_resampler) return;
+
+        slice_samples = DOWNLINK_PCM_BLOCK;
+        while (resampler_max_output(stream_resampler, slice_samples) > DOWNLINK_PCM_BLOCK) {
+            slice_samples /= 2;
+        }
+    }
+
+    while (samples > 0) {
+        size_t n = samples < slice_samples ? samples : slice_samples;
+        size_t bytes = resampler_process(stream_resampler, pcm, n, out) * AUDIO_BYTES_PER_SAMPLE;
+
+        // A response decodes faster than it plays: hold the decoder back rather than
+        // cut the response off when the jitter buffer is full
+        if (!wait_for_room(stream_jitter_buffer, bytes, generation)) {
+            return;
+        }
+        size_t written = jitter_buffer_push(stream_jitter_buffer, (const unsigned char *)out, bytes);
+        atomic_fetch_add_explicit(&bytes_played, written, memory_order_relaxed);
+        atomic_fetch_add_explicit(&bytes_overflow, bytes - written, memory_order_relaxed);
+
+        pcm += n;
+        samples -= n;
+    }
+}
+
+// Drop everything queued (stream_mutex held, so the decoder thread is not reading)
+static void discard_downlink_ring(void) {
+    unsigned char scratch[DOWNLINK_READ_BYTES];
+    while (read_audio_buffer(downlink_ring, scratch, sizeof(scratch)) > 0) {
+    }
+}
+
+// Decode everything queued into the jitter buffer. Each chunk is read and the
+// decoder set up under stream_mutex; the decode itself runs unlocked.
+static void drain_downlink_ring(void) {
+    unsigned char chunk[DOWNLINK_READ_BYTES];
+    size_t size;
+
+    size_t depth = audio_ring_buffer_used(downlink_ring);
+    if (depth > atomic_load_explicit(&max_queue_depth, memory_order_relaxed)) {
+        atomic_store_explicit(&max_queue_depth, depth, memory_order_relaxed);
+    }
+
+    pthread_mutex_lock(&stream_mutex);
+    while ((size = read_audio_buffer(downlink_ring, chunk, sizeof(chunk))) > 0) {
+        if (!stream_active) {
+            atomic_fetch_add_explicit(&bytes_dropped, size, memory_order_relaxed);
+            continue;
+        }
+
+        size_t offset = 0;
+        if (!stream_decoder) {
+            // A WAV file (base64 clips in JSON) says what it holds; its header is skipped
+            audio_format_t detected;
+            int wav = decoder_parse_wav(chunk, size, &detected, &offset);
+            if (wav == 0) {
+                decoder_detect(chunk, size, &stream_format, &detected);
+            }
+            stream_decoder = wav < 0 ? NULL : decoder_create(&detected, DEVICE_SAMPLE_RATE);
+            if (!stream_decoder) {
+                // Nothing to play this stream with; the rest of it is dropped
+                stream_active = 0;
+                atomic_fetch_add_explicit(&bytes_dropped, size, memory_order_relaxed);
+                continue;
+            }
+            atomic_store(&stream_decoder_name, stream_decoder->decoder->name);
+            printf("🎵 Decoding %s TTS stream\n", stream_decoder->decoder->name);
+        }
+        if (size <= offset) {
+            continue;
+        }
+
+        unsigned int generation = atomic_load(&stream_generation);
+        decoding = 1;
+        pthread_mutex_unlock(&stream_mutex);
+
+        int decoded = decoder_decode(stream_decoder, chunk + offset, size - offset, play_decoded, &generation);
+
+        pthread_mutex_lock(&stream_mutex);
+        decoding = 0;
+        pthread_cond_broadcast(&stream_cond);
+        if (!decoded && atomic_load(&stream_generation) == generation) {
+            atomic_fetch_add_explicit(&decode_errors, 1, memory_order_relaxed);
+            metrics_add(METRIC_DOWNLINK_DECODE_ERRORS, 1);
+        }
+    }
+    pthread_mutex_unlock(&stream_mutex);
+}
+
+// Make the decode in flight stale and wait until the decoder thread lets go of
+// the stream (stream_mutex held); it drops the rest of that chunk's output
+static void retire_stream_locked(void) {
+    atomic_fetch_add(&stream_generation, 1);
+    pthread_cond_broadcast(&stream_cond);
+    while (decoding) {
+        pthread_cond_wait(&stream_cond, &stream_mutex);
+    }
+}
+
+// Decoder thread - keeps codec work off the WebSocket service loop
+static void* decoder_thread(void *arg) {
+    (void)arg;
+
+    while (atomic_load(&decoder_running)) {
+        pthread_mutex_lock(&wake_mutex);
+        while (!wake_pending && atomic_load(&decoder_running)) {
+            pthread_cond_wait(&wake_cond, &wake_mutex);
+        }
+        atomic_store(&draining, 1);
+        wake_pending = 0;
+        pthread_mutex_unlock(&wake_mutex);
+
+        drain_downlink_ring();
+        atomic_store(&draining, 0);
+    }
+
+    return NULL;
+}
+
+// Initialize downlink pipeline
+int downlink_init(void) {
+    if (downlink_ring) {
+        return 1; // Already initialized
+    }
+
+    downlink_ring = init_audio_ring_buffer(DOWNLINK_RING_SIZE);
+    if (!downlink_ring) {
+        printf("❌ Failed to allocate downlink ring\n");
+        return 0;
+    }
+
+    atomic_store(&decoder_running, 1);
+    if (pthread_create(&decoder_tid, NULL, decoder_thread, NULL) != 0) {
+        printf("❌ Failed to create decoder thread\n");
+        atomic_store(&decoder_running, 0);
+        cleanup_audio_ring_buffer(downlink_ring);
+        downlink_ring = NULL;
+        return 0;
+    }
+
+    return 1;
+}
+
+// Cleanup downlink pipeline
+void downlink_cleanup(void) {
+    if (!downlink_ring) return;
+
+    pthread_mutex_lock(&wake_mutex);
+    atomic_store(&decoder_running, 0);
+    pthread_cond_signal(&wake_cond);
+    pthread_mutex_unlock(&wake_mutex);
+
+    // A decode waiting for room in the jitter buffer gives up
+    pthread_mutex_lock(&stream_mutex);
+    pthread_cond_broadcast(&stream_cond);
+    pthread_mutex_unlock(&stream_mutex);
+    pthread_join(decoder_tid, NULL);
+
+    downlink_end();
+
+    cleanup_audio_ring_buffer(downlink_ring);
+    downlink_ring = NULL;
+}
+
+// Attach the jitter buffer for a new TTS stream
+int downlink_begin(JitterBuffer *jitter_buffer, const audio_format_t *format) {
+    if (!downlink_ring || !jitter_buffer) return 0;
+
+    pthread_mutex_lock(&stream_mutex);
+
+    retire_stream_locked();
+    discard_downlink_ring();
+    decoder_destroy(stream_decoder);
+    stream_decoder = NULL;
+    resampler_destroy(stream_resampler);
+    stream_resampler = NULL;
+
+    stream_jitter_buffer = jitter_buffer;
+    stream_format = *format;
+    atomic_store(&stream_decoder_name, "none");
+    stream_active = 1;
+
+    atomic_store(&bytes_received, 0);
+    atomic_store(&bytes_dropped, 0);
+    atomic_store(&samples_decoded, 0);
+    atomic_store(&bytes_played, 0);
+    atomic_store(&bytes_overflow, 0);
+    atomic_store(&decode_errors, 0);
+    atomic_store(&max_queue_depth, 0);
+
+    pthread_mutex_unlock(&stream_mutex);
+    return 1;
+}
+
+// Detach the jitter buffer; audio not decoded yet is dropped
+void downlink_end(void) {
+    pthread_mutex_lock(&stream_mutex);
+
+    stream_active = 0;
+    retire_stream_locked();
+    stream_jitter_buffer = NULL;
+    if (downlink_ring) {
+        discard_downlink_ring();
+    }
+    decoder_destroy(stream_decoder);
+    stream_decoder = NULL;
+    resampler_destroy(stream_resampler);
+    stream_resampler = NULL;
+
+    pthread_mutex_unlock(&stream_mutex);
+}
+
+// Queue encoded TTS for the decoder thread
+size_t downlink_push(const unsigned char *data, size_t size) {
+    if (!downlink_ring || size == 0) return 0;
+
+    size_t written = write_audio_buffer(downlink_ring, data, size);
+    atomic_fetch_add_explicit(&bytes_received, written, memory_order_relaxed);
+    metrics_add(METRIC_DOWNLINK_BYTES_RECEIVED, written);
+    if (written < size) {
+        atomic_fetch_add_explicit(&bytes_dropped, size - written, memory_order_relaxed);
+        metrics_add(METRIC_DOWNLINK_BYTES_DROPPED, size - written);
+    }
+
+    pthread_mutex_lock(&wake_mutex);
+    wake_pending = 1;
+    pthread_cond_signal(&wake_cond);
+    pthread_mutex_unlock(&wake_mutex);
+
+    return written;
+}
+
+// Nothing queued or being decoded. The ring is checked first: if it is empty the
+// thread has already set draining for the pass that emptied it.
+int downlink_idle(void) {
+    if (!downlink_ring) return 1;
+
+    return audio_ring_buffer_used(downlink_ring) == 0 && !atomic_load(&draining);
+}
+
+// Get downlink pipeline statistics
+void downlink_get_stats(downlink_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    stats->bytes_received = atomic_load(&bytes_received);
+    stats->bytes_dropped = atomic_load(&bytes_dropped);
+    stats->samples_decoded = atomic_load(&samples_decoded);
+    stats->bytes_played = atomic_load(&bytes_played);
+    stats->bytes_overflow = atomic_load(&bytes_overflow);
+    stats->decode_errors = atomic_load(&decode_errors);
+    stats->max_queue_depth = atomic_load(&max_queue_depth);
+    stats->queue_depth = audio_ring_buffer_used(downlink_ring);
+    stats->decoder = atomic_load(&stream_decoder_name);
+}
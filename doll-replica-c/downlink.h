@@ -0,0 +1,48 @@
+#ifndef DOWNLINK_H
+#define DOWNLINK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "audio_format.h"
+#include "jitter_buffer.h"
+
+// Downlink pipeline configuration
+#define DOWNLINK_RING_SIZE (1024 * 1024)   // Encoded TTS between the WebSocket thread and the decoder: 2 min of mu-law
+#define DOWNLINK_READ_BYTES 4096           // Encoded bytes decoded per pass
+#define DOWNLINK_PCM_BLOCK 1024            // Device-rate samples pushed to the jitter buffer at once
+#define DOWNLINK_ROOM_POLL_MS 5            // Decoder recheck while the jitter buffer is full
+
+// Downlink pipeline statistics
+typedef struct {
+    const char *decoder;        // Decoder of the current / last stream
+    uint64_t bytes_received;    // Accepted into the downlink ring
+    uint64_t bytes_dropped;     // Lost because the ring was full
+    uint64_t samples_decoded;   // Decoder output, before resampling
+    uint64_t bytes_played;      // PCM accepted by the jitter buffer
+    uint64_t bytes_overflow;    // PCM the jitter buffer refused (the decoder waits for room, so rare)
+    unsigned int decode_errors;
+    size_t queue_depth;         // Encoded bytes waiting for the decoder thread now
+    size_t max_queue_depth;
+} downlink_stats_t;
+
+// Downlink pipeline functions
+int downlink_init(void);
+void downlink_cleanup(void);
+
+// Attach / detach the jitter buffer the decoded audio goes to. The stream
+// encoding is detected from its first bytes, falling back to the negotiated format.
+int downlink_begin(JitterBuffer *jitter_buffer, const audio_format_t *format);
+void downlink_end(void);
+
+// Called from the WebSocket thread with encoded TTS: copies into the downlink
+// ring and wakes the decoder thread, never decodes. Returns the bytes accepted.
+// The decoder thread waits for room in the jitter buffer rather than drop, so a
+// response longer than the jitter buffer backs up here while it plays.
+size_t downlink_push(const unsigned char *data, size_t size);
+
+// True when everything pushed so far has been decoded into the jitter buffer
+int downlink_idle(void);
+
+void downlink_get_stats(downlink_stats_t *stats);
+
+#endif // DOWNLINK_H
@@ -0,0 +1,379 @@
+#include "g711.h"
+#include <stdio.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define G711_X86 1
+#include <immintrin.h>
+#endif
+
+#define ULAW_BIAS 0x84
+#define ULAW_CLIP 32635
+
+// Decode tables (ITU-T G.711, same values as the reference formulas below)
+static const int16_t ulaw_decode_table[256] = {
+    -32124, -31100, -30076, -29052, -28028, -27004, -25980, -24956,
+    -23932, -22908, -21884, -20860, -19836, -18812, -17788, -16764,
+    -15996, -15484, -14972, -14460, -13948, -13436, -12924, -12412,
+    -11900, -11388, -10876, -10364,  -9852,  -9340,  -8828,  -8316,
+     -7932,  -7676,  -7420,  -7164,  -6908,  -6652,  -6396,  -6140,
+     -5884,  -5628,  -5372,  -5116,  -4860,  -4604,  -4348,  -4092,
+     -3900,  -3772,  -3644,  -3516,  -3388,  -3260,  -3132,  -3004,
+     -2876,  -2748,  -2620,  -2492,  -2364,  -2236,  -2108,  -1980,
+     -1884,  -1820,  -1756,  -1692,  -1628,  -1564,  -1500,  -1436,
+     -1372,  -1308,  -1244,  -1180,  -1116,  -1052,   -988,   -924,
+      -876,   -844,   -812,   -780,   -748,   -716,   -684,   -652,
+      -620,   -588,   -556,   -524,   -492,   -460,   -428,   -396,
+      -372,   -356,   -340,   -324,   -308,   -292,   -276,   -260,
+      -244,   -228,   -212,   -196,   -180,   -164,   -148,   -132,
+      -120,   -112,   -104,    -96,    -88,    -80,    -72,    -64,
+       -56,    -48,    -40,    -32,    -24,    -16,     -8,      0,
+     32124,  31100,  30076,  29052,  28028,  27004,  25980,  24956,
+     23932,  22908,  21884,  20860,  19836,  18812,  17788,  16764,
+     15996,  15484,  14972,  14460,  13948,  13436,  12924,  12412,
+     11900,  11388,  10876,  10364,   9852,   9340,   8828,   8316,
+      7932,   7676,   7420,   7164,   6908,   6652,   6396,   6140,
+      5884,   5628,   5372,   5116,   4860,   4604,   4348,   4092,
+      3900,   3772,   3644,   3516,   3388,   3260,   3132,   3004,
+      2876,   2748,   2620,   2492,   2364,   2236,   2108,   1980,
+      1884,   1820,   1756,   1692,   1628,   1564,   1500,   1436,
+      1372,   1308,   1244,   1180,   1116,   1052,    988,    924,
+       876,    844,    812,    780,    748,    716,    684,    652,
+       620,    588,    556,    524,    492,    460,    428,    396,
+       372,    356,    340,    324,    308,    292,    276,    260,
+       244,    228,    212,    196,    180,    164,    148,    132,
+       120,    112,    104,     96,     88,     80,     72,     64,
+        56,     48,     40,     32,     24,     16,      8,      0,
+};
+
+static const int16_t alaw_decode_table[256] = {
+     -5504,  -5248,  -6016,  -5760,  -4480,  -4224,  -4992,  -4736,
+     -7552,  -7296,  -8064,  -7808,  -6528,  -6272,  -7040,  -6784,
+     -2752,  -2624,  -3008,  -2880,  -2240,  -2112,  -2496,  -2368,
+     -3776,  -3648,  -4032,  -3904,  -3264,  -3136,  -3520,  -3392,
+    -22016, -20992, -24064, -23040, -17920, -16896, -19968, -18944,
+    -30208, -29184, -32256, -31232, -26112, -25088, -28160, -27136,
+    -11008, -10496, -12032, -11520,  -8960,  -8448,  -9984,  -9472,
+    -15104, -14592, -16128, -15616, -13056, -12544, -14080, -13568,
+      -344,   -328,   -376,   -360,   -280,   -264,   -312,   -296,
+      -472,   -456,   -504,   -488,   -408,   -392,   -440,   -424,
+       -88,    -72,   -120,   -104,    -24,     -8,    -56,    -40,
+      -216,   -200,   -248,   -232,   -152,   -136,   -184,   -168,
+     -1376,  -1312,  -1504,  -1440,  -1120,  -1056,  -1248,  -1184,
+     -1888,  -1824,  -2016,  -1952,  -1632,  -1568,  -1760,  -1696,
+      -688,   -656,   -752,   -720,   -560,   -528,   -624,   -592,
+      -944,   -912,  -1008,   -976,   -816,   -784,   -880,   -848,
+      5504,   5248,   6016,   5760,   4480,   4224,   4992,   4736,
+      7552,   7296,   8064,   7808,   6528,   6272,   7040,   6784,
+      2752,   2624,   3008,   2880,   2240,   2112,   2496,   2368,
+      3776,   3648,   4032,   3904,   3264,   3136,   3520,   3392,
+     22016,  20992,  24064,  23040,  17920,  16896,  19968,  18944,
+     30208,  29184,  32256,  31232,  26112,  25088,  28160,  27136,
+     11008,  10496,  12032,  11520,   8960,   8448,   9984,   9472,
+     15104,  14592,  16128,  15616,  13056,  12544,  14080,  13568,
+       344,    328,    376,    360,    280,    264,    312,    296,
+       472,    456,    504,    488,    408,    392,    440,    424,
+        88,     72,    120,    104,     24,      8,     56,     40,
+       216,    200,    248,    232,    152,    136,    184,    168,
+      1376,   1312,   1504,   1440,   1120,   1056,   1248,   1184,
+      1888,   1824,   2016,   1952,   1632,   1568,   1760,   1696,
+       688,    656,    752,    720,    560,    528,    624,    592,
+       944,    912,   1008,    976,    816,    784,    880,    848,
+};
+
+// Widened copies for the AVX2 gather path
+static int32_t ulaw_gather_table[256];
+
+// ============================================================================
+// SCALAR KERNELS
+// ============================================================================
+
+int16_t g711_ulaw_to_linear(uint8_t ulaw) {
+    return ulaw_decode_table[ulaw];
+}
+
+// Sign, bias, then find the segment from the position of the top bit
+uint8_t g711_linear_to_ulaw(int16_t pcm) {
+    int value = pcm;
+    int sign = 0;
+    if (value < 0) {
+        value = -value;
+        sign = 0x80;
+    }
+    if (value > ULAW_CLIP) value = ULAW_CLIP;
+    value += ULAW_BIAS;
+
+    int exponent = 31 - __builtin_clz((unsigned int)(value >> 7) | 1);
+    int mantissa = (value >> (exponent + 3)) & 0x0F;
+    return (uint8_t)~(sign | (exponent << 4) | mantissa);
+}
+
+int16_t g711_alaw_to_linear(uint8_t alaw) {
+    return alaw_decode_table[alaw];
+}
+
+uint8_t g711_linear_to_alaw(int16_t pcm) {
+    int value = pcm >> 3;
+    int mask;
+    if (value >= 0) {
+        mask = 0xD5;
+    } else {
+        mask = 0x55;
+        value = -value - 1;
+    }
+
+    int segment = value > 0x1F ? 32 - __builtin_clz((unsigned int)value) - 5 : 0;
+    if (segment >= 8) {
+        return (uint8_t)(0x7F ^ mask);
+    }
+
+    int alaw = segment << 4;
+    alaw |= segment < 2 ? (value >> 1) & 0x0F : (value >> segment) & 0x0F;
+    return (uint8_t)(alaw ^ mask);
+}
+
+static void ulaw_decode_scalar(int16_t *pcm, const uint8_t *ulaw, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        pcm[i] = ulaw_decode_table[ulaw[i]];
+    }
+}
+
+static void ulaw_encode_scalar(uint8_t *ulaw, const int16_t *pcm, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        ulaw[i] = g711_linear_to_ulaw(pcm[i]);
+    }
+}
+
+static void alaw_decode_scalar(int16_t *pcm, const uint8_t *alaw, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        pcm[i] = alaw_decode_table[alaw[i]];
+    }
+}
+
+static void alaw_encode_scalar(uint8_t *alaw, const int16_t *pcm, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        alaw[i] = g711_linear_to_alaw(pcm[i]);
+    }
+}
+
+#ifdef G711_X86
+
+// ============================================================================
+// SSE4.1 KERNELS
+// ============================================================================
+
+// mu-law decode of 8 samples without a table: the 2^exponent factor comes from
+// a pshufb lookup so the per-lane shift becomes a multiply
+__attribute__((target("sse4.1")))
+static inline __m128i ulaw_decode8_sse41(__m128i bytes16) {
+    const __m128i pow2 = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char)128, 0, 0, 0, 0, 0, 0, 0, 0);
+    __m128i v = _mm_xor_si128(bytes16, _mm_set1_epi16(0xFF));
+    __m128i exponent = _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi16(7));
+    __m128i mantissa = _mm_and_si128(v, _mm_set1_epi16(0x0F));
+    __m128i scale = _mm_and_si128(_mm_shuffle_epi8(pow2, exponent), _mm_set1_epi16(0xFF));
+
+    __m128i magnitude = _mm_add_epi16(_mm_slli_epi16(mantissa, 3), _mm_set1_epi16(ULAW_BIAS));
+    magnitude = _mm_sub_epi16(_mm_mullo_epi16(magnitude, scale), _mm_set1_epi16(ULAW_BIAS));
+
+    // -1 where the sign bit is set, +1 elsewhere
+    __m128i sign = _mm_cmpeq_epi16(_mm_and_si128(v, _mm_set1_epi16(0x80)), _mm_set1_epi16(0x80));
+    return _mm_sign_epi16(magnitude, _mm_or_si128(sign, _mm_set1_epi16(1)));
+}
+
+__attribute__((target("sse4.1")))
+static void ulaw_decode_sse41(int16_t *pcm, const uint8_t *ulaw, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(ulaw + i));
+        __m128i low = ulaw_decode8_sse41(_mm_cvtepu8_epi16(bytes));
+        __m128i high = ulaw_decode8_sse41(_mm_cvtepu8_epi16(_mm_srli_si128(bytes, 8)));
+        _mm_storeu_si128((__m128i *)(pcm + i), low);
+        _mm_storeu_si128((__m128i *)(pcm + i + 8), high);
+    }
+    ulaw_decode_scalar(pcm + i, ulaw + i, count - i);
+}
+
+// mu-law encode of 8 samples. The segment is the number of thresholds the
+// biased magnitude reaches; the mantissa shift is a mulhi by 2^(13 - segment).
+__attribute__((target("sse4.1")))
+static inline __m128i ulaw_encode8_sse41(__m128i samples) {
+    const __m128i shift_low = _mm_setr_epi8(0, 0, 0, 0, 0, 0, (char)128, 64, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i shift_high = _mm_setr_epi8(0x20, 0x10, 0x08, 0x04, 0x02, 0x01, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+
+    __m128i sign = _mm_and_si128(_mm_srai_epi16(samples, 15), _mm_set1_epi16(0x80));
+    __m128i magnitude = _mm_min_epu16(_mm_abs_epi16(samples), _mm_set1_epi16(ULAW_CLIP));
+    magnitude = _mm_add_epi16(magnitude, _mm_set1_epi16(ULAW_BIAS));
+
+    __m128i exponent = _mm_setzero_si128();
+    for (int k = 0; k < 7; k++) {
+        exponent = _mm_sub_epi16(exponent, _mm_cmpgt_epi16(magnitude, _mm_set1_epi16((0x100 << k) - 1)));
+    }
+
+    __m128i scale = _mm_or_si128(
+        _mm_and_si128(_mm_shuffle_epi8(shift_low, exponent), _mm_set1_epi16(0xFF)),
+        _mm_slli_epi16(_mm_shuffle_epi8(shift_high, exponent), 8));
+    __m128i mantissa = _mm_and_si128(_mm_mulhi_epu16(magnitude, scale), _mm_set1_epi16(0x0F));
+
+    __m128i code = _mm_or_si128(_mm_or_si128(sign, _mm_slli_epi16(exponent, 4)), mantissa);
+    return _mm_xor_si128(code, _mm_set1_epi16(0xFF));
+}
+
+__attribute__((target("sse4.1")))
+static void ulaw_encode_sse41(uint8_t *ulaw, const int16_t *pcm, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i low = ulaw_encode8_sse41(_mm_loadu_si128((const __m128i *)(pcm + i)));
+        __m128i high = ulaw_encode8_sse41(_mm_loadu_si128((const __m128i *)(pcm + i + 8)));
+        _mm_storeu_si128((__m128i *)(ulaw + i), _mm_packus_epi16(low, high));
+    }
+    ulaw_encode_scalar(ulaw + i, pcm + i, count - i);
+}
+
+// ============================================================================
+// AVX2 KERNELS
+// ============================================================================
+
+// Table decode of 16 samples with two 8-lane gathers
+__attribute__((target("avx2")))
+static inline void gather_decode16_avx2(int16_t *pcm, const uint8_t *codes, const int32_t *table) {
+    __m128i bytes = _mm_loadu_si128((const __m128i *)codes);
+    __m256i low = _mm256_i32gather_epi32(table, _mm256_cvtepu8_epi32(bytes), 4);
+    __m256i high = _mm256_i32gather_epi32(table, _mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8)), 4);
+
+    // packs works per 128-bit lane, so restore sample order afterwards
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(low, high), 0xD8);
+    _mm256_storeu_si256((__m256i *)pcm, packed);
+}
+
+__attribute__((target("avx2")))
+static void ulaw_decode_avx2(int16_t *pcm, const uint8_t *ulaw, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        gather_decode16_avx2(pcm + i, ulaw + i, ulaw_gather_table);
+    }
+    ulaw_decode_scalar(pcm + i, ulaw + i, count - i);
+}
+
+// Same segment search as the SSE4.1 kernel on 16 lanes
+__attribute__((target("avx2")))
+static inline __m256i ulaw_encode16_avx2(__m256i samples) {
+    const __m256i shift_low = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, (char)128, 64, 0, 0, 0, 0, 0, 0, 0, 0,
+                                               0, 0, 0, 0, 0, 0, (char)128, 64, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i shift_high = _mm256_setr_epi8(0x20, 0x10, 0x08, 0x04, 0x02, 0x01, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                                0x20, 0x10, 0x08, 0x04, 0x02, 0x01, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+
+    __m256i sign = _mm256_and_si256(_mm256_srai_epi16(samples, 15), _mm256_set1_epi16(0x80));
+    __m256i magnitude = _mm256_min_epu16(_mm256_abs_epi16(samples), _mm256_set1_epi16(ULAW_CLIP));
+    magnitude = _mm256_add_epi16(magnitude, _mm256_set1_epi16(ULAW_BIAS));
+
+    __m256i exponent = _mm256_setzero_si256();
+    for (int k = 0; k < 7; k++) {
+        exponent = _mm256_sub_epi16(exponent, _mm256_cmpgt_epi16(magnitude, _mm256_set1_epi16((0x100 << k) - 1)));
+    }
+
+    __m256i scale = _mm256_or_si256(
+        _mm256_and_si256(_mm256_shuffle_epi8(shift_low, exponent), _mm256_set1_epi16(0xFF)),
+        _mm256_slli_epi16(_mm256_shuffle_epi8(shift_high, exponent), 8));
+    __m256i mantissa = _mm256_and_si256(_mm256_mulhi_epu16(magnitude, scale), _mm256_set1_epi16(0x0F));
+
+    __m256i code = _mm256_or_si256(_mm256_or_si256(sign, _mm256_slli_epi16(exponent, 4)), mantissa);
+    return _mm256_xor_si256(code, _mm256_set1_epi16(0xFF));
+}
+
+__attribute__((target("avx2")))
+static void ulaw_encode_avx2(uint8_t *ulaw, const int16_t *pcm, size_t count) {
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i low = ulaw_encode16_avx2(_mm256_loadu_si256((const __m256i *)(pcm + i)));
+        __m256i high = ulaw_encode16_avx2(_mm256_loadu_si256((const __m256i *)(pcm + i + 16)));
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), 0xD8);
+        _mm256_storeu_si256((__m256i *)(ulaw + i), packed);
+    }
+    ulaw_encode_sse41(ulaw + i, pcm + i, count - i);
+}
+
+#endif // G711_X86
+
+// ============================================================================
+// DISPATCH
+// ============================================================================
+
+typedef struct {
+    const char *name;
+    void (*ulaw_decode)(int16_t *, const uint8_t *, size_t);
+    void (*ulaw_encode)(uint8_t *, const int16_t *, size_t);
+    void (*alaw_decode)(int16_t *, const uint8_t *, size_t);
+    void (*alaw_encode)(uint8_t *, const int16_t *, size_t);
+} g711_kernels_t;
+
+static const g711_kernels_t scalar_kernels = {
+    "scalar", ulaw_decode_scalar, ulaw_encode_scalar, alaw_decode_scalar, alaw_encode_scalar
+};
+
+// A-law stays scalar in every set. There is no vector encode, and the AVX2
+// gather decode did not reliably beat the 256-entry table lookup, which loses
+// nothing on CPUs with slow gathers. Nothing on the hot path uses A-law.
+#ifdef G711_X86
+static const g711_kernels_t sse41_kernels = {
+    "sse4.1", ulaw_decode_sse41, ulaw_encode_sse41, alaw_decode_scalar, alaw_encode_scalar
+};
+
+static const g711_kernels_t avx2_kernels = {
+    "avx2", ulaw_decode_avx2, ulaw_encode_avx2, alaw_decode_scalar, alaw_encode_scalar
+};
+#endif
+
+// Usable before g711_init(), which only upgrades to a faster set
+static const g711_kernels_t *kernels = &scalar_kernels;
+
+// Select a kernel set
+int g711_set_impl(g711_impl_t impl) {
+    for (int i = 0; i < 256; i++) {
+        ulaw_gather_table[i] = ulaw_decode_table[i];
+    }
+
+    switch (impl) {
+        case G711_IMPL_SCALAR:
+            kernels = &scalar_kernels;
+            return 1;
+#ifdef G711_X86
+        case G711_IMPL_SSE41:
+            if (!__builtin_cpu_supports("sse4.1")) return 0;
+            kernels = &sse41_kernels;
+            return 1;
+        case G711_IMPL_AVX2:
+            if (!__builtin_cpu_supports("avx2")) return 0;
+            kernels = &avx2_kernels;
+            return 1;
+#endif
+        default:
+            return 0;
+    }
+}
+
+// Pick the fastest kernels this CPU supports
+void g711_init(void) {
+    if (!g711_set_impl(G711_IMPL_AVX2) && !g711_set_impl(G711_IMPL_SSE41)) {
+        g711_set_impl(G711_IMPL_SCALAR);
+    }
+    printf("✅ G.711 codec ready (%s kernels)\n", kernels->name);
+}
+
+const char* g711_impl_name(void) {
+    return kernels->name;
+}
+
+void g711_ulaw_decode(int16_t *pcm, const uint8_t *ulaw, size_t count) {
+    kernels->ulaw_decode(pcm, ulaw, count);
+}
+
+void g711_ulaw_encode(uint8_t *ulaw, const int16_t *pcm, size_t count) {
+    kernels->ulaw_encode(ulaw, pcm, count);
+}
+
+void g711_alaw_decode(int16_t *pcm, const uint8_t *alaw, size_t count) {
+    kernels->alaw_decode(pcm, alaw, count);
+}
+
+void g711_alaw_encode(uint8_t *alaw, const int16_t *pcm, size_t count) {
+    kernels->alaw_encode(alaw, pcm, count);
+}
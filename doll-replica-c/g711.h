@@ -0,0 +1,34 @@
+#ifndef G711_H
+#define G711_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define G711_ULAW_SILENCE 0xFF
+#define G711_ALAW_SILENCE 0xD5
+
+// Kernel implementations, fastest available is picked by g711_init()
+typedef enum {
+    G711_IMPL_SCALAR = 0,
+    G711_IMPL_SSE41,
+    G711_IMPL_AVX2,
+} g711_impl_t;
+
+// G.711 codec functions
+void g711_init(void);
+int g711_set_impl(g711_impl_t impl);  // Returns 0 if the CPU lacks it
+const char* g711_impl_name(void);
+
+// Single samples (table / segment search)
+int16_t g711_ulaw_to_linear(uint8_t ulaw);
+uint8_t g711_linear_to_ulaw(int16_t pcm);
+int16_t g711_alaw_to_linear(uint8_t alaw);
+uint8_t g711_linear_to_alaw(int16_t pcm);
+
+// Bulk conversion through the selected kernels
+void g711_ulaw_decode(int16_t *pcm, const uint8_t *ulaw, size_t count);
+void g711_ulaw_encode(uint8_t *ulaw, const int16_t *pcm, size_t count);
+void g711_alaw_decode(int16_t *pcm, const uint8_t *alaw, size_t count);
+void g711_alaw_encode(uint8_t *alaw, const int16_t *pcm, size_t count);
+
+#endif // G711_H
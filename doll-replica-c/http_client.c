@@ -1,13 +1,24 @@
 #include "http_client.h"
+#include "audio_format.h"
+#include "trace.h"
+#include "cbor.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <poll.h>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
 
 // HTTP client state
 bool http_initialized = false;
@@ -17,6 +28,14 @@ char current_jwt_token[MAX_JWT_TOKEN_LENGTH] = {0};
 static int streaming_socket = -1;
 static bool streaming_session_active = false;
 static char streaming_session_id[64] = {0};
+static unsigned int pending_dtx_ms = 0;
+static const uplink_codec_t *streaming_codec = NULL;
+
+// Codec the server last accepted, offered first so later sessions skip the fallback round trips
+static const uplink_codec_t *negotiated_codec = NULL;
+
+// The uplink thread streams chunks while the input thread or the VAD may finish the session
+static pthread_mutex_t streaming_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 // Helper function to create HTTP request
 static char* create_http_request(const char *method, const char *path, 
@@ -39,16 +58,45 @@ static char* create_http_request(const char *method, const char *path,
     return request;
 }
 
-// Helper function to send HTTP request and receive response
-static bool send_http_request(const char *request, const char *body, 
-                             size_t body_length, char *response, size_t max_response) {
+// Helper function to write a full iovec array, resuming after short writes
+static bool send_all_iov(int sock, const struct iovec *iov, int iov_count) {
+    struct iovec batch[IOV_MAX];
+    size_t skip = 0; // Bytes of iov[0] already sent
+    
+    while (iov_count > 0) {
+        int count = iov_count < IOV_MAX ? iov_count : IOV_MAX;
+        memcpy(batch, iov, count * sizeof(struct iovec));
+        batch[0].iov_base = (char *)batch[0].iov_base + skip;
+        batch[0].iov_len -= skip;
+        
+        ssize_t sent = writev(sock, batch, count);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        
+        // Advance past fully written entries
+        size_t remaining = (size_t)sent + skip;
+        while (iov_count > 0 && remaining >= iov->iov_len) {
+            remaining -= iov->iov_len;
+            iov++;
+            iov_count--;
+        }
+        skip = remaining;
+    }
+    
+    return true;
+}
+
+// Helper function to open a TCP connection to the HTTP server
+static int connect_to_http_server(void) {
     int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0) return false;
+    if (sock < 0) return -1;
     
     struct hostent *server = gethostbyname(HTTP_SERVER_ADDRESS);
     if (!server) {
         close(sock);
-        return false;
+        return -1;
     }
     
     struct sockaddr_in server_addr;
@@ -59,16 +107,27 @@ static bool send_http_request(const char *request, const char *body,
     
     if (connect(sock, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
         close(sock);
-        return false;
+        return -1;
     }
     
-    if (send(sock, request, strlen(request), 0) < 0) {
+    return sock;
+}
+
+// Helper function to send HTTP request and receive response
+// The response is NUL-terminated; response_length, if given, gets its size for binary bodies
+static bool send_http_request_iov(const char *request, const struct iovec *body_iov, int body_iov_count,
+                                  char *response, size_t max_response, size_t *response_length) {
+    int sock = connect_to_http_server();
+    if (sock < 0) return false;
+    
+    struct iovec header_iov = { (void *)request, strlen(request) };
+    if (!send_all_iov(sock, &header_iov, 1)) {
         close(sock);
         return false;
     }
     
-    if (body && body_length > 0) {
-        if (send(sock, body, body_length, 0) < 0) {
+    if (body_iov && body_iov_count > 0) {
+        if (!send_all_iov(sock, body_iov, body_iov_count)) {
             close(sock);
             return false;
         }
@@ -81,10 +140,19 @@ static bool send_http_request(const char *request, const char *body,
     }
     
     response[bytes_received] = '\0';
+    if (response_length) *response_length = (size_t)bytes_received;
     close(sock);
     return true;
 }
 
+// Helper function to send HTTP request with a contiguous body
+static bool send_http_request(const char *request, const char *body, 
+                             size_t body_length, char *response, size_t max_response) {
+    struct iovec body_iov = { (void *)body, body_length };
+    return send_http_request_iov(request, body ? &body_iov : NULL, body ? 1 : 0,
+                                 response, max_response, NULL);
+}
+
 bool http_init(void) {
     if (http_initialized) return true;
     
@@ -101,7 +169,7 @@ void http_cleanup(void) {
     memset(current_jwt_token, 0, sizeof(current_jwt_token));
     
     // Clean up streaming session if active
-    if (streaming_session_active) {
+    if (http_streaming_session_active()) {
         http_finish_streaming_session();
     }
 }
@@ -181,44 +249,66 @@ bool http_get_jwt_token(char *jwt_token, size_t max_length) {
     return false;
 }
 
-bool http_init_streaming_session(const char *jwt_token) {
-    if (!http_initialized || !jwt_token) return false;
-    
-    printf("🚀 Initializing real-time streaming session...\n");
-    
-    // Create socket for streaming
-    streaming_socket = socket(AF_INET, SOCK_STREAM, 0);
-    if (streaming_socket < 0) return false;
-    
-    struct hostent *server = gethostbyname(HTTP_SERVER_ADDRESS);
-    if (!server) {
-        close(streaming_socket);
-        streaming_socket = -1;
-        return false;
+// Wait for the interim response to "Expect: 100-continue". Returns 100 when the
+// body may follow (also when the server stays silent, as RFC 9110 allows),
+// the final status code when it answered early, or -1 on a broken connection.
+static int await_continue(int sock) {
+    struct pollfd pfd = { sock, POLLIN, 0 };
+    int ready = poll(&pfd, 1, HTTP_CONTINUE_TIMEOUT_MS);
+    if (ready == 0) {
+        return 100;
+    }
+    if (ready < 0) {
+        return -1;
     }
     
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(HTTP_SERVER_PORT);
-    memcpy(&server_addr.sin_addr.s_addr, server->h_addr, server->h_length);
+    // Read the status line and headers of the interim or final response
+    char response[MAX_HTTP_RESPONSE_LENGTH];
+    size_t received = 0;
+    while (received < sizeof(response) - 1) {
+        ssize_t n = recv(sock, response + received, sizeof(response) - 1 - received, 0);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            break;
+        }
+        received += n;
+        response[received] = '\0';
+        if (strstr(response, "\r\n\r\n")) break;
+    }
+    response[received] = '\0';
     
-    if (connect(streaming_socket, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-        close(streaming_socket);
-        streaming_socket = -1;
-        return false;
+    int status = 0;
+    if (sscanf(response, "HTTP/%*d.%*d %d", &status) != 1) {
+        return -1;
     }
+    return status;
+}
+
+// Open the chunked upload offering one codec; returns the socket or -1, with
+// the server's status in *status (415 means try another codec)
+static int open_streaming_request(const char *jwt_token, const uplink_codec_t *codec,
+                                  bool expect_continue, int *status) {
+    *status = -1;
+    int sock = connect_to_http_server();
+    if (sock < 0) return -1;
     
     // Send HTTP request headers
-    char headers[512];
+    char headers[MAX_JWT_TOKEN_LENGTH + 512];
     snprintf(headers, sizeof(headers),
         "Authorization: Bearer %s\r\n"
-        "Content-Type: audio/wav\r\n"
-        "Transfer-Encoding: chunked\r\n",
-        jwt_token
+        "Content-Type: %s\r\n"
+        "Transfer-Encoding: chunked\r\n"
+        "%s %s;rate=%d\r\n"
+        "%s %s\r\n"
+        "%s",
+        jwt_token,
+        codec->content_type,
+        AUDIO_FORMAT_HEADER, codec->name, HTTP_UPLINK_SAMPLE_RATE,
+        AUDIO_ACCEPT_HEADER, AUDIO_ACCEPT_FORMATS,
+        expect_continue ? "Expect: 100-continue\r\n" : ""
     );
     
-    char request[1024];
+    char request[MAX_JWT_TOKEN_LENGTH + 1024];
     snprintf(request, sizeof(request),
         "POST /api/v1/audio/stream HTTP/1.1\r\n"
         "Host: %s:%d\r\n"
@@ -227,25 +317,83 @@ bool http_init_streaming_session(const char *jwt_token) {
         HTTP_SERVER_ADDRESS, HTTP_SERVER_PORT, headers
     );
     
-    if (send(streaming_socket, request, strlen(request), 0) < 0) {
-        close(streaming_socket);
-        streaming_socket = -1;
+    if (send(sock, request, strlen(request), 0) < 0) {
+        close(sock);
+        return -1;
+    }
+    
+    *status = expect_continue ? await_continue(sock) : 100;
+    if (*status != 100) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+static bool init_streaming_session_locked(const char *jwt_token) {
+    if (!http_initialized || !jwt_token) return false;
+    
+    printf("🚀 Initializing real-time streaming session...\n");
+    
+    // Offer codecs best first; the previously accepted one goes to the front
+    const uplink_codec_t *offers[HTTP_MAX_CODEC_OFFERS + 1];
+    size_t count = 0;
+    if (negotiated_codec) {
+        offers[count++] = negotiated_codec;
+    }
+    const uplink_codec_t *preferred[HTTP_MAX_CODEC_OFFERS];
+    size_t preferred_count = codec_preference_list(preferred, HTTP_MAX_CODEC_OFFERS);
+    for (size_t i = 0; i < preferred_count; i++) {
+        if (preferred[i] != negotiated_codec) {
+            offers[count++] = preferred[i];
+        }
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        // Only ask for 100-continue when there is something to fall back to
+        bool expect_continue = i + 1 < count;
+        int status;
+        
+        streaming_socket = open_streaming_request(jwt_token, offers[i], expect_continue, &status);
+        if (streaming_socket >= 0) {
+            streaming_codec = offers[i];
+            negotiated_codec = offers[i];
+            break;
+        }
+        
+        if (status != 415) {
+            printf("❌ Streaming request failed (status %d)\n", status);
+            return false;
+        }
+        printf("↩️  Server declined %s uplink, trying next codec\n", offers[i]->name);
+        if (negotiated_codec == offers[i]) {
+            negotiated_codec = NULL;
+        }
+    }
+    
+    if (streaming_socket < 0) {
         return false;
     }
     
     streaming_session_active = true;
-    printf("✅ Streaming session initialized\n");
+    pending_dtx_ms = 0;
+    printf("✅ Streaming session initialized (%s uplink)\n", streaming_codec->name);
     return true;
 }
 
-bool http_stream_audio_chunk(const unsigned char *chunk_data, size_t chunk_size) {
+static bool stream_audio_chunk_locked(const unsigned char *chunk_data, size_t chunk_size) {
     if (!streaming_session_active || streaming_socket < 0 || !chunk_data || chunk_size == 0) {
         return false;
     }
     
-    // Send chunk in chunked transfer encoding format
-    char chunk_header[32];
-    snprintf(chunk_header, sizeof(chunk_header), "%zx\r\n", chunk_size);
+    // Send chunk in chunked transfer encoding format, carrying any DTX gap as an extension
+    char chunk_header[48];
+    if (pending_dtx_ms > 0) {
+        snprintf(chunk_header, sizeof(chunk_header), "%zx;dtx=%u\r\n", chunk_size, pending_dtx_ms);
+        pending_dtx_ms = 0;
+    } else {
+        snprintf(chunk_header, sizeof(chunk_header), "%zx\r\n", chunk_size);
+    }
     
     if (send(streaming_socket, chunk_header, strlen(chunk_header), 0) < 0) {
         return false;
@@ -259,16 +407,20 @@ bool http_stream_audio_chunk(const unsigned char *chunk_data, size_t chunk_size)
         return false;
     }
     
+    trace_event(TRACE_CHUNK_SENT, chunk_size);
     return true;
 }
 
-bool http_finish_streaming_session(void) {
+static bool finish_streaming_session_locked(void) {
     if (!streaming_session_active || streaming_socket < 0) {
         return false;
     }
     
     printf("🏁 Finishing streaming session...\n");
     
+    // The turn's clock starts here: everything after is waiting for the answer
+    trace_event(TRACE_USER_STOP, 0);
+    
     // Send end-of-stream marker
     if (send(streaming_socket, "0\r\n\r\n", 5, 0) < 0) {
         printf("❌ Failed to send end-of-stream marker\n");
@@ -290,29 +442,109 @@ bool http_finish_streaming_session(void) {
     return true;
 }
 
-bool http_stream_audio_realtime(const char *jwt_token, const unsigned char *audio_data, size_t data_size) {
-    if (!http_initialized || !jwt_token || !audio_data || data_size == 0) return false;
+bool http_init_streaming_session(const char *jwt_token) {
+    pthread_mutex_lock(&streaming_mutex);
+    bool result = init_streaming_session_locked(jwt_token);
+    pthread_mutex_unlock(&streaming_mutex);
+    return result;
+}
+
+bool http_stream_audio_chunk(const unsigned char *chunk_data, size_t chunk_size) {
+    pthread_mutex_lock(&streaming_mutex);
+    bool result = stream_audio_chunk_locked(chunk_data, chunk_size);
+    pthread_mutex_unlock(&streaming_mutex);
+    return result;
+}
+
+bool http_finish_streaming_session(void) {
+    pthread_mutex_lock(&streaming_mutex);
+    bool result = finish_streaming_session_locked();
+    pthread_mutex_unlock(&streaming_mutex);
+    return result;
+}
+
+const uplink_codec_t* http_streaming_codec(void) {
+    pthread_mutex_lock(&streaming_mutex);
+    const uplink_codec_t *codec = streaming_session_active ? streaming_codec : NULL;
+    pthread_mutex_unlock(&streaming_mutex);
+    return codec;
+}
+
+bool http_streaming_session_active(void) {
+    pthread_mutex_lock(&streaming_mutex);
+    bool active = streaming_session_active;
+    pthread_mutex_unlock(&streaming_mutex);
+    return active;
+}
+
+void http_stream_audio_dtx(unsigned int silent_ms) {
+    pthread_mutex_lock(&streaming_mutex);
+    if (streaming_session_active) {
+        pending_dtx_ms += silent_ms;
+    }
+    pthread_mutex_unlock(&streaming_mutex);
+}
+
+// Content-Type of the response headers (which end at headers_end) is CBOR
+static bool response_is_cbor(const char *response, const char *headers_end) {
+    static const char name[] = "\r\nContent-Type:";
+    
+    for (const char *line = strstr(response, "\r\n"); line && line < headers_end; line = strstr(line + 2, "\r\n")) {
+        if (strncasecmp(line, name, sizeof(name) - 1) != 0) continue;
+        
+        const char *value = line + sizeof(name) - 1;
+        while (*value == ' ') value++;
+        return strncasecmp(value, "application/cbor", 16) == 0;
+    }
+    return false;
+}
+
+bool http_stream_audio_realtime(const char *jwt_token, const struct iovec *audio_iov, int iov_count) {
+    if (!http_initialized || !jwt_token || !audio_iov || iov_count <= 0) return false;
     
-    printf("📤 Streaming %zu bytes of audio data (real-time)...\n", data_size);
+    size_t data_size = 0;
+    for (int i = 0; i < iov_count; i++) {
+        data_size += audio_iov[i].iov_len;
+    }
+    if (data_size == 0) return false;
     
-    char headers[512];
+    printf("📤 Streaming %zu bytes of audio data in %d segments (real-time)...\n", data_size, iov_count);
+    
+    char headers[MAX_JWT_TOKEN_LENGTH + 512];
     snprintf(headers, sizeof(headers),
         "Authorization: Bearer %s\r\n"
-        "Content-Type: audio/wav\r\n",
-        jwt_token
+        "Content-Type: audio/wav\r\n"
+        "%s mulaw;rate=%d\r\n"
+        "%s %s\r\n"
+        "Accept: %s\r\n",
+        jwt_token,
+        AUDIO_FORMAT_HEADER, HTTP_UPLINK_SAMPLE_RATE,
+        AUDIO_ACCEPT_HEADER, AUDIO_ACCEPT_FORMATS,
+        HTTP_ACCEPT_CBOR ? "application/cbor, application/json" : "application/json"
     );
     
     char *request = create_http_request("POST", "/api/v1/audio/stream", headers, data_size);
     if (!request) return false;
     
     char response[MAX_HTTP_RESPONSE_LENGTH];
-    bool success = send_http_request(request, (const char*)audio_data, data_size, response, sizeof(response));
+    size_t response_length = 0;
+    bool success = send_http_request_iov(request, audio_iov, iov_count, response, sizeof(response), &response_length);
     free(request);
     
     if (!success) return false;
     
+    // Same fields either way; a CBOR body is read in place
     http_audio_response_t parsed_response;
-    if (http_parse_audio_response(response, &parsed_response)) {
+    const char *body = strstr(response, "\r\n\r\n");
+    bool parsed;
+    if (body && response_is_cbor(response, body)) {
+        body += 4;
+        parsed = http_parse_audio_response_cbor((const unsigned char *)body,
+                                                response_length - (size_t)(body - response), &parsed_response);
+    } else {
+        parsed = http_parse_audio_response(response, &parsed_response);
+    }
+    if (parsed) {
         printf("✅ Audio streamed successfully!\n");
         printf("   Session ID: %s\n", parsed_response.session_id);
         printf("   Message: %s\n", parsed_response.message);
@@ -381,4 +613,64 @@ bool http_parse_audio_response(const char *response, http_audio_response_t *pars
     }
     
     return true;
-} 
\ No newline at end of file
+}
+
+// Copy a CBOR text value into a fixed field, cut to fit
+static void copy_cbor_text(char *field, size_t size, const char *text, size_t length) {
+    if (length > size - 1) length = size - 1;
+    memcpy(field, text, length);
+    field[length] = '\0';
+}
+
+bool http_parse_audio_response_cbor(const unsigned char *body, size_t length, http_audio_response_t *parsed_response) {
+    if (!body || !parsed_response) return false;
+    
+    memset(parsed_response, 0, sizeof(http_audio_response_t));
+    
+    CborReader reader;
+    uint64_t pairs;
+    cbor_reader_init(&reader, body, length);
+    cbor_skip_self_describe(&reader);
+    if (!cbor_read_map(&reader, &pairs)) return false;
+    
+    for (uint64_t i = 0; i < pairs; i++) {
+        const char *key = NULL;
+        size_t key_length = 0;
+        if (cbor_peek(&reader) == CBOR_MAJOR_TEXT) {
+            if (!cbor_read_text(&reader, &key, &key_length)) return false;
+        } else if (!cbor_skip(&reader)) {
+            return false;
+        }
+        
+        char *field = NULL;
+        size_t size = 0;
+        if (key && key_length == 7 && memcmp(key, "success", 7) == 0 && cbor_peek(&reader) == CBOR_MAJOR_SIMPLE) {
+            int value;
+            if (!cbor_read_bool(&reader, &value)) return false;
+            parsed_response->success = value;
+            continue;
+        }
+        
+        if (key && key_length == 7 && memcmp(key, "message", 7) == 0) {
+            field = parsed_response->message;
+            size = sizeof(parsed_response->message);
+        } else if (key && key_length == 10 && memcmp(key, "session_id", 10) == 0) {
+            field = parsed_response->session_id;
+            size = sizeof(parsed_response->session_id);
+        } else if (key && key_length == 4 && memcmp(key, "text", 4) == 0) {
+            field = parsed_response->text;
+            size = sizeof(parsed_response->text);
+        }
+        
+        if (field && cbor_peek(&reader) == CBOR_MAJOR_TEXT) {
+            const char *text;
+            size_t text_length;
+            if (!cbor_read_text(&reader, &text, &text_length)) return false;
+            copy_cbor_text(field, size, text, text_length);
+        } else if (!cbor_skip(&reader)) {
+            return false;
+        }
+    }
+    
+    return true;
+}
@@ -3,6 +3,8 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <sys/uio.h>
+#include "codec.h"
 
 // HTTP client configuration
 #define HTTP_SERVER_ADDRESS "127.0.0.1"
@@ -11,6 +13,10 @@
 #define HTTP_API_SECRET "Doe"
 #define MAX_JWT_TOKEN_LENGTH 1024
 #define MAX_HTTP_RESPONSE_LENGTH 4096
+#define HTTP_UPLINK_SAMPLE_RATE 8000       // Rate of every uplink body, whatever the codec
+#define HTTP_CONTINUE_TIMEOUT_MS 1000      // How long a codec offer waits for 100 Continue
+#define HTTP_MAX_CODEC_OFFERS 8
+#define HTTP_ACCEPT_CBOR 1                 // Offer CBOR response bodies ahead of JSON
 
 // HTTP client functions
 bool http_init(void);
@@ -23,12 +29,22 @@ bool http_get_jwt_token(char *jwt_token, size_t max_length);
 bool http_health_check(void);
 
 // Real-time audio streaming (sends transcription via WebSocket)
-bool http_stream_audio_realtime(const char *jwt_token, const unsigned char *audio_data, size_t data_size);
+// The body is gathered straight from the caller's buffers with vectored I/O
+bool http_stream_audio_realtime(const char *jwt_token, const struct iovec *audio_iov, int iov_count);
 
-// Real-time chunk streaming (for streaming individual chunks during recording)
+// Real-time chunk streaming (for streaming individual chunks during recording).
+// The uplink codec is negotiated through Content-Type: each codec in
+// UPLINK_CODEC_PREFERENCE is offered with "Expect: 100-continue" and a 415
+// moves on to the next, ending with mu-law.
 bool http_init_streaming_session(const char *jwt_token);
+const uplink_codec_t* http_streaming_codec(void);  // Codec the open session carries
 bool http_stream_audio_chunk(const unsigned char *chunk_data, size_t chunk_size);
 bool http_finish_streaming_session(void);
+bool http_streaming_session_active(void);
+
+// Discontinuous transmission: announce suppressed silence on the next chunk
+// as a chunk extension (";dtx=<ms>"), which servers that do not know it ignore
+void http_stream_audio_dtx(unsigned int silent_ms);
 
 // Response parsing
 typedef struct {
@@ -39,6 +55,7 @@ typedef struct {
 } http_audio_response_t;
 
 bool http_parse_audio_response(const char *response, http_audio_response_t *parsed_response);
+bool http_parse_audio_response_cbor(const unsigned char *body, size_t length, http_audio_response_t *parsed_response);
 
 // HTTP client state
 extern bool http_initialized;
@@ -5,48 +5,113 @@
 #include "websocket_client.h"
 #include "audio.h"
 #include "http_client.h"
+#include "capture.h"
+#include "trace.h"
+#include "ws_uplink.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <unistd.h>
+
+typedef enum {
+    INPUT_COMMAND_TRACE = 0,
+    INPUT_COMMAND_RECORD,
+    INPUT_COMMAND_STREAM,
+    INPUT_COMMAND_STOP,
+} input_command_t;
 
 static pthread_t input_tid;
 static int input_thread_running = 0;
+static pthread_mutex_t command_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t command_cond = PTHREAD_COND_INITIALIZER;
+static input_command_t commands[INPUT_COMMAND_QUEUE];
+static size_t command_head = 0;
+static size_t command_count = 0;
 
-// Input thread function - reads keyboard input
-void* input_thread(void *arg) {
-    char input_buffer[MAX_MESSAGE_LENGTH];
-    char timestamp[16];
+// Line being typed, assembled from stdin reads (service thread only)
+static char input_line[MAX_MESSAGE_LENGTH];
+static size_t input_line_len = 0;
+static atomic_int streaming_recording = 0; // Current recording streams chunks as it goes
+
+// Open a streaming session and start recording into it: binary frames on the
+// WebSocket when it is up, a chunked HTTP upload otherwise
+int start_streaming_utterance(void) {
+    if (ws_uplink_begin()) {
+        capture_set_uplink_codec(ws_uplink_codec());
+    } else if (http_init_streaming_session(current_jwt_token)) {
+        // Encode the uplink with whichever codec the server accepted
+        capture_set_uplink_codec(http_streaming_codec());
+    } else {
+        printf("❌ Failed to open streaming session\n");
+        return 0;
+    }
     
-    printf("\n💬 Type your message and press Enter to send (Ctrl+C to exit):\n");
-    printf("🎤 Commands: 'record' to start recording, 'stop' to stop recording\n");
+    if (!start_recording_with_streaming(handle_audio_chunk)) {
+        finish_streaming_utterance();
+        printf("❌ Failed to start recording\n");
+        return 0;
+    }
+    
+    atomic_store(&streaming_recording, 1);
+    return 1;
+}
+
+// Close whichever uplink the utterance went over, once the recording has stopped.
+// Whoever ends it (the VAD or 'stop'), a later 'stop' is for a plain recording.
+void finish_streaming_utterance(void) {
+    atomic_store(&streaming_recording, 0);
+    
+    if (ws_uplink_active()) {
+        ws_uplink_end();
+    } else if (http_streaming_session_active()) {
+        http_finish_streaming_session();
+    }
+}
+
+// Barge-in utterance thread - opening the session must not stall the service loop
+static void* utterance_thread(void *arg) {
+    (void)arg;
+    
+    if (start_streaming_utterance()) {
+        printf("🎤 Listening - it ends on silence, or type 'stop'.\n");
+    } else {
+        // Nobody is talking to the server after all: let its next response play
+        audio_suppress_downlink(0);
+    }
     printf("> ");
     fflush(stdout);
-    
-    while (!should_exit && input_thread_running) {
-        if (fgets(input_buffer, sizeof(input_buffer), stdin) == NULL) {
-            if (feof(stdin)) {
-                printf("\nEOF detected, exiting...\n");
-                should_exit = 1;
-                break;
-            }
-            continue;
-        }
-        
-        // Remove newline character
-        size_t len = strlen(input_buffer);
-        if (len > 0 && input_buffer[len-1] == '\n') {
-            input_buffer[len-1] = '\0';
-            len--;
-        }
-        
-        // Skip empty messages
-        if (len == 0) {
-            printf("> ");
-            fflush(stdout);
-            continue;
-        }
-        
-        // Handle recording commands
-        if (strcmp(input_buffer, "record") == 0) {
+    return NULL;
+}
+
+// Start a streaming utterance without waiting for the session
+int start_streaming_utterance_async(void) {
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, utterance_thread, NULL) != 0) {
+        printf("❌ Failed to create utterance thread\n");
+        return 0;
+    }
+    pthread_detach(tid);
+    return 1;
+}
+
+// Print the prompt again
+static void prompt(void) {
+    printf("> ");
+    fflush(stdout);
+}
+
+// Run one command (input thread) - these block on the audio device and HTTP
+static void run_command(input_command_t command) {
+    switch (command) {
+        case INPUT_COMMAND_TRACE:
+            // Latency breakdown so far, and a Chrome trace of it
+            trace_report();
+            trace_dump_chrome(TRACE_FILE);
+            break;
+            
+        case INPUT_COMMAND_RECORD:
             // Start recording without streaming (collect all audio first)
             if (start_recording()) {
                 printf("🎤 Recording started! Say something and type 'stop' to end recording.\n");
@@ -54,85 +119,218 @@ void* input_thread(void *arg) {
             } else {
                 printf("❌ Failed to start recording\n");
             }
-            printf("> ");
-            fflush(stdout);
-            continue;
-        }
-        
-        if (strcmp(input_buffer, "stop") == 0) {
+            break;
+            
+        case INPUT_COMMAND_STREAM:
+            // Start recording and stream chunks from the uplink thread as they are captured
+            if (start_streaming_utterance()) {
+                printf("🎤 Streaming started! Say something - it ends on silence, or type 'stop'.\n");
+            }
+            break;
+            
+        case INPUT_COMMAND_STOP:
+            if (atomic_exchange(&streaming_recording, 0)) {
+                // The VAD may already have ended the utterance on trailing silence
+                if (is_recording_active() && stop_recording()) {
+                    printf("⏹️  Recording stopped.\n");
+                }
+                finish_streaming_utterance();
+                break;
+            }
+            
             if (stop_recording()) {
                 printf("⏹️  Recording stopped.\n");
                 
-                // Get the recorded audio data
-                unsigned char *audio_data = NULL;
-                size_t audio_size = 0;
+                // Take ownership of the recorded segments - no copy
+                recording_t *recording = NULL;
                 
-                if (get_recorded_audio(&audio_data, &audio_size)) {
-                    printf("📤 Sending %zu bytes of audio data...\n", audio_size);
+                if (get_recorded_audio(&recording)) {
+                    printf("📤 Sending %zu bytes of audio data...\n", recording_size(recording));
                     
-                    // Send audio data as a single request
-                    if (http_stream_audio_realtime(current_jwt_token, audio_data, audio_size)) {
+                    // Send the segments as a single request with vectored I/O
+                    struct iovec *audio_iov = malloc(recording->segment_count * sizeof(struct iovec));
+                    int iov_count = audio_iov ? recording_to_iovec(recording, audio_iov, recording->segment_count) : 0;
+                    
+                    if (iov_count > 0 && http_stream_audio_realtime(current_jwt_token, audio_iov, iov_count)) {
                         printf("✅ Audio sent successfully! Transcription will be sent via WebSocket.\n");
                     } else {
                         printf("❌ Failed to send audio data\n");
                     }
                     
-                    // Free the audio data
-                    free(audio_data);
+                    // Release the segments
+                    free(audio_iov);
+                    recording_release(recording);
                 } else {
                     printf("❌ Failed to get recorded audio data\n");
                 }
             } else {
                 printf("❌ Failed to stop recording\n");
             }
-            printf("> ");
-            fflush(stdout);
-            continue;
+            break;
+    }
+    prompt();
+}
+
+// Hand a command to the input thread; the service loop never waits on it
+static void post_command(input_command_t command) {
+    pthread_mutex_lock(&command_mutex);
+    if (command_count == INPUT_COMMAND_QUEUE) {
+        pthread_mutex_unlock(&command_mutex);
+        printf("❌ Still busy with earlier commands, please wait...\n> ");
+        fflush(stdout);
+        return;
+    }
+    commands[(command_head + command_count) % INPUT_COMMAND_QUEUE] = command;
+    command_count++;
+    pthread_cond_signal(&command_cond);
+    pthread_mutex_unlock(&command_mutex);
+}
+
+// One line typed by the user (service thread)
+static void handle_input_line(const char *line, size_t len) {
+    char timestamp[16];
+    
+    // Skip empty messages
+    if (len == 0) {
+        prompt();
+        return;
+    }
+    
+    if (strcmp(line, "trace") == 0) {
+        post_command(INPUT_COMMAND_TRACE);
+        return;
+    }
+    if (strcmp(line, "record") == 0) {
+        post_command(INPUT_COMMAND_RECORD);
+        return;
+    }
+    if (strcmp(line, "stream") == 0) {
+        post_command(INPUT_COMMAND_STREAM);
+        return;
+    }
+    if (strcmp(line, "stop") == 0) {
+        post_command(INPUT_COMMAND_STOP);
+        return;
+    }
+    if (strcmp(line, "reconnect-bench") == 0) {
+        // Runs on the service loop, timer-driven; it prints its own report
+        websocket_reconnect_bench();
+        prompt();
+        return;
+    }
+    
+    // Regular text message handling
+    if (add_message_to_queue(line)) {
+        get_timestamp(timestamp, sizeof(timestamp));
+        printf("[%s] You: %s\n", timestamp, line);
+        prompt();
+        websocket_request_write();
+    } else {
+        printf("❌ Message queue is full, please wait...\n> ");
+        fflush(stdout);
+    }
+}
+
+// stdin as a raw file on the service loop: it wakes the loop only when there is input
+int input_stdin_callback(struct lws *wsi, enum lws_callback_reasons reason,
+                         void *user, void *in, size_t len) {
+    switch (reason) {
+        case LWS_CALLBACK_RAW_RX_FILE: {
+            char chunk[4096];
+            ssize_t n = read(STDIN_FILENO, chunk, sizeof(chunk));
+            if (n < 0) {
+                return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+            }
+            if (n == 0) {
+                printf("\nEOF detected, exiting...\n");
+                should_exit = 1;
+                return -1;
+            }
+            
+            for (ssize_t i = 0; i < n; i++) {
+                if (chunk[i] != '\n') {
+                    input_line[input_line_len++] = chunk[i];
+                    // A line longer than a message is sent in pieces, as fgets() did
+                    if (input_line_len < sizeof(input_line) - 1) {
+                        continue;
+                    }
+                }
+                input_line[input_line_len] = '\0';
+                handle_input_line(input_line, input_line_len);
+                input_line_len = 0;
+            }
+            break;
         }
         
-        // Regular text message handling
-        if (add_message_to_queue(input_buffer)) {
-            get_timestamp(timestamp, sizeof(timestamp));
-            printf("[%s] You: %s\n", timestamp, input_buffer);
-            printf("> ");
-            fflush(stdout);
+        case LWS_CALLBACK_RAW_CLOSE_FILE:
+            // Nothing can be typed any more
+            should_exit = 1;
+            break;
             
-            // Trigger WebSocket writeable callback to send the message
-            if (websocket_connection) {
-                lws_callback_on_writable(websocket_connection);
-                
-                // Also try to service the context to process the callback
-                lws_service(websocket_context, 0);
-                // Additional service call to ensure immediate processing
-                lws_service(websocket_context, 50);
-            } else {
-                printf("❌ WebSocket connection is NULL!\n");
-            }
-        } else {
-            printf("❌ Message queue is full, please wait...\n> ");
-            fflush(stdout);
+        default:
+            break;
+    }
+    return 0;
+}
+
+// Input thread function - runs the commands typed on stdin
+void* input_thread(void *arg) {
+    (void)arg;
+    
+    for (;;) {
+        pthread_mutex_lock(&command_mutex);
+        while (input_thread_running && command_count == 0) {
+            pthread_cond_wait(&command_cond, &command_mutex);
         }
+        if (!input_thread_running) {
+            pthread_mutex_unlock(&command_mutex);
+            break;
+        }
+        input_command_t command = commands[command_head];
+        command_head = (command_head + 1) % INPUT_COMMAND_QUEUE;
+        command_count--;
+        pthread_mutex_unlock(&command_mutex);
+        
+        run_command(command);
     }
     
     return NULL;
 }
 
-// Start input thread
+// Start input thread, and read stdin from the service loop
 int start_input_thread(void) {
     input_thread_running = 1;
     if (pthread_create(&input_tid, NULL, input_thread, NULL) != 0) {
         printf("❌ Failed to create input thread\n");
         return 0;
     }
+    
+    lws_sock_file_fd_type fd;
+    fd.filefd = STDIN_FILENO;
+    
+    struct lws_vhost *vhost = lws_get_vhost_by_name(websocket_context, "default");
+    if (!vhost || !lws_adopt_descriptor_vhost(vhost, LWS_ADOPT_RAW_FILE_DESC, fd, INPUT_PROTOCOL_NAME, NULL)) {
+        printf("❌ Failed to add stdin to the service loop\n");
+        stop_input_thread();
+        wait_for_input_thread();
+        return 0;
+    }
+    
+    printf("\n💬 Type your message and press Enter to send (Ctrl+C to exit):\n");
+    printf("🎤 Commands: 'record' to start recording, 'stream' to record while streaming, 'stop' to stop recording, 'trace' for latency, 'reconnect-bench' for reconnect time\n");
+    prompt();
     return 1;
 }
 
 // Stop input thread
 void stop_input_thread(void) {
+    pthread_mutex_lock(&command_mutex);
     input_thread_running = 0;
+    pthread_cond_signal(&command_cond);
+    pthread_mutex_unlock(&command_mutex);
 }
 
 // Wait for input thread to finish
 void wait_for_input_thread(void) {
     pthread_join(input_tid, NULL);
-} 
\ No newline at end of file
+}
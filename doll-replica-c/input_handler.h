@@ -1,13 +1,25 @@
 #ifndef INPUT_HANDLER_H
 #define INPUT_HANDLER_H
 
+#include <libwebsockets.h>
 #include <pthread.h>
 #include <stddef.h>
 
-// Audio chunk callback function declaration
-void handle_audio_chunk(const unsigned char *chunk, size_t chunk_size);
+#define INPUT_PROTOCOL_NAME "stdin"     // Raw file protocol stdin is adopted with
+#define INPUT_COMMAND_QUEUE 8           // Commands waiting for the command thread
 
-// Input handler functions
+// Audio pipeline callback declarations (implemented in main.c)
+int handle_audio_chunk(const unsigned char *chunk, size_t chunk_size);
+void handle_audio_dtx(unsigned int silent_ms);
+void handle_end_of_utterance(void);
+
+// Open a streaming session and record into it (also used on barge-in)
+int start_streaming_utterance(void);
+int start_streaming_utterance_async(void);  // Same, on a short-lived thread
+void finish_streaming_utterance(void);      // After the recording stopped
+
+// Input handler functions: stdin is read on the service loop, commands that block
+// (recording, HTTP uploads) run on the input thread
 int start_input_thread(void);
 void stop_input_thread(void);
 void wait_for_input_thread(void);
@@ -15,4 +27,8 @@ void wait_for_input_thread(void);
 // Input thread function
 void* input_thread(void *arg);
 
+// Raw file callback for stdin (service thread)
+int input_stdin_callback(struct lws *wsi, enum lws_callback_reasons reason,
+                         void *user, void *in, size_t len);
+
 #endif // INPUT_HANDLER_H 
\ No newline at end of file
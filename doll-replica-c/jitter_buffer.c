@@ -0,0 +1,281 @@
+#include "jitter_buffer.h"
+#include "metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define JITTER_SAFETY_FACTOR 3          // Target depth in multiples of the jitter estimate
+#define JITTER_UNDERRUN_STEP_MS 20      // Extra depth added after a genuine underrun
+#define JITTER_SHRINK_DIVISOR 16        // Fraction of the excess depth released per chunk
+#define JITTER_RESPONSE_GAP_US 1000000  // Longer silences start a new response
+#define JITTER_PACED_PERCENT 50         // A chunk arriving sooner than this share of its length is a burst
+
+// Monotonic clock in microseconds
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static size_t clamp_size(size_t value, size_t low, size_t high) {
+    if (value < low) return low;
+    if (value > high) return high;
+    return value;
+}
+
+// Initialize jitter buffer
+JitterBuffer* init_jitter_buffer(size_t capacity, const jitter_buffer_config_t *config) {
+    JitterBuffer *jb = calloc(1, sizeof(JitterBuffer));
+    if (!jb) {
+        printf("❌ Failed to allocate jitter buffer\n");
+        return NULL;
+    }
+
+    jb->ring = init_audio_ring_buffer(capacity);
+    if (!jb->ring) {
+        free(jb);
+        return NULL;
+    }
+
+    jb->config = *config;
+    jb->bytes_per_ms = (size_t)config->sample_rate * config->bytes_per_sample / 1000;
+    if (jb->bytes_per_ms == 0) jb->bytes_per_ms = 1;
+
+    atomic_init(&jb->target_bytes, config->target_ms * jb->bytes_per_ms);
+    atomic_init(&jb->underruns, 0);
+    atomic_init(&jb->jitter_us, 0);
+    atomic_init(&jb->concealed_bytes, 0);
+    atomic_init(&jb->dropped_bytes, 0);
+    atomic_init(&jb->drift_bytes, 0);
+    atomic_init(&jb->last_push_us, 0);
+
+    jb->start_bytes = config->start_ms * jb->bytes_per_ms;
+
+    printf("✅ Jitter buffer initialized (target %ums, start %ums, range %u-%ums)\n",
+           config->target_ms, config->start_ms, config->min_ms, config->max_ms);
+    return jb;
+}
+
+// Cleanup jitter buffer (both sides must have stopped using it)
+void cleanup_jitter_buffer(JitterBuffer *jb) {
+    if (!jb) return;
+
+    cleanup_audio_ring_buffer(jb->ring);
+    free(jb);
+}
+
+// Reset for the next stream (neither side is using the buffer)
+void jitter_buffer_reset(JitterBuffer *jb) {
+    if (!jb) return;
+
+    discard_audio_buffer(jb->ring);
+
+    atomic_store(&jb->underruns, 0);
+    atomic_store(&jb->concealed_bytes, 0);
+    atomic_store(&jb->dropped_bytes, 0);
+    atomic_store(&jb->drift_bytes, 0);
+    atomic_store(&jb->last_push_us, 0);
+
+    jb->last_arrival_us = 0;
+    jb->last_chunk_us = 0;
+    jb->underruns_seen = 0;
+
+    jb->playing = 0;
+    jb->start_bytes = jb->config.start_ms * jb->bytes_per_ms;
+    jb->waited_bytes = 0;
+    jb->conceal_pos = 0;
+    jb->last_period_samples = 0;
+}
+
+// Move the target depth towards what the observed jitter calls for
+static void update_target(JitterBuffer *jb) {
+    size_t min_bytes = jb->config.min_ms * jb->bytes_per_ms;
+    size_t max_bytes = jb->config.max_ms * jb->bytes_per_ms;
+    size_t target = atomic_load_explicit(&jb->target_bytes, memory_order_relaxed);
+    size_t desired = (size_t)(jb->jitter_estimate_us * JITTER_SAFETY_FACTOR / 1000.0) * jb->bytes_per_ms;
+    desired = clamp_size(desired, min_bytes, max_bytes);
+
+    if (desired > target) {
+        // Grow immediately - late audio is audible, extra latency is not
+        target = desired;
+    } else {
+        // Shrink slowly so a single quiet stretch does not undo the margin
+        target -= (target - desired) / JITTER_SHRINK_DIVISOR;
+    }
+
+    atomic_store_explicit(&jb->target_bytes, clamp_size(target, min_bytes, max_bytes),
+                          memory_order_relaxed);
+}
+
+// Push decoded audio (network thread)
+size_t jitter_buffer_push(JitterBuffer *jb, const unsigned char *data, size_t size) {
+    if (!jb || !data || size == 0) return 0;
+
+    uint64_t arrival = now_us();
+    uint64_t chunk_us = (uint64_t)size * 1000 / jb->bytes_per_ms;
+
+    if (jb->last_arrival_us && arrival - jb->last_arrival_us < JITTER_RESPONSE_GAP_US) {
+        // RFC 3550 style inter-arrival jitter against the media clock
+        double transit = (double)(arrival - jb->last_arrival_us) - (double)jb->last_chunk_us;
+        if (transit < 0) transit = -transit;
+        jb->jitter_estimate_us += (transit - jb->jitter_estimate_us) / 16.0;
+
+        // An underrun while audio was still flowing means the target was too shallow
+        unsigned int underruns = atomic_load_explicit(&jb->underruns, memory_order_relaxed);
+        if (underruns != jb->underruns_seen) {
+            size_t max_bytes = jb->config.max_ms * jb->bytes_per_ms;
+            size_t target = atomic_load_explicit(&jb->target_bytes, memory_order_relaxed);
+            target = clamp_size(target + JITTER_UNDERRUN_STEP_MS * jb->bytes_per_ms, 0, max_bytes);
+            atomic_store_explicit(&jb->target_bytes, target, memory_order_relaxed);
+        }
+        update_target(jb);
+
+        // Clock drift: a real-time stream that keeps arriving a little ahead of
+        // playback. Late chunks pay the early ones back, so jitter cancels out.
+        // A burst (a whole response in one message) is not paced and adds nothing:
+        // audio that arrived early costs no latency.
+        uint64_t interval = arrival - jb->last_arrival_us;
+        if (interval * 100 >= jb->last_chunk_us * JITTER_PACED_PERCENT) {
+            long early = (long)(jb->last_chunk_us * jb->bytes_per_ms / 1000) - (long)(interval * jb->bytes_per_ms / 1000);
+            long drift = atomic_fetch_add_explicit(&jb->drift_bytes, early, memory_order_relaxed) + early;
+            if (drift < 0) {
+                atomic_fetch_sub_explicit(&jb->drift_bytes, drift, memory_order_relaxed);
+            }
+        }
+    } else {
+        atomic_store_explicit(&jb->drift_bytes, 0, memory_order_relaxed);
+    }
+    jb->underruns_seen = atomic_load_explicit(&jb->underruns, memory_order_relaxed);
+    jb->last_arrival_us = arrival;
+    jb->last_chunk_us = chunk_us;
+    atomic_store_explicit(&jb->last_push_us, arrival, memory_order_relaxed);
+    atomic_store_explicit(&jb->jitter_us, (unsigned int)jb->jitter_estimate_us, memory_order_relaxed);
+
+    size_t written = write_audio_buffer(jb->ring, data, size);
+    if (written < size) {
+        atomic_fetch_add_explicit(&jb->dropped_bytes, size - written, memory_order_relaxed);
+    }
+    return written;
+}
+
+// Keep the tail of the last good period around for concealment
+static void remember_period(JitterBuffer *jb, const unsigned char *data, size_t size) {
+    size_t samples = size / sizeof(int16_t);
+    if (samples > JITTER_CONCEAL_MAX_SAMPLES) {
+        data += (samples - JITTER_CONCEAL_MAX_SAMPLES) * sizeof(int16_t);
+        samples = JITTER_CONCEAL_MAX_SAMPLES;
+    }
+    memcpy(jb->last_period, data, samples * sizeof(int16_t));
+    jb->last_period_samples = samples;
+    jb->conceal_pos = 0;
+}
+
+// Repeat the last period while fading it out, then fall back to silence
+static void conceal(JitterBuffer *jb, unsigned char *output, size_t size) {
+    size_t fade_samples = jb->config.conceal_ms * jb->bytes_per_ms / sizeof(int16_t);
+    size_t samples = size / sizeof(int16_t);
+    size_t concealed = 0;
+    int16_t sample;
+
+    for (size_t i = 0; i < samples; i++) {
+        if (jb->last_period_samples > 0 && jb->conceal_pos < fade_samples) {
+            int gain = (int)(((fade_samples - jb->conceal_pos) << 8) / fade_samples);
+            sample = (int16_t)((jb->last_period[jb->conceal_pos % jb->last_period_samples] * gain) >> 8);
+            jb->conceal_pos++;
+            concealed++;
+        } else {
+            sample = 0;
+        }
+        memcpy(output + i * sizeof(int16_t), &sample, sizeof(sample));
+    }
+
+    if (concealed > 0) {
+        atomic_fetch_add_explicit(&jb->concealed_bytes, concealed * sizeof(int16_t), memory_order_relaxed);
+    }
+}
+
+// Pull one callback period (real-time audio thread)
+size_t jitter_buffer_pull(JitterBuffer *jb, unsigned char *output, size_t size) {
+    if (!jb || size == 0) return 0;
+
+    size_t used = audio_ring_buffer_used(jb->ring);
+    size_t target = atomic_load_explicit(&jb->target_bytes, memory_order_relaxed);
+
+    if (!jb->playing) {
+        // Prebuffer until the watermark, or until the stream stalls with audio pending
+        // (end of a response shorter than the watermark)
+        if (used > 0) jb->waited_bytes += size;
+        if (used < jb->start_bytes && jb->waited_bytes < jb->start_bytes) {
+            conceal(jb, output, size);
+            return 0;
+        }
+        jb->playing = 1;
+        jb->waited_bytes = 0;
+    }
+
+    // Depth well above target from drift: drop a sliver of each period, never
+    // more than the drift itself
+    long drift = atomic_load_explicit(&jb->drift_bytes, memory_order_relaxed);
+    if (drift > 0 && used > target + 2 * size) {
+        size_t drop = used - target;
+        if (drop > size / 8) drop = size / 8;
+        if (drop > (size_t)drift) drop = (size_t)drift;
+        drop -= drop % jb->config.bytes_per_sample; // Never split a sample
+        drop = read_audio_buffer(jb->ring, output, drop);
+        atomic_fetch_sub_explicit(&jb->drift_bytes, (long)drop, memory_order_relaxed);
+        atomic_fetch_add_explicit(&jb->dropped_bytes, drop, memory_order_relaxed);
+    }
+
+    size_t got = read_audio_buffer(jb->ring, output, size);
+    if (got > 0) {
+        remember_period(jb, output, got);
+    }
+
+    if (got < size) {
+        // Ran dry: conceal the gap and rebuffer up to the current target. It is
+        // an underrun only while more audio was due; a response that played out
+        // its last push is just over.
+        conceal(jb, output + got, size - got);
+        jb->playing = 0;
+        jb->start_bytes = target;
+        jb->waited_bytes = 0;
+
+        uint64_t last_push = atomic_load_explicit(&jb->last_push_us, memory_order_relaxed);
+        if (last_push && now_us() - last_push < JITTER_RESPONSE_GAP_US) {
+            atomic_fetch_add_explicit(&jb->underruns, 1, memory_order_relaxed);
+            metrics_add(METRIC_JITTER_UNDERRUNS, 1);
+        }
+    }
+
+    return got;
+}
+
+// Drop everything queued (real-time audio thread)
+size_t jitter_buffer_flush(JitterBuffer *jb) {
+    if (!jb) return 0;
+
+    size_t flushed = discard_audio_buffer(jb->ring);
+    atomic_fetch_add_explicit(&jb->dropped_bytes, flushed, memory_order_relaxed);
+
+    atomic_store_explicit(&jb->drift_bytes, 0, memory_order_relaxed);
+
+    jb->playing = 0;
+    jb->start_bytes = atomic_load_explicit(&jb->target_bytes, memory_order_relaxed);
+    jb->waited_bytes = 0;
+    jb->last_period_samples = 0;
+    return flushed;
+}
+
+// Snapshot statistics
+void jitter_buffer_get_stats(JitterBuffer *jb, jitter_buffer_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (!jb) return;
+
+    stats->target_ms = atomic_load(&jb->target_bytes) / jb->bytes_per_ms;
+    stats->depth_ms = audio_ring_buffer_used(jb->ring) / jb->bytes_per_ms;
+    stats->jitter_ms = atomic_load(&jb->jitter_us) / 1000;
+    stats->underruns = atomic_load(&jb->underruns);
+    stats->concealed_bytes = atomic_load(&jb->concealed_bytes);
+    stats->dropped_bytes = atomic_load(&jb->dropped_bytes);
+}
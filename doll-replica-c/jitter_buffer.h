@@ -0,0 +1,85 @@
+#ifndef JITTER_BUFFER_H
+#define JITTER_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "ring_buffer.h"
+
+#define JITTER_CONCEAL_MAX_SAMPLES 2048 // Largest callback period we can repeat
+
+// Jitter buffer configuration (all depths in milliseconds)
+typedef struct {
+    unsigned int sample_rate;
+    unsigned int bytes_per_sample;
+    unsigned int target_ms;   // Initial steady-state depth
+    unsigned int start_ms;    // Prebuffer watermark before the first sample plays
+    unsigned int min_ms;      // Adaptation never shrinks below this
+    unsigned int max_ms;      // ... nor grows above this
+    unsigned int conceal_ms;  // Fade-out length of the concealment on underrun
+} jitter_buffer_config_t;
+
+// Jitter buffer statistics snapshot
+typedef struct {
+    unsigned int target_ms;
+    unsigned int depth_ms;
+    unsigned int jitter_ms;
+    unsigned int underruns;
+    uint64_t concealed_bytes;
+    uint64_t dropped_bytes;
+} jitter_buffer_stats_t;
+
+// Playout buffer of signed 16-bit PCM between the network (producer) and the
+// audio callback (consumer). The producer measures inter-arrival jitter and moves
+// the target depth; the consumer holds playback until the watermark is reached
+// and conceals underruns.
+typedef struct {
+    AudioRingBuffer *ring;
+    jitter_buffer_config_t config;
+    size_t bytes_per_ms;
+
+    // Shared between both sides
+    atomic_size_t target_bytes;
+    atomic_uint underruns;
+    atomic_uint jitter_us;
+    atomic_uint_fast64_t concealed_bytes;
+    atomic_uint_fast64_t dropped_bytes;
+    atomic_long drift_bytes;        // Depth gained on the media clock while paced: may be trimmed
+    atomic_uint_fast64_t last_push_us;  // Arrival of the newest audio, 0 before any
+
+    // Producer side only
+    uint64_t last_arrival_us;
+    uint64_t last_chunk_us;
+    double jitter_estimate_us;
+    unsigned int underruns_seen;
+
+    // Consumer side only (real-time callback)
+    int playing;
+    size_t start_bytes;
+    size_t waited_bytes;
+    size_t conceal_pos;
+    size_t last_period_samples;
+    int16_t last_period[JITTER_CONCEAL_MAX_SAMPLES];
+} JitterBuffer;
+
+// Jitter buffer functions
+JitterBuffer* init_jitter_buffer(size_t capacity, const jitter_buffer_config_t *config);
+void cleanup_jitter_buffer(JitterBuffer *jb);
+
+// Both sides stopped: drop queued audio and per-stream state and counters, keeping
+// the depth learned so far for the next stream
+void jitter_buffer_reset(JitterBuffer *jb);
+
+// Producer side: queue decoded audio and update the jitter estimate
+size_t jitter_buffer_push(JitterBuffer *jb, const unsigned char *data, size_t size);
+
+// Consumer side: always fills exactly size bytes, never blocks or allocates
+size_t jitter_buffer_pull(JitterBuffer *jb, unsigned char *output, size_t size);
+
+// Consumer side: drop all queued audio in O(1) and prebuffer again before the next
+// sample plays; nothing of the dropped audio is used for concealment
+size_t jitter_buffer_flush(JitterBuffer *jb);
+
+void jitter_buffer_get_stats(JitterBuffer *jb, jitter_buffer_stats_t *stats);
+
+#endif // JITTER_BUFFER_H
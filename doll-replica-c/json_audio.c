@@ -0,0 +1,44 @@
+#include "json_audio.h"
+#include <string.h>
+
+void json_audio_init(JsonAudioStream *stream, json_audio_output_fn output, void *ctx) {
+    memset(stream, 0, sizeof(*stream));
+    stream->output = output;
+    stream->ctx = ctx;
+    json_audio_reset(stream);
+}
+
+void json_audio_reset(JsonAudioStream *stream) {
+    stream->error = 0;
+    stream->complete = 0;
+    stream->audio_bytes = 0;
+    base64_stream_init(&stream->base64);
+}
+
+// Decode a run of base64 characters and hand the audio on, a slice at a time
+void json_audio_feed(JsonAudioStream *stream, const char *data, size_t length) {
+    uint8_t decoded[BASE64_STREAM_DECODED_MAX(JSON_AUDIO_SLICE)];
+
+    while (length > 0 && !stream->error) {
+        size_t slice = length < JSON_AUDIO_SLICE ? length : JSON_AUDIO_SLICE;
+        size_t size;
+        if (!base64_stream_decode(&stream->base64, decoded, &size, data, slice)) {
+            stream->error = 1;
+            break;
+        }
+
+        if (size > 0) {
+            stream->audio_bytes += size;
+            stream->output(stream->ctx, decoded, size);
+        }
+        data += slice;
+        length -= slice;
+    }
+}
+
+void json_audio_finish(JsonAudioStream *stream) {
+    if (!stream->error && !base64_stream_finish(&stream->base64)) {
+        stream->error = 1;
+    }
+    stream->complete = !stream->error;
+}
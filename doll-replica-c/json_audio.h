@@ -0,0 +1,35 @@
+#ifndef JSON_AUDIO_H
+#define JSON_AUDIO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "base64.h"
+
+// JSON audio streaming configuration
+#define JSON_AUDIO_SLICE 4096           // Base64 characters decoded per pass
+#define JSON_AUDIO_START_BYTES 512      // Decoded bytes gathered before playback starts (a whole WAV header)
+
+// Decoded audio, as it becomes available
+typedef void (*json_audio_output_fn)(void *ctx, const unsigned char *data, size_t size);
+
+// Decodes the base64 "audio" string of a JSON text message while its fragments
+// arrive, without ever holding the whole message. json_message.c finds the
+// string and undoes its escapes; a quantum split across fragments is carried over.
+typedef struct {
+    base64_stream_t base64;
+    int error;                  // The audio string was malformed; its rest is skipped
+    int complete;               // The audio string was closed
+    uint64_t audio_bytes;       // Decoded so far in this message
+
+    json_audio_output_fn output;
+    void *ctx;
+} JsonAudioStream;
+
+void json_audio_init(JsonAudioStream *stream, json_audio_output_fn output, void *ctx);
+void json_audio_reset(JsonAudioStream *stream);     // Start of a new message
+
+// Characters of the audio string as they arrive, then its closing quote
+void json_audio_feed(JsonAudioStream *stream, const char *data, size_t length);
+void json_audio_finish(JsonAudioStream *stream);
+
+#endif // JSON_AUDIO_H
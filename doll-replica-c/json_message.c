@@ -0,0 +1,540 @@
+#include "json_message.h"
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void json_message_init(JsonMessage *message, json_message_value_fn on_value,
+                       json_message_value_end_fn on_value_end, void *ctx) {
+    memset(message, 0, sizeof(*message));
+    message->on_value = on_value;
+    message->on_value_end = on_value_end;
+    message->ctx = ctx;
+    json_message_reset(message);
+}
+
+void json_message_reset(JsonMessage *message) {
+    control_message_reset(&message->fields);
+    message->error = 0;
+    message->complete = 0;
+    message->length = 0;
+
+    message->state = JSON_MESSAGE_VALUE;
+    message->depth = 0;
+    message->top_level_object = 0;
+    message->key_length = 0;
+    message->field = -1;
+    message->value_field = -1;
+    message->value_length = 0;
+    message->literal_length = 0;
+    message->unicode = 0;
+    message->unicode_digits = 0;
+    message->high_surrogate = 0;
+}
+
+static int is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static int is_literal_char(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           c == '.' || c == '+' || c == '-';
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static void value_done(JsonMessage *message);
+
+static int fail(JsonMessage *message) {
+    message->error = 1;
+    return 0;
+}
+
+// Unescaped characters of the string being read (only called for a field)
+static void emit(JsonMessage *message, const char *data, size_t length) {
+    if (message->value_field == CONTROL_FIELD_AUDIO) {
+        if (message->on_value && length > 0) {
+            message->on_value(message->ctx, data, length);
+        }
+        return;
+    }
+
+    size_t size;
+    char *buffer = control_message_string(&message->fields, message->value_field, &size);
+    if (!buffer) return;
+
+    size_t room = size - 1 - message->value_length;
+    if (length > room) {
+        length = room;
+        message->fields.truncated |= CONTROL_FIELD_BIT(message->value_field);
+    }
+    memcpy(buffer + message->value_length, data, length);
+    message->value_length += length;
+    buffer[message->value_length] = '\0';
+}
+
+static void emit_codepoint(JsonMessage *message, uint32_t codepoint) {
+    char utf8[4];
+    size_t length;
+
+    if (codepoint < 0x80) {
+        utf8[0] = (char)codepoint;
+        length = 1;
+    } else if (codepoint < 0x800) {
+        utf8[0] = (char)(0xC0 | (codepoint >> 6));
+        utf8[1] = (char)(0x80 | (codepoint & 0x3F));
+        length = 2;
+    } else if (codepoint < 0x10000) {
+        utf8[0] = (char)(0xE0 | (codepoint >> 12));
+        utf8[1] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        utf8[2] = (char)(0x80 | (codepoint & 0x3F));
+        length = 3;
+    } else {
+        utf8[0] = (char)(0xF0 | (codepoint >> 18));
+        utf8[1] = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+        utf8[2] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        utf8[3] = (char)(0x80 | (codepoint & 0x3F));
+        length = 4;
+    }
+    if (message->value_field >= 0) {
+        emit(message, utf8, length);
+    }
+}
+
+// A high surrogate that no low one followed stands for itself: U+FFFD
+static void flush_surrogate(JsonMessage *message) {
+    if (message->high_surrogate) {
+        message->high_surrogate = 0;
+        emit_codepoint(message, 0xFFFD);
+    }
+}
+
+static void finish_unicode(JsonMessage *message, uint32_t codepoint) {
+    if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+        flush_surrogate(message);
+        message->high_surrogate = codepoint;
+        return;
+    }
+    if (codepoint >= 0xDC00 && codepoint <= 0xDFFF) {
+        if (!message->high_surrogate) {
+            emit_codepoint(message, 0xFFFD);
+            return;
+        }
+        codepoint = 0x10000 + ((message->high_surrogate - 0xD800) << 10) + (codepoint - 0xDC00);
+        message->high_surrogate = 0;
+    }
+    flush_surrogate(message);
+    emit_codepoint(message, codepoint);
+}
+
+// Index of the first '"' or '\\' from i on, or length
+static size_t find_string_end(const char *data, size_t i, size_t length) {
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    for (; i + 16 <= length; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(data + i));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                                                  _mm_cmpeq_epi8(chunk, backslash)));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+    while (i < length && data[i] != '"' && data[i] != '\\') {
+        i++;
+    }
+    return i;
+}
+
+#if defined(__SSE2__)
+// Bit per byte of the 64 at p that is a quote, backslash, bracket or brace
+static uint64_t structural_mask(const char *p) {
+    // '[' and '{' are 0x5B and 0x7B, ']' and '}' 0x5D and 0x7D: setting bit 5 folds them
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    const __m128i open = _mm_set1_epi8('{');
+    const __m128i close = _mm_set1_epi8('}');
+    uint64_t mask = 0;
+
+    for (int k = 0; k < 4; k++) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(p + 16 * k));
+        __m128i folded = _mm_or_si128(chunk, case_bit);
+        __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                                    _mm_or_si128(_mm_cmpeq_epi8(folded, open), _mm_cmpeq_epi8(folded, close)));
+        mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(hits) << (16 * k);
+    }
+    return mask;
+}
+#endif
+
+typedef struct {
+    int in_string;
+    size_t resume;          // First byte not taken by an escape
+    unsigned int depth;
+} skip_state_t;
+
+// One quote, backslash, bracket or brace at p; returns 1 when it closes the nested value
+static int skip_step(skip_state_t *skip, char c, size_t p) {
+    if (p < skip->resume) {
+        return 0;
+    }
+    if (skip->in_string) {
+        if (c == '\\') {
+            skip->resume = p + 2;
+        } else if (c == '"') {
+            skip->in_string = 0;
+        }
+    } else if (c == '"') {
+        skip->in_string = 1;
+    } else if (c == '{' || c == '[') {
+        skip->depth++;
+    } else if (c == '}' || c == ']') {
+        return --skip->depth == 1;
+    }
+    return 0;
+}
+
+// The rest of a nested container, 64 bytes per step where SSE2 is there: only
+// its quotes, escapes and brackets matter. Returns where the top level goes on,
+// or length when the container continues in the next fragment.
+static size_t skip_nested(JsonMessage *message, const char *data, size_t i, size_t length) {
+    skip_state_t skip = {
+        message->state != JSON_MESSAGE_SKIP,
+        message->state == JSON_MESSAGE_SKIP_ESCAPE ? i + 1 : i,
+        message->depth,
+    };
+
+#if defined(__SSE2__)
+    for (; i + 64 <= length; i += 64) {
+        uint64_t mask = structural_mask(data + i);
+        while (mask) {
+            size_t p = i + __builtin_ctzll(mask);
+            mask &= mask - 1;
+            if (skip_step(&skip, data[p], p)) {
+                message->depth = 1;
+                value_done(message);
+                return p + 1;
+            }
+        }
+    }
+#endif
+    for (size_t p = i; p < length; p++) {
+        char c = data[p];
+        if ((c == '"' || c == '\\' || c == '{' || c == '}' || c == '[' || c == ']') && skip_step(&skip, c, p)) {
+            message->depth = 1;
+            value_done(message);
+            return p + 1;
+        }
+    }
+
+    message->depth = skip.depth;
+    message->state = skip.resume > length ? JSON_MESSAGE_SKIP_ESCAPE :
+                     skip.in_string ? JSON_MESSAGE_SKIP_STRING : JSON_MESSAGE_SKIP;
+    return length;
+}
+
+static int in_object(const JsonMessage *message) {
+    return message->depth == 1 && message->top_level_object;
+}
+
+static void value_done(JsonMessage *message) {
+    message->value_field = -1;
+    if (message->depth == 0) {
+        message->complete = 1;
+        message->state = JSON_MESSAGE_DONE;
+    } else {
+        message->state = JSON_MESSAGE_AFTER_VALUE;
+    }
+}
+
+// First character of a value; a literal's is read again as part of it
+static int begin_value(JsonMessage *message, char c) {
+    int field = message->field;
+    message->field = -1;
+
+    switch (c) {
+        case '{':
+        case '[':
+            // None of our fields are containers: anything below the top level is skipped
+            if (message->depth++ > 0) {
+                message->state = JSON_MESSAGE_SKIP;
+            } else {
+                message->top_level_object = c == '{';
+                message->state = c == '{' ? JSON_MESSAGE_OBJECT_START : JSON_MESSAGE_ARRAY_START;
+            }
+            return 1;
+        case '"': {
+            size_t size;
+            char *buffer = control_message_string(&message->fields, field, &size);
+            // A repeated key replaces the earlier value
+            if (buffer) {
+                buffer[0] = '\0';
+                message->fields.truncated &= ~CONTROL_FIELD_BIT(field);
+            }
+            message->value_field = (buffer || field == CONTROL_FIELD_AUDIO) ? field : -1;
+            message->value_length = 0;
+            message->state = JSON_MESSAGE_STRING;
+            return 1;
+        }
+        default:
+            if (!is_literal_char(c)) {
+                return 0;
+            }
+            message->value_field = control_message_number(&message->fields, field) ? field : -1;
+            message->literal_length = 0;
+            message->state = JSON_MESSAGE_LITERAL;
+            return 1;
+    }
+}
+
+static void end_string(JsonMessage *message) {
+    flush_surrogate(message);
+    if (message->value_field >= 0) {
+        message->fields.found |= CONTROL_FIELD_BIT(message->value_field);
+        if (message->value_field == CONTROL_FIELD_AUDIO && message->on_value_end) {
+            message->on_value_end(message->ctx);
+        }
+    }
+    value_done(message);
+}
+
+static int end_literal(JsonMessage *message) {
+    char *literal = message->literal;
+    int numeric = literal[0] == '-' || (literal[0] >= '0' && literal[0] <= '9');
+
+    if (message->literal_length == JSON_MESSAGE_NUMBER_MAX) {
+        // Too long to check; only a number gets this long
+        if (!numeric) return 0;
+    } else {
+        literal[message->literal_length] = '\0';
+        if (!numeric) {
+            if (strcmp(literal, "true") != 0 && strcmp(literal, "false") != 0 && strcmp(literal, "null") != 0) {
+                return 0;
+            }
+        } else {
+            char *end;
+            strtod(literal, &end);
+            if (*end != '\0') {
+                return 0;
+            }
+            uint64_t *number = control_message_number(&message->fields, message->value_field);
+            if (number && strspn(literal, "0123456789") == message->literal_length) {
+                *number = strtoull(literal, NULL, 10);
+                message->fields.found |= CONTROL_FIELD_BIT(message->value_field);
+            }
+        }
+    }
+    value_done(message);
+    return 1;
+}
+
+int json_message_feed(JsonMessage *message, const char *data, size_t length) {
+    if (message->error) {
+        return 0;
+    }
+    message->length += length;
+
+    size_t i = 0;
+    while (i < length) {
+        char c = data[i];
+
+        switch (message->state) {
+            case JSON_MESSAGE_VALUE:
+                if (is_space(c)) {
+                    i++;
+                    break;
+                }
+                if (!begin_value(message, c)) {
+                    return fail(message);
+                }
+                if (message->state != JSON_MESSAGE_LITERAL) {
+                    i++;
+                }
+                break;
+
+            case JSON_MESSAGE_OBJECT_START:
+            case JSON_MESSAGE_OBJECT_KEY:
+                if (is_space(c)) {
+                    i++;
+                } else if (c == '"') {
+                    message->key_length = 0;
+                    message->state = JSON_MESSAGE_KEY;
+                    i++;
+                } else if (c == '}' && message->state == JSON_MESSAGE_OBJECT_START) {
+                    message->depth--;
+                    value_done(message);
+                    i++;
+                } else {
+                    return fail(message);
+                }
+                break;
+
+            case JSON_MESSAGE_ARRAY_START:
+                if (is_space(c)) {
+                    i++;
+                } else if (c == ']') {
+                    message->depth--;
+                    value_done(message);
+                    i++;
+                } else {
+                    message->state = JSON_MESSAGE_VALUE;
+                }
+                break;
+
+            case JSON_MESSAGE_KEY:
+                if (c == '"') {
+                    message->state = JSON_MESSAGE_COLON;
+                } else if (c == '\\') {
+                    // An escaped key is never one of ours
+                    message->key_length = JSON_MESSAGE_KEY_MAX;
+                    message->state = JSON_MESSAGE_KEY_ESCAPE;
+                } else if (message->key_length < JSON_MESSAGE_KEY_MAX) {
+                    message->key[message->key_length++] = c;
+                }
+                i++;
+                break;
+
+            case JSON_MESSAGE_KEY_ESCAPE:
+                message->state = JSON_MESSAGE_KEY;
+                i++;
+                break;
+
+            case JSON_MESSAGE_COLON:
+                if (is_space(c)) {
+                    i++;
+                    break;
+                }
+                if (c != ':') {
+                    return fail(message);
+                }
+                message->field = message->depth == 1 ? control_field_lookup(message->key, message->key_length) : -1;
+                message->state = JSON_MESSAGE_VALUE;
+                i++;
+                break;
+
+            case JSON_MESSAGE_STRING: {
+                // The bulk of a message is string contents: take them a run at a time
+                size_t run = i;
+                i = find_string_end(data, i, length);
+                if (i > run && message->value_field >= 0) {
+                    flush_surrogate(message);
+                    emit(message, data + run, i - run);
+                }
+                if (i == length) {
+                    break;
+                }
+                if (data[i] == '\\') {
+                    message->state = JSON_MESSAGE_STRING_ESCAPE;
+                } else {
+                    end_string(message);
+                }
+                i++;
+                break;
+            }
+
+            case JSON_MESSAGE_STRING_ESCAPE: {
+                if (c == 'u') {
+                    message->unicode = 0;
+                    message->unicode_digits = 0;
+                    message->state = JSON_MESSAGE_STRING_UNICODE;
+                    i++;
+                    break;
+                }
+
+                char unescaped;
+                switch (c) {
+                    case '"': unescaped = '"'; break;
+                    case '\\': unescaped = '\\'; break;
+                    case '/': unescaped = '/'; break;
+                    case 'b': unescaped = '\b'; break;
+                    case 'f': unescaped = '\f'; break;
+                    case 'n': unescaped = '\n'; break;
+                    case 'r': unescaped = '\r'; break;
+                    case 't': unescaped = '\t'; break;
+                    default: return fail(message);
+                }
+                if (message->value_field >= 0) {
+                    flush_surrogate(message);
+                    emit(message, &unescaped, 1);
+                }
+                message->state = JSON_MESSAGE_STRING;
+                i++;
+                break;
+            }
+
+            case JSON_MESSAGE_STRING_UNICODE: {
+                int digit = hex_value(c);
+                if (digit < 0) {
+                    return fail(message);
+                }
+                message->unicode = (message->unicode << 4) | (uint32_t)digit;
+                if (++message->unicode_digits == 4) {
+                    finish_unicode(message, message->unicode);
+                    message->state = JSON_MESSAGE_STRING;
+                }
+                i++;
+                break;
+            }
+
+            case JSON_MESSAGE_LITERAL:
+                if (is_literal_char(c)) {
+                    if (message->literal_length < JSON_MESSAGE_NUMBER_MAX - 1) {
+                        message->literal[message->literal_length++] = c;
+                    } else {
+                        message->literal_length = JSON_MESSAGE_NUMBER_MAX;
+                    }
+                    i++;
+                    break;
+                }
+                // c is looked at again, after the value
+                if (!end_literal(message)) {
+                    return fail(message);
+                }
+                break;
+
+            case JSON_MESSAGE_AFTER_VALUE:
+                if (is_space(c)) {
+                    i++;
+                } else if (c == ',') {
+                    message->state = in_object(message) ? JSON_MESSAGE_OBJECT_KEY : JSON_MESSAGE_VALUE;
+                    i++;
+                } else if (c == (in_object(message) ? '}' : ']')) {
+                    message->depth--;
+                    value_done(message);
+                    i++;
+                } else {
+                    return fail(message);
+                }
+                break;
+
+            case JSON_MESSAGE_SKIP:
+            case JSON_MESSAGE_SKIP_STRING:
+            case JSON_MESSAGE_SKIP_ESCAPE:
+                i = skip_nested(message, data, i, length);
+                break;
+
+            case JSON_MESSAGE_DONE:
+                if (!is_space(c)) {
+                    return fail(message);
+                }
+                i++;
+                break;
+        }
+    }
+    return 1;
+}
+
+int json_message_finish(JsonMessage *message) {
+    if (!message->error && message->state == JSON_MESSAGE_LITERAL && !end_literal(message)) {
+        fail(message);
+    }
+    return !message->error && message->complete;
+}
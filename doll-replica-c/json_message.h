@@ -0,0 +1,77 @@
+#ifndef JSON_MESSAGE_H
+#define JSON_MESSAGE_H
+
+#include "control_message.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Incoming message parser configuration
+#define JSON_MESSAGE_KEY_MAX 16         // Longer keys are never one of the control fields
+#define JSON_MESSAGE_NUMBER_MAX 24
+
+// Characters of the audio string as they arrive, escapes already undone, and its end
+typedef void (*json_message_value_fn)(void *ctx, const char *data, size_t length);
+typedef void (*json_message_value_end_fn)(void *ctx);
+
+typedef enum {
+    JSON_MESSAGE_VALUE = 0,         // Expecting a value
+    JSON_MESSAGE_OBJECT_START,      // After '{': a key or '}'
+    JSON_MESSAGE_OBJECT_KEY,        // After ',' in an object: a key
+    JSON_MESSAGE_ARRAY_START,       // After '[': a value or ']'
+    JSON_MESSAGE_KEY,
+    JSON_MESSAGE_KEY_ESCAPE,
+    JSON_MESSAGE_COLON,
+    JSON_MESSAGE_STRING,
+    JSON_MESSAGE_STRING_ESCAPE,
+    JSON_MESSAGE_STRING_UNICODE,    // Hex digits of a \u escape
+    JSON_MESSAGE_LITERAL,           // Number, true, false or null
+    JSON_MESSAGE_AFTER_VALUE,       // ',' or the end of the container
+    JSON_MESSAGE_SKIP,              // Inside a nested container: brackets and strings only
+    JSON_MESSAGE_SKIP_STRING,
+    JSON_MESSAGE_SKIP_ESCAPE,
+    JSON_MESSAGE_DONE,              // Only whitespace may follow
+} json_message_state_t;
+
+// Single-pass tokenizer for one JSON text message that arrives in fragments.
+// Nothing but the control fields is kept: each byte is looked at once and a field
+// split across fragments carries over. The top level is tokenized in full;
+// nested containers only have their brackets counted, and they and strings are skipped
+// a vector at a time.
+typedef struct {
+    // Results, filled in as top-level members complete; audio goes to on_value
+    control_message_t fields;
+    int error;                      // Not well-formed JSON; nothing after it was read
+    int complete;                   // One whole JSON value was read
+    uint64_t length;                // Bytes fed for this message
+
+    // Tokenizer state
+    json_message_state_t state;
+    unsigned int depth;
+    int top_level_object;           // The message is an object, not an array
+    char key[JSON_MESSAGE_KEY_MAX];
+    size_t key_length;              // JSON_MESSAGE_KEY_MAX once it cannot match
+    int field;                      // Top-level member whose value is next, -1 for others
+    int value_field;                // Field of the string or literal being read, -1 for none
+    size_t value_length;
+    char literal[JSON_MESSAGE_NUMBER_MAX];
+    size_t literal_length;
+    uint32_t unicode;
+    unsigned int unicode_digits;
+    uint32_t high_surrogate;        // First half of a pair, waiting for the second
+
+    json_message_value_fn on_value;
+    json_message_value_end_fn on_value_end;
+    void *ctx;
+} JsonMessage;
+
+void json_message_init(JsonMessage *message, json_message_value_fn on_value,
+                       json_message_value_end_fn on_value_end, void *ctx);
+void json_message_reset(JsonMessage *message);      // Start of a new message
+
+// Feed the next fragment; returns 0 once the message turned out not to be JSON
+int json_message_feed(JsonMessage *message, const char *data, size_t length);
+
+// After the last fragment; returns 1 if it held exactly one JSON value
+int json_message_finish(JsonMessage *message);
+
+#endif // JSON_MESSAGE_H
@@ -10,23 +10,95 @@
 #include "input_handler.h"
 #include "audio.h"
 #include "http_client.h"
+#include "capture.h"
+#include "base64.h"
+#include "trace.h"
+#include "metrics.h"
+#include "metrics_server.h"
+#include "ws_uplink.h"
 
-// Audio chunk streaming callback
-void handle_audio_chunk(const unsigned char *chunk, size_t chunk_size) {
+// Audio chunk streaming callback (runs on the uplink thread)
+int handle_audio_chunk(const unsigned char *chunk, size_t chunk_size) {
     static int chunk_count = 0;
     chunk_count++;
     
-    // Stream the audio chunk immediately
-    if (!http_stream_audio_chunk(chunk, chunk_size)) {
+    // Stream the audio chunk immediately, over whichever uplink the utterance opened
+    int sent = ws_uplink_active() ? ws_uplink_send(chunk, chunk_size, capture_sink_position())
+                                  : http_stream_audio_chunk(chunk, chunk_size);
+    if (!sent) {
         printf("❌ Failed to stream audio chunk %d (%zu bytes)\n", chunk_count, chunk_size);
-    } else {
-        // Log every 10th chunk to avoid spam
-        if (chunk_count % 10 == 0) {
-            printf("📤 Streamed audio chunk %d (%zu bytes)\n", chunk_count, chunk_size);
-        }
+        return 0;
+    }
+    
+    // Log every 10th chunk to avoid spam
+    if (chunk_count % 10 == 0) {
+        printf("📤 Streamed audio chunk %d (%zu bytes)\n", chunk_count, chunk_size);
+    }
+    return 1;
+}
+
+// Silence suppressed by the VAD before the next chunk (runs on the uplink thread).
+// WebSocket frames carry it in their timestamps already.
+void handle_audio_dtx(unsigned int silent_ms) {
+    if (!ws_uplink_active()) {
+        http_stream_audio_dtx(silent_ms);
     }
 }
 
+// Trailing silence ended the utterance (runs on the uplink thread, no locks held)
+void handle_end_of_utterance(void) {
+    printf("\n🤫 End of speech detected, finishing utterance\n");
+    
+    stop_recording();
+    finish_streaming_utterance();
+    
+    printf("> ");
+    fflush(stdout);
+}
+
+// The user talked over the TTS (main loop). The callback has already flushed playback;
+// tear the stream down, cancel the response on the server and start listening.
+static void handle_barge_in(void) {
+    printf("\n🗣️  Barge-in: interrupting the response\n");
+    
+    // Whatever is still on its way for this response is dropped, not played
+    audio_suppress_downlink(1);
+    stop_streaming_audio_playback();
+    cancel_audio_clip(0);
+    
+    if (websocket_connection) {
+        websocket_send_control("cancel", "reason", "barge_in");
+    }
+    
+    // The speech that triggered this is kept and opens the new utterance
+    if (!start_streaming_utterance_async()) {
+        audio_suppress_downlink(0);
+    }
+}
+
+// Wakes the service loop for the checks below; the audio callback cannot wake it itself
+static lws_sorted_usec_list_t service_tick;
+
+static void service_tick_expired(lws_sorted_usec_list_t *timer) {
+    (void)timer; // Returning from lws_service() is all it is for
+}
+
+// Main loop work, after every service pass
+static void service_housekeeping(void) {
+    if (audio_take_barge_in()) {
+        handle_barge_in();
+    }
+    
+    // Idle the output once a finished response has played out
+    audio_poll_playback();
+    metrics_poll();
+    
+    // Barge-in and drain are only polled for while a response plays
+    int active = audio_utterance_active() || is_streaming_audio_active();
+    lws_usec_t tick_ms = active ? SERVICE_ACTIVE_TICK_MS : SERVICE_IDLE_TICK_MS;
+    lws_sul_schedule(websocket_context, 0, &service_tick, service_tick_expired, tick_ms * LWS_US_PER_MS);
+}
+
 int main(void) {
     printf("🚀 Starting C WebSocket client with real-time HTTP audio streaming...\n");
     printf("📍 Connecting to: %s:%d%s\n", SERVER_ADDRESS, SERVER_PORT, WEBSOCKET_PATH);
@@ -37,7 +109,12 @@ int main(void) {
     signal(SIGTERM, signal_handler);
     
     // Initialize message queue
-    init_message_queue();
+    if (!init_message_queue()) {
+        return 1;
+    }
+    
+    // Pick the base64 kernels for this CPU
+    base64_init();
     
     // Initialize audio system
     if (!init_audio()) {
@@ -46,6 +123,12 @@ int main(void) {
         return 1;
     }
     
+    // Gate the streaming uplink with voice activity detection
+    capture_set_vad_handlers(handle_audio_dtx, handle_end_of_utterance);
+    
+    // Let the user interrupt TTS by talking over it
+    audio_set_barge_in(1);
+    
     // Initialize HTTP client for audio streaming
     if (!http_init()) {
         printf("❌ Failed to initialize HTTP client\n");
@@ -72,6 +155,9 @@ int main(void) {
         return 1;
     }
     
+    // Local /metrics endpoint, served by the same service loop
+    metrics_server_start(websocket_context);
+    
     // Connect to server
     if (!connect_to_server()) {
         printf("❌ Failed to connect to server\n");
@@ -104,7 +190,7 @@ int main(void) {
     printf("🎤 Audio will be streamed in real-time during recording\n");
     printf("💬 Text responses will come via WebSocket\n");
     
-    // Start input thread
+    // Start input thread, stdin joins the service loop
     if (!start_input_thread()) {
         printf("❌ Failed to start input thread\n");
         cleanup_websocket_client();
@@ -114,9 +200,11 @@ int main(void) {
         return 1;
     }
     
-    // Main event loop
+    // Main event loop - sleeps until a socket, stdin, the tick or lws_cancel_service()
+    // wakes it (lws takes any non-negative timeout as "wait for the next event")
     while (!should_exit) {
-        lws_service(websocket_context, 10);  // 10ms timeout for more responsive input
+        lws_service(websocket_context, 0);
+        service_housekeeping();
     }
     
     // Cleanup
@@ -126,6 +214,10 @@ int main(void) {
     
     printf("\n👋 Shutting down client\n");
     
+    // Where the time went, per turn
+    trace_report();
+    trace_dump_chrome(TRACE_FILE);
+    
     // Final cleanup
     cleanup_websocket_client();
     http_cleanup();
@@ -1,139 +1,384 @@
 #include "message_queue.h"
+#include "metrics.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-// Global queue variables
-queued_message_t message_queue[MAX_QUEUE_SIZE];
-int queue_head = 0;
-int queue_tail = 0;
-pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static const size_t pool_sizes[MESSAGE_POOL_CLASSES] = MESSAGE_POOL_SIZES;
+static const int pool_counts[MESSAGE_POOL_CLASSES] = MESSAGE_POOL_COUNTS;
+static const size_t lane_limits[MESSAGE_LANE_COUNT] = MESSAGE_LANE_LIMITS;
+static const size_t lane_quanta[MESSAGE_LANE_COUNT] = MESSAGE_LANE_QUANTA;
+static const metric_id_t lane_metrics[MESSAGE_LANE_COUNT] = {
+    METRIC_WS_QUEUE_CONTROL_BYTES, METRIC_WS_QUEUE_TEXT_BYTES, METRIC_WS_QUEUE_AUDIO_BYTES
+};
 
-// Initialize message queue
-void init_message_queue(void) {
-    queue_head = 0;
-    queue_tail = 0;
-    pthread_mutex_init(&queue_mutex, NULL);
+// One slab of buffers per size class. The free list is a Treiber stack of
+// buffer indexes; the top carries a tag in its high half against ABA.
+typedef struct {
+    unsigned char *slab;
+    message_buffer_t *buffers;
+    atomic_uint_fast64_t free_top;  // (tag << 32) | (index + 1), index 0 = empty
+} message_pool_t;
+
+// Intrusive multi-producer single-consumer queue (Vyukov): producers swap
+// themselves in at head, the service thread walks from tail. The stub keeps
+// the list non-empty so neither side ever takes a lock.
+typedef struct {
+    _Atomic(message_buffer_t *) head;
+    message_buffer_t *tail;         // Consumer only
+    message_buffer_t stub;
+    message_buffer_t *staged;       // Taken off the list but not yet sent (consumer only)
+    size_t deficit;                 // Round robin byte budget (consumer only)
+
+    atomic_size_t bytes;
+    atomic_uint depth;
+    atomic_size_t max_bytes;
+    atomic_uint_fast64_t sent;
+    atomic_uint_fast64_t slow_downs;
+    atomic_uint_fast64_t rejected;
+} message_lane_queue_t;
+
+static message_pool_t pools[MESSAGE_POOL_CLASSES];
+static message_lane_queue_t lanes[MESSAGE_LANE_COUNT];
+static message_lane_t current_lane = MESSAGE_LANE_TEXT;    // Whose round robin turn it is
+
+// ============================================================================
+// BUFFER POOL
+// ============================================================================
+
+static message_buffer_t* pool_take(message_pool_t *pool) {
+    uint_fast64_t top = atomic_load_explicit(&pool->free_top, memory_order_acquire);
+    for (;;) {
+        uint32_t index = (uint32_t)top;
+        if (index == 0) {
+            return NULL;
+        }
+        
+        message_buffer_t *buffer = &pool->buffers[index - 1];
+        uint_fast64_t next = (((top >> 32) + 1) << 32) |
+                             atomic_load_explicit(&buffer->free_next, memory_order_relaxed);
+        if (atomic_compare_exchange_weak_explicit(&pool->free_top, &top, next,
+                                                  memory_order_acquire, memory_order_acquire)) {
+            return buffer;
+        }
+    }
 }
 
-// Cleanup message queue
-void cleanup_message_queue(void) {
-    pthread_mutex_lock(&queue_mutex);
+static void pool_give(message_pool_t *pool, message_buffer_t *buffer) {
+    uint32_t index = (uint32_t)(buffer - pool->buffers) + 1;
+    uint_fast64_t top = atomic_load_explicit(&pool->free_top, memory_order_relaxed);
+    uint_fast64_t next;
+    do {
+        atomic_store_explicit(&buffer->free_next, (uint32_t)top, memory_order_relaxed);
+        next = (((top >> 32) + 1) << 32) | index;
+    } while (!atomic_compare_exchange_weak_explicit(&pool->free_top, &top, next,
+                                                    memory_order_release, memory_order_relaxed));
+}
+
+static message_buffer_t* allocate_one_off(size_t capacity) {
+    unsigned char *block = malloc(sizeof(message_buffer_t) + LWS_PRE + capacity);
+    if (!block) {
+        return NULL;
+    }
+    
+    message_buffer_t *buffer = (message_buffer_t *)block;
+    buffer->data = block + sizeof(message_buffer_t) + LWS_PRE;
+    buffer->capacity = capacity;
+    buffer->size_class = -1;
+    atomic_init(&buffer->free_next, 0);
+    return buffer;
+}
+
+static void reset_buffer(message_buffer_t *buffer) {
+    buffer->length = 0;
+    buffer->is_binary = 0;
+    atomic_init(&buffer->next, NULL);
+}
+
+// Smallest class that fits and has a buffer free; bigger messages than the
+// largest class are allocated on their own
+message_buffer_t* message_buffer_acquire(size_t capacity) {
+    message_buffer_t *buffer = NULL;
     
-    // Free any remaining large binary data
-    for (int i = 0; i < MAX_QUEUE_SIZE; i++) {
-        if (message_queue[i].large_binary_data) {
-            free(message_queue[i].large_binary_data);
-            message_queue[i].large_binary_data = NULL;
+    for (int c = 0; c < MESSAGE_POOL_CLASSES && !buffer; c++) {
+        if (pool_sizes[c] >= capacity && pools[c].buffers) {
+            buffer = pool_take(&pools[c]);
         }
     }
     
-    pthread_mutex_unlock(&queue_mutex);
-    pthread_mutex_destroy(&queue_mutex);
+    if (!buffer && capacity > pool_sizes[MESSAGE_POOL_CLASSES - 1]) {
+        buffer = allocate_one_off(capacity);
+    }
+    
+    if (buffer) {
+        reset_buffer(buffer);
+    }
+    return buffer;
 }
 
-// Helper function to add message to queue
-int add_message_to_queue(const char *message) {
-    pthread_mutex_lock(&queue_mutex);
-    
-    int next_tail = (queue_tail + 1) % MAX_QUEUE_SIZE;
-    if (next_tail == queue_head) {
-        pthread_mutex_unlock(&queue_mutex);
-        return 0; // Queue is full
+void message_buffer_release(message_buffer_t *buffer) {
+    if (!buffer) {
+        return;
     }
     
-    strncpy(message_queue[queue_tail].message, message, MAX_MESSAGE_LENGTH - 1);
-    message_queue[queue_tail].message[MAX_MESSAGE_LENGTH - 1] = '\0';
-    message_queue[queue_tail].length = strlen(message_queue[queue_tail].message);
-    queue_tail = next_tail;
+    if (buffer->size_class < 0) {
+        free(buffer);
+        return;
+    }
     
-    pthread_mutex_unlock(&queue_mutex);
-    return 1; // Success
+    pool_give(&pools[buffer->size_class], buffer);
+}
+
+// ============================================================================
+// LANES
+// ============================================================================
+
+static void lane_link(message_lane_queue_t *lane, message_buffer_t *buffer) {
+    atomic_store_explicit(&buffer->next, NULL, memory_order_relaxed);
+    message_buffer_t *prev = atomic_exchange_explicit(&lane->head, buffer, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, buffer, memory_order_release);
 }
 
-// Helper function to get message from queue
-int get_message_from_queue(char *message, int *length) {
-    pthread_mutex_lock(&queue_mutex);
+// Oldest message of the lane (service thread). NULL when empty, and also for the
+// instant a producer has swapped in at head but not linked yet; the depth
+// counter still shows it, so the caller asks for another writeable callback.
+static message_buffer_t* lane_unlink(message_lane_queue_t *lane) {
+    message_buffer_t *tail = lane->tail;
+    message_buffer_t *next = atomic_load_explicit(&tail->next, memory_order_acquire);
     
-    if (queue_head == queue_tail) {
-        pthread_mutex_unlock(&queue_mutex);
-        return 0; // Queue is empty
+    if (tail == &lane->stub) {
+        if (!next) {
+            return NULL;
+        }
+        lane->tail = next;
+        tail = next;
+        next = atomic_load_explicit(&next->next, memory_order_acquire);
     }
     
-    strcpy(message, message_queue[queue_head].message);
-    *length = message_queue[queue_head].length;
-    queue_head = (queue_head + 1) % MAX_QUEUE_SIZE;
+    if (next) {
+        lane->tail = next;
+        return tail;
+    }
     
-    pthread_mutex_unlock(&queue_mutex);
-    return 1; // Success
+    if (tail != atomic_load_explicit(&lane->head, memory_order_acquire)) {
+        return NULL;
+    }
+    
+    // tail is the last one: put the stub behind it so it can be taken
+    lane_link(lane, &lane->stub);
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (next) {
+        lane->tail = next;
+        return tail;
+    }
+    return NULL;
 }
 
-// Helper function to add binary message to queue
-int add_binary_message_to_queue(const unsigned char *data, size_t data_size) {
-    pthread_mutex_lock(&queue_mutex);
-    
-    int next_tail = (queue_tail + 1) % MAX_QUEUE_SIZE;
-    if (next_tail == queue_head) {
-        pthread_mutex_unlock(&queue_mutex);
-        return 0; // Queue is full
-    }
-    
-    if (data_size <= MAX_MESSAGE_LENGTH) {
-        // Small data - copy directly
-        memcpy(message_queue[queue_tail].message, data, data_size);
-        message_queue[queue_tail].length = data_size;
-        message_queue[queue_tail].is_binary = 1;
-        message_queue[queue_tail].large_binary_data = NULL;
-        message_queue[queue_tail].large_binary_size = 0;
-    } else {
-        // Large data - allocate dynamically
-        message_queue[queue_tail].large_binary_data = malloc(data_size);
-        if (!message_queue[queue_tail].large_binary_data) {
-            pthread_mutex_unlock(&queue_mutex);
-            return 0; // Memory allocation failed
+static message_buffer_t* lane_peek(message_lane_queue_t *lane) {
+    if (!lane->staged) {
+        lane->staged = lane_unlink(lane);
+    }
+    return lane->staged;
+}
+
+static message_buffer_t* lane_take(message_lane_t id) {
+    message_lane_queue_t *lane = &lanes[id];
+    message_buffer_t *buffer = lane->staged;
+    lane->staged = NULL;
+    
+    size_t bytes = atomic_fetch_sub_explicit(&lane->bytes, buffer->length, memory_order_relaxed) - buffer->length;
+    atomic_fetch_sub_explicit(&lane->depth, 1, memory_order_relaxed);
+    metrics_set(lane_metrics[id], (double)bytes);
+    return buffer;
+}
+
+// ============================================================================
+// QUEUE
+// ============================================================================
+
+// Initialize message queue
+int init_message_queue(void) {
+    for (int c = 0; c < MESSAGE_POOL_CLASSES; c++) {
+        message_pool_t *pool = &pools[c];
+        size_t stride = LWS_PRE + pool_sizes[c];
+        
+        pool->slab = malloc(stride * pool_counts[c]);
+        pool->buffers = calloc(pool_counts[c], sizeof(message_buffer_t));
+        if (!pool->slab || !pool->buffers) {
+            printf("❌ Failed to allocate message pool (%zu byte class)\n", pool_sizes[c]);
+            cleanup_message_queue();
+            return 0;
+        }
+        
+        // Free list in index order: buffer i links to i + 1
+        for (int i = 0; i < pool_counts[c]; i++) {
+            message_buffer_t *buffer = &pool->buffers[i];
+            buffer->data = pool->slab + stride * i + LWS_PRE;
+            buffer->capacity = pool_sizes[c];
+            buffer->size_class = c;
+            atomic_init(&buffer->free_next, i + 1 < pool_counts[c] ? (unsigned int)(i + 2) : 0);
         }
-        memcpy(message_queue[queue_tail].large_binary_data, data, data_size);
-        message_queue[queue_tail].large_binary_size = data_size;
-        message_queue[queue_tail].length = 0;
-        message_queue[queue_tail].is_binary = 1;
+        atomic_init(&pool->free_top, 1);
     }
     
-    queue_tail = next_tail;
-    pthread_mutex_unlock(&queue_mutex);
-    return 1; // Success
+    for (int l = 0; l < MESSAGE_LANE_COUNT; l++) {
+        message_lane_queue_t *lane = &lanes[l];
+        memset(lane, 0, sizeof(*lane));
+        atomic_init(&lane->stub.next, NULL);
+        atomic_init(&lane->head, &lane->stub);
+        lane->tail = &lane->stub;
+    }
+    current_lane = MESSAGE_LANE_TEXT;
+    return 1;
 }
 
-// Helper function to get binary message from queue
-int get_binary_message_from_queue(unsigned char **data, size_t *data_size) {
-    pthread_mutex_lock(&queue_mutex);
+// Cleanup message queue (no producers left)
+void cleanup_message_queue(void) {
+    for (int l = 0; l < MESSAGE_LANE_COUNT; l++) {
+        message_lane_queue_t *lane = &lanes[l];
+        if (!lane->tail) {
+            continue;
+        }
+        while (lane_peek(lane)) {
+            message_buffer_release(lane_take((message_lane_t)l));
+        }
+    }
     
-    if (queue_head == queue_tail) {
-        pthread_mutex_unlock(&queue_mutex);
-        return 0; // Queue is empty
+    for (int c = 0; c < MESSAGE_POOL_CLASSES; c++) {
+        free(pools[c].slab);
+        free(pools[c].buffers);
+        pools[c].slab = NULL;
+        pools[c].buffers = NULL;
+        atomic_store(&pools[c].free_top, 0);
+    }
+}
+
+message_queue_status_t message_queue_push(message_buffer_t *buffer, message_lane_t id) {
+    message_lane_queue_t *lane = &lanes[id];
+    size_t length = buffer->length;
+    size_t limit = lane_limits[id];
+    
+    // A message bigger than the whole limit still goes out on an empty lane
+    size_t bytes = atomic_fetch_add_explicit(&lane->bytes, length, memory_order_relaxed) + length;
+    if (bytes > limit && bytes > length) {
+        atomic_fetch_sub_explicit(&lane->bytes, length, memory_order_relaxed);
+        atomic_fetch_add_explicit(&lane->rejected, 1, memory_order_relaxed);
+        metrics_add(METRIC_WS_QUEUE_REJECTED, 1);
+        message_buffer_release(buffer);
+        return MESSAGE_REJECTED;
     }
     
-    if (!message_queue[queue_head].is_binary) {
-        pthread_mutex_unlock(&queue_mutex);
-        return 0; // Not a binary message
+    atomic_fetch_add_explicit(&lane->depth, 1, memory_order_relaxed);
+    if (bytes > atomic_load_explicit(&lane->max_bytes, memory_order_relaxed)) {
+        atomic_store_explicit(&lane->max_bytes, bytes, memory_order_relaxed);
     }
+    metrics_set(lane_metrics[id], (double)bytes);
+    lane_link(lane, buffer);
     
-    if (message_queue[queue_head].large_binary_data) {
-        // Large data - return the pointer directly
-        *data = message_queue[queue_head].large_binary_data;
-        *data_size = message_queue[queue_head].large_binary_size;
-        message_queue[queue_head].large_binary_data = NULL; // Transfer ownership
-    } else {
-        // Small data - allocate and copy
-        *data = malloc(message_queue[queue_head].length);
-        if (!*data) {
-            pthread_mutex_unlock(&queue_mutex);
-            return 0; // Memory allocation failed
+    if (bytes * 100 > limit * MESSAGE_LANE_HIGH_WATER_PERCENT) {
+        atomic_fetch_add_explicit(&lane->slow_downs, 1, memory_order_relaxed);
+        metrics_add(METRIC_WS_QUEUE_SLOW_DOWNS, 1);
+        return MESSAGE_QUEUED_SLOW_DOWN;
+    }
+    return MESSAGE_QUEUED;
+}
+
+// Control first, always. Text and audio take turns by deficit round robin: a
+// lane sends while its byte budget covers its next message, then earns another
+// quantum and hands the turn over, so a burst of audio cannot starve text.
+message_buffer_t* message_queue_pop(void) {
+    if (lane_peek(&lanes[MESSAGE_LANE_CONTROL])) {
+        atomic_fetch_add_explicit(&lanes[MESSAGE_LANE_CONTROL].sent, 1, memory_order_relaxed);
+        return lane_take(MESSAGE_LANE_CONTROL);
+    }
+    
+    int empty = 0;
+    while (empty < MESSAGE_LANE_COUNT - 1) {
+        message_lane_queue_t *lane = &lanes[current_lane];
+        message_buffer_t *head = lane_peek(lane);
+        
+        if (head && lane->deficit >= head->length) {
+            lane->deficit -= head->length;
+            atomic_fetch_add_explicit(&lane->sent, 1, memory_order_relaxed);
+            return lane_take(current_lane);
         }
-        memcpy(*data, message_queue[queue_head].message, message_queue[queue_head].length);
-        *data_size = message_queue[queue_head].length;
+        
+        if (head) {
+            lane->deficit += lane_quanta[current_lane];
+            empty = 0;
+        } else {
+            lane->deficit = 0;  // Budget is not saved up while idle
+            empty++;
+        }
+        current_lane = current_lane + 1 < MESSAGE_LANE_COUNT ? current_lane + 1 : MESSAGE_LANE_TEXT;
     }
+    return NULL;
+}
+
+unsigned int message_queue_discard(message_lane_t id) {
+    message_lane_queue_t *lane = &lanes[id];
+    unsigned int count = 0;
     
-    queue_head = (queue_head + 1) % MAX_QUEUE_SIZE;
-    pthread_mutex_unlock(&queue_mutex);
-    return 1; // Success
-} 
\ No newline at end of file
+    while (lane_peek(lane)) {
+        message_buffer_release(lane_take(id));
+        count++;
+    }
+    lane->deficit = 0;
+    return count;
+}
+
+int message_queue_pending(void) {
+    unsigned int pending = 0;
+    for (int l = 0; l < MESSAGE_LANE_COUNT; l++) {
+        pending += atomic_load_explicit(&lanes[l].depth, memory_order_relaxed);
+    }
+    return (int)pending;
+}
+
+void message_queue_get_stats(message_lane_t id, message_lane_stats_t *stats) {
+    message_lane_queue_t *lane = &lanes[id];
+    stats->depth = atomic_load(&lane->depth);
+    stats->bytes = atomic_load(&lane->bytes);
+    stats->max_bytes = atomic_load(&lane->max_bytes);
+    stats->sent = atomic_load(&lane->sent);
+    stats->slow_downs = atomic_load(&lane->slow_downs);
+    stats->rejected = atomic_load(&lane->rejected);
+}
+
+static message_queue_status_t queue_copy(const void *data, size_t size, int is_binary, message_lane_t lane) {
+    message_buffer_t *buffer = message_buffer_acquire(size);
+    
+    // Control must get through even when bulk traffic has drained the pool
+    if (!buffer && lane == MESSAGE_LANE_CONTROL && (buffer = allocate_one_off(size))) {
+        reset_buffer(buffer);
+    }
+    
+    if (!buffer) {
+        atomic_fetch_add_explicit(&lanes[lane].rejected, 1, memory_order_relaxed);
+        metrics_add(METRIC_WS_QUEUE_REJECTED, 1);
+        return MESSAGE_REJECTED; // Pool exhausted
+    }
+    
+    memcpy(buffer->data, data, size);
+    buffer->length = size;
+    buffer->is_binary = is_binary;
+    return message_queue_push(buffer, lane);
+}
+
+// Helper function to add message to queue
+message_queue_status_t add_message_to_queue(const char *message) {
+    return queue_copy(message, strlen(message), 0, MESSAGE_LANE_TEXT);
+}
+
+message_queue_status_t add_control_message_to_queue(const char *message) {
+    return queue_copy(message, strlen(message), 0, MESSAGE_LANE_CONTROL);
+}
+
+message_queue_status_t add_binary_control_message_to_queue(const unsigned char *data, size_t data_size) {
+    return queue_copy(data, data_size, 1, MESSAGE_LANE_CONTROL);
+}
+
+// Helper function to add binary message to queue
+message_queue_status_t add_binary_message_to_queue(const unsigned char *data, size_t data_size) {
+    return queue_copy(data, data_size, 1, MESSAGE_LANE_AUDIO);
+}
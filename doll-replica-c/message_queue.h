@@ -2,30 +2,82 @@
 #define MESSAGE_QUEUE_H
 
 #include "config.h"
-#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <libwebsockets.h>
 
-// Message queue structure
-typedef struct {
-    char message[MAX_MESSAGE_LENGTH];
-    int length;
+// Outbound message pool configuration: payload sizes of the classes and how many
+// buffers each has. Larger messages get a buffer of their own.
+#define MESSAGE_POOL_CLASSES 3
+#define MESSAGE_POOL_SIZES { 512, 4096, 65536 }
+#define MESSAGE_POOL_COUNTS { 32, 16, 2 }
+
+// Outbound lanes. Control always goes first; text and audio share the link by
+// deficit round robin, each getting its quantum of bytes per round.
+typedef enum {
+    MESSAGE_LANE_CONTROL = 0,   // cancel, acks: small and urgent
+    MESSAGE_LANE_TEXT,          // chat text
+    MESSAGE_LANE_AUDIO,         // bulk binary audio
+    MESSAGE_LANE_COUNT
+} message_lane_t;
+
+#define MESSAGE_LANE_LIMITS { 16 * 1024, 64 * 1024, 256 * 1024 }   // Queued bytes per lane before pushes are refused
+#define MESSAGE_LANE_QUANTA { 0, 4096, 16384 }                     // Bytes per round robin turn (control is not scheduled)
+#define MESSAGE_LANE_HIGH_WATER_PERCENT 75                          // Past this, pushes ask the producer to slow down
+
+// An outbound WebSocket message. The payload starts LWS_PRE bytes into its
+// allocation, so the producer writes it once and lws_write sends it in place.
+typedef struct message_buffer {
+    unsigned char *data;            // Payload; LWS_PRE bytes of headroom in front
+    size_t length;                  // Bytes of payload written
+    size_t capacity;                // Room for payload
     int is_binary;
-    // For large binary data, store pointer instead of copying
-    unsigned char *large_binary_data;
-    size_t large_binary_size;
-} queued_message_t;
+    int size_class;                 // Pool class, -1 for an oversized one-off
+    atomic_uint free_next;          // Pool free list link (index + 1, 0 ends it)
+    _Atomic(struct message_buffer *) next;  // Lane queue link
+} message_buffer_t;
+
+// What a push tells the producer. Non-zero means the message was queued, so
+// callers that only test for success keep working.
+typedef enum {
+    MESSAGE_REJECTED = 0,           // Lane full or pool exhausted; nothing was queued
+    MESSAGE_QUEUED = 1,
+    MESSAGE_QUEUED_SLOW_DOWN = 2,   // Queued, but the lane is past its high water mark
+} message_queue_status_t;
+
+// Per-lane queue statistics
+typedef struct {
+    unsigned int depth;             // Messages waiting now
+    size_t bytes;                   // Payload bytes waiting now
+    size_t max_bytes;
+    uint64_t sent;
+    uint64_t slow_downs;
+    uint64_t rejected;
+} message_lane_stats_t;
 
 // Message queue functions
-int add_message_to_queue(const char *message);
-int add_binary_message_to_queue(const unsigned char *data, size_t data_size);
-int get_message_from_queue(char *message, int *length);
-int get_binary_message_from_queue(unsigned char **data, size_t *data_size);
-void init_message_queue(void);
+int init_message_queue(void);
 void cleanup_message_queue(void);
 
-// Global queue variables (extern for access from other modules)
-extern queued_message_t message_queue[MAX_QUEUE_SIZE];
-extern int queue_head;
-extern int queue_tail;
-extern pthread_mutex_t queue_mutex;
+// A free buffer with room for at least capacity bytes, NULL if the pool is
+// exhausted. Lock-free, safe from any thread.
+message_buffer_t* message_buffer_acquire(size_t capacity);
+void message_buffer_release(message_buffer_t *buffer);
+
+// Any thread may push (lock-free). The queue takes the buffer over; a rejected
+// one is released. Only the WebSocket service thread pops.
+message_queue_status_t message_queue_push(message_buffer_t *buffer, message_lane_t lane);
+message_buffer_t* message_queue_pop(void);      // Next by priority and fairness, NULL if none
+int message_queue_pending(void);
+unsigned int message_queue_discard(message_lane_t lane);   // Drop what a lane holds (service thread); returns how many
+
+void message_queue_get_stats(message_lane_t lane, message_lane_stats_t *stats);
+
+// Copy a message into a pool buffer and queue it
+message_queue_status_t add_message_to_queue(const char *message);            // Text lane
+message_queue_status_t add_control_message_to_queue(const char *message);    // Control lane
+message_queue_status_t add_binary_control_message_to_queue(const unsigned char *data, size_t data_size);  // Control lane, CBOR
+message_queue_status_t add_binary_message_to_queue(const unsigned char *data, size_t data_size);  // Audio lane
 
-#endif // MESSAGE_QUEUE_H 
\ No newline at end of file
+#endif // MESSAGE_QUEUE_H
@@ -0,0 +1,196 @@
+#include "metrics.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <stdatomic.h>
+
+typedef struct {
+    const char *name;
+    const char *help;
+    metric_type_t type;
+    const uint64_t *bounds;     // Histogram bucket upper bounds, ascending
+    size_t bound_count;
+} metric_desc_t;
+
+static const uint64_t callback_us_bounds[] = { 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 32000 };
+static const uint64_t first_sample_ms_bounds[] = { 20, 40, 60, 80, 100, 150, 200, 300, 500, 1000 };
+static const uint64_t reconnect_ms_bounds[] = { 10, 25, 50, 100, 150, 200, 300, 500, 1000, 2000, 5000 };
+static const uint64_t gap_ms_bounds[] = { 50, 100, 200, 500, 1000, 2000, 5000, 10000, 30000 };
+
+#define HISTOGRAM(bounds) METRIC_HISTOGRAM, bounds, sizeof(bounds) / sizeof(bounds[0])
+
+static const metric_desc_t metric_descs[METRIC_COUNT] = {
+    [METRIC_AUDIO_CALLBACKS] = { "doll_audio_callbacks_total", "Audio callback periods", METRIC_COUNTER, NULL, 0 },
+    [METRIC_AUDIO_OUTPUT_UNDERFLOWS] = { "doll_audio_output_underflows_total", "Periods the device ran out of output", METRIC_COUNTER, NULL, 0 },
+    [METRIC_AUDIO_OUTPUT_OVERFLOWS] = { "doll_audio_output_overflows_total", "Periods of output the device discarded", METRIC_COUNTER, NULL, 0 },
+    [METRIC_AUDIO_INPUT_UNDERFLOWS] = { "doll_audio_input_underflows_total", "Periods padded because input was missing", METRIC_COUNTER, NULL, 0 },
+    [METRIC_AUDIO_INPUT_OVERFLOWS] = { "doll_audio_input_overflows_total", "Periods of input the device lost", METRIC_COUNTER, NULL, 0 },
+    [METRIC_AUDIO_CALLBACK_US] = { "doll_audio_callback_duration_us", "Time spent in the audio callback", HISTOGRAM(callback_us_bounds) },
+    [METRIC_AUDIO_CPU_LOAD] = { "doll_audio_cpu_load", "PortAudio stream CPU load (0-1)", METRIC_GAUGE, NULL, 0 },
+    [METRIC_CAPTURE_OVERRUN_BYTES] = { "doll_capture_overrun_bytes_total", "Captured PCM lost to a full capture ring", METRIC_COUNTER, NULL, 0 },
+    [METRIC_CAPTURE_QUEUE_BYTES] = { "doll_capture_queue_bytes", "Captured PCM waiting for the uplink thread", METRIC_GAUGE, NULL, 0 },
+    [METRIC_UPLINK_BYTES_SENT] = { "doll_uplink_bytes_sent_total", "Encoded audio sent on the streaming session", METRIC_COUNTER, NULL, 0 },
+    [METRIC_UPLINK_SEND_FAILURES] = { "doll_uplink_send_failures_total", "Uplink chunks that failed to send", METRIC_COUNTER, NULL, 0 },
+    [METRIC_DOWNLINK_BYTES_RECEIVED] = { "doll_downlink_bytes_received_total", "Encoded TTS queued for decoding", METRIC_COUNTER, NULL, 0 },
+    [METRIC_DOWNLINK_BYTES_DROPPED] = { "doll_downlink_bytes_dropped_total", "Encoded TTS dropped before decoding", METRIC_COUNTER, NULL, 0 },
+    [METRIC_DOWNLINK_DECODE_ERRORS] = { "doll_downlink_decode_errors_total", "TTS chunks the decoder rejected", METRIC_COUNTER, NULL, 0 },
+    [METRIC_DOWNLINK_QUEUE_BYTES] = { "doll_downlink_queue_bytes", "Encoded TTS waiting for the decoder thread", METRIC_GAUGE, NULL, 0 },
+    [METRIC_JITTER_UNDERRUNS] = { "doll_jitter_underruns_total", "Playback underruns concealed by the jitter buffer", METRIC_COUNTER, NULL, 0 },
+    [METRIC_JITTER_DEPTH_MS] = { "doll_jitter_depth_ms", "Decoded TTS buffered for playback", METRIC_GAUGE, NULL, 0 },
+    [METRIC_FIRST_SAMPLE_MS] = { "doll_first_sample_latency_ms", "First TTS byte to first played sample", HISTOGRAM(first_sample_ms_bounds) },
+    [METRIC_BARGE_INS] = { "doll_barge_ins_total", "Responses interrupted by the user", METRIC_COUNTER, NULL, 0 },
+    [METRIC_WS_MESSAGES_RECEIVED] = { "doll_ws_messages_received_total", "WebSocket messages received", METRIC_COUNTER, NULL, 0 },
+    [METRIC_WS_BYTES_RECEIVED] = { "doll_ws_bytes_received_total", "WebSocket payload bytes received", METRIC_COUNTER, NULL, 0 },
+    [METRIC_WS_MESSAGES_SENT] = { "doll_ws_messages_sent_total", "WebSocket messages sent", METRIC_COUNTER, NULL, 0 },
+    [METRIC_WS_QUEUE_CONTROL_BYTES] = { "doll_ws_queue_control_bytes", "Control messages waiting to be sent", METRIC_GAUGE, NULL, 0 },
+    [METRIC_WS_QUEUE_TEXT_BYTES] = { "doll_ws_queue_text_bytes", "Text messages waiting to be sent", METRIC_GAUGE, NULL, 0 },
+    [METRIC_WS_QUEUE_AUDIO_BYTES] = { "doll_ws_queue_audio_bytes", "Binary audio waiting to be sent", METRIC_GAUGE, NULL, 0 },
+    [METRIC_WS_QUEUE_SLOW_DOWNS] = { "doll_ws_queue_slow_downs_total", "Pushes past a lane's high water mark", METRIC_COUNTER, NULL, 0 },
+    [METRIC_WS_QUEUE_REJECTED] = { "doll_ws_queue_rejected_total", "Outbound messages refused (lane full or pool exhausted)", METRIC_COUNTER, NULL, 0 },
+    [METRIC_WS_RECONNECTS] = { "doll_ws_reconnects_total", "WebSocket connections recovered after a drop", METRIC_COUNTER, NULL, 0 },
+    [METRIC_WS_RECONNECT_MS] = { "doll_ws_reconnect_duration_ms", "Drop noticed to connection back up", HISTOGRAM(reconnect_ms_bounds) },
+    [METRIC_UPLINK_REPLAYED_BYTES] = { "doll_uplink_replayed_bytes_total", "Uplink frame bytes sent again after a reconnect", METRIC_COUNTER, NULL, 0 },
+    [METRIC_UPLINK_LOST_BYTES] = { "doll_uplink_lost_bytes_total", "Uplink frame bytes that left the replay window unsent", METRIC_COUNTER, NULL, 0 },
+    [METRIC_UPLINK_GAP_MS] = { "doll_uplink_gap_duration_ms", "Uplink down time, drop to reconnect", HISTOGRAM(gap_ms_bounds) },
+};
+
+// Counter value, gauge bits (a double) or histogram observation count
+static atomic_uint_fast64_t metric_values[METRIC_COUNT];
+static atomic_uint_fast64_t metric_sums[METRIC_COUNT];
+static atomic_uint_fast64_t metric_buckets[METRIC_COUNT][METRICS_MAX_BUCKETS];
+
+static _Atomic(metrics_collector) collector = NULL;
+static time_t last_log_time = 0;
+
+// Counters
+void metrics_add(metric_id_t id, uint64_t amount) {
+    atomic_fetch_add_explicit(&metric_values[id], amount, memory_order_relaxed);
+}
+
+// Gauges: the double travels as its bit pattern
+void metrics_set(metric_id_t id, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    atomic_store_explicit(&metric_values[id], bits, memory_order_relaxed);
+}
+
+static double gauge_value(metric_id_t id) {
+    uint64_t bits = atomic_load_explicit(&metric_values[id], memory_order_relaxed);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Histograms: one bucket (non-cumulative here), the count and the sum
+void metrics_observe(metric_id_t id, uint64_t value) {
+    const metric_desc_t *desc = &metric_descs[id];
+    for (size_t i = 0; i < desc->bound_count; i++) {
+        if (value <= desc->bounds[i]) {
+            atomic_fetch_add_explicit(&metric_buckets[id][i], 1, memory_order_relaxed);
+            break;
+        }
+    }
+    atomic_fetch_add_explicit(&metric_sums[id], value, memory_order_relaxed);
+    atomic_fetch_add_explicit(&metric_values[id], 1, memory_order_relaxed);
+}
+
+void metrics_set_collector(metrics_collector collect) {
+    atomic_store(&collector, collect);
+}
+
+static void collect(void) {
+    metrics_collector collect_fn = atomic_load(&collector);
+    if (collect_fn) {
+        collect_fn();
+    }
+}
+
+// Append to the render buffer, never past its end
+static void append(char *buffer, size_t size, size_t *length, const char *format, ...) {
+    if (*length + 1 >= size) return;
+
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(buffer + *length, size - *length, format, args);
+    va_end(args);
+
+    if (written < 0) return;
+    *length += (size_t)written < size - *length ? (size_t)written : size - *length - 1;
+}
+
+// Render everything in the Prometheus text format
+size_t metrics_render(char *buffer, size_t size) {
+    static const char *type_names[] = { "counter", "gauge", "histogram" };
+    size_t length = 0;
+
+    if (size == 0) return 0;
+    buffer[0] = '\0';
+    collect();
+
+    for (int id = 0; id < METRIC_COUNT; id++) {
+        const metric_desc_t *desc = &metric_descs[id];
+        append(buffer, size, &length, "# HELP %s %s\n# TYPE %s %s\n",
+               desc->name, desc->help, desc->name, type_names[desc->type]);
+
+        if (desc->type == METRIC_COUNTER) {
+            append(buffer, size, &length, "%s %llu\n", desc->name,
+                   (unsigned long long)atomic_load_explicit(&metric_values[id], memory_order_relaxed));
+        } else if (desc->type == METRIC_GAUGE) {
+            append(buffer, size, &length, "%s %g\n", desc->name, gauge_value(id));
+        } else {
+            // Buckets are cumulative on the wire; +Inf is the total count
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i < desc->bound_count; i++) {
+                cumulative += atomic_load_explicit(&metric_buckets[id][i], memory_order_relaxed);
+                append(buffer, size, &length, "%s_bucket{le=\"%llu\"} %llu\n", desc->name,
+                       (unsigned long long)desc->bounds[i], (unsigned long long)cumulative);
+            }
+            uint64_t count = atomic_load_explicit(&metric_values[id], memory_order_relaxed);
+            if (count < cumulative) count = cumulative;
+            append(buffer, size, &length, "%s_bucket{le=\"+Inf\"} %llu\n%s_sum %llu\n%s_count %llu\n",
+                   desc->name, (unsigned long long)count, desc->name,
+                   (unsigned long long)atomic_load_explicit(&metric_sums[id], memory_order_relaxed),
+                   desc->name, (unsigned long long)count);
+        }
+    }
+    return length;
+}
+
+static uint64_t counter(metric_id_t id) {
+    return atomic_load_explicit(&metric_values[id], memory_order_relaxed);
+}
+
+// One line with what matters when watching a fleet: xruns, losses and load
+void metrics_log_line(void) {
+    collect();
+    printf("📊 Metrics: %llu periods, %llu/%llu output underflows/overflows, %llu/%llu input underflows/overflows, "
+           "cpu %.1f%%, capture overrun %llu B, uplink %llu B (%llu failures), downlink %llu B (%llu dropped), "
+           "%llu jitter underruns, %llu barge-ins\n",
+           (unsigned long long)counter(METRIC_AUDIO_CALLBACKS),
+           (unsigned long long)counter(METRIC_AUDIO_OUTPUT_UNDERFLOWS),
+           (unsigned long long)counter(METRIC_AUDIO_OUTPUT_OVERFLOWS),
+           (unsigned long long)counter(METRIC_AUDIO_INPUT_UNDERFLOWS),
+           (unsigned long long)counter(METRIC_AUDIO_INPUT_OVERFLOWS),
+           gauge_value(METRIC_AUDIO_CPU_LOAD) * 100.0,
+           (unsigned long long)counter(METRIC_CAPTURE_OVERRUN_BYTES),
+           (unsigned long long)counter(METRIC_UPLINK_BYTES_SENT),
+           (unsigned long long)counter(METRIC_UPLINK_SEND_FAILURES),
+           (unsigned long long)counter(METRIC_DOWNLINK_BYTES_RECEIVED),
+           (unsigned long long)counter(METRIC_DOWNLINK_BYTES_DROPPED),
+           (unsigned long long)counter(METRIC_JITTER_UNDERRUNS),
+           (unsigned long long)counter(METRIC_BARGE_INS));
+}
+
+// Periodic stats line
+void metrics_poll(void) {
+    if (METRICS_LOG_INTERVAL_S <= 0) return;
+
+    time_t now = time(NULL);
+    if (last_log_time == 0) {
+        last_log_time = now;
+    } else if (now - last_log_time >= METRICS_LOG_INTERVAL_S) {
+        last_log_time = now;
+        metrics_log_line();
+    }
+}
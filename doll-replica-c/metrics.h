@@ -0,0 +1,82 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Metrics configuration
+#define METRICS_HTTP_PORT 9464          // Local Prometheus listener (127.0.0.1 only), 0 disables it
+#define METRICS_LOG_INTERVAL_S 30       // Periodic stats line, 0 disables it
+#define METRICS_MAX_BUCKETS 12          // Histogram buckets, +Inf excluded
+#define METRICS_RENDER_MAX 16384        // Prometheus text for all metrics
+
+typedef enum {
+    METRIC_COUNTER = 0,
+    METRIC_GAUGE,
+    METRIC_HISTOGRAM,
+} metric_type_t;
+
+// Every metric the client exports. Updates are single atomic operations, so
+// they are safe from the audio callback and every other hot path.
+typedef enum {
+    // Audio device (duplex callback)
+    METRIC_AUDIO_CALLBACKS = 0,
+    METRIC_AUDIO_OUTPUT_UNDERFLOWS,
+    METRIC_AUDIO_OUTPUT_OVERFLOWS,
+    METRIC_AUDIO_INPUT_UNDERFLOWS,
+    METRIC_AUDIO_INPUT_OVERFLOWS,
+    METRIC_AUDIO_CALLBACK_US,
+    METRIC_AUDIO_CPU_LOAD,
+
+    // Uplink
+    METRIC_CAPTURE_OVERRUN_BYTES,
+    METRIC_CAPTURE_QUEUE_BYTES,
+    METRIC_UPLINK_BYTES_SENT,
+    METRIC_UPLINK_SEND_FAILURES,
+
+    // Downlink and playback
+    METRIC_DOWNLINK_BYTES_RECEIVED,
+    METRIC_DOWNLINK_BYTES_DROPPED,
+    METRIC_DOWNLINK_DECODE_ERRORS,
+    METRIC_DOWNLINK_QUEUE_BYTES,
+    METRIC_JITTER_UNDERRUNS,
+    METRIC_JITTER_DEPTH_MS,
+    METRIC_FIRST_SAMPLE_MS,
+    METRIC_BARGE_INS,
+
+    // WebSocket
+    METRIC_WS_MESSAGES_RECEIVED,
+    METRIC_WS_BYTES_RECEIVED,
+    METRIC_WS_MESSAGES_SENT,
+    METRIC_WS_QUEUE_CONTROL_BYTES,
+    METRIC_WS_QUEUE_TEXT_BYTES,
+    METRIC_WS_QUEUE_AUDIO_BYTES,
+    METRIC_WS_QUEUE_SLOW_DOWNS,
+    METRIC_WS_QUEUE_REJECTED,
+    METRIC_WS_RECONNECTS,
+    METRIC_WS_RECONNECT_MS,
+    METRIC_UPLINK_REPLAYED_BYTES,
+    METRIC_UPLINK_LOST_BYTES,
+    METRIC_UPLINK_GAP_MS,
+
+    METRIC_COUNT
+} metric_id_t;
+
+// Hot path updates
+void metrics_add(metric_id_t id, uint64_t amount);       // Counters
+void metrics_set(metric_id_t id, double value);          // Gauges
+void metrics_observe(metric_id_t id, uint64_t value);    // Histograms
+
+// Gauges that are sampled rather than pushed: the collector runs (on the
+// caller's thread) before the metrics are rendered or logged
+typedef void (*metrics_collector)(void);
+void metrics_set_collector(metrics_collector collect);
+
+// Prometheus text exposition format; returns the length written (truncated to size - 1)
+size_t metrics_render(char *buffer, size_t size);
+
+// Print the periodic stats line when METRICS_LOG_INTERVAL_S has passed (main loop)
+void metrics_poll(void);
+void metrics_log_line(void);
+
+#endif // METRICS_H
@@ -0,0 +1,99 @@
+#include "metrics_server.h"
+#include "metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// One scrape: the body is rendered when the request arrives and written once writable
+typedef struct {
+    unsigned char *body;    // LWS_PRE bytes of headroom, then the text
+    size_t length;
+} metrics_session_t;
+
+static int metrics_http_callback(struct lws *wsi, enum lws_callback_reasons reason,
+                                 void *user, void *in, size_t len) {
+    metrics_session_t *session = (metrics_session_t *)user;
+    (void)len;
+
+    switch (reason) {
+        case LWS_CALLBACK_HTTP: {
+            if (strcmp((const char *)in, "/metrics") != 0) {
+                lws_return_http_status(wsi, HTTP_STATUS_NOT_FOUND, NULL);
+                return -1;
+            }
+
+            session->body = malloc(LWS_PRE + METRICS_RENDER_MAX);
+            if (!session->body) return -1;
+            session->length = metrics_render((char *)session->body + LWS_PRE, METRICS_RENDER_MAX);
+
+            unsigned char headers[LWS_PRE + 256];
+            unsigned char *start = &headers[LWS_PRE], *p = start, *end = &headers[sizeof(headers) - 1];
+            if (lws_add_http_common_headers(wsi, HTTP_STATUS_OK, "text/plain; version=0.0.4",
+                                            (int64_t)session->length, &p, end) ||
+                lws_finalize_write_http_header(wsi, start, &p, end)) {
+                return 1;
+            }
+
+            lws_callback_on_writable(wsi);
+            return 0;
+        }
+
+        case LWS_CALLBACK_HTTP_WRITEABLE: {
+            if (!session->body) break;
+
+            int written = lws_write(wsi, session->body + LWS_PRE, session->length, LWS_WRITE_HTTP_FINAL);
+            free(session->body);
+            session->body = NULL;
+            if (written < 0 || lws_http_transaction_completed(wsi)) {
+                return -1;
+            }
+            return 0;
+        }
+
+        case LWS_CALLBACK_CLOSED_HTTP:
+            free(session->body);
+            session->body = NULL;
+            break;
+
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+static struct lws_protocols metrics_protocols[] = {
+    {
+        "http",                     // Default HTTP protocol of the vhost
+        metrics_http_callback,
+        sizeof(metrics_session_t),
+        0,
+        0, NULL, 0
+    },
+    { NULL, NULL, 0, 0, 0, NULL, 0 }  // Terminator
+};
+
+// Add the listening vhost to the client context
+int metrics_server_start(struct lws_context *context) {
+    if (METRICS_HTTP_PORT <= 0) {
+        return 1; // Disabled
+    }
+
+    struct lws_context_creation_info info;
+    memset(&info, 0, sizeof(info));
+
+    info.port = METRICS_HTTP_PORT;
+    info.iface = "127.0.0.1";      // Scraped locally (or through an agent), never exposed
+    info.protocols = metrics_protocols;
+    info.vhost_name = "metrics";
+    info.gid = -1;
+    info.uid = -1;
+
+    if (!lws_create_vhost(context, &info)) {
+        printf("⚠️  Failed to start metrics listener on port %d\n", METRICS_HTTP_PORT);
+        return 0;
+    }
+
+    printf("📈 Metrics at http://127.0.0.1:%d/metrics\n", METRICS_HTTP_PORT);
+    return 1;
+}
@@ -0,0 +1,10 @@
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+#include <libwebsockets.h>
+
+// Serve GET /metrics (Prometheus text) on 127.0.0.1:METRICS_HTTP_PORT from the
+// client's own lws context, so requests are handled in the existing service loop
+int metrics_server_start(struct lws_context *context);
+
+#endif // METRICS_SERVER_H
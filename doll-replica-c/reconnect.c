@@ -0,0 +1,50 @@
+#include "reconnect.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+// xorshift32: jitter only needs to differ between devices, not be unpredictable
+static uint32_t next_random(uint32_t *seed) {
+    uint32_t x = *seed ? *seed : 0x9E3779B9u;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *seed = x;
+    return x;
+}
+
+unsigned int reconnect_delay_ms(unsigned int attempt, uint32_t *seed) {
+    if (attempt == 0) {
+        return 0;
+    }
+
+    unsigned int ceiling = RECONNECT_MAX_MS;
+    if (attempt - 1 < 16 && (RECONNECT_BASE_MS << (attempt - 1)) < RECONNECT_MAX_MS) {
+        ceiling = RECONNECT_BASE_MS << (attempt - 1);
+    }
+    return ceiling / 2 + next_random(seed) % (ceiling / 2 + 1);
+}
+
+int reconnect_resolve(const char *host, int port, char *address, size_t size) {
+    struct addrinfo hints;
+    struct addrinfo *result = NULL;
+    char service[8];
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(service, sizeof(service), "%d", port);
+
+    if (getaddrinfo(host, service, &hints, &result) != 0 || !result) {
+        return 0;
+    }
+
+    // The first answer is the one the system prefers
+    int ok = getnameinfo(result->ai_addr, result->ai_addrlen, address, (socklen_t)size,
+                         NULL, 0, NI_NUMERICHOST) == 0;
+    freeaddrinfo(result);
+    return ok;
+}
@@ -0,0 +1,41 @@
+#ifndef RECONNECT_H
+#define RECONNECT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Reconnect configuration
+#define RECONNECT_BASE_MS 25            // Second attempt; the first one after a drop goes out at once
+#define RECONNECT_MAX_MS 2000           // Backoff ceiling, which bounds recovery once the link is back
+#define RECONNECT_ADDRESS_MAX 64        // Numeric IPv4 or IPv6 address
+#define RECONNECT_RESOLVE_AFTER 3       // Failed attempts in a row before the address is looked up again
+#define RECONNECT_BENCH_ROUNDS 20       // Drops per "reconnect-bench" run
+#define RECONNECT_BENCH_SETTLE_MS 250   // Connected time between two drops
+#define RECONNECT_TARGET_MS 200
+
+// Session resumption: the handshake answer carries a token, which goes back on the
+// next handshake; the server answers with x-resumed: 1 if it picked the session up.
+// Off, every reconnect is a new session.
+#define RESUME_ENABLED 1
+#define RESUME_TOKEN_MAX 128
+#define RESUME_TOKEN_HEADER "x-resume-token:"
+#define RESUMED_HEADER "x-resumed:"
+
+typedef enum {
+    RECONNECT_IDLE = 0,             // Never connected
+    RECONNECT_CONNECTING,           // Handshake in progress
+    RECONNECT_CONNECTED,
+    RECONNECT_WAITING,              // Backing off before the next attempt
+    RECONNECT_STOPPED,              // Shutting down: a close is final
+} reconnect_state_t;
+
+// Delay before retry number attempt (0 is the first after a drop): none, then
+// RECONNECT_BASE_MS doubling up to RECONNECT_MAX_MS, half of it random so a
+// fleet that lost the same access point does not come back in lockstep
+unsigned int reconnect_delay_ms(unsigned int attempt, uint32_t *seed);
+
+// Look host up once, as a numeric address lws can connect to without DNS.
+// Returns 0 if it does not resolve.
+int reconnect_resolve(const char *host, int port, char *address, size_t size);
+
+#endif // RECONNECT_H
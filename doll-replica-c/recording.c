@@ -0,0 +1,157 @@
+#include "recording.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// Create an empty recording (nothing is allocated until audio arrives)
+recording_t* recording_create(void) {
+    recording_t *recording = calloc(1, sizeof(recording_t));
+    if (!recording) {
+        printf("❌ Failed to allocate recording\n");
+        return NULL;
+    }
+
+    atomic_init(&recording->refcount, 1);
+    recording->spill_fd = -1;
+    return recording;
+}
+
+// Take another reference
+recording_t* recording_retain(recording_t *recording) {
+    if (recording) {
+        atomic_fetch_add_explicit(&recording->refcount, 1, memory_order_relaxed);
+    }
+    return recording;
+}
+
+// Drop a reference, freeing every segment with the last one
+void recording_release(recording_t *recording) {
+    if (!recording) return;
+
+    if (atomic_fetch_sub_explicit(&recording->refcount, 1, memory_order_acq_rel) != 1) {
+        return;
+    }
+
+    recording_segment_t *segment = recording->head;
+    while (segment) {
+        recording_segment_t *next = segment->next;
+        if (segment->spilled) {
+            munmap(segment->data, RECORDING_SEGMENT_SIZE);
+        } else {
+            free(segment->data);
+        }
+        free(segment);
+        segment = next;
+    }
+
+    if (recording->spill_fd >= 0) {
+        close(recording->spill_fd);
+    }
+    free(recording);
+}
+
+// Map one more segment from the spill file, creating it on first use
+static unsigned char* map_spill_segment(recording_t *recording) {
+    if (recording->spill_fd < 0) {
+        char path[] = RECORDING_SPILL_TEMPLATE;
+        recording->spill_fd = mkstemp(path);
+        if (recording->spill_fd < 0) {
+            printf("❌ Failed to create recording spill file\n");
+            return NULL;
+        }
+        // Keep only the descriptor: the file disappears with the last reference
+        unlink(path);
+        printf("💾 Recording exceeds %d KB, spilling to disk\n", RECORDING_RAM_CAP / 1024);
+    }
+
+    if (ftruncate(recording->spill_fd, recording->spill_size + RECORDING_SEGMENT_SIZE) != 0) {
+        printf("❌ Failed to grow recording spill file\n");
+        return NULL;
+    }
+
+    void *data = mmap(NULL, RECORDING_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      recording->spill_fd, (off_t)recording->spill_size);
+    if (data == MAP_FAILED) {
+        printf("❌ Failed to map recording spill segment\n");
+        return NULL;
+    }
+
+    recording->spill_size += RECORDING_SEGMENT_SIZE;
+    return data;
+}
+
+// Add a segment to the end of the chain
+static recording_segment_t* grow_recording(recording_t *recording) {
+    recording_segment_t *segment = calloc(1, sizeof(recording_segment_t));
+    if (!segment) return NULL;
+
+    if (recording->ram_bytes + RECORDING_SEGMENT_SIZE <= RECORDING_RAM_CAP) {
+        segment->data = malloc(RECORDING_SEGMENT_SIZE);
+        recording->ram_bytes += RECORDING_SEGMENT_SIZE;
+    } else {
+        segment->data = map_spill_segment(recording);
+        segment->spilled = 1;
+    }
+
+    if (!segment->data) {
+        free(segment);
+        return NULL;
+    }
+
+    if (recording->tail) {
+        recording->tail->next = segment;
+    } else {
+        recording->head = segment;
+    }
+    recording->tail = segment;
+    recording->segment_count++;
+    return segment;
+}
+
+// Append captured audio
+int recording_append(recording_t *recording, const unsigned char *data, size_t size) {
+    if (!recording || !data) return 0;
+
+    while (size > 0) {
+        recording_segment_t *segment = recording->tail;
+        if (!segment || segment->used == RECORDING_SEGMENT_SIZE) {
+            segment = grow_recording(recording);
+            if (!segment) {
+                printf("❌ Failed to grow recording buffer\n");
+                return 0;
+            }
+        }
+
+        size_t space = RECORDING_SEGMENT_SIZE - segment->used;
+        size_t bytes = size < space ? size : space;
+        memcpy(segment->data + segment->used, data, bytes);
+        segment->used += bytes;
+        recording->total_size += bytes;
+        data += bytes;
+        size -= bytes;
+    }
+
+    return 1;
+}
+
+// Total recorded bytes
+size_t recording_size(const recording_t *recording) {
+    return recording ? recording->total_size : 0;
+}
+
+// Describe the segments for writev()
+int recording_to_iovec(const recording_t *recording, struct iovec *iov, int max_iov) {
+    int count = 0;
+
+    for (recording_segment_t *segment = recording ? recording->head : NULL;
+         segment && count < max_iov; segment = segment->next) {
+        if (segment->used == 0) continue;
+        iov[count].iov_base = segment->data;
+        iov[count].iov_len = segment->used;
+        count++;
+    }
+
+    return count;
+}
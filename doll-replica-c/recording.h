@@ -0,0 +1,47 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+#include <sys/uio.h>
+
+// Recording buffer configuration
+#define RECORDING_SEGMENT_SIZE (16 * 1024)  // Multiple of the page size so segments can be mapped
+#define RECORDING_RAM_CAP (256 * 1024)      // Segments past this live in the spill file
+#define RECORDING_SPILL_TEMPLATE "/tmp/doll-recording-XXXXXX"
+
+// One fixed-size piece of a recording, either heap or spill-file backed
+typedef struct recording_segment {
+    struct recording_segment *next;
+    unsigned char *data;
+    size_t used;
+    int spilled;
+} recording_segment_t;
+
+// Recorded utterance: a lazily grown chain of segments shared by reference.
+// Only one thread appends; readers take a reference once appending is done.
+typedef struct {
+    atomic_int refcount;
+    recording_segment_t *head;
+    recording_segment_t *tail;
+    size_t total_size;
+    size_t segment_count;
+    size_t ram_bytes;
+    int spill_fd;
+    size_t spill_size;
+} recording_t;
+
+// Recording functions
+recording_t* recording_create(void);
+recording_t* recording_retain(recording_t *recording);
+void recording_release(recording_t *recording);
+
+// Append captured audio, growing by one segment at a time
+int recording_append(recording_t *recording, const unsigned char *data, size_t size);
+
+size_t recording_size(const recording_t *recording);
+
+// Describe the segments for vectored I/O; returns the number of entries filled
+int recording_to_iovec(const recording_t *recording, struct iovec *iov, int max_iov);
+
+#endif // RECORDING_H
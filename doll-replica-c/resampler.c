@@ -0,0 +1,260 @@
+#include "resampler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RESAMPLER_X86 1
+#include <immintrin.h>
+#endif
+
+#define RESAMPLER_PASSBAND 0.9  // Fraction of the lower Nyquist kept before the cutoff
+
+static unsigned int gcd(unsigned int a, unsigned int b) {
+    while (b) {
+        unsigned int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// ============================================================================
+// DOT PRODUCT KERNELS (n is always a multiple of 16)
+// ============================================================================
+
+static int32_t dot_scalar(const int16_t *a, const int16_t *b, size_t n) {
+    int32_t sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        sum += (int32_t)a[i] * b[i];
+    }
+    return sum;
+}
+
+#ifdef RESAMPLER_X86
+
+__attribute__((target("sse2")))
+static int32_t dot_sse2(const int16_t *a, const int16_t *b, size_t n) {
+    __m128i sum = _mm_setzero_si128();
+    for (size_t i = 0; i < n; i += 8) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(va, vb));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+}
+
+__attribute__((target("avx2")))
+static int32_t dot_avx2(const int16_t *a, const int16_t *b, size_t n) {
+    __m256i sum = _mm256_setzero_si256();
+    for (size_t i = 0; i < n; i += 16) {
+        __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(va, vb));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(half);
+}
+
+#endif // RESAMPLER_X86
+
+// ============================================================================
+// FILTER DESIGN
+// ============================================================================
+
+// Blackman-windowed sinc prototype at rows times the input rate, split into phases.
+// Each phase is normalized to unity DC gain so interpolation keeps the level.
+static int design_filter(Resampler *rs) {
+    size_t length = (size_t)rs->rows * rs->taps;
+    double cutoff = RESAMPLER_PASSBAND * 0.5 / rs->rows;
+    if (rs->down > rs->up) {
+        cutoff *= (double)rs->up / rs->down;
+    }
+    double *prototype = malloc(length * sizeof(double));
+    if (!prototype) return 0;
+
+    for (size_t k = 0; k < length; k++) {
+        double x = (double)k - (length - 1) / 2.0;
+        double sinc = x == 0.0 ? 1.0 : sin(2.0 * M_PI * cutoff * x) / (2.0 * M_PI * cutoff * x);
+        double window = 0.42 - 0.5 * cos(2.0 * M_PI * k / (length - 1))
+                             + 0.08 * cos(4.0 * M_PI * k / (length - 1));
+        prototype[k] = sinc * window;
+    }
+
+    // Row rows is past the prototype's end by one tap: phase 0, one sample on
+    for (unsigned int p = 0; p <= rs->rows; p++) {
+        double sum = 0.0;
+        for (unsigned int t = 0; t < rs->taps; t++) {
+            size_t k = p + (size_t)t * rs->rows;
+            sum += k < length ? prototype[k] : 0.0;
+        }
+
+        // Reversed so the window is walked forwards in time by the dot product
+        for (unsigned int t = 0; t < rs->taps; t++) {
+            size_t k = p + (size_t)(rs->taps - 1 - t) * rs->rows;
+            double c = k < length ? prototype[k] / sum : 0.0;
+            rs->coefs[(size_t)p * rs->taps + t] = (int16_t)lrint(c * 32767.0);
+        }
+    }
+
+    free(prototype);
+    return 1;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+// Create a resampler for in_rate -> out_rate
+Resampler* resampler_create(unsigned int in_rate, unsigned int out_rate) {
+    if (in_rate == 0 || out_rate == 0) {
+        printf("❌ Invalid resampler rates %u -> %u\n", in_rate, out_rate);
+        return NULL;
+    }
+
+    Resampler *rs = calloc(1, sizeof(Resampler));
+    if (!rs) {
+        printf("❌ Failed to allocate resampler\n");
+        return NULL;
+    }
+
+    unsigned int divisor = gcd(in_rate, out_rate);
+    rs->in_rate = in_rate;
+    rs->out_rate = out_rate;
+    rs->up = out_rate / divisor;
+    rs->down = in_rate / divisor;
+
+    if (resampler_is_passthrough(rs)) {
+        return rs;
+    }
+
+    // A finer ratio than the table holds blends its phases from neighbouring rows
+    rs->rows = rs->up > RESAMPLER_MAX_PHASES ? RESAMPLER_MAX_PHASES : rs->up;
+
+    // Decimation lowers the cutoff, so widen the filter to keep the transition sharp
+    unsigned int widen = (rs->down + rs->up - 1) / rs->up;
+    rs->taps = RESAMPLER_TAPS * widen;
+    if (rs->taps > RESAMPLER_MAX_TAPS) rs->taps = RESAMPLER_MAX_TAPS;
+
+    rs->coefs = malloc((size_t)(rs->rows + 1) * rs->taps * sizeof(int16_t));
+    rs->history = malloc((rs->taps - 1 + RESAMPLER_BLOCK) * sizeof(int16_t));
+    if (rs->rows < rs->up) {
+        rs->blend = malloc(rs->taps * sizeof(int16_t));
+    }
+    if (!rs->coefs || !rs->history || (rs->rows < rs->up && !rs->blend) || !design_filter(rs)) {
+        printf("❌ Failed to allocate resampler filter\n");
+        resampler_destroy(rs);
+        return NULL;
+    }
+
+    rs->dot = dot_scalar;
+#ifdef RESAMPLER_X86
+    if (__builtin_cpu_supports("avx2")) {
+        rs->dot = dot_avx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        rs->dot = dot_sse2;
+    }
+#endif
+
+    resampler_reset(rs);
+    printf("✅ Resampler %u -> %u Hz (%u/%u, %u taps x %u phases%s)\n",
+           in_rate, out_rate, rs->up, rs->down, rs->taps, rs->rows,
+           rs->rows < rs->up ? ", interpolated" : "");
+    return rs;
+}
+
+// Destroy a resampler
+void resampler_destroy(Resampler *rs) {
+    if (!rs) return;
+
+    free(rs->coefs);
+    free(rs->history);
+    free(rs->blend);
+    free(rs);
+}
+
+// Drop carried input, e.g. between utterances
+void resampler_reset(Resampler *rs) {
+    if (!rs || resampler_is_passthrough(rs)) return;
+
+    // Start with a window of silence so the first input lands on the first output
+    memset(rs->history, 0, (rs->taps - 1) * sizeof(int16_t));
+    rs->history_fill = rs->taps - 1;
+    rs->position = 0;
+    rs->phase = 0;
+}
+
+int resampler_is_passthrough(const Resampler *rs) {
+    return rs->up == rs->down;
+}
+
+size_t resampler_max_output(const Resampler *rs, size_t in_count) {
+    if (resampler_is_passthrough(rs)) return in_count;
+    return (in_count + rs->taps) * rs->up / rs->down + 1;
+}
+
+// Coefficients of one phase: a table row, or a blend of the two rows around it
+static const int16_t* phase_coefs(Resampler *rs) {
+    if (rs->rows == rs->up) {
+        return rs->coefs + (size_t)rs->phase * rs->taps;
+    }
+
+    uint64_t scaled = (uint64_t)rs->phase * rs->rows;
+    const int16_t *lo = rs->coefs + (size_t)(scaled / rs->up) * rs->taps;
+    const int16_t *hi = lo + rs->taps;
+    int32_t frac = (int32_t)((scaled % rs->up) * 32768 / rs->up);     // Q15
+    for (unsigned int t = 0; t < rs->taps; t++) {
+        rs->blend[t] = (int16_t)(lo[t] + (((hi[t] - lo[t]) * frac + (1 << 14)) >> 15));
+    }
+    return rs->blend;
+}
+
+// Convert a block of samples
+size_t resampler_process(Resampler *rs, const int16_t *in, size_t in_count, int16_t *out) {
+    if (resampler_is_passthrough(rs)) {
+        memcpy(out, in, in_count * sizeof(int16_t));
+        return in_count;
+    }
+
+    size_t capacity = rs->taps - 1 + RESAMPLER_BLOCK;
+    size_t produced = 0;
+
+    while (in_count > 0) {
+        size_t n = capacity - rs->history_fill;
+        if (n > in_count) n = in_count;
+        memcpy(rs->history + rs->history_fill, in, n * sizeof(int16_t));
+        rs->history_fill += n;
+        in += n;
+        in_count -= n;
+
+        while (rs->position + rs->taps <= rs->history_fill) {
+            int32_t acc = rs->dot(rs->history + rs->position, phase_coefs(rs), rs->taps);
+            acc = (acc + (1 << 14)) >> 15;
+            if (acc > INT16_MAX) acc = INT16_MAX;
+            if (acc < INT16_MIN) acc = INT16_MIN;
+            out[produced++] = (int16_t)acc;
+
+            rs->phase += rs->down;
+            rs->position += rs->phase / rs->up;
+            rs->phase %= rs->up;
+        }
+
+        // Keep the partial window; when decimating the next one may start past the end
+        if (rs->position >= rs->history_fill) {
+            rs->position -= rs->history_fill;
+            rs->history_fill = 0;
+        } else {
+            memmove(rs->history, rs->history + rs->position,
+                    (rs->history_fill - rs->position) * sizeof(int16_t));
+            rs->history_fill -= rs->position;
+            rs->position = 0;
+        }
+    }
+
+    return produced;
+}
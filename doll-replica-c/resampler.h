@@ -0,0 +1,54 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Resampler configuration
+#define RESAMPLER_TAPS 16           // Taps per phase when not decimating
+#define RESAMPLER_MAX_TAPS 128      // Decimation widens the filter up to this
+#define RESAMPLER_MAX_PHASES 512    // Filter table rows; a finer ratio interpolates between them
+#define RESAMPLER_BLOCK 1024        // Input samples staged per pass
+
+// Streaming polyphase FIR resampler for mono 16-bit PCM.
+// The ratio out/in is reduced to L/M; output sample m uses filter phase
+// (m * M) % L over the input window ending at (m * M) / L. Coefficients are
+// Q15 so the inner product runs on pmaddwd (SSE2 / AVX2). When L is over
+// RESAMPLER_MAX_PHASES (11025 -> 16000 is 640/441) the table keeps that many
+// rows and each phase is blended from the two rows around it, so the output
+// rate stays exact.
+typedef struct {
+    unsigned int in_rate;
+    unsigned int out_rate;
+    unsigned int up;            // L
+    unsigned int down;          // M
+    unsigned int taps;          // Per phase, multiple of 16
+    unsigned int rows;          // Filter table phases: up, or RESAMPLER_MAX_PHASES
+    int16_t *coefs;             // (rows + 1) * taps, phase-major, time-reversed;
+                                // the last row is phase 0 one input sample later
+    int16_t *blend;             // taps, the phase being built when rows < up
+    int32_t (*dot)(const int16_t *a, const int16_t *b, size_t n);
+
+    // Streaming state: the last taps - 1 inputs are carried between calls
+    int16_t *history;           // taps - 1 + RESAMPLER_BLOCK
+    size_t history_fill;
+    size_t position;            // Index of the next window start in history
+    unsigned int phase;
+} Resampler;
+
+// Resampler functions
+Resampler* resampler_create(unsigned int in_rate, unsigned int out_rate);
+void resampler_destroy(Resampler *rs);
+void resampler_reset(Resampler *rs);
+
+// True when in and out rates match (process is then a plain copy)
+int resampler_is_passthrough(const Resampler *rs);
+
+// Upper bound on the output produced by one call with in_count samples
+size_t resampler_max_output(const Resampler *rs, size_t in_count);
+
+// Convert in_count samples; returns how many were written to out, which must
+// hold resampler_max_output(in_count)
+size_t resampler_process(Resampler *rs, const int16_t *in, size_t in_count, int16_t *out);
+
+#endif // RESAMPLER_H
@@ -0,0 +1,123 @@
+#include "ring_buffer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Round up to the next power of two so indices can be masked
+static size_t round_up_pow2(size_t value) {
+    size_t size = 1;
+    while (size < value) {
+        size <<= 1;
+    }
+    return size;
+}
+
+// Initialize ring buffer
+AudioRingBuffer* init_audio_ring_buffer(size_t min_size) {
+    AudioRingBuffer *rb = NULL;
+
+    // Keep the structure itself cache-line aligned so head and tail never share a line
+    if (posix_memalign((void **)&rb, RING_BUFFER_CACHE_LINE, sizeof(AudioRingBuffer)) != 0) {
+        printf("❌ Failed to allocate ring buffer structure\n");
+        return NULL;
+    }
+
+    rb->size = round_up_pow2(min_size);
+    rb->mask = rb->size - 1;
+    rb->buffer = malloc(rb->size);
+    if (!rb->buffer) {
+        printf("❌ Failed to allocate ring buffer memory\n");
+        free(rb);
+        return NULL;
+    }
+
+    atomic_init(&rb->head, 0);
+    atomic_init(&rb->tail, 0);
+
+    printf("✅ Ring buffer initialized (%zu bytes)\n", rb->size);
+    return rb;
+}
+
+// Cleanup ring buffer (both sides must have stopped using it)
+void cleanup_audio_ring_buffer(AudioRingBuffer *rb) {
+    if (!rb) return;
+
+    free(rb->buffer);
+    free(rb);
+}
+
+// Write to ring buffer - never blocks, drops what does not fit
+size_t write_audio_buffer(AudioRingBuffer *rb, const unsigned char *data, size_t size) {
+    if (!rb || !data || size == 0) return 0;
+
+    size_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+    size_t space = rb->size - (head - tail);
+    if (size > space) size = space;
+    if (size == 0) return 0;
+
+    size_t offset = head & rb->mask;
+    size_t first_chunk = rb->size - offset;
+    if (first_chunk > size) first_chunk = size;
+
+    memcpy(rb->buffer + offset, data, first_chunk);
+    if (first_chunk < size) {
+        memcpy(rb->buffer, data + first_chunk, size - first_chunk);
+    }
+
+    // Publish the data before the new head becomes visible to the consumer
+    atomic_store_explicit(&rb->head, head + size, memory_order_release);
+    return size;
+}
+
+// Read from ring buffer - never blocks, returns a short count on underrun
+size_t read_audio_buffer(AudioRingBuffer *rb, unsigned char *data, size_t size) {
+    if (!rb || !data || size == 0) return 0;
+
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+    size_t available = head - tail;
+    if (size > available) size = available;
+    if (size == 0) return 0;
+
+    size_t offset = tail & rb->mask;
+    size_t first_chunk = rb->size - offset;
+    if (first_chunk > size) first_chunk = size;
+
+    memcpy(data, rb->buffer + offset, first_chunk);
+    if (first_chunk < size) {
+        memcpy(data + first_chunk, rb->buffer, size - first_chunk);
+    }
+
+    // Hand the space back to the producer only after the copy is done
+    atomic_store_explicit(&rb->tail, tail + size, memory_order_release);
+    return size;
+}
+
+// Discard everything queued - moves tail up to head without touching the data
+size_t discard_audio_buffer(AudioRingBuffer *rb) {
+    if (!rb) return 0;
+
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+
+    atomic_store_explicit(&rb->tail, head, memory_order_release);
+    return head - tail;
+}
+
+// Bytes currently queued
+size_t audio_ring_buffer_used(AudioRingBuffer *rb) {
+    if (!rb) return 0;
+
+    // Load tail first: it can never overtake a head loaded after it
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+    size_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+    return head - tail;
+}
+
+// Bytes that can be written without dropping
+size_t audio_ring_buffer_free(AudioRingBuffer *rb) {
+    if (!rb) return 0;
+
+    return rb->size - audio_ring_buffer_used(rb);
+}
@@ -0,0 +1,38 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+#define RING_BUFFER_CACHE_LINE 64
+
+// Wait-free single-producer/single-consumer byte ring.
+// head is only advanced by the producer and tail only by the consumer, so
+// neither side ever takes a lock or waits. Both indices run freely and are
+// masked on access, which is why the capacity is always a power of two.
+typedef struct {
+    _Alignas(RING_BUFFER_CACHE_LINE) atomic_size_t head;  // Producer write index
+    _Alignas(RING_BUFFER_CACHE_LINE) atomic_size_t tail;  // Consumer read index
+    _Alignas(RING_BUFFER_CACHE_LINE) unsigned char *buffer;
+    size_t size;
+    size_t mask;
+} AudioRingBuffer;
+
+// Ring buffer functions
+AudioRingBuffer* init_audio_ring_buffer(size_t min_size);
+void cleanup_audio_ring_buffer(AudioRingBuffer *rb);
+
+// Producer side: copies as much as fits and returns the number of bytes written
+size_t write_audio_buffer(AudioRingBuffer *rb, const unsigned char *data, size_t size);
+
+// Consumer side: copies what is available and returns the number of bytes read
+size_t read_audio_buffer(AudioRingBuffer *rb, unsigned char *data, size_t size);
+
+// Consumer side: drops everything queued in O(1) and returns the number of bytes dropped
+size_t discard_audio_buffer(AudioRingBuffer *rb);
+
+// Occupancy (exact for the calling side, a snapshot for the other one)
+size_t audio_ring_buffer_used(AudioRingBuffer *rb);
+size_t audio_ring_buffer_free(AudioRingBuffer *rb);
+
+#endif // RING_BUFFER_H
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "resampler.h"
+
+#define TEST_SECONDS 1
+#define TEST_TONE_HZ 440.0
+#define TEST_AMPLITUDE 10000.0
+#define TEST_CHUNK 147          // Odd block size so the streaming state is exercised
+
+// Rates the device, the network and TTS clips meet at
+static const unsigned int rate_pairs[][2] = {
+    { 16000, 8000 }, { 8000, 16000 }, { 24000, 16000 }, { 48000, 16000 }, { 44100, 16000 },
+    { 22050, 16000 }, { 11025, 16000 }, { 22050, 8000 }, { 11025, 8000 }, { 16000, 22050 },
+    { 16000, 11025 },
+};
+
+// Run a tone through one rate pair, in one call and in chunks; returns 1 if it passes
+static int test_pair(unsigned int in_rate, unsigned int out_rate) {
+    size_t in_count = (size_t)in_rate * TEST_SECONDS;
+    int16_t *in = malloc(in_count * sizeof(int16_t));
+    for (size_t i = 0; i < in_count; i++) {
+        in[i] = (int16_t)lrint(TEST_AMPLITUDE * sin(2.0 * M_PI * TEST_TONE_HZ * i / in_rate));
+    }
+
+    Resampler *whole = resampler_create(in_rate, out_rate);
+    Resampler *chunked = resampler_create(in_rate, out_rate);
+    if (!whole || !chunked) {
+        printf("❌ %u -> %u Hz: resampler_create failed\n", in_rate, out_rate);
+        free(in);
+        resampler_destroy(whole);
+        resampler_destroy(chunked);
+        return 0;
+    }
+
+    int16_t *out = malloc(resampler_max_output(whole, in_count) * sizeof(int16_t));
+    int16_t *out_chunked = malloc(resampler_max_output(whole, in_count) * sizeof(int16_t));
+    size_t produced = resampler_process(whole, in, in_count, out);
+    size_t produced_chunked = 0;
+    for (size_t i = 0; i < in_count; i += TEST_CHUNK) {
+        size_t n = in_count - i < TEST_CHUNK ? in_count - i : TEST_CHUNK;
+        produced_chunked += resampler_process(chunked, in + i, n, out_chunked + produced_chunked);
+    }
+
+    // Level and pitch over the settled middle: RMS against the tone's, and zero crossings
+    size_t skip = produced / 10;
+    double energy = 0.0;
+    unsigned int crossings = 0;
+    for (size_t i = skip; i < produced - skip; i++) {
+        energy += (double)out[i] * out[i];
+        if (i > skip && (out[i - 1] < 0) != (out[i] < 0)) {
+            crossings++;
+        }
+    }
+    size_t span = produced - 2 * skip;
+    double rms_ratio = sqrt(energy / span) / (TEST_AMPLITUDE / sqrt(2.0));
+    double tone_hz = crossings / 2.0 * out_rate / span;
+
+    int passed = 1;
+    size_t expected = (size_t)out_rate * TEST_SECONDS;
+    if (produced + 64 < expected || produced > expected + 1) {
+        printf("❌ %u -> %u Hz: %zu samples, expected about %zu\n", in_rate, out_rate, produced, expected);
+        passed = 0;
+    }
+    if (produced_chunked != produced || memcmp(out, out_chunked, produced * sizeof(int16_t)) != 0) {
+        printf("❌ %u -> %u Hz: chunked output differs\n", in_rate, out_rate);
+        passed = 0;
+    }
+    if (fabs(rms_ratio - 1.0) > 0.03) {
+        printf("❌ %u -> %u Hz: level %.3f of the input\n", in_rate, out_rate, rms_ratio);
+        passed = 0;
+    }
+    if (fabs(tone_hz - TEST_TONE_HZ) > TEST_TONE_HZ * 0.01) {
+        printf("❌ %u -> %u Hz: tone at %.1f Hz\n", in_rate, out_rate, tone_hz);
+        passed = 0;
+    }
+    if (passed) {
+        printf("✅ %u -> %u Hz: %zu samples, level %.3f, tone %.1f Hz\n",
+               in_rate, out_rate, produced, rms_ratio, tone_hz);
+    }
+
+    free(in);
+    free(out);
+    free(out_chunked);
+    resampler_destroy(whole);
+    resampler_destroy(chunked);
+    return passed;
+}
+
+int main(void) {
+    printf("🧪 Testing the resampler...\n");
+
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(rate_pairs) / sizeof(rate_pairs[0]); i++) {
+        failures += !test_pair(rate_pairs[i][0], rate_pairs[i][1]);
+    }
+
+    if (failures) {
+        printf("❌ %d resampler test(s) failed\n", failures);
+        return 1;
+    }
+    printf("✅ Resampler test completed successfully!\n");
+    return 0;
+}
@@ -0,0 +1,241 @@
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
+
+typedef struct {
+    uint64_t timestamp_us;
+    uint64_t arg;
+    uint32_t event;
+    uint32_t thread;
+} trace_record_t;
+
+// One slot of the event ring. seq is the event's index + 1, stored last, so a
+// reader can tell a complete slot from one being rewritten.
+typedef struct {
+    atomic_uint_fast64_t seq;
+    trace_record_t record;
+} trace_slot_t;
+
+// A turn: user stop, then the stages that lead to the first audible answer
+typedef struct {
+    uint64_t stage_us[TRACE_EVENT_COUNT];
+} trace_turn_t;
+
+// Event ring; capacity is a power of two
+typedef struct {
+    trace_slot_t *slots;
+    uint64_t capacity;
+    atomic_uint_fast64_t next;
+} trace_ring_t;
+
+// Capture periods and uplink chunks arrive dozens of times a second; the turn
+// milestones a few times a minute, so they get a ring of their own
+static trace_slot_t period_slots[TRACE_MAX_EVENTS];
+static trace_slot_t milestone_slots[TRACE_MAX_MILESTONES];
+static trace_ring_t period_ring = { period_slots, TRACE_MAX_EVENTS, 0 };
+static trace_ring_t milestone_ring = { milestone_slots, TRACE_MAX_MILESTONES, 0 };
+static atomic_uint next_thread = 0;
+static _Thread_local uint32_t thread_id = 0;
+
+static const char *event_names[TRACE_EVENT_COUNT] = {
+    "capture", "chunk_sent", "user_stop", "transcription", "tts_first_byte", "first_sample",
+};
+
+// Stages reported per turn, between two trace points
+typedef struct {
+    const char *name;
+    trace_event_t from;
+    trace_event_t to;
+} trace_stage_t;
+
+static const trace_stage_t stages[] = {
+    { "stop -> transcription", TRACE_USER_STOP, TRACE_TRANSCRIPTION },
+    { "transcription -> first TTS byte", TRACE_TRANSCRIPTION, TRACE_TTS_FIRST_BYTE },
+    { "first TTS byte -> first sample", TRACE_TTS_FIRST_BYTE, TRACE_FIRST_SAMPLE },
+    { "stop -> first sample", TRACE_USER_STOP, TRACE_FIRST_SAMPLE },
+};
+#define TRACE_STAGE_COUNT (sizeof(stages) / sizeof(stages[0]))
+
+// Monotonic clock in microseconds
+uint64_t trace_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Record an event at a given time
+void trace_event_at(trace_event_t event, uint64_t timestamp_us, uint64_t arg) {
+    if (thread_id == 0) {
+        thread_id = atomic_fetch_add_explicit(&next_thread, 1, memory_order_relaxed) + 1;
+    }
+
+    trace_ring_t *ring = event < TRACE_USER_STOP ? &period_ring : &milestone_ring;
+    uint64_t index = atomic_fetch_add_explicit(&ring->next, 1, memory_order_relaxed);
+    trace_slot_t *slot = &ring->slots[index & (ring->capacity - 1)];
+
+    // Invalidate first so a reader never pairs the old seq with new fields
+    atomic_store_explicit(&slot->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->record.timestamp_us = timestamp_us;
+    slot->record.arg = arg;
+    slot->record.event = (uint32_t)event;
+    slot->record.thread = thread_id;
+    atomic_store_explicit(&slot->seq, index + 1, memory_order_release);
+}
+
+// Record an event now
+void trace_event(trace_event_t event, uint64_t arg) {
+    trace_event_at(event, trace_now_us(), arg);
+}
+
+// Append the events still in a ring, oldest first. Slots rewritten while copying
+// are skipped. Returns the number appended.
+static size_t snapshot_ring(trace_ring_t *ring, trace_record_t *out) {
+    uint64_t end = atomic_load_explicit(&ring->next, memory_order_acquire);
+    uint64_t begin = end > ring->capacity ? end - ring->capacity : 0;
+
+    size_t count = 0;
+    for (uint64_t index = begin; index < end; index++) {
+        trace_slot_t *slot = &ring->slots[index & (ring->capacity - 1)];
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != index + 1) continue;
+
+        trace_record_t record = slot->record;
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != index + 1) continue;
+
+        out[count++] = record;
+    }
+    return count;
+}
+
+// Group events into turns: each user stop opens one, and the first transcription,
+// TTS byte and played sample after it complete it
+static size_t build_turns(const trace_record_t *events, size_t count, trace_turn_t *turns, size_t max_turns) {
+    size_t turn_count = 0;
+    trace_turn_t *current = NULL;
+
+    for (size_t i = 0; i < count; i++) {
+        trace_event_t event = (trace_event_t)events[i].event;
+        if (event == TRACE_USER_STOP) {
+            if (turn_count == max_turns) {
+                memmove(turns, turns + 1, (max_turns - 1) * sizeof(trace_turn_t));
+                turn_count--;
+            }
+            current = &turns[turn_count++];
+            memset(current, 0, sizeof(*current));
+            current->stage_us[TRACE_USER_STOP] = events[i].timestamp_us;
+        } else if (current && event > TRACE_USER_STOP && !current->stage_us[event]) {
+            current->stage_us[event] = events[i].timestamp_us;
+        }
+    }
+    return turn_count;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of a sorted array
+static double percentile(const double *sorted, size_t count, double p) {
+    size_t rank = (size_t)(p / 100.0 * count + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return sorted[rank - 1];
+}
+
+// Print the per-turn latency breakdown
+void trace_report(void) {
+    trace_record_t *events = malloc(TRACE_MAX_MILESTONES * sizeof(trace_record_t));
+    trace_turn_t *turns = malloc(TRACE_MAX_TURNS * sizeof(trace_turn_t));
+    double *samples = malloc(TRACE_MAX_TURNS * sizeof(double));
+    if (!events || !turns || !samples) {
+        free(events);
+        free(turns);
+        free(samples);
+        printf("❌ Failed to allocate memory for trace report\n");
+        return;
+    }
+
+    size_t count = snapshot_ring(&milestone_ring, events);
+    size_t turn_count = build_turns(events, count, turns, TRACE_MAX_TURNS);
+    printf("📈 Latency per turn (%zu turns):\n", turn_count);
+
+    for (size_t s = 0; s < TRACE_STAGE_COUNT; s++) {
+        size_t n = 0;
+        for (size_t t = 0; t < turn_count; t++) {
+            uint64_t from = turns[t].stage_us[stages[s].from];
+            uint64_t to = turns[t].stage_us[stages[s].to];
+            if (from && to >= from) {
+                samples[n++] = (double)(to - from) / 1000.0;
+            }
+        }
+
+        if (n == 0) {
+            printf("   %-32s no samples\n", stages[s].name);
+            continue;
+        }
+        qsort(samples, n, sizeof(double), compare_double);
+        printf("   %-32s p50 %7.1f ms  p95 %7.1f ms  p99 %7.1f ms  (n=%zu)\n", stages[s].name,
+               percentile(samples, n, 50), percentile(samples, n, 95), percentile(samples, n, 99), n);
+    }
+
+    free(events);
+    free(turns);
+    free(samples);
+}
+
+// Write the Chrome trace: every event as an instant, every turn stage as a span
+int trace_dump_chrome(const char *path) {
+    trace_record_t *events = malloc((TRACE_MAX_MILESTONES + TRACE_MAX_EVENTS) * sizeof(trace_record_t));
+    trace_turn_t *turns = malloc(TRACE_MAX_TURNS * sizeof(trace_turn_t));
+    FILE *file = (events && turns) ? fopen(path, "w") : NULL;
+    if (!file) {
+        free(events);
+        free(turns);
+        printf("❌ Failed to write trace to %s\n", path);
+        return 0;
+    }
+
+    // Milestones first: turns are built from them before the periods are appended
+    size_t milestones = snapshot_ring(&milestone_ring, events);
+    size_t turn_count = build_turns(events, milestones, turns, TRACE_MAX_TURNS);
+    size_t count = milestones + snapshot_ring(&period_ring, events + milestones);
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    int first = 1;
+    for (size_t i = 0; i < count; i++) {
+        fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,\"ts\":%llu,"
+                "\"args\":{\"arg\":%llu}}",
+                first ? "" : ",\n", event_names[events[i].event], events[i].thread,
+                (unsigned long long)events[i].timestamp_us, (unsigned long long)events[i].arg);
+        first = 0;
+    }
+
+    // Stages on their own track (tid 0) so each turn reads as one row of spans;
+    // the last stage is their total and would only overlap them
+    for (size_t t = 0; t < turn_count; t++) {
+        for (size_t s = 0; s + 1 < TRACE_STAGE_COUNT; s++) {
+            uint64_t from = turns[t].stage_us[stages[s].from];
+            uint64_t to = turns[t].stage_us[stages[s].to];
+            if (!from || to < from) continue;
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":0,\"ts\":%llu,\"dur\":%llu,"
+                    "\"args\":{\"turn\":%zu}}",
+                    first ? "" : ",\n", stages[s].name, (unsigned long long)from,
+                    (unsigned long long)(to - from), t);
+            first = 0;
+        }
+    }
+    fprintf(file, "\n]}\n");
+
+    int ok = fclose(file) == 0;
+    free(events);
+    free(turns);
+    if (ok) {
+        printf("📝 Trace with %zu events and %zu turns written to %s\n", count, turn_count, path);
+    }
+    return ok;
+}
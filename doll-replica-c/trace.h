@@ -0,0 +1,38 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Tracer configuration
+#define TRACE_MAX_EVENTS (1 << 16)        // Per-period events (power of two), oldest overwritten
+#define TRACE_MAX_MILESTONES 4096         // Turn events, kept apart so periods never push them out
+#define TRACE_MAX_TURNS 256               // Most recent turns in the latency report
+#define TRACE_FILE "doll-trace.json"      // Chrome trace written on exit and by the 'trace' command
+
+// Fixed trace points along one conversational turn
+typedef enum {
+    TRACE_CAPTURE = 0,      // Input period captured (stamped with its ADC time)
+    TRACE_CHUNK_SENT,       // Uplink chunk written to the streaming session
+    TRACE_USER_STOP,        // Streaming session finished: the user stopped talking
+    TRACE_TRANSCRIPTION,    // Transcription received on the WebSocket
+    TRACE_TTS_FIRST_BYTE,   // First TTS frame of a response
+    TRACE_FIRST_SAMPLE,     // First TTS sample handed to the device
+    TRACE_EVENT_COUNT
+} trace_event_t;
+
+// Monotonic clock shared by every trace point
+uint64_t trace_now_us(void);
+
+// Record an event; lock-free and allocation-free, safe in the audio callback
+void trace_event(trace_event_t event, uint64_t arg);
+void trace_event_at(trace_event_t event, uint64_t timestamp_us, uint64_t arg);
+
+// Print the user-stop-to-first-audio breakdown per turn (p50/p95/p99)
+void trace_report(void);
+
+// Write the recorded events and turn stages as Chrome trace_event JSON
+// (chrome://tracing or ui.perfetto.dev). Returns 1 on success.
+int trace_dump_chrome(const char *path);
+
+#endif // TRACE_H
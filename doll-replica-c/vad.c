@@ -0,0 +1,79 @@
+#include "vad.h"
+#include <string.h>
+
+#define VAD_NOISE_INITIAL 100000.0  // Starting noise floor before any adaptation
+#define VAD_NOISE_RISE 0.01         // Slow upward tracking so speech does not raise the floor
+#define VAD_NOISE_FALL 0.2          // Fast downward tracking when the room gets quieter
+
+// Initialize detector
+void vad_init(VoiceActivityDetector *vad, unsigned int sample_rate) {
+    memset(vad, 0, sizeof(*vad));
+    vad->sample_rate = sample_rate;
+    vad->noise_floor = VAD_NOISE_INITIAL;
+}
+
+// Reset per-utterance state, keeping the learned noise floor
+void vad_reset(VoiceActivityDetector *vad) {
+    vad->state = VAD_SILENCE;
+    vad->hangover_ms = 0;
+    vad->silence_ms = 0;
+    vad->speech_seen = 0;
+    vad->end_reported = 0;
+}
+
+// Classify one frame
+vad_state_t vad_process_frame(VoiceActivityDetector *vad, const int16_t *samples, size_t count) {
+    if (count == 0) return vad->state;
+
+    double energy = 0.0;
+    size_t crossings = 0;
+    for (size_t i = 0; i < count; i++) {
+        energy += (double)samples[i] * samples[i];
+        if (i > 0 && ((samples[i] >= 0) != (samples[i - 1] >= 0))) {
+            crossings++;
+        }
+    }
+    energy /= count;
+    double zcr = (double)crossings / count;
+    unsigned int frame_ms = (unsigned int)(count * 1000 / vad->sample_rate);
+
+    double threshold = vad->noise_floor * VAD_SPEECH_RATIO;
+    if (threshold < VAD_MIN_ENERGY) threshold = VAD_MIN_ENERGY;
+
+    // Voiced speech: energy over the floor with a moderate zero-crossing rate.
+    // Loud frames count regardless so strong fricatives are not clipped.
+    int is_speech = (energy > threshold && zcr < VAD_MAX_ZCR) || energy > threshold * 4;
+
+    if (is_speech) {
+        vad->state = VAD_SPEECH;
+        vad->hangover_ms = VAD_HANGOVER_MS;
+        vad->silence_ms = 0;
+        vad->speech_seen = 1;
+    } else {
+        // Only learn the noise floor from non-speech frames
+        double rate = energy < vad->noise_floor ? VAD_NOISE_FALL : VAD_NOISE_RISE;
+        vad->noise_floor += (energy - vad->noise_floor) * rate;
+
+        vad->silence_ms += frame_ms;
+        if (vad->hangover_ms > frame_ms) {
+            vad->hangover_ms -= frame_ms;
+            vad->state = VAD_HANGOVER;
+        } else {
+            vad->hangover_ms = 0;
+            vad->state = VAD_SILENCE;
+        }
+    }
+
+    return vad->state;
+}
+
+// End-of-utterance check
+int vad_end_of_utterance(VoiceActivityDetector *vad) {
+    if (!vad->speech_seen || vad->end_reported) return 0;
+
+    if (vad->silence_ms >= VAD_END_OF_UTTERANCE_MS) {
+        vad->end_reported = 1;
+        return 1;
+    }
+    return 0;
+}
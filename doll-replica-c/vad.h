@@ -0,0 +1,42 @@
+#ifndef VAD_H
+#define VAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Voice activity detection configuration
+#define VAD_FRAME_MS 20                 // Analysis frame length
+#define VAD_HANGOVER_MS 240             // Frames kept as speech after the energy drops
+#define VAD_END_OF_UTTERANCE_MS 900     // Trailing silence that ends the utterance
+#define VAD_SPEECH_RATIO 4.0            // Frame energy over noise floor that counts as speech (~6 dB)
+#define VAD_MIN_ENERGY 40000.0          // Absolute floor (int16 mean square) so hiss never counts
+#define VAD_MAX_ZCR 0.35                // Zero-crossing rate above which weak frames are noise
+
+typedef enum {
+    VAD_SILENCE = 0,
+    VAD_SPEECH,
+    VAD_HANGOVER,
+} vad_state_t;
+
+// Energy + zero-crossing voice activity detector with a hangover timer
+typedef struct {
+    unsigned int sample_rate;
+    double noise_floor;         // Running estimate of the background energy
+    vad_state_t state;
+    unsigned int hangover_ms;   // Remaining hangover
+    unsigned int silence_ms;    // Consecutive non-speech time
+    int speech_seen;            // Speech has occurred in this utterance
+    int end_reported;
+} VoiceActivityDetector;
+
+// VAD functions
+void vad_init(VoiceActivityDetector *vad, unsigned int sample_rate);
+void vad_reset(VoiceActivityDetector *vad);
+
+// Classify one frame; returns VAD_SPEECH / VAD_HANGOVER frames should be sent
+vad_state_t vad_process_frame(VoiceActivityDetector *vad, const int16_t *samples, size_t count);
+
+// True once, when trailing silence after speech passes VAD_END_OF_UTTERANCE_MS
+int vad_end_of_utterance(VoiceActivityDetector *vad);
+
+#endif // VAD_H
@@ -4,55 +4,449 @@
 #include "message_queue.h"
 #include "audio.h"
 #include "http_client.h"
+#include "trace.h"
+#include "metrics.h"
+#include "json_audio.h"
+#include "json_message.h"
+#include "control_message.h"
+#include "cbor.h"
+#include "input_handler.h"
+#include "reconnect.h"
+#include "ws_uplink.h"
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
-#include <cjson/cJSON.h>
+#include <unistd.h>
 
 // Global WebSocket variables
 struct lws *websocket_connection = NULL;
 struct lws_context *websocket_context = NULL;
 int should_exit = 0;
 
-// Timer structure for ping messages
-static lws_sorted_usec_list_t ping_timer;
+// Set by other threads before lws_cancel_service(), taken in EVENT_WAIT_CANCELLED
+static atomic_int write_requested = 0;
 
-// Buffer for accumulating incoming WebSocket data
-#define INCOMING_BUFFER_SIZE (1024 * 256)
-static char incoming_buffer[INCOMING_BUFFER_SIZE];
-static size_t incoming_buffer_len = 0;
+// Control message encoding of the current connection, from the subprotocol the server picked
+static control_encoding_t control_encoding = CONTROL_ENCODING_JSON;
 
-// Function to send ping message
-static void send_ping(lws_sorted_usec_list_t *timer) {
-    if (!websocket_connection || should_exit) {
+// Incoming text messages are parsed as their fragments arrive; only the fields
+// we act on are kept, plus the start of the message for the log
+#define INCOMING_PREVIEW_SIZE 1024
+static JsonMessage incoming_message;
+static int incoming_active = 0;             // A message has started and not ended
+static char incoming_preview[INCOMING_PREVIEW_SIZE];
+static size_t incoming_preview_len = 0;
+
+// Base64 audio in a JSON text message is decoded into playback while the message arrives
+static JsonAudioStream incoming_audio;
+static unsigned char json_audio_start[JSON_AUDIO_START_BYTES];
+static size_t json_audio_start_len = 0;
+static int json_audio_playing = 0;          // The first bytes have gone to playback
+static int json_audio_owns_utterance = 0;   // It started the utterance, so it ends it
+
+// Binary messages are TTS audio, or CBOR control messages when that was negotiated.
+// A CBOR message in one fragment is decoded where lws left it; only a fragmented
+// one is gathered here first.
+static int incoming_binary_active = 0;      // A binary message has started and not ended
+static int incoming_binary_cbor = 0;        // ...and it is a CBOR control message
+static uint8_t incoming_cbor[CONTROL_CBOR_MAX];
+static size_t incoming_cbor_len = 0;
+static int incoming_cbor_dropped = 0;       // Outgrew incoming_cbor
+static control_message_t incoming_control;
+
+// Reconnection state (service thread only). A drop retries at once, then backs
+// off; the server address is resolved once so a retry does not wait on DNS.
+static reconnect_state_t reconnect_state = RECONNECT_IDLE;
+static lws_sorted_usec_list_t reconnect_timer;
+static unsigned int reconnect_attempt = 0;      // Failed attempts since the drop
+static unsigned int resolve_failures = 0;       // Failed attempts since the address was looked up
+static uint32_t reconnect_seed = 0;
+static char server_address[RECONNECT_ADDRESS_MAX];
+static lws_usec_t dropped_at = 0;               // When the connection went, 0 while it is up
+static char resume_token[RESUME_TOKEN_MAX];     // From the last handshake, empty if none
+static int session_resumed = 0;                 // The last handshake picked the session back up
+
+// Keepalive: pings go out from the writeable callback, never from the timer itself
+static lws_sorted_usec_list_t keepalive_timer;
+static int ping_due = 0;                        // Send a ping on the next writeable
+static lws_usec_t ping_sent_at = 0;             // Waiting for its pong, 0 when not
+
+// "reconnect-bench": time to recover from a series of forced drops
+static lws_sorted_usec_list_t bench_timer;
+static int bench_active = 0;
+static unsigned int bench_drops_left = 0;
+static unsigned int bench_count = 0;
+static lws_usec_t bench_us[RECONNECT_BENCH_ROUNDS];
+
+static void connection_lost(void);
+static void bench_record(lws_usec_t elapsed);
+
+// No pong since the last ping (or it could not even be written): the link is
+// gone even if TCP has not noticed, as after losing the Wi-Fi association
+static void keepalive_expired(lws_sorted_usec_list_t *timer) {
+    (void)timer;
+    if (!websocket_connection) {
+        return;
+    }
+    
+    if (ping_due || ping_sent_at) {
+        printf("💔 No pong in %d ms, dropping the connection\n", KEEPALIVE_TIMEOUT_MS);
+        lws_set_timeout(websocket_connection, PENDING_TIMEOUT_USER_OK, LWS_TO_KILL_ASYNC);
+        return;
+    }
+    
+    ping_due = 1;
+    lws_callback_on_writable(websocket_connection);
+    lws_sul_schedule(websocket_context, 0, &keepalive_timer, keepalive_expired,
+                     (lws_usec_t)KEEPALIVE_TIMEOUT_MS * LWS_US_PER_MS);
+}
+
+// Start a handshake with the cached address; returns 0 if lws refused at once
+static int open_connection(void) {
+    struct lws_client_connect_info connection_info;
+    memset(&connection_info, 0, sizeof(connection_info));
+    
+    connection_info.context = websocket_context;
+    connection_info.address = server_address;
+    connection_info.port = SERVER_PORT;
+    connection_info.path = WEBSOCKET_PATH;
+    connection_info.host = SERVER_ADDRESS;
+    connection_info.origin = SERVER_ADDRESS;
+    connection_info.protocol = WS_OFFER_CBOR ? WS_PROTOCOL_CBOR "," WS_PROTOCOL_JSON : WS_PROTOCOL_JSON;
+    connection_info.ssl_connection = 0;  // No SSL for local testing
+    
+    return lws_client_connect_via_info(&connection_info) != NULL;
+}
+
+static void reconnect_expired(lws_sorted_usec_list_t *timer) {
+    (void)timer;
+    if (reconnect_state != RECONNECT_WAITING || should_exit) {
+        return;
+    }
+    
+    // The server may have moved (new network, DHCP lease); this lookup blocks,
+    // but nothing else is waiting on the connection
+    if (resolve_failures >= RECONNECT_RESOLVE_AFTER) {
+        resolve_failures = 0;
+        reconnect_resolve(SERVER_ADDRESS, SERVER_PORT, server_address, sizeof(server_address));
+    }
+    
+    reconnect_state = RECONNECT_CONNECTING;
+    if (!open_connection()) {
+        connection_lost();
+    }
+}
+
+// The connection dropped or an attempt failed: schedule the next attempt
+static void connection_lost(void) {
+    int was_connected = reconnect_state == RECONNECT_CONNECTED;
+    
+    // lws can report one failure twice (error callback, then a NULL from connect)
+    if (!was_connected && reconnect_state != RECONNECT_CONNECTING) {
+        return;
+    }
+    
+    websocket_connection = NULL;
+    lws_sul_cancel(&keepalive_timer);
+    ping_due = 0;
+    ping_sent_at = 0;
+    incoming_active = 0;
+    incoming_binary_active = 0;
+    
+    if (should_exit) {
+        reconnect_state = RECONNECT_STOPPED;
+        return;
+    }
+    
+    if (was_connected) {
+        dropped_at = lws_now_usecs();
+        reconnect_attempt = 0;
+        printf("📶 Connection lost, reconnecting...\n");
+        ws_uplink_link_down();
+        
+        // Nothing to resume: the response that was playing is gone
+        if (!resume_token[0] && is_streaming_audio_active()) {
+            stop_streaming_audio_playback();
+        }
+    } else {
+        reconnect_attempt++;
+        resolve_failures++;
+    }
+    
+    unsigned int delay_ms = reconnect_delay_ms(reconnect_attempt, &reconnect_seed);
+    if (reconnect_attempt > 0) {
+        printf("⏳ Connection attempt %u failed, retrying in %u ms\n", reconnect_attempt, delay_ms);
+    }
+    reconnect_state = RECONNECT_WAITING;
+    lws_sul_schedule(websocket_context, 0, &reconnect_timer, reconnect_expired, (lws_usec_t)delay_ms * LWS_US_PER_MS);
+}
+
+// Handshake done after a drop
+static void connection_recovered(void) {
+    lws_usec_t elapsed = lws_now_usecs() - dropped_at;
+    dropped_at = 0;
+    
+    metrics_add(METRIC_WS_RECONNECTS, 1);
+    metrics_observe(METRIC_WS_RECONNECT_MS, (uint64_t)(elapsed / LWS_US_PER_MS));
+    printf("🔁 Reconnected in %.1f ms after %u failed attempts (%s)\n", elapsed / 1000.0,
+           reconnect_attempt, session_resumed ? "session resumed" : "new session");
+    
+    // A new session knows nothing of what was in flight
+    if (!session_resumed && is_streaming_audio_active()) {
+        stop_streaming_audio_playback();
+    }
+    ws_uplink_link_up(session_resumed);
+    bench_record(elapsed);
+}
+
+static int compare_usec(const void *a, const void *b) {
+    lws_usec_t x = *(const lws_usec_t *)a;
+    lws_usec_t y = *(const lws_usec_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void bench_report(void) {
+    qsort(bench_us, bench_count, sizeof(bench_us[0]), compare_usec);
+    double p50 = bench_us[bench_count / 2] / 1000.0;
+    double p95 = bench_us[(bench_count * 95) / 100 < bench_count ? (bench_count * 95) / 100 : bench_count - 1] / 1000.0;
+    
+    printf("📊 Reconnect benchmark, %u drops: min %.1f ms, p50 %.1f ms, p95 %.1f ms, max %.1f ms\n",
+           bench_count, bench_us[0] / 1000.0, p50, p95, bench_us[bench_count - 1] / 1000.0);
+    if (p95 <= RECONNECT_TARGET_MS) {
+        printf("✅ p95 within the %d ms target\n", RECONNECT_TARGET_MS);
+    } else {
+        printf("⚠️  p95 over the %d ms target\n", RECONNECT_TARGET_MS);
+    }
+}
+
+// Drop the connection the way a dead link would, without a close handshake
+static void bench_drop(lws_sorted_usec_list_t *timer) {
+    (void)timer;
+    if (!bench_active) {
+        return;
+    }
+    if (!websocket_connection) {
+        // Still recovering from something else
+        lws_sul_schedule(websocket_context, 0, &bench_timer, bench_drop,
+                         (lws_usec_t)RECONNECT_BENCH_SETTLE_MS * LWS_US_PER_MS);
+        return;
+    }
+    bench_drops_left--;
+    lws_set_timeout(websocket_connection, PENDING_TIMEOUT_USER_OK, LWS_TO_KILL_ASYNC);
+}
+
+static void bench_record(lws_usec_t elapsed) {
+    if (!bench_active) {
         return;
     }
+    bench_us[bench_count++] = elapsed;
+    
+    if (bench_drops_left > 0) {
+        lws_sul_schedule(websocket_context, 0, &bench_timer, bench_drop,
+                         (lws_usec_t)RECONNECT_BENCH_SETTLE_MS * LWS_US_PER_MS);
+        return;
+    }
+    bench_active = 0;
+    bench_report();
+    printf("> ");
+    fflush(stdout);
+}
+
+// tts_start / tts_end around each TTS response; returns 1 if the message was one
+static int handle_utterance_marker(const control_message_t *message, const char *timestamp) {
+    int is_start = strcmp(message->type, "tts_start") == 0;
+    int is_end = strcmp(message->type, "tts_end") == 0;
+    if (!is_start && !is_end) {
+        return 0;
+    }
+    unsigned int utterance_id = (unsigned int)message->utterance_id;
+    
+    // Markers of the response the user interrupted are dropped with its audio
+    if (audio_downlink_suppressed()) {
+        return 1;
+    }
+    
+    if (is_start) {
+        printf("[%s] 🎵 Utterance %u started\n", timestamp, utterance_id);
+        if (!audio_begin_utterance(utterance_id)) {
+            printf("[%s] ❌ Failed to start streaming audio playback\n", timestamp);
+        }
+    } else if (!audio_end_utterance(utterance_id)) {
+        printf("[%s] ⚠️  End of unknown utterance %u\n", timestamp, utterance_id);
+    }
+    return 1;
+}
+
+// Keep the start of the message being received for the log
+static void append_incoming_preview(const char *text, size_t length) {
+    size_t room = sizeof(incoming_preview) - 1 - incoming_preview_len;
+    if (length > room) length = room;
+    memcpy(incoming_preview + incoming_preview_len, text, length);
+    incoming_preview_len += length;
+    incoming_preview[incoming_preview_len] = '\0';
+}
+
+// Show a message we do not act on, as much of it as was kept
+static void print_incoming_message(const char *timestamp) {
+    if (incoming_message.fields.found & CONTROL_FIELD_BIT(CONTROL_FIELD_AUDIO)) {
+        printf("[%s] Server: %s message with audio\n", timestamp,
+               incoming_message.fields.type[0] ? incoming_message.fields.type : "untyped");
+    } else if (incoming_message.length > incoming_preview_len) {
+        printf("[%s] Server: %s... (%llu bytes)\n", timestamp, incoming_preview,
+               (unsigned long long)incoming_message.length);
+    } else {
+        printf("[%s] Server: %s\n", timestamp, incoming_preview);
+    }
+}
+
+// A decoded control message, whichever the encoding; returns 0 if it is not one we act on
+static int handle_control_message(const control_message_t *message, uint64_t length, const char *timestamp) {
+    if (!(message->found & CONTROL_FIELD_BIT(CONTROL_FIELD_TYPE))) {
+        return 0;
+    }
+    
+    // Utterance markers around each TTS response
+    if (handle_utterance_marker(message, timestamp)) {
+        return 1;
+    }
+    
+    // Uplink frames the server has, up to and including this one
+    if (strcmp(message->type, "uplink_ack") == 0) {
+        unsigned int needed = CONTROL_FIELD_BIT(CONTROL_FIELD_UTTERANCE_ID) | CONTROL_FIELD_BIT(CONTROL_FIELD_SEQUENCE);
+        if ((message->found & needed) == needed) {
+            ws_uplink_ack((unsigned int)message->utterance_id, (uint32_t)message->sequence);
+        }
+        return 1;
+    }
+    
+    if (strcmp(message->type, "transcription") != 0) {
+        return 0;
+    }
+    
+    trace_event(TRACE_TRANSCRIPTION, length);
+    
+    unsigned int needed = CONTROL_FIELD_BIT(CONTROL_FIELD_TEXT) | CONTROL_FIELD_BIT(CONTROL_FIELD_SESSION_ID);
+    if ((message->found & needed) != needed) {
+        return 0;
+    }
+    printf("[%s] 🎤 Transcription (Session: %s): %s%s\n", timestamp,
+           message->session_id, message->text,
+           (message->truncated & CONTROL_FIELD_BIT(CONTROL_FIELD_TEXT)) ? "..." : "");
+    return 1;
+}
+
+// A complete text message
+static void handle_incoming_message(const char *timestamp) {
+    if (!json_message_finish(&incoming_message) ||
+        !handle_control_message(&incoming_message.fields, incoming_message.length, timestamp)) {
+        print_incoming_message(timestamp);
+    }
+}
+
+// A complete CBOR control message
+static void handle_cbor_message(const uint8_t *data, size_t length, const char *timestamp) {
+    if (!control_message_decode_cbor(&incoming_control, data, length)) {
+        printf("[%s] ❌ Malformed CBOR control message (%zu bytes)\n", timestamp, length);
+    } else if (!handle_control_message(&incoming_control, length, timestamp)) {
+        printf("[%s] Server: %s CBOR message (%zu bytes)\n", timestamp,
+               incoming_control.type[0] ? incoming_control.type : "untyped", length);
+    }
+}
+
+// A fragment of a CBOR control message; decoded once the message ends
+static void receive_cbor_fragment(const uint8_t *data, size_t len, int message_end, const char *timestamp) {
+    // The whole message in one piece: no copy
+    if (message_end && incoming_cbor_len == 0 && !incoming_cbor_dropped) {
+        handle_cbor_message(data, len, timestamp);
+        return;
+    }
+    
+    if (len > sizeof(incoming_cbor) - incoming_cbor_len) {
+        incoming_cbor_dropped = 1;
+    } else if (!incoming_cbor_dropped) {
+        memcpy(incoming_cbor + incoming_cbor_len, data, len);
+        incoming_cbor_len += len;
+    }
+    if (!message_end) {
+        return;
+    }
+    
+    if (incoming_cbor_dropped) {
+        printf("[%s] ❌ CBOR control message over %d bytes dropped\n", timestamp, CONTROL_CBOR_MAX);
+    } else {
+        handle_cbor_message(incoming_cbor, incoming_cbor_len, timestamp);
+    }
+}
+
+// Characters of the audio string, and its end (json_message.c callbacks)
+static void feed_json_audio(void *ctx, const char *data, size_t length) {
+    json_audio_feed(ctx, data, length);
+}
+
+static void end_json_audio(void *ctx) {
+    json_audio_finish(ctx);
+}
 
-    // Create ping message with timestamp
-    time_t current_time = time(NULL);
-    char ping_message[64];
-    snprintf(ping_message, sizeof(ping_message), "ping-%ld", current_time);
+static void start_json_audio(void) {
+    json_audio_playing = 1;
+    json_audio_owns_utterance = !audio_utterance_active();
+    printf("🎵 Streaming base64 audio from JSON\n");
     
-    // Prepare ping buffer
-    unsigned char ping_buffer[LWS_PRE + 64];
-    int message_length = strlen(ping_message);
-    memcpy(&ping_buffer[LWS_PRE], ping_message, message_length);
+    if (!play_audio_chunk(json_audio_start, json_audio_start_len)) {
+        printf("❌ Failed to queue JSON audio\n");
+    }
+}
+
+// Decoded audio from the JSON stream: the first JSON_AUDIO_START_BYTES are
+// gathered so the downlink sees a whole WAV header, the rest goes straight on
+static void play_json_audio(void *ctx, const unsigned char *data, size_t size) {
+    (void)ctx;
     
-    // Send ping
-    int result = lws_write(websocket_connection, &ping_buffer[LWS_PRE], message_length, LWS_WRITE_PING);
+    // The user interrupted this response; the rest of it is not played
+    if (audio_downlink_suppressed()) {
+        return;
+    }
     
-    if (result < 0) {
-        printf("❌ Failed to send ping (error: %d)\n", result);
-        should_exit = 1;
+    if (!json_audio_playing) {
+        size_t take = JSON_AUDIO_START_BYTES - json_audio_start_len;
+        if (take > size) take = size;
+        memcpy(json_audio_start + json_audio_start_len, data, take);
+        json_audio_start_len += take;
+        data += take;
+        size -= take;
+        
+        if (json_audio_start_len < JSON_AUDIO_START_BYTES) {
+            return;
+        }
+        start_json_audio();
     }
-    // Ping sent successfully - no need to display it
+    
+    if (size > 0 && !play_audio_chunk(data, size)) {
+        printf("❌ Failed to queue JSON audio\n");
+    }
+}
 
-    // Schedule next ping in PING_INTERVAL_SECONDS
-    // Disabled to avoid segmentation fault
-    // if (!should_exit && websocket_connection) {
-    //     lws_sul_schedule(websocket_context, 0, timer, send_ping, PING_INTERVAL_SECONDS * LWS_US_PER_SEC);
-    // }
+// End of a text message: play out a short clip and close the utterance it opened
+static void finish_json_audio(const char *timestamp) {
+    if (incoming_audio.audio_bytes > 0) {
+        if (!json_audio_playing && !audio_downlink_suppressed()) {
+            start_json_audio();
+        }
+        if (json_audio_owns_utterance) {
+            audio_end_utterance(0);
+        }
+        printf("[%s] 🎵 JSON audio: %llu bytes decoded as it arrived\n",
+               timestamp, (unsigned long long)incoming_audio.audio_bytes);
+    }
+    if (incoming_audio.error) {
+        printf("[%s] ❌ Malformed base64 audio in JSON, the rest of the clip was skipped\n", timestamp);
+    }
+    
+    json_audio_start_len = 0;
+    json_audio_playing = 0;
+    json_audio_owns_utterance = 0;
 }
 
 // WebSocket callback function - handles all WebSocket events
@@ -66,9 +460,9 @@ int websocket_callback(struct lws *wsi, enum lws_callback_reasons reason,
             // Create "Bearer <jwt-token>" header
             snprintf(auth_header, sizeof(auth_header), "Bearer %s", current_jwt_token);
             
-            // Add the header to the request
+            // Add the header to the request (len is the space left after *in)
             unsigned char **header_ptr = (unsigned char **)in;
-            unsigned char *header_end = (unsigned char *)in + len;
+            unsigned char *header_end = *header_ptr + len;
             
             if (lws_add_http_header_by_name(wsi, 
                                           (const unsigned char *)"authorization",
@@ -77,6 +471,68 @@ int websocket_callback(struct lws *wsi, enum lws_callback_reasons reason,
                 printf("❌ Failed to add Authorization header\n");
                 return 1;
             }
+            
+            // Advertise the TTS formats we can play; the server answers with the one it picked
+            if (lws_add_http_header_by_name(wsi,
+                                          (const unsigned char *)AUDIO_ACCEPT_HEADER,
+                                          (const unsigned char *)AUDIO_ACCEPT_FORMATS,
+                                          strlen(AUDIO_ACCEPT_FORMATS), header_ptr, header_end)) {
+                printf("❌ Failed to add audio accept header\n");
+                return 1;
+            }
+            
+            // Ask to pick the session up where the dropped connection left it
+            if (resume_token[0] &&
+                lws_add_http_header_by_name(wsi,
+                                          (const unsigned char *)RESUME_TOKEN_HEADER,
+                                          (const unsigned char *)resume_token,
+                                          strlen(resume_token), header_ptr, header_end)) {
+                printf("❌ Failed to add resume token header\n");
+                return 1;
+            }
+            break;
+        }
+        
+        case LWS_CALLBACK_CLIENT_FILTER_PRE_ESTABLISH: {
+            // Servers that do not negotiate keep sending the default 8 kHz mu-law
+            audio_format_t format = { AUDIO_ENCODING_MULAW, SAMPLE_RATE };
+            char value[AUDIO_FORMAT_MAX_LENGTH];
+            
+            if (lws_hdr_custom_length(wsi, AUDIO_FORMAT_HEADER, strlen(AUDIO_FORMAT_HEADER)) > 0 &&
+                lws_hdr_custom_copy(wsi, value, sizeof(value), AUDIO_FORMAT_HEADER, strlen(AUDIO_FORMAT_HEADER)) > 0) {
+                if (!audio_format_parse(value, &format)) {
+                    printf("⚠️  Unsupported TTS format \"%s\", assuming mulaw;rate=%d\n", value, SAMPLE_RATE);
+                    format.encoding = AUDIO_ENCODING_MULAW;
+                    format.sample_rate = SAMPLE_RATE;
+                }
+            }
+            
+            audio_set_downlink_format(&format);
+            printf("🎚️  TTS format: %s %uHz\n", audio_encoding_name(format.encoding), format.sample_rate);
+            
+            // Utterances go up the WebSocket only in codecs the server says it reassembles
+            char uplink_codecs[WS_UPLINK_CODECS_MAX];
+            if (lws_hdr_custom_copy(wsi, uplink_codecs, sizeof(uplink_codecs), WS_UPLINK_CODECS_HEADER,
+                                    strlen(WS_UPLINK_CODECS_HEADER)) > 0) {
+                ws_uplink_set_server_codecs(uplink_codecs);
+                printf("🎤 WebSocket uplink: %s\n", uplink_codecs);
+            } else {
+                ws_uplink_set_server_codecs(NULL);
+            }
+            
+            // The token for the next reconnect, and whether this handshake resumed;
+            // with resume off no token is kept, so none is ever sent
+            char token[RESUME_TOKEN_MAX];
+            char resumed[4];
+            session_resumed = resume_token[0] &&
+                              lws_hdr_custom_copy(wsi, resumed, sizeof(resumed), RESUMED_HEADER, strlen(RESUMED_HEADER)) > 0 &&
+                              strcmp(resumed, "1") == 0;
+            if (RESUME_ENABLED &&
+                lws_hdr_custom_copy(wsi, token, sizeof(token), RESUME_TOKEN_HEADER, strlen(RESUME_TOKEN_HEADER)) > 0) {
+                memcpy(resume_token, token, sizeof(resume_token));
+            } else {
+                resume_token[0] = '\0';
+            }
             break;
         }
         
@@ -84,58 +540,65 @@ int websocket_callback(struct lws *wsi, enum lws_callback_reasons reason,
             printf("✅ Connected to WebSocket server!\n");
             websocket_connection = wsi;
             
-            // Disable ping for now to avoid segmentation fault
-            // lws_sul_schedule(websocket_context, 0, &ping_timer, send_ping, PING_INTERVAL_SECONDS * LWS_US_PER_SEC);
+            // The protocol lws bound is the one the server accepted; none means the first
+            control_encoding = (control_encoding_t)lws_get_protocol(wsi)->id;
+            incoming_binary_active = 0;
+            printf("📨 Control messages: %s\n", control_encoding == CONTROL_ENCODING_CBOR ? "CBOR" : "JSON");
+            
+            reconnect_state = RECONNECT_CONNECTED;
+            resolve_failures = 0;
+            if (dropped_at) {
+                connection_recovered();
+            }
+            
+            lws_sul_schedule(websocket_context, 0, &keepalive_timer, keepalive_expired,
+                             (lws_usec_t)KEEPALIVE_INTERVAL_MS * LWS_US_PER_MS);
             
-            // Send initial greeting message
+            // Send whatever was queued while we were away
             lws_callback_on_writable(wsi);
             break;
             
         case LWS_CALLBACK_CLIENT_WRITEABLE: {
-            // Send queued messages
-            char message_to_send[MAX_MESSAGE_LENGTH];
-            int message_length;
-            unsigned char *binary_data = NULL;
-            size_t binary_size;
-            
-            // Try to get binary message first
-            if (get_binary_message_from_queue(&binary_data, &binary_size)) {
-                // Allocate buffer dynamically
-                unsigned char *message_buffer = malloc(LWS_PRE + binary_size);
-                if (message_buffer) {
-                    memcpy(&message_buffer[LWS_PRE], binary_data, binary_size);
-                    
-                    int result = lws_write(wsi, &message_buffer[LWS_PRE], binary_size, LWS_WRITE_BINARY);
-                    if (result < 0) {
-                        printf("❌ Failed to send binary message (error: %d)\n", result);
-                    }
-                    
-                    free(message_buffer);
-                } else {
-                    printf("❌ Failed to allocate memory for binary message\n");
+            // A keepalive ping goes ahead of everything queued
+            if (ping_due) {
+                unsigned char ping[LWS_PRE];
+                ping_due = 0;
+                if (lws_write(wsi, &ping[LWS_PRE], 0, LWS_WRITE_PING) < 0) {
+                    printf("❌ Failed to send ping\n");
+                    return -1;
                 }
-                
-                // Free the binary data
-                free(binary_data);
-                
-                // If there are more messages in queue, schedule another write
-                if (queue_head != queue_tail) {
+                ping_sent_at = lws_now_usecs();
+                if (message_queue_pending()) {
                     lws_callback_on_writable(wsi);
                 }
-            } else if (get_message_from_queue(message_to_send, &message_length)) {
-                // Handle text messages
-                unsigned char message_buffer[LWS_PRE + MAX_MESSAGE_LENGTH];
-                memcpy(&message_buffer[LWS_PRE], message_to_send, message_length);
-                
-                int result = lws_write(wsi, &message_buffer[LWS_PRE], message_length, LWS_WRITE_TEXT);
-                if (result < 0) {
-                    printf("❌ Failed to send message (error: %d)\n", result);
-                }
-                
-                // If there are more messages in queue, schedule another write
-                if (queue_head != queue_tail) {
+                break;
+            }
+            
+            // Send the next queued message straight from its pool buffer
+            message_buffer_t *message = message_queue_pop();
+            if (!message) {
+                // A producer may be halfway through a push; come back for it
+                if (message_queue_pending()) {
                     lws_callback_on_writable(wsi);
                 }
+                break;
+            }
+            
+            int result = lws_write(wsi, message->data, message->length,
+                                   message->is_binary ? LWS_WRITE_BINARY : LWS_WRITE_TEXT);
+            if (result < 0) {
+                printf("❌ Failed to send %s message (error: %d)\n", message->is_binary ? "binary" : "text", result);
+            } else {
+                metrics_add(METRIC_WS_MESSAGES_SENT, 1);
+            }
+            message_buffer_release(message);
+            
+            // A replay waiting for room on the audio lane has some now
+            ws_uplink_pump();
+            
+            // If there are more messages in queue, schedule another write
+            if (message_queue_pending()) {
+                lws_callback_on_writable(wsi);
             }
             break;
         }
@@ -143,26 +606,47 @@ int websocket_callback(struct lws *wsi, enum lws_callback_reasons reason,
         case LWS_CALLBACK_CLIENT_RECEIVE: {
             char timestamp[16];
             get_timestamp(timestamp, sizeof(timestamp));
+            metrics_add(METRIC_WS_MESSAGES_RECEIVED, 1);
+            metrics_add(METRIC_WS_BYTES_RECEIVED, len);
 
-            // Check if this is binary data (audio chunks)
+            // A large frame comes in several callbacks, the last fragment included
+            int message_end = lws_is_final_fragment(wsi) && lws_remaining_packet_payload(wsi) == 0;
+
+            // Check if this is binary data (audio chunks, or CBOR control messages)
             if (lws_frame_is_binary(wsi)) {
-                printf("[%s] 🎵 Received audio chunk (%zu bytes)\n", timestamp, len);
+                // Control messages carry the self-describe tag; audio formats never start with it
+                if (!incoming_binary_active) {
+                    incoming_binary_active = 1;
+                    incoming_binary_cbor = control_encoding == CONTROL_ENCODING_CBOR &&
+                                           cbor_is_tagged((const uint8_t *)in, len);
+                    incoming_cbor_len = 0;
+                    incoming_cbor_dropped = 0;
+                }
+                if (message_end) {
+                    incoming_binary_active = 0;
+                }
                 
-                // Start streaming audio playback if not already active
-                if (!is_streaming_audio_active()) {
-                    if (start_streaming_audio_playback()) {
-                        printf("[%s] 🎵 Started streaming audio playback\n", timestamp);
-                    } else {
-                        printf("[%s] ❌ Failed to start streaming audio playback\n", timestamp);
-                        break;
+                if (incoming_binary_cbor) {
+                    receive_cbor_fragment((const uint8_t *)in, len, message_end, timestamp);
+                    if (message_end) {
+                        printf("> ");
+                        fflush(stdout);
                     }
+                    break;
+                }
+                
+                printf("[%s] 🎵 Received audio chunk (%zu bytes)\n", timestamp, len);
+                
+                // The user interrupted this response; the rest of it is not played
+                if (audio_downlink_suppressed()) {
+                    printf("[%s] 🔇 Dropped audio chunk of the interrupted response\n", timestamp);
+                    break;
                 }
                 
-                // Play the audio chunk
-                if (play_audio_chunk((const unsigned char *)in, len)) {
-                    printf("[%s] ✅ Audio chunk played successfully\n", timestamp);
-                } else {
-                    printf("[%s] ❌ Failed to play audio chunk\n", timestamp);
+                // Hand the chunk to the decoder thread; no codec work on the service loop.
+                // Without a tts_start first, the chunk starts an utterance of its own.
+                if (!play_audio_chunk((const unsigned char *)in, len)) {
+                    printf("[%s] ❌ Failed to queue audio chunk\n", timestamp);
                 }
                 
                 printf("> ");
@@ -170,57 +654,24 @@ int websocket_callback(struct lws *wsi, enum lws_callback_reasons reason,
                 break;
             }
 
-            // Handle text messages (transcription responses)
-            // Append incoming data to buffer
-            if (incoming_buffer_len + len < INCOMING_BUFFER_SIZE) {
-                memcpy(incoming_buffer + incoming_buffer_len, in, len);
-                incoming_buffer_len += len;
-                incoming_buffer[incoming_buffer_len] = '\0';
-            } else {
-                printf("❌ Incoming buffer overflow, clearing buffer\n");
-                incoming_buffer_len = 0;
-                incoming_buffer[0] = '\0';
-            }
-
-            // Try to parse as JSON transcription message
-            if (strstr(incoming_buffer, "\"type\":\"transcription\"") != NULL) {
-                // Parse transcription message
-                char *text_start = strstr(incoming_buffer, "\"text\":\"");
-                char *session_start = strstr(incoming_buffer, "\"session_id\":\"");
-                
-                if (text_start && session_start) {
-                    text_start += 8; // Skip "text":"
-                    session_start += 14; // Skip "session_id":"
-                    
-                    char *text_end = strchr(text_start, '"');
-                    char *session_end = strchr(session_start, '"');
-                    
-                    if (text_end && session_end) {
-                        char session_id[64] = {0};
-                        char transcription_text[1024] = {0};
-                        
-                        size_t session_len = session_end - session_start;
-                        size_t text_len = text_end - text_start;
-                        
-                        if (session_len < sizeof(session_id) && text_len < sizeof(transcription_text)) {
-                            strncpy(session_id, session_start, session_len);
-                            strncpy(transcription_text, text_start, text_len);
-                            
-                            printf("[%s] 🎤 Transcription (Session: %s): %s\n", 
-                                   timestamp, session_id, transcription_text);
-                        }
-                    }
-                } else {
-                    printf("[%s] Server: %s\n", timestamp, incoming_buffer);
-                }
-            } else {
-                // Display the raw text response from server
-                printf("[%s] Server: %s\n", timestamp, incoming_buffer);
+            // Handle text messages (transcription responses), parsed as their fragments
+            // arrive; a base64 audio member starts playing before the message ends
+            if (!incoming_active) {
+                incoming_active = 1;
+                json_message_reset(&incoming_message);
+                json_audio_reset(&incoming_audio);
+                incoming_preview_len = 0;
+                incoming_preview[0] = '\0';
             }
+            append_incoming_preview((const char *)in, len);
+            json_message_feed(&incoming_message, (const char *)in, len);
             
-            // Clear buffer after processing
-            incoming_buffer_len = 0;
-            incoming_buffer[0] = '\0';
+            if (!message_end) {
+                break;
+            }
+            incoming_active = 0;
+            finish_json_audio(timestamp);
+            handle_incoming_message(timestamp);
 
             printf("> ");
             fflush(stdout);
@@ -228,25 +679,28 @@ int websocket_callback(struct lws *wsi, enum lws_callback_reasons reason,
         }
         
         case LWS_CALLBACK_CLIENT_RECEIVE_PONG:
-            // Pong received - connection is healthy, no need to display
+            // Pong received - connection is healthy; the next ping is due in an interval
+            ping_sent_at = 0;
+            lws_sul_schedule(websocket_context, 0, &keepalive_timer, keepalive_expired,
+                             (lws_usec_t)KEEPALIVE_INTERVAL_MS * LWS_US_PER_MS);
             break;
             
         case LWS_CALLBACK_CLOSED:
+        case LWS_CALLBACK_CLIENT_CLOSED:
             printf("🔌 Connection closed\n");
-            websocket_connection = NULL;
+            connection_lost();
+            break;
             
-            // Stop streaming audio playback
-            if (is_streaming_audio_active()) {
-                stop_streaming_audio_playback();
+        case LWS_CALLBACK_EVENT_WAIT_CANCELLED:
+            // Another thread queued a message; only this one may touch the connection
+            if (atomic_exchange(&write_requested, 0) && websocket_connection) {
+                lws_callback_on_writable(websocket_connection);
             }
-            
-            should_exit = 1;
             break;
             
         case LWS_CALLBACK_CLIENT_CONNECTION_ERROR:
-            printf("❌ Connection error occurred\n");
-            websocket_connection = NULL;
-            should_exit = 1;
+            printf("❌ Connection error: %s\n", in ? (const char *)in : "unknown");
+            connection_lost();
             break;
             
         default:
@@ -256,13 +710,28 @@ int websocket_callback(struct lws *wsi, enum lws_callback_reasons reason,
 }
 
 // WebSocket protocol definition
+// The first entry is what lws binds when the server names no subprotocol
 static struct lws_protocols protocols[] = {
     {
-        "websocket",           // Protocol name
+        WS_PROTOCOL_JSON,      // Protocol name
         websocket_callback,    // Callback function
         0,                     // Per-session data size
         MAX_MESSAGE_LENGTH,    // Max frame size - match MAX_MESSAGE_LENGTH
-        0, NULL, 0             // Additional parameters
+        CONTROL_ENCODING_JSON, // id: control message encoding
+        NULL, 0                // Additional parameters
+    },
+    {
+        WS_PROTOCOL_CBOR,      // Same messages, CBOR-encoded control messages
+        websocket_callback,
+        0,
+        MAX_MESSAGE_LENGTH,
+        CONTROL_ENCODING_CBOR,
+        NULL, 0
+    },
+    {
+        INPUT_PROTOCOL_NAME,   // stdin, adopted as a raw file by start_input_thread()
+        input_stdin_callback,
+        0, 0, 0, NULL, 0
     },
     { NULL, NULL, 0, 0, 0, NULL, 0 }  // Terminator
 };
@@ -271,6 +740,62 @@ static struct lws_protocols protocols[] = {
 void signal_handler(int signal) {
     printf("\n🛑 Received signal %d, shutting down...\n", signal);
     should_exit = 1;
+    
+    // The service loop may be asleep with nothing else due
+    if (websocket_context) {
+        lws_cancel_service(websocket_context);
+    }
+}
+
+// Queue-side half of a send from another thread: lws_callback_on_writable() is only
+// safe on the service thread, so flag it and wake that thread up
+void websocket_request_write(void) {
+    atomic_store(&write_requested, 1);
+    if (websocket_context) {
+        lws_cancel_service(websocket_context);
+    }
+}
+
+void websocket_reconnect_bench(void) {
+    if (bench_active) {
+        printf("⏳ Reconnect benchmark already running\n");
+        return;
+    }
+    if (!websocket_connection) {
+        printf("❌ Not connected\n");
+        return;
+    }
+    
+    printf("📊 Reconnect benchmark: %d forced drops\n", RECONNECT_BENCH_ROUNDS);
+    bench_active = 1;
+    bench_drops_left = RECONNECT_BENCH_ROUNDS;
+    bench_count = 0;
+    bench_drop(NULL);
+}
+
+int websocket_send_control(const char *type, const char *key, const char *value) {
+    message_queue_status_t status;
+    
+    if (control_encoding == CONTROL_ENCODING_CBOR) {
+        uint8_t message[256];
+        size_t length = control_message_encode_cbor(message, sizeof(message), type, key, value);
+        status = length ? add_binary_control_message_to_queue(message, length) : MESSAGE_REJECTED;
+    } else {
+        char message[256];
+        if (key) {
+            snprintf(message, sizeof(message), "{\"type\":\"%s\",\"%s\":\"%s\"}", type, key, value);
+        } else {
+            snprintf(message, sizeof(message), "{\"type\":\"%s\"}", type);
+        }
+        status = add_control_message_to_queue(message);
+    }
+    
+    if (status == MESSAGE_REJECTED) {
+        printf("❌ Failed to queue %s message\n", type);
+        return 0;
+    }
+    websocket_request_write();
+    return 1;
 }
 
 // Initialize WebSocket client
@@ -278,6 +803,9 @@ int init_websocket_client(void) {
     // Enable libwebsockets logging
     lws_set_log_level(LOG_LEVELS, NULL);
     
+    json_audio_init(&incoming_audio, play_json_audio, NULL);
+    json_message_init(&incoming_message, feed_json_audio, end_json_audio, &incoming_audio);
+    
     // Create WebSocket context
     struct lws_context_creation_info context_info;
     memset(&context_info, 0, sizeof(context_info));
@@ -304,24 +832,19 @@ void cleanup_websocket_client(void) {
     }
 }
 
-// Connect to server
+// Connect to server; a drop after this reconnects on its own
 int connect_to_server(void) {
-    // Set up connection information
-    struct lws_client_connect_info connection_info;
-    memset(&connection_info, 0, sizeof(connection_info));
-    
-    connection_info.context = websocket_context;
-    connection_info.address = SERVER_ADDRESS;
-    connection_info.port = SERVER_PORT;
-    connection_info.path = WEBSOCKET_PATH;
-    connection_info.host = SERVER_ADDRESS;
-    connection_info.origin = SERVER_ADDRESS;
-    connection_info.protocol = protocols[0].name;
-    connection_info.ssl_connection = 0;  // No SSL for local testing
+    if (!reconnect_resolve(SERVER_ADDRESS, SERVER_PORT, server_address, sizeof(server_address))) {
+        printf("❌ Cannot resolve %s\n", SERVER_ADDRESS);
+        return 0;
+    }
+    reconnect_seed = (uint32_t)lws_now_usecs() ^ (uint32_t)getpid();
     
     // Attempt to connect
-    if (!lws_client_connect_via_info(&connection_info)) {
+    reconnect_state = RECONNECT_CONNECTING;
+    if (!open_connection()) {
         printf("❌ Failed to initiate connection\n");
+        reconnect_state = RECONNECT_IDLE;
         return 0;
     }
     
@@ -330,6 +853,12 @@ int connect_to_server(void) {
 
 // Disconnect from server
 void disconnect_from_server(void) {
+    reconnect_state = RECONNECT_STOPPED;
+    bench_active = 0;
+    lws_sul_cancel(&reconnect_timer);
+    lws_sul_cancel(&keepalive_timer);
+    lws_sul_cancel(&bench_timer);
+    
     if (websocket_connection) {
         lws_callback_on_writable(websocket_connection);
         websocket_connection = NULL;
@@ -10,6 +10,16 @@ void cleanup_websocket_client(void);
 int connect_to_server(void);
 void disconnect_from_server(void);
 
+// Have the service thread flush the send queue; any thread, after queueing a message
+void websocket_request_write(void);
+
+// Force RECONNECT_BENCH_ROUNDS drops and report how fast each one recovered (service thread)
+void websocket_reconnect_bench(void);
+
+// Queue {"type": type, key: value} on the control lane in the negotiated encoding
+// (key NULL for none) and flush it; any thread. Returns 1 if it was queued.
+int websocket_send_control(const char *type, const char *key, const char *value);
+
 // Global WebSocket variables (extern for access from other modules)
 extern struct lws *websocket_connection;
 extern struct lws_context *websocket_context;
@@ -0,0 +1,436 @@
+#include "ws_uplink.h"
+#include "audio.h"
+#include "message_queue.h"
+#include "websocket_client.h"
+#include "metrics.h"
+#include "trace.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+// Open utterance (uplink_mutex): begin, the capture sink and end may each run on
+// a different thread, but never at the same time for one utterance. The link
+// events and the ack come from the service thread.
+static pthread_mutex_t uplink_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int uplink_active = 0;
+static const uplink_codec_t *uplink_codec = NULL;
+static unsigned int utterance_counter = 0;
+static uint32_t next_sequence = 0;
+static uint32_t last_timestamp = 0;
+
+// Replay window (uplink_mutex): frames from oldest to newest, back to back in a
+// byte ring. A frame that would run past the end starts over at 0, so each one
+// is contiguous and goes into a pool buffer with a single copy.
+typedef struct {
+    unsigned char *data;            // In replay_data, or reopen_begin
+    size_t length;                  // Header included
+    unsigned int utterance;
+    uint32_t sequence;
+} replay_frame_t;
+
+static unsigned char replay_data[WS_UPLINK_REPLAY_BYTES];
+static replay_frame_t replay_frames[WS_UPLINK_REPLAY_FRAMES];
+static unsigned char reopen_begin[WS_UPLINK_HEADER_BYTES + WS_UPLINK_BEGIN_BYTES];  // Put in front of a reopened utterance
+static size_t replay_first = 0;         // Index of the oldest frame
+static size_t replay_count = 0;
+static size_t replay_queued = 0;        // Frames from the oldest on that went to the audio lane
+static int link_up = 1;                 // Down from a drop to the reconnect
+static int acks_seen = 0;               // Without acks, a frame that was sent counts as delivered
+static uint64_t link_down_at = 0;       // trace_now_us()
+static size_t lost_bytes = 0;           // Pushed out of the window unsent since the drop
+static unsigned int lost_frames = 0;
+static atomic_int replay_backlog = 0;   // Frames wait for room on the audio lane
+
+// Codec ids the server reassembles, one bit each; 0 until a handshake names some
+static atomic_uint server_codecs = 0;
+
+static void put_u16(unsigned char *out, unsigned int value) {
+    out[0] = (unsigned char)(value >> 8);
+    out[1] = (unsigned char)value;
+}
+
+static void put_u32(unsigned char *out, uint32_t value) {
+    out[0] = (unsigned char)(value >> 24);
+    out[1] = (unsigned char)(value >> 16);
+    out[2] = (unsigned char)(value >> 8);
+    out[3] = (unsigned char)value;
+}
+
+static void put_header(unsigned char *out, ws_uplink_frame_t type, unsigned int utterance,
+                       uint32_t sequence, uint32_t timestamp) {
+    out[0] = (unsigned char)type;
+    out[1] = (unsigned char)uplink_codec->id;
+    put_u16(out + 2, utterance);
+    put_u32(out + 4, sequence);
+    put_u32(out + 8, timestamp);
+}
+
+// Frame index from the oldest one
+static replay_frame_t* replay_frame(size_t index) {
+    return &replay_frames[(replay_first + index) % WS_UPLINK_REPLAY_FRAMES];
+}
+
+// Release the oldest frame: acknowledged, or pushed out by a newer one
+static void drop_oldest_locked(void) {
+    replay_frame_t *frame = replay_frame(0);
+    if (replay_queued > 0) {
+        replay_queued--;
+    } else {
+        lost_bytes += frame->length;
+        lost_frames++;
+        metrics_add(METRIC_UPLINK_LOST_BYTES, frame->length);
+    }
+    replay_first = (replay_first + 1) % WS_UPLINK_REPLAY_FRAMES;
+    replay_count--;
+}
+
+// Offset in replay_data where length bytes fit without overwriting a frame, -1 if
+// they do not
+static long replay_space(size_t length) {
+    size_t oldest = replay_count > 0 && replay_frame(0)->data == reopen_begin ? 1 : 0;
+    if (oldest >= replay_count) {
+        return 0;
+    }
+
+    size_t start = (size_t)(replay_frame(oldest)->data - replay_data);
+    replay_frame_t *newest = replay_frame(replay_count - 1);
+    size_t end = (size_t)(newest->data - replay_data) + newest->length;
+    if (end > start) {
+        if (end + length <= WS_UPLINK_REPLAY_BYTES) {
+            return (long)end;
+        }
+        return length <= start ? 0 : -1;
+    }
+    return end + length <= start ? (long)end : -1;
+}
+
+// Build the next frame into the replay window, pushing the oldest ones out if it
+// is full (uplink_mutex held). pump_locked() sends it.
+static int append_frame_locked(ws_uplink_frame_t type, uint32_t timestamp,
+                               const unsigned char *payload, size_t size) {
+    size_t length = WS_UPLINK_HEADER_BYTES + size;
+    if (length > WS_UPLINK_REPLAY_BYTES / 4) {
+        metrics_add(METRIC_WS_QUEUE_REJECTED, 1);
+        return 0;
+    }
+
+    long offset = replay_space(length);
+    while (replay_count == WS_UPLINK_REPLAY_FRAMES || offset < 0) {
+        drop_oldest_locked();
+        offset = replay_space(length);
+    }
+
+    replay_frame_t *frame = replay_frame(replay_count);
+    frame->data = replay_data + offset;
+    frame->length = length;
+    frame->utterance = utterance_counter;
+    frame->sequence = next_sequence++;  // A rejected frame takes no number: a gap is real loss
+    replay_count++;
+
+    put_header(frame->data, type, frame->utterance, frame->sequence, timestamp);
+    if (size > 0) {
+        memcpy(frame->data + WS_UPLINK_HEADER_BYTES, payload, size);
+    }
+    return 1;
+}
+
+// Copy the frames not sent yet onto the audio lane, in order, until it passes its
+// high water mark; the rest follows from ws_uplink_pump() as it drains
+// (uplink_mutex held). Returns how many were queued.
+static unsigned int pump_locked(void) {
+    unsigned int queued = 0;
+
+    while (link_up && replay_queued < replay_count) {
+        replay_frame_t *frame = replay_frame(replay_queued);
+        message_buffer_t *buffer = message_buffer_acquire(frame->length);
+        if (!buffer) {
+            break;
+        }
+        memcpy(buffer->data, frame->data, frame->length);
+        buffer->length = frame->length;
+        buffer->is_binary = 1;
+
+        message_queue_status_t status = message_queue_push(buffer, MESSAGE_LANE_AUDIO);
+        if (status == MESSAGE_REJECTED) {
+            break;
+        }
+        replay_queued++;
+        queued++;
+        if (status == MESSAGE_QUEUED_SLOW_DOWN) {
+            break;
+        }
+    }
+    atomic_store(&replay_backlog, link_up && replay_queued < replay_count);
+    return queued;
+}
+
+// Start a new utterance number with its begin frame (uplink_mutex held)
+static int append_begin_locked(void) {
+    utterance_counter = (utterance_counter + 1) & 0xFFFF;
+    next_sequence = 0;
+    last_timestamp = 0;
+
+    unsigned char begin[WS_UPLINK_BEGIN_BYTES];
+    put_u32(begin, SAMPLE_RATE);
+    return append_frame_locked(WS_UPLINK_FRAME_BEGIN, 0, begin, sizeof(begin));
+}
+
+// The server lost every utterance with the old session. Each one still whole in
+// the window goes up again under a new number. The open utterance gets a begin
+// frame in front of what is left of it. Anything else cannot be replayed.
+static void renumber_locked(void) {
+    if (replay_count > 0 && replay_frame(0)->data[0] != WS_UPLINK_FRAME_BEGIN) {
+        unsigned int partial = replay_frame(0)->utterance;
+        if (uplink_active && partial == utterance_counter) {
+            if (replay_count == WS_UPLINK_REPLAY_FRAMES) {
+                drop_oldest_locked();
+            }
+            replay_first = (replay_first + WS_UPLINK_REPLAY_FRAMES - 1) % WS_UPLINK_REPLAY_FRAMES;
+            replay_count++;
+
+            replay_frame_t *frame = replay_frame(0);
+            frame->data = reopen_begin;
+            frame->length = sizeof(reopen_begin);
+            put_header(reopen_begin, WS_UPLINK_FRAME_BEGIN, partial, 0, 0);
+            put_u32(reopen_begin + WS_UPLINK_HEADER_BYTES, SAMPLE_RATE);
+        } else {
+            while (replay_count > 0 && replay_frame(0)->utterance == partial) {
+                drop_oldest_locked();
+            }
+        }
+    }
+
+    // Nothing of the open utterance left to replay: the rest of it starts afresh
+    if (uplink_active && (replay_count == 0 || replay_frame(replay_count - 1)->utterance != utterance_counter)) {
+        append_begin_locked();
+    }
+
+    for (size_t i = 0; i < replay_count; i++) {
+        replay_frame_t *frame = replay_frame(i);
+        if (frame->data[0] == WS_UPLINK_FRAME_BEGIN) {
+            utterance_counter = (utterance_counter + 1) & 0xFFFF;
+            next_sequence = 0;
+        }
+        frame->utterance = utterance_counter;
+        frame->sequence = next_sequence++;
+        put_u16(frame->data + 2, frame->utterance);
+        put_u32(frame->data + 4, frame->sequence);
+    }
+}
+
+void ws_uplink_set_server_codecs(const char *codecs) {
+    unsigned int mask = 0;
+    char list[WS_UPLINK_CODECS_MAX];
+
+    if (codecs) {
+        snprintf(list, sizeof(list), "%s", codecs);
+        char *save = NULL;
+        for (char *name = strtok_r(list, ", ", &save); name; name = strtok_r(NULL, ", ", &save)) {
+            const uplink_codec_t *codec = codec_find(name);
+            if (codec) {
+                mask |= 1u << codec->id;
+            }
+        }
+    }
+    atomic_store(&server_codecs, mask);
+}
+
+int ws_uplink_begin(void) {
+    if (!WS_UPLINK_ENABLED || !websocket_connection) {
+        return 0;
+    }
+
+    // The handshake named what the server can reassemble; anything else goes over HTTP
+    unsigned int accepted = atomic_load(&server_codecs);
+    const uplink_codec_t *preferred[4];
+    const uplink_codec_t *codec = NULL;
+    size_t count = codec_preference_list(preferred, 4);
+    for (size_t i = 0; i < count && !codec; i++) {
+        if (accepted & (1u << preferred[i]->id)) {
+            codec = preferred[i];
+        }
+    }
+    if (!codec) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&uplink_mutex);
+    uplink_codec = codec;
+    uplink_active = append_begin_locked();
+    int result = uplink_active;
+    unsigned int queued = pump_locked();
+    pthread_mutex_unlock(&uplink_mutex);
+
+    if (queued) {
+        websocket_request_write();
+    }
+    if (result) {
+        printf("✅ Streaming over the WebSocket (%s uplink)\n", codec->name);
+    }
+    return result;
+}
+
+int ws_uplink_active(void) {
+    pthread_mutex_lock(&uplink_mutex);
+    int active = uplink_active;
+    pthread_mutex_unlock(&uplink_mutex);
+    return active;
+}
+
+const uplink_codec_t* ws_uplink_codec(void) {
+    pthread_mutex_lock(&uplink_mutex);
+    const uplink_codec_t *codec = uplink_active ? uplink_codec : NULL;
+    pthread_mutex_unlock(&uplink_mutex);
+    return codec;
+}
+
+int ws_uplink_send(const unsigned char *data, size_t size, uint64_t position) {
+    if (!data || size == 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&uplink_mutex);
+    int result = 0;
+    unsigned int queued = 0;
+    if (uplink_active) {
+        last_timestamp = (uint32_t)position;
+        result = append_frame_locked(WS_UPLINK_FRAME_AUDIO, last_timestamp, data, size);
+        queued = pump_locked();
+    }
+    pthread_mutex_unlock(&uplink_mutex);
+
+    if (queued) {
+        websocket_request_write();
+    }
+    if (result) {
+        trace_event(TRACE_CHUNK_SENT, size);
+    }
+    return result;
+}
+
+int ws_uplink_end(void) {
+    pthread_mutex_lock(&uplink_mutex);
+    if (!uplink_active) {
+        pthread_mutex_unlock(&uplink_mutex);
+        return 0;
+    }
+
+    // The turn's clock starts here: everything after is waiting for the answer
+    trace_event(TRACE_USER_STOP, 0);
+
+    int result = append_frame_locked(WS_UPLINK_FRAME_END, last_timestamp, NULL, 0);
+    uplink_active = 0;
+    uint32_t frames = next_sequence;
+    unsigned int queued = pump_locked();
+    int held = !link_up;
+    pthread_mutex_unlock(&uplink_mutex);
+
+    if (queued) {
+        websocket_request_write();
+    }
+    if (result && held) {
+        printf("🏁 Utterance held for the reconnect (%u frames)\n", frames);
+    } else if (result) {
+        printf("🏁 Utterance sent over the WebSocket (%u frames)\n", frames);
+    } else {
+        printf("❌ Failed to queue the end of the utterance\n");
+    }
+    return result;
+}
+
+void ws_uplink_ack(unsigned int utterance, uint32_t sequence) {
+    pthread_mutex_lock(&uplink_mutex);
+    acks_seen = 1;
+
+    // Only a frame that went out can be acknowledged; an ack of anything else is stale
+    for (size_t i = 0; i < replay_queued; i++) {
+        replay_frame_t *frame = replay_frame(i);
+        if (frame->utterance == (utterance & 0xFFFF) && frame->sequence == sequence) {
+            for (size_t n = 0; n <= i; n++) {
+                drop_oldest_locked();
+            }
+            break;
+        }
+    }
+    pthread_mutex_unlock(&uplink_mutex);
+}
+
+void ws_uplink_link_down(void) {
+    pthread_mutex_lock(&uplink_mutex);
+    unsigned int dropped = message_queue_discard(MESSAGE_LANE_AUDIO);
+    link_up = 0;
+    link_down_at = trace_now_us();
+    lost_bytes = 0;
+    lost_frames = 0;
+
+    // A server that never acknowledged anything gets what it already had once
+    // only: the frames that left the lane before the drop are taken as delivered
+    if (!acks_seen) {
+        size_t sent = replay_queued > dropped ? replay_queued - dropped : 0;
+        for (size_t n = 0; n < sent; n++) {
+            drop_oldest_locked();
+        }
+    }
+    replay_queued = 0;
+    atomic_store(&replay_backlog, 0);
+    pthread_mutex_unlock(&uplink_mutex);
+}
+
+void ws_uplink_link_up(int resumed) {
+    pthread_mutex_lock(&uplink_mutex);
+    if (link_up) {
+        pthread_mutex_unlock(&uplink_mutex);
+        return;
+    }
+
+    uint64_t gap_ms = (trace_now_us() - link_down_at) / 1000;
+
+    // A server that no longer takes the codec would read the frames as clips:
+    // the window is given up and the link stays down for the open utterance
+    if (replay_count > 0 && !(atomic_load(&server_codecs) & (1u << uplink_codec->id))) {
+        while (replay_count > 0) {
+            drop_oldest_locked();
+        }
+        pthread_mutex_unlock(&uplink_mutex);
+        printf("⚠️  Server no longer takes %s uplink frames, dropping the replay\n", uplink_codec->name);
+        return;
+    }
+    link_up = 1;
+    if (!resumed) {
+        renumber_locked();
+    }
+
+    size_t frames = replay_count;
+    size_t bytes = 0;
+    for (size_t i = 0; i < replay_count; i++) {
+        bytes += replay_frame(i)->length;
+    }
+    unsigned int open_utterance = uplink_active ? utterance_counter : 0;
+    size_t lost = lost_bytes;
+    unsigned int lost_count = lost_frames;
+    pump_locked();
+    pthread_mutex_unlock(&uplink_mutex);
+
+    metrics_observe(METRIC_UPLINK_GAP_MS, gap_ms);
+    if (frames > 0) {
+        metrics_add(METRIC_UPLINK_REPLAYED_BYTES, bytes);
+        printf("♻️  Uplink back after a %llu ms gap, replaying %zu frames (%zu bytes)\n",
+               (unsigned long long)gap_ms, frames, bytes);
+    }
+    if (!resumed && open_utterance) {
+        printf("🎤 Utterance continues as utterance %u\n", open_utterance);
+    }
+    if (lost_count > 0) {
+        printf("⚠️  %u uplink frames (%zu bytes) could not be kept for the replay\n", lost_count, lost);
+    }
+}
+
+void ws_uplink_pump(void) {
+    if (!atomic_load(&replay_backlog)) {
+        return;
+    }
+    pthread_mutex_lock(&uplink_mutex);
+    pump_locked();
+    pthread_mutex_unlock(&uplink_mutex);
+}
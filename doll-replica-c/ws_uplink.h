@@ -0,0 +1,62 @@
+#ifndef WS_UPLINK_H
+#define WS_UPLINK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "codec.h"
+
+// WebSocket uplink configuration
+#define WS_UPLINK_ENABLED 1             // Stream utterances up the WebSocket when the server takes them; 0 always uses HTTP
+#define WS_UPLINK_CODECS_HEADER "x-doll-uplink:"   // Handshake answer: codecs the server reassembles frames in
+#define WS_UPLINK_CODECS_MAX 64
+#define WS_UPLINK_HEADER_BYTES 12
+#define WS_UPLINK_BEGIN_BYTES 4         // Begin frame payload: sample rate
+#define WS_UPLINK_REPLAY_BYTES (256 * 1024)     // Replay window: about 30 s of mu-law, more with the other codecs
+#define WS_UPLINK_REPLAY_FRAMES 2048            // Frames the window indexes, headers included
+
+// Binary frame layout, all fields in network byte order:
+//   0  type       ws_uplink_frame_t
+//   1  codec      uplink_codec_t.id
+//   2  utterance  16-bit counter, one per begin
+//   4  sequence   32-bit, from 0 at begin; a gap means frames were dropped
+//   8  timestamp  32-bit, in samples at the uplink rate from the start of the
+//                 utterance; suppressed silence (DTX) shows up as a jump
+//  12  payload    encoded audio, or the begin fields
+//
+// Frames stay in a replay window until the server acknowledges them with
+// {"type":"uplink_ack","utterance_id":U,"sequence":S}, which covers every frame up
+// to and including that one. After a reconnect the window goes up again from the
+// first frame not acknowledged, so the server must drop sequence numbers it has.
+typedef enum {
+    WS_UPLINK_FRAME_AUDIO = 1,
+    WS_UPLINK_FRAME_BEGIN = 2,      // Payload: 32-bit sample rate
+    WS_UPLINK_FRAME_END = 3,        // Timestamp: that of the last audio frame
+} ws_uplink_frame_t;
+
+// Codecs the server named in its handshake answer, comma separated; NULL when it
+// sent none, which keeps every utterance on HTTP (service thread)
+void ws_uplink_set_server_codecs(const char *codecs);
+
+// Open an utterance on the connected WebSocket with the first codec in
+// UPLINK_CODEC_PREFERENCE that the server named. Returns 0 when the WebSocket
+// cannot take it, so the caller uses HTTP.
+int ws_uplink_begin(void);
+int ws_uplink_active(void);
+const uplink_codec_t* ws_uplink_codec(void);    // Codec of the open utterance
+
+// Queue one batch of encoded audio from the capture sink (uplink thread);
+// position is where it starts, as capture_sink_position() reports it. While the
+// link is down the frame is only kept in the replay window.
+int ws_uplink_send(const unsigned char *data, size_t size, uint64_t position);
+int ws_uplink_end(void);
+
+// Link events, all on the service thread
+void ws_uplink_ack(unsigned int utterance, uint32_t sequence);
+void ws_uplink_link_down(void);         // What was queued is dropped; the window keeps it
+// Reconnected: resend the window. A new session lost every utterance, so the ones
+// still whole in the window go up again under new numbers, and an utterance still
+// being recorded goes on as a new one.
+void ws_uplink_link_up(int resumed);
+void ws_uplink_pump(void);              // Queue more of a replay as the audio lane drains
+
+#endif // WS_UPLINK_H
@@ -9,6 +9,7 @@
 #define SAMPLE_RATE 16000
 #define CHANNELS 1
 #define FRAMES_PER_BUFFER 512
+#define PLAYBACK_AUDIO_FORMAT "linear16;rate=16000" // Advertised in the x-audio-accept handshake header
 
 int playback_init(PaStream **stream);
 void playback_close(PaStream *stream);
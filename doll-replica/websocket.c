@@ -1,5 +1,6 @@
 // websocket.c: WebSocket implementation using libwebsockets
 #include "websocket.h"
+#include "playback.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -20,7 +21,7 @@ static int ws_callback(struct lws *wsi, enum lws_callback_reasons reason,
             char auth_header[1024];
             snprintf(auth_header, sizeof(auth_header), "Bearer %s", ws_jwt_token);
             unsigned char **p = (unsigned char **)in;
-            unsigned char *end = (unsigned char *)in + len;
+            unsigned char *end = *p + len;
             if (lws_add_http_header_by_name(wsi,
                     (const unsigned char *)"authorization",
                     (const unsigned char *)auth_header,
@@ -28,6 +29,14 @@ static int ws_callback(struct lws *wsi, enum lws_callback_reasons reason,
                 printf("❌ Failed to add Authorization header\n");
                 return 1;
             }
+            // Playback writes raw frames straight to the device, so only its native format works
+            if (lws_add_http_header_by_name(wsi,
+                    (const unsigned char *)"x-audio-accept:",
+                    (const unsigned char *)PLAYBACK_AUDIO_FORMAT,
+                    strlen(PLAYBACK_AUDIO_FORMAT), p, end)) {
+                printf("❌ Failed to add audio accept header\n");
+                return 1;
+            }
             break;
         }
         default: